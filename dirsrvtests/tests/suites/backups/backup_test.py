@@ -6,6 +6,7 @@ from lib389._constants import DEFAULT_SUFFIX, INSTALL_LATEST_CONFIG
 from lib389.properties import BACKEND_SAMPLE_ENTRIES, TASK_WAIT
 from lib389.topologies import topology_st as topo
 from lib389.backend import Backend
+from lib389.idm.user import UserAccounts
 from lib389.tasks import BackupTask, RestoreTask
 from lib389.config import BDB_LDBMConfig
 from lib389 import DSEldif
@@ -99,6 +100,64 @@ def test_db_home_dir_online_backup(topo):
         assert topo.standalone.ds_error_log.match(f".*Failed renaming {backup_dir}.bak back to {backup_dir}")
 
 
+@pytest.mark.skipif(get_default_db_lib() != "mdb", reason="Only supported over mdb")
+def test_mdb_incremental_backup(topo):
+    """Test that an incremental backup only stores the changed chunks
+    and that restoring it rebuilds the database of the backup time.
+
+    :id: 0c6f1d2e-7b4a-4c55-9a3e-5e8d2f1b7c90
+    :setup: Standalone Instance
+    :steps:
+        1. Perform a full backup
+        2. Add some users then perform an incremental backup on top of the full one
+        3. Check the incremental backup files
+        4. Add other users then restore the incremental backup
+        5. Check the users
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The backup contains a delta smaller than the full map copy
+        4. Success
+        5. Only the users added before the incremental backup exist
+    """
+    inst = topo.standalone
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    now = datetime.now().strftime("%Y_%m_%d_%H_%M_%S")
+    full = os.path.join(inst.ds_paths.backup_dir, f"full-{now}")
+    incr = os.path.join(inst.ds_paths.backup_dir, f"incr-{now}")
+
+    backup_task = BackupTask(inst)
+    backup_task.create(properties={'nsArchiveDir': full})
+    backup_task.wait()
+    assert backup_task.get_exit_code() == 0
+
+    before = [users.create_test_user(uid=3000 + i) for i in range(20)]
+
+    backup_task = BackupTask(inst)
+    backup_task.create(properties={'nsArchiveDir': incr, 'nsIncrementalBase': full})
+    backup_task.wait()
+    assert backup_task.get_exit_code() == 0
+
+    assert not os.path.exists(os.path.join(incr, 'data.mdb'))
+    assert os.path.exists(os.path.join(incr, 'data.mdb.sums'))
+    delta_size = os.path.getsize(os.path.join(incr, 'data.mdb.delta'))
+    assert delta_size < os.path.getsize(os.path.join(full, 'data.mdb'))
+
+    after = [users.create_test_user(uid=3100 + i) for i in range(20)]
+
+    restore_task = RestoreTask(inst)
+    restore_task.create(properties={'nsArchiveDir': incr})
+    restore_task.wait()
+    assert restore_task.get_exit_code() == 0
+
+    for user in before:
+        assert user.exists()
+    for user in after:
+        assert not user.exists()
+    for user in before:
+        user.delete()
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
@@ -70,6 +70,42 @@ def test_dsctl_dbverify(topology_st, set_log_file):
         assert message in file_content
 
 
+@pytest.mark.skipif(get_default_db_lib() != "mdb", reason="Online verify is only supported over mdb")
+def test_online_dbverify(topology_st):
+    """Test the dbverify task on a running server
+
+    :id: 7d3e5c1a-2b8f-4f6e-9c0d-1a4b6e8f2d35
+    :setup: Standalone instance
+    :steps:
+         1. Add some users
+         2. Run the dbverify task with a full cross check
+         3. Run the dbverify task with a sampled cross check
+    :expectedresults:
+         1. Success
+         2. The task succeeds and reports the verified indexes
+         3. The task succeeds
+    """
+    from lib389.idm.user import UserAccounts
+
+    standalone = topology_st.standalone
+    users = UserAccounts(standalone, DEFAULT_SUFFIX)
+    created = [users.create_test_user(uid=4000 + i) for i in range(20)]
+
+    task = DBVerifyTask(standalone)
+    task.create(properties={'nsInstance': DEFAULT_BENAME})
+    task.wait()
+    assert task.get_exit_code() == 0
+    assert 'Verify succeeded' in task.get_attr_val_utf8('nsTaskLog')
+
+    task = DBVerifyTask(standalone)
+    task.create(properties={'nsVerifySampleRate': '7'})
+    task.wait()
+    assert task.get_exit_code() == 0
+
+    for user in created:
+        user.delete()
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
@@ -9,7 +9,7 @@
 import logging
 import time
 import pytest, os, ldap
-from lib389.cos import  CosClassicDefinition, CosClassicDefinitions, CosTemplate
+from lib389.cos import  CosClassicDefinition, CosClassicDefinitions, CosTemplate, CosPointerDefinition
 from lib389._constants import DEFAULT_SUFFIX
 from lib389.topologies import topology_st as topo
 from lib389.idm.role import FilteredRoles
@@ -144,6 +144,70 @@ def test_vattr_on_cos_definition(topo, reset_ignore_vattr):
     topo.standalone.restart()
     assert topo.standalone.config.get_attr_val_utf8('nsslapd-ignore-virtual-attrs') == "on"
 
+def _wait_for_value(entry, attr, value):
+    # The cos cache is updated asynchronously
+    for _ in range(20):
+        if entry.get_attr_val_utf8(attr) == value:
+            return True
+        time.sleep(0.5)
+    return False
+
+
+def test_template_change(topo):
+    """Check that a template change is reflected while other templates stay cached
+
+    :id: 0c4f5b8e-7d2a-4a61-9a3e-5d1f8c2b6e47
+    :setup: Standalone instance
+    :steps:
+        1. Add two pointer cos definitions, each with its own template
+        2. Add a user under both definitions
+        3. Modify the first template
+        4. Delete the first template
+        5. Clean up
+    :expectedresults:
+        1. Success
+        2. The user gets the values of both templates
+        3. The user gets the new value, the second template still applies
+        4. The first value is gone, the second template still applies
+        5. Success
+    """
+    inst = topo.standalone
+    tmpl_a = CosTemplate(inst, 'cn=cosTemplateChangeA,{}'.format(DEFAULT_SUFFIX))
+    tmpl_a.create(properties={'cn': 'cosTemplateChangeA', 'employeeType': 'typeA'})
+    tmpl_b = CosTemplate(inst, 'cn=cosTemplateChangeB,{}'.format(DEFAULT_SUFFIX))
+    tmpl_b.create(properties={'cn': 'cosTemplateChangeB', 'roomNumber': '101'})
+
+    def_a = CosPointerDefinition(inst, 'cn=cosTemplateChangeDefA,{}'.format(DEFAULT_SUFFIX))
+    def_a.create(properties={'cn': 'cosTemplateChangeDefA',
+                             'cosTemplateDn': tmpl_a.dn,
+                             'cosAttribute': 'employeeType'})
+    def_b = CosPointerDefinition(inst, 'cn=cosTemplateChangeDefB,{}'.format(DEFAULT_SUFFIX))
+    def_b.create(properties={'cn': 'cosTemplateChangeDefB',
+                             'cosTemplateDn': tmpl_b.dn,
+                             'cosAttribute': 'roomNumber'})
+
+    user = UserAccount(inst, 'cn=cosTemplateChangeUser,{}'.format(DEFAULT_SUFFIX))
+    user.create(properties={'uid': 'cosTemplateChangeUser',
+                            'cn': 'cosTemplateChangeUser',
+                            'sn': 'user',
+                            'uidNumber': '1001',
+                            'gidNumber': '2001',
+                            'homeDirectory': '/home/cosTemplateChangeUser'})
+
+    assert _wait_for_value(user, 'employeeType', 'typeA')
+    assert _wait_for_value(user, 'roomNumber', '101')
+
+    tmpl_a.replace('employeeType', 'typeB')
+    assert _wait_for_value(user, 'employeeType', 'typeB')
+    assert user.get_attr_val_utf8('roomNumber') == '101'
+
+    tmpl_a.delete()
+    assert _wait_for_value(user, 'employeeType', None)
+    assert user.get_attr_val_utf8('roomNumber') == '101'
+
+    for entry in [user, def_a, def_b, tmpl_b]:
+        entry.delete()
+
 if __name__ == "__main__":
     CURRENT_FILE = os.path.realpath(__file__)
     pytest.main("-s -v %s" % CURRENT_FILE)
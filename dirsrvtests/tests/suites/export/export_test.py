@@ -10,6 +10,8 @@
 import os
 import pytest
 import subprocess
+from ldif import LDIFRecordList
+from ldap.dn import str2dn
 
 from lib389.topologies import topology_st as topo
 from lib389._constants import DEFAULT_SUFFIX, DEFAULT_BENAME
@@ -17,6 +19,9 @@ from lib389.utils import *
 from lib389.paths import Paths
 from lib389.cli_base import FakeArgs
 from lib389.cli_ctl.dbtasks import dbtasks_db2ldif
+from lib389.backend import Backends
+from lib389.idm.user import UserAccounts
+from lib389.idm.organizationalunit import OrganizationalUnits
 
 pytestmark = pytest.mark.tier1
 
@@ -153,3 +158,53 @@ def test_dbtasks_db2ldif_with_non_accessible_ldif_file_path_output(topo):
     log.info("Restarting the instance...")
     topo.standalone.start()
 
+
+def test_export_order_and_count(topo):
+    """Check an export writes every entry once, parents before children
+
+    :id: 2c4f8e1a-6b3d-4f0e-a9c7-5d1e8b2f7a40
+    :setup: Standalone Instance
+    :steps:
+        1. Add users, then an OU, and move some users under the OU
+           so that their parent has a higher entry ID
+        2. Export the backend with a task
+        3. Read the LDIF
+    :expectedresults:
+        1. Success
+        2. The task succeeds
+        3. Each entry is written once, after its parent
+    """
+    inst = topo.standalone
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    created = [users.create_test_user(uid=6000 + i) for i in range(2500)]
+    ou = OrganizationalUnits(inst, DEFAULT_SUFFIX).create(properties={'ou': 'export_order'})
+    for user in created[:100]:
+        user.rename(user.rdn, newsuperior=ou.dn)
+
+    ldif_file = os.path.join(inst.get_ldif_dir(), 'export_order.ldif')
+    be = Backends(inst).get(DEFAULT_BENAME)
+    task = be.export_ldif(ldif=ldif_file)
+    task.wait()
+    assert task.get_exit_code() == 0
+
+    def dn_key(dn):
+        return tuple(tuple(tuple(ava[:2]) for ava in rdn) for rdn in str2dn(dn.lower()))
+
+    seen = set()
+    with open(ldif_file) as f:
+        records = LDIFRecordList(f)
+        records.parse()
+    for dn, _ in records.all_records:
+        key = dn_key(dn)
+        assert key not in seen
+        if key != dn_key(DEFAULT_SUFFIX):
+            assert key[1:] in seen
+        seen.add(key)
+    assert dn_key(ou.dn) in seen
+    for user in created:
+        assert dn_key(user.dn) in seen
+
+    for user in created:
+        user.delete()
+    ou.delete()
+    os.remove(ldif_file)
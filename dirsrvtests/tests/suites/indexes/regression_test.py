@@ -16,8 +16,10 @@ from lib389.backend import Backends, DatabaseConfig
 from lib389.idm.user import UserAccounts
 from lib389.idm.group import Groups, Group
 from lib389.topologies import topology_st as topo
-from lib389.utils import ds_is_older
+from lib389.utils import ds_is_older, get_default_db_lib
 from lib389.plugins import MemberOfPlugin
+from lib389.tasks import Tasks
+from lib389.replica import Replicas, ReplicationManager
 
 pytestmark = pytest.mark.tier1
 
@@ -215,6 +217,307 @@ def test_unindexed_internal_search_crashes_server(topo, add_a_group_with_users,
     assert inst.status()
 
 
+def test_online_reindex_keeps_backend_writable(topo):
+    """Build a new index online while entries are added
+
+    :id: 3f4d9b1e-6c2a-4e57-8f0b-d1a7c95e2b64
+    :setup: Standalone instance
+    :steps:
+        1. Add users with a description value
+        2. Add an equality index on description
+        3. Start an online index task for description
+        4. Add more users while the task runs
+        5. Wait for the task
+        6. Require indexed searches and search each description value
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. The backend accepts the adds
+        5. The task succeeds
+        6. The searches are indexed and return every user
+    """
+
+    inst = topo.standalone
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    created = []
+
+    def add_user(num):
+        name = f'online_idx_{num}'
+        created.append(users.create(properties={
+            'uid': name,
+            'sn': name,
+            'cn': name,
+            'uidNumber': f'{num}',
+            'gidNumber': f'{num}',
+            'homeDirectory': f'/home/{name}',
+            'description': f'online_{num % 5}'
+        }))
+
+    for num in range(500):
+        add_user(num)
+
+    backend = Backends(inst).get(DEFAULT_BENAME)
+    index = backend.get_indexes().create(properties={
+        'cn': 'description',
+        'nsSystemIndex': 'false',
+        'nsIndexType': 'eq'
+        })
+
+    tasks = Tasks(inst)
+    tasks.reindex(benamebase=DEFAULT_BENAME, attrname='description', online=True)
+    for num in range(500, 550):
+        add_user(num)
+    (done, exit_code, warning_code) = inst.tasks.checkTask(tasks.entry, True)
+    assert exit_code == 0
+
+    backend.set('nsslapd-require-index', 'on')
+    try:
+        for value in range(5):
+            entries = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, f'(description=online_{value})', ['dn'])
+            assert len(entries) == 110
+    finally:
+        backend.set('nsslapd-require-index', 'off')
+        index.delete()
+        for user in created:
+            user.delete()
+
+
+def test_packed_idlist_format(topo):
+    """Check an index storing its id lists as packed blocks
+
+    :id: 8c2e51d7-3b94-4f0a-a6e3-5d71c0b92f48
+    :setup: Standalone instance
+    :steps:
+        1. Add users with a description value
+        2. Add an equality index on description with nsIndexIDListFormat: packed
+        3. Reindex description
+        4. Delete some users and add new ones
+        5. Require indexed searches and search each description value
+        6. Switch the index back to the plain format and reindex
+        7. Search each description value
+        8. Set an invalid nsIndexIDListFormat value
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. Success
+        5. The searches are indexed and return the expected users
+        6. Success with mdb, bdb rejects the change while the index has keys
+        7. The searches return the expected users
+        8. The value is rejected
+    """
+
+    inst = topo.standalone
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    created = {}
+
+    def add_user(num):
+        name = f'packed_idx_{num}'
+        created[num] = users.create(properties={
+            'uid': name,
+            'sn': name,
+            'cn': name,
+            'uidNumber': f'{num}',
+            'gidNumber': f'{num}',
+            'homeDirectory': f'/home/{name}',
+            'description': f'packed_{num % 3}'
+        })
+
+    def check_searches():
+        for value in range(3):
+            expected = len([num for num in created if num % 3 == value])
+            entries = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, f'(description=packed_{value})', ['dn'])
+            assert len(entries) == expected
+
+    for num in range(600):
+        add_user(num)
+
+    backend = Backends(inst).get(DEFAULT_BENAME)
+    index = backend.get_indexes().create(properties={
+        'cn': 'description',
+        'nsSystemIndex': 'false',
+        'nsIndexType': 'eq',
+        'nsIndexIDListFormat': 'packed'
+        })
+    tasks = Tasks(inst)
+    tasks.reindex(benamebase=DEFAULT_BENAME, attrname='description')
+    (done, exit_code, warning_code) = inst.tasks.checkTask(tasks.entry, True)
+    assert exit_code == 0
+
+    try:
+        for num in range(0, 600, 7):
+            created.pop(num).delete()
+        for num in range(600, 650):
+            add_user(num)
+        backend.set('nsslapd-require-index', 'on')
+        check_searches()
+
+        if get_default_db_lib() == "bdb":
+            # bdb reads the keys with the configured format
+            with pytest.raises(ldap.UNWILLING_TO_PERFORM):
+                index.replace('nsIndexIDListFormat', 'plain')
+        else:
+            index.replace('nsIndexIDListFormat', 'plain')
+            tasks.reindex(benamebase=DEFAULT_BENAME, attrname='description')
+            (done, exit_code, warning_code) = inst.tasks.checkTask(tasks.entry, True)
+            assert exit_code == 0
+        check_searches()
+
+        with pytest.raises(ldap.LDAPError):
+            index.replace('nsIndexIDListFormat', 'compressed')
+    finally:
+        backend.set('nsslapd-require-index', 'off')
+        index.delete()
+        for user in created.values():
+            user.delete()
+
+def test_index_bloom_filter(topo):
+    """Check the bloom filter of an equality index
+
+    :id: 5f0b7e92-c4d1-4a6b-9e37-1a8d2f6c3b05
+    :setup: Standalone instance
+    :steps:
+        1. Add users with a description value
+        2. Add an equality index on description with nsIndexBloomFilter: on
+        3. Reindex description
+        4. Check the backend monitor entry
+        5. Search existing and missing description values
+        6. Add a user with a new description value and search it
+        7. Check the backend monitor entry
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. The filter of description is ready
+        5. The searches return the expected users
+        6. The new user is found
+        7. The filter answered the lookups of the missing values
+    """
+
+    inst = topo.standalone
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    created = []
+
+    def add_user(num):
+        name = f'bloom_idx_{num}'
+        created.append(users.create(properties={
+            'uid': name,
+            'sn': name,
+            'cn': name,
+            'uidNumber': f'{num}',
+            'gidNumber': f'{num}',
+            'homeDirectory': f'/home/{name}',
+            'description': f'bloom_{num}'
+        }))
+
+    def get_filter_stats():
+        for value in backend.get_monitor().get_attr_vals_utf8('indexBloomFilter'):
+            fields = value.split()
+            if fields[0].lower() == 'description':
+                return dict(field.split('=') for field in fields[1:])
+        return None
+
+    for num in range(100):
+        add_user(num)
+
+    backend = Backends(inst).get(DEFAULT_BENAME)
+    index = backend.get_indexes().create(properties={
+        'cn': 'description',
+        'nsSystemIndex': 'false',
+        'nsIndexType': 'eq',
+        'nsIndexBloomFilter': 'on'
+        })
+    tasks = Tasks(inst)
+    tasks.reindex(benamebase=DEFAULT_BENAME, attrname='description')
+    (done, exit_code, warning_code) = inst.tasks.checkTask(tasks.entry, True)
+    assert exit_code == 0
+
+    try:
+        stats = get_filter_stats()
+        assert stats is not None
+        assert stats['state'] == 'ready'
+        assert int(stats['keys']) >= 100
+
+        for num in range(0, 100, 10):
+            entries = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, f'(description=bloom_{num})', ['dn'])
+            assert len(entries) == 1
+        for num in range(100, 200):
+            entries = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, f'(description=bloom_{num})', ['dn'])
+            assert len(entries) == 0
+
+        add_user(100)
+        entries = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, '(description=bloom_100)', ['dn'])
+        assert len(entries) == 1
+
+        stats = get_filter_stats()
+        assert int(stats['negatives']) > 0
+        assert int(stats['negatives']) + int(stats['falsepositives']) >= 100
+    finally:
+        index.delete()
+        for user in created:
+            user.delete()
+
+
+
+def test_online_reindex_tombstones(topo):
+    """Rebuild nsuniqueid online and look up the RUV and a tombstone
+
+    :id: 9b51c0e7-2d4a-4f86-a3e5-7c18f6d2b409
+    :setup: Standalone instance
+    :steps:
+        1. Enable replication so that the suffix has a RUV tombstone
+        2. Add a user, read its nsuniqueid and delete it
+        3. Drop the equality keys of nsuniqueid with an offline reindex
+           of a presence only index
+        4. Restore the equality index and build nsuniqueid online
+        5. Require indexed searches and search the RUV by nsuniqueid
+        6. Search the tombstone of the user by nsuniqueid
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. The task succeeds
+        5. The RUV tombstone is found
+        6. The tombstone is found
+    """
+
+    inst = topo.standalone
+    repl = ReplicationManager(DEFAULT_SUFFIX)
+    repl.create_first_supplier(inst)
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=4201)
+    uniqueid = user.get_attr_val_utf8('nsuniqueid')
+    user.delete()
+
+    backend = Backends(inst).get(DEFAULT_BENAME)
+    index = backend.get_index('nsuniqueid')
+    index_types = index.get_attr_vals_utf8('nsIndexType')
+    index.replace('nsIndexType', 'pres')
+    inst.stop()
+    inst.db2index(bename=DEFAULT_BENAME, attrs=['nsuniqueid'])
+    inst.start()
+    index.replace('nsIndexType', index_types)
+
+    tasks = Tasks(inst)
+    tasks.reindex(benamebase=DEFAULT_BENAME, attrname='nsuniqueid', online=True)
+    (done, exit_code, warning_code) = inst.tasks.checkTask(tasks.entry, True)
+    assert exit_code == 0
+
+    backend.set('nsslapd-require-index', 'on')
+    try:
+        ruv = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE,
+                            '(&(nsuniqueid=ffffffff-ffffffff-ffffffff-ffffffff)(objectclass=nstombstone))',
+                            ['nsds50ruv'])
+        assert len(ruv) == 1
+        tombstone = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE,
+                                  f'(&(nsuniqueid={uniqueid})(objectclass=nstombstone))', ['dn'])
+        assert len(tombstone) == 1
+    finally:
+        backend.set('nsslapd-require-index', 'off')
+        Replicas(inst).get(DEFAULT_SUFFIX).delete()
+
 if __name__ == "__main__":
     # Run isolated
     # -s for DEBUG mode
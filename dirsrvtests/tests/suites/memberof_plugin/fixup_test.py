@@ -0,0 +1,116 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import ldap
+import pytest
+import os
+from lib389._constants import DEFAULT_SUFFIX
+from lib389.topologies import topology_st as topo
+from lib389.plugins import MemberOfPlugin
+from lib389.idm.user import UserAccounts
+from lib389.idm.group import Groups
+
+pytestmark = pytest.mark.tier1
+
+DEBUGGING = os.getenv('DEBUGGING', default=False)
+if DEBUGGING:
+    logging.getLogger(__name__).setLevel(logging.DEBUG)
+else:
+    logging.getLogger(__name__).setLevel(logging.INFO)
+log = logging.getLogger(__name__)
+
+USERS_NUM = 50
+
+
+@pytest.mark.parametrize("threads", [1, 4])
+def test_fixup_nested_groups(topo, threads):
+    """Check the fixup task rebuilds direct, nested and looping memberships
+
+    :id: 5b7f3a52-8a0c-4c1e-9d42-3c1f0e6b9a71
+    :parametrized: yes
+    :setup: Standalone Instance
+    :steps:
+        1. With the memberOf plugin disabled, create users in grp_a,
+           grp_a in grp_b, grp_b in grp_c, grp_c in grp_d and grp_d in grp_b
+        2. Enable the memberOf plugin and run the fixup task with a number of threads
+        3. Check the memberOf values of the users and of the groups
+    :expectedresults:
+        1. Success
+        2. The task succeeds
+        3. Users belong to every group, groups belong to their ancestors
+           but never to themselves
+    """
+    inst = topo.standalone
+    memberof = MemberOfPlugin(inst)
+    memberof.disable()
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    created = []
+    user_list = []
+    for i in range(USERS_NUM):
+        user = users.create_test_user(uid=2000 + i + threads * 100)
+        user_list.append(user)
+        created.append(user)
+
+    grp_a = groups.create(properties={'cn': f'fixup_a_{threads}',
+                                      'member': [u.dn for u in user_list]})
+    grp_b = groups.create(properties={'cn': f'fixup_b_{threads}', 'member': grp_a.dn})
+    grp_c = groups.create(properties={'cn': f'fixup_c_{threads}', 'member': grp_b.dn})
+    grp_d = groups.create(properties={'cn': f'fixup_d_{threads}', 'member': grp_c.dn})
+    grp_b.add('member', grp_d.dn)
+    created += [grp_a, grp_b, grp_c, grp_d]
+
+    memberof.enable()
+    inst.restart()
+
+    task = memberof.fixup(DEFAULT_SUFFIX, threads=threads)
+    task.wait()
+    assert task.get_exit_code() == 0
+
+    expected = {grp_a.dn.lower(), grp_b.dn.lower(), grp_c.dn.lower(), grp_d.dn.lower()}
+    for user in user_list:
+        assert {dn.lower() for dn in user.get_attr_vals_utf8('memberOf')} == expected
+
+    # grp_b, grp_c and grp_d form a loop: none of them is its own member
+    for grp in [grp_a, grp_b, grp_c, grp_d]:
+        values = {dn.lower() for dn in grp.get_attr_vals_utf8('memberOf')}
+        assert values == expected - {grp_a.dn.lower(), grp.dn.lower()}
+
+    for entry in created:
+        entry.delete()
+
+
+
+@pytest.mark.parametrize("threads", ['0', '65', '-1', 'four', '4x'])
+def test_fixup_invalid_threads(topo, threads):
+    """Check the fixup task rejects an invalid number of threads
+
+    :id: 8d2e61c4-0f5b-4a8e-b7d3-6e9c1a4f2b07
+    :parametrized: yes
+    :setup: Standalone Instance
+    :steps:
+        1. Create a fixup task with an invalid threads value
+    :expectedresults:
+        1. The task entry is rejected
+    """
+    memberof = MemberOfPlugin(topo.standalone)
+    if not memberof.status():
+        memberof.enable()
+        topo.standalone.restart()
+
+    with pytest.raises(ldap.UNWILLING_TO_PERFORM):
+        memberof.fixup(DEFAULT_SUFFIX, threads=threads)
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main(["-s", CURRENT_FILE])
@@ -857,6 +857,61 @@ def test_silent_memberof_failure(topology_st):
         topology_st.standalone.log.info("Should assert %s has memberof is %s" % (user_dn, ent.hasAttr('memberof')))
         assert not ent.hasAttr('memberof')
 
+
+def test_memberof_add_nested_delta(topology_st):
+    """Check members added to a nested group get the memberships of all
+    the ancestor groups, including through a group loop
+
+    :id: 0d3c5e0a-6f1d-4b7e-a1f2-7d93c4c2e8b5
+    :setup: Standalone Instance
+    :steps:
+        1. Enable the memberOf plugin
+        2. Create grp_top containing grp_mid, and grp_loop and grp_mid containing each other
+        3. Create a group grp_new with two users and add it to grp_mid
+        4. Check the memberOf values of the users and of grp_new
+        5. Add a third user to grp_new
+        6. Check the memberOf values of the third user
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. The users and grp_new belong to grp_mid, grp_top and grp_loop
+        5. Success
+        6. The user belongs to grp_new, grp_mid, grp_top and grp_loop
+    """
+    inst = topology_st.standalone
+    memberof = MemberOfPlugin(inst)
+    memberof.enable()
+    memberof.set_autoaddoc('nsMemberOf')
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    user_list = [users.create_test_user(uid=3000 + i) for i in range(3)]
+
+    grp_mid = groups.create(properties={'cn': 'delta_mid'})
+    grp_top = groups.create(properties={'cn': 'delta_top', 'member': grp_mid.dn})
+    grp_loop = groups.create(properties={'cn': 'delta_loop', 'member': grp_mid.dn})
+    grp_mid.add('member', grp_loop.dn)
+    grp_new = groups.create(properties={'cn': 'delta_new',
+                                        'member': [user_list[0].dn, user_list[1].dn]})
+    grp_mid.add('member', grp_new.dn)
+
+    ancestors = {grp_mid.dn.lower(), grp_top.dn.lower(), grp_loop.dn.lower()}
+    assert {dn.lower() for dn in grp_new.get_attr_vals_utf8('memberOf')} == ancestors
+    for user in user_list[:2]:
+        assert {dn.lower() for dn in user.get_attr_vals_utf8('memberOf')} == ancestors | {grp_new.dn.lower()}
+    # grp_mid and grp_loop form a loop: grp_mid is not its own member
+    assert {dn.lower() for dn in grp_mid.get_attr_vals_utf8('memberOf')} == {grp_top.dn.lower(),
+                                                                             grp_loop.dn.lower()}
+
+    grp_new.add('member', user_list[2].dn)
+    assert {dn.lower() for dn in user_list[2].get_attr_vals_utf8('memberOf')} == ancestors | {grp_new.dn.lower()}
+
+    for entry in [grp_new, grp_loop, grp_top, grp_mid] + user_list:
+        entry.delete()
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
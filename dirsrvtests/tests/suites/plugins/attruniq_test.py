@@ -80,4 +80,61 @@ def test_modrdn_attr_uniqueness(topology_st):
     log.debug(excinfo.value)
 
     log.debug('Move user2 to group1')
-    user2.rename(f'uid={user2.rdn}', group1.dn)
\ No newline at end of file
+    user2.rename(f'uid={user2.rdn}', group1.dn)
+
+def test_multivalued_attr_uniqueness(topology_st):
+    """Test that every value of a multi-valued attribute is checked when
+    the values are looked up together
+
+    :id: 8e2f4c16-3b5a-4d0e-9f71-2a6c1d9b7e43
+
+    :setup: Standalone instance
+
+    :steps: 1. Setup PLUGIN_ATTR_UNIQUENESS plugin for 'mail' on the suffix
+            2. Add a user with 100 unique 'mail' values
+            3. Add a user with 100 new 'mail' values and one value of the first user
+            4. Add 100 new 'mail' values and one value of the first user to a second user
+            5. Add the 100 new 'mail' values to the second user
+
+    :expectedresults:
+            1. Success
+            2. Success
+            3. Add operation should FAIL
+            4. Modify operation should FAIL
+            5. Success
+    """
+    inst = topology_st.standalone
+    attruniq = AttributeUniquenessPlugin(inst, dn="cn=attruniq_mv,cn=plugins,cn=config")
+    attruniq.create(properties={'cn': 'attruniq_mv'})
+    attruniq.add_unique_attribute('mail')
+    attruniq.add_unique_subtree(DEFAULT_SUFFIX)
+    attruniq.enable()
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user1 = users.create_test_user(10)
+    user1.replace('mail', [f'first{i}@example.com' for i in range(100)])
+
+    new_values = [f'second{i}@example.com' for i in range(100)]
+    properties = {
+        'uid': 'test_user_11',
+        'cn': 'test_user_11',
+        'sn': 'test_user_11',
+        'uidNumber': '11',
+        'gidNumber': '2000',
+        'homeDirectory': '/home/test_user_11',
+        'mail': new_values + ['first42@example.com'],
+    }
+    with pytest.raises(ldap.CONSTRAINT_VIOLATION):
+        users.create(properties=properties)
+
+    user2 = users.create_test_user(12)
+    with pytest.raises(ldap.CONSTRAINT_VIOLATION):
+        user2.add('mail', new_values + ['first99@example.com'])
+    user2.add('mail', new_values)
+    assert len(user2.get_attr_vals_utf8('mail')) == 100
+
+    user1.delete()
+    user2.delete()
+    attruniq.delete()
+    inst.restart()
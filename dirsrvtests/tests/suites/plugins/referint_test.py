@@ -142,6 +142,107 @@ def test_invalid_referint_log(topo):
     assert inst.status()
 
 
+def test_referint_multiple_attrs(topo):
+    """Check an entry referring to a DN through several membership attributes
+    is fully updated on MODRDN and DELETE
+
+    :id: 1d0b6c3e-7f52-4d8a-9a3e-5c2f81e4b7d6
+    :setup: Standalone Instance
+    :steps:
+        1. Configure the plugin with member, owner and seeAlso, without delay
+        2. Create a group referring to a user through the three attributes,
+           with more than 128 members
+        3. Rename the user
+        4. Delete the user
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The three attributes refer to the new DN, other members are kept
+        4. The three attributes no longer refer to the user
+    """
+
+    inst = topo.standalone
+
+    plugin = ReferentialIntegrityPlugin(inst)
+    plugin.enable()
+    plugin.set_update_delay('0')
+    plugin.replace('referint-membership-attr', ['member', 'owner', 'seeAlso'])
+    plugin.remove_all('nsslapd-plugincontainerscope')
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    user = users.create_test_user(uid=3001)
+    others = [users.create_test_user(uid=3100 + i) for i in range(130)]
+
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    group = groups.create(properties={'cn': 'multi_attr_group',
+                                      'member': [user.dn] + [u.dn for u in others],
+                                      'owner': user.dn,
+                                      'seeAlso': user.dn})
+
+    user.rename('uid=test_user_3001_renamed')
+    for attr in ['member', 'owner', 'seeAlso']:
+        values = [v.lower() for v in group.get_attr_vals_utf8(attr)]
+        assert user.dn.lower() in values
+        assert 'uid=test_user_3001,ou=people,%s' % DEFAULT_SUFFIX.lower() not in values
+    assert len(group.get_attr_vals_utf8('member')) == 131
+
+    user_dn = user.dn.lower()
+    user.delete()
+    for attr in ['member', 'owner', 'seeAlso']:
+        values = [v.lower() for v in group.get_attr_vals_utf8(attr)]
+        assert user_dn not in values
+    assert len(group.get_attr_vals_utf8('member')) == 130
+
+    group.delete()
+    for u in others:
+        u.delete()
+
+
+def test_referint_delete_partial_attrs(topo):
+    """Check deleting a DN held by only one of the membership attributes
+    of an entry
+
+    :id: 6a3f1e2b-94c7-4d05-b8e1-2f7c0d5a9e63
+    :setup: Standalone Instance
+    :steps:
+        1. Configure the plugin with member and owner, without delay
+        2. Create a group with a user as member and another user as owner
+        3. Delete the member user
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The delete succeeds, the member is removed and the owner is kept
+    """
+
+    inst = topo.standalone
+
+    plugin = ReferentialIntegrityPlugin(inst)
+    plugin.enable()
+    plugin.set_update_delay('0')
+    plugin.replace('referint-membership-attr', ['member', 'owner'])
+    plugin.remove_all('nsslapd-plugincontainerscope')
+    inst.restart()
+
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    member = users.create_test_user(uid=3201)
+    owner = users.create_test_user(uid=3202)
+
+    groups = Groups(inst, DEFAULT_SUFFIX)
+    group = groups.create(properties={'cn': 'partial_attr_group',
+                                      'member': [member.dn, owner.dn],
+                                      'owner': owner.dn})
+
+    member_dn = member.dn.lower()
+    member.delete()
+    assert member_dn not in [v.lower() for v in group.get_attr_vals_utf8('member')]
+    assert owner.dn.lower() in [v.lower() for v in group.get_attr_vals_utf8('member')]
+    assert [v.lower() for v in group.get_attr_vals_utf8('owner')] == [owner.dn.lower()]
+
+    group.delete()
+    owner.delete()
+
+
 if __name__ == '__main__':
     # Run isolated
     # -s for DEBUG mode
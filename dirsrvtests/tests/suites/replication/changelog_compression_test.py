@@ -0,0 +1,84 @@
+# --- BEGIN COPYRIGHT BLOCK ---
+# Copyright (C) 2026 Red Hat, Inc.
+# All rights reserved.
+#
+# License: GPL (version 3 or any later version).
+# See LICENSE for details.
+# --- END COPYRIGHT BLOCK ---
+#
+import logging
+import pytest
+import os
+from lib389._constants import DEFAULT_SUFFIX, DEFAULT_BENAME
+from lib389.topologies import topology_m1c1 as topo
+from lib389.idm.user import UserAccounts
+from lib389.replica import Replicas, Changelog
+
+pytestmark = pytest.mark.tier1
+
+DEBUGGING = os.getenv("DEBUGGING", default=False)
+if DEBUGGING:
+    logging.getLogger(__name__).setLevel(logging.DEBUG)
+else:
+    logging.getLogger(__name__).setLevel(logging.INFO)
+log = logging.getLogger(__name__)
+
+
+def test_cl_compression(topo):
+    """Check that compressed changelog records are replayed and
+    can be read by dbscan
+
+    :id: 5b0e7f2c-5c31-4a4e-9d7a-2f3f6f0bb0a1
+    :setup: Supplier Instance, Consumer Instance
+    :steps:
+        1. Add a user with compression disabled
+        2. Enable changelog compression
+        3. Add and modify a user
+        4. Check dbscan reports compressed records and records written
+           before compression was enabled, which keep the V_6 format
+        5. Verify replication is still working
+        6. Disable compression and verify replication is still working
+    :expectedresults:
+        1. Success
+        2. Success
+        3. Success
+        4. Success
+        5. Success
+        6. Success
+    """
+
+    supplier = topo.ms['supplier1']
+    consumer = topo.cs['consumer1']
+    replica = Replicas(supplier).get(DEFAULT_SUFFIX)
+    users = UserAccounts(supplier, DEFAULT_SUFFIX)
+    cl = Changelog(supplier, DEFAULT_SUFFIX)
+
+    log.info('Add a user before enabling compression ...')
+    users.create_test_user(uid=1001)
+
+    log.info('Enable changelog compression ...')
+    cl.set_compression('on')
+
+    user = users.create_test_user(uid=1002)
+    user.replace('description', 'compressed ' * 20)
+    assert replica.test_replication([consumer])
+
+    log.info('Check the changelog content with dbscan ...')
+    dbscan_out = supplier.dbscan(DEFAULT_BENAME, 'replication_changelog')
+    assert b'compressed: yes' in dbscan_out
+    assert b'encrypted: no' in dbscan_out
+    # dbscan only prints the compressed flag of V_7 records
+    assert dbscan_out.count(b'encrypted: ') > dbscan_out.count(b'compressed: ')
+    assert b'test_user_1002' in dbscan_out
+
+    log.info('Disable changelog compression ...')
+    cl.set_compression('off')
+    users.create_test_user(uid=1003)
+    assert replica.test_replication([consumer])
+
+
+if __name__ == '__main__':
+    # Run isolated
+    # -s for DEBUG mode
+    CURRENT_FILE = os.path.realpath(__file__)
+    pytest.main(["-s", CURRENT_FILE])
@@ -1001,6 +1001,53 @@ def test_change_repl_passwd(topo_m2, request, bind_cn):
     a2.testok()
 
 
+def test_online_init_streams_all_entries(topo_m2):
+    """Check that a total update sends every entry and reports the count
+
+    :id: 0c7e5d8a-6b1f-4f0e-9a43-7d2c2e9b51f4
+    :setup: Two suppliers replication setup
+    :steps:
+        1. Add enough users on supplier1 to fill the sender queue several times
+        2. Perform on line init of supplier2 from supplier1
+        3. Check the number of entries sent that supplier1 logs
+        4. Check supplier2 has the same entries as supplier1
+    :expectedresults:
+        1. Success
+        2. Success
+        3. At least all the added users are reported as sent
+        4. Entry counts match
+    """
+
+    m1 = topo_m2.ms["supplier1"]
+    m2 = topo_m2.ms["supplier2"]
+    nb_users = 2000
+
+    users = UserAccounts(m1, DEFAULT_SUFFIX)
+    for idx in range(nb_users):
+        users.create_test_user(uid=10000 + idx)
+
+    m1.deleteErrorLogs(restart=False)
+    agmt = Agreements(m1).list()[0]
+    agmt.begin_reinit()
+    (done, error) = agmt.wait_reinit()
+    assert done is True
+    assert error is False
+
+    sent = m1.ds_error_log.match(r'.*Finished total update of replica .*Sent [0-9]+ entries.*')
+    assert sent
+    nb_sent = int(re.search(r'Sent ([0-9]+) entries', sent[-1]).group(1))
+    log.info("Total update sent %d entries", nb_sent)
+    assert nb_sent >= nb_users
+
+    filter = '(|(objectclass=ldapsubentry)(objectclass=nstombstone)(nsuniqueid=*))'
+    m1entries = m1.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, filter)
+    m2entries = m2.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, filter)
+    assert len(m1entries) == len(m2entries)
+
+    for idx in range(nb_users):
+        users.get('test_user_%d' % (10000 + idx)).delete()
+
+
 @pytest.mark.ds49915
 @pytest.mark.bz1626375
 def test_online_reinit_may_hang(topo_with_sigkill):
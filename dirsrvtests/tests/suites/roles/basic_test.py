@@ -11,6 +11,7 @@
 Importing necessary Modules.
 """
 
+import ldap
 import logging
 import time
 import os
@@ -23,6 +24,7 @@ from lib389.idm.organizationalunit import OrganizationalUnit
 from lib389.topologies import topology_st as topo
 from lib389.idm.role import FilteredRoles, ManagedRoles, NestedRoles
 from lib389.idm.domain import Domain
+from lib389.plugins import RolesPlugin
 
 logging.getLogger(__name__).setLevel(logging.INFO)
 log = logging.getLogger(__name__)
@@ -504,6 +506,115 @@ def test_vattr_on_managed_role(topo, request):
 
     request.addfinalizer(fin)
 
+def test_membership_cache(topo, request):
+    """Check nsrole stays right when it is kept per entry
+
+    :id: 3e9d6a1c-52f4-4b8e-a0d7-8c41b7f2e915
+    :setup: Standalone instance
+    :steps:
+        1. Set nsRoleMembershipCacheSize on the Roles plugin and restart
+        2. Add a filtered role and a managed role, and a user in both
+        3. Read nsrole twice
+        4. Modify the user so that it leaves the filtered role
+        5. Modify the filter of the filtered role so that the user is in it again
+        6. Delete the managed role
+    :expectedresults:
+        1. Success
+        2. Success
+        3. The user has both roles, each time
+        4. The user only has the managed role
+        5. The user has both roles
+        6. The user only has the filtered role
+    """
+    inst = topo.standalone
+    plugin = RolesPlugin(inst)
+    plugin.replace('nsRoleMembershipCacheSize', '1000')
+    inst.restart()
+
+    filtered = FilteredRoles(inst, DEFAULT_SUFFIX).create(
+        properties={'cn': 'cacheFilteredRole', 'nsRoleFilter': '(description=cached)'})
+    managed = ManagedRoles(inst, DEFAULT_SUFFIX).create(properties={'cn': 'cacheManagedRole'})
+    user = UserAccounts(inst, DEFAULT_SUFFIX).create_test_user(uid=5100)
+    user.replace('description', 'cached')
+    user.replace('nsRoleDN', managed.dn)
+
+    both = {filtered.dn.lower(), managed.dn.lower()}
+    for _ in range(2):
+        assert {dn.lower() for dn in user.get_attr_vals_utf8('nsrole')} == both
+
+    user.replace('description', 'other')
+    assert {dn.lower() for dn in user.get_attr_vals_utf8('nsrole')} == {managed.dn.lower()}
+
+    filtered.replace('nsRoleFilter', '(description=other)')
+    assert {dn.lower() for dn in user.get_attr_vals_utf8('nsrole')} == both
+
+    managed.delete()
+    assert {dn.lower() for dn in user.get_attr_vals_utf8('nsrole')} == {filtered.dn.lower()}
+
+    def fin():
+        for entry in [user, filtered]:
+            if entry.exists():
+                entry.delete()
+        plugin.remove_all('nsRoleMembershipCacheSize')
+        inst.restart()
+        inst.config.set('nsslapd-ignore-virtual-attrs', 'on')
+
+    request.addfinalizer(fin)
+
+
+def test_search_on_nsrole(topo, request):
+    """Check searches on nsrole return the members of the roles
+
+    :id: 8b0f4d27-c6e1-4a3f-95d2-1e7a6c0b4f58
+    :setup: Standalone instance
+    :steps:
+        1. Add a managed role, a filtered role, a nested role of both and users
+        2. Search (nsrole=<role>) for each role
+        3. Search the users of the nested role that are not in the managed role
+        4. Search with the nsrole component under an OR
+    :expectedresults:
+        1. Success
+        2. Exactly the members of each role are returned
+        3. Only the members of the filtered role are returned
+        4. The members of the role and the other matching users are returned
+    """
+    inst = topo.standalone
+    users = UserAccounts(inst, DEFAULT_SUFFIX)
+    managed = ManagedRoles(inst, DEFAULT_SUFFIX).create(properties={'cn': 'searchManagedRole'})
+    filtered = FilteredRoles(inst, DEFAULT_SUFFIX).create(
+        properties={'cn': 'searchFilteredRole', 'nsRoleFilter': '(description=searchrole)'})
+    nested = NestedRoles(inst, DEFAULT_SUFFIX).create(
+        properties={'cn': 'searchNestedRole', 'nsRoleDN': [managed.dn, filtered.dn]})
+
+    managed_users = [users.create_test_user(uid=5200 + i) for i in range(3)]
+    filtered_users = [users.create_test_user(uid=5300 + i) for i in range(3)]
+    other_user = users.create_test_user(uid=5400)
+    for user in managed_users:
+        user.replace('nsRoleDN', managed.dn)
+    for user in filtered_users:
+        user.replace('description', 'searchrole')
+
+    def search(filterstr):
+        entries = inst.search_s(DEFAULT_SUFFIX, ldap.SCOPE_SUBTREE, filterstr, ['uid'])
+        return {e.dn.lower() for e in entries}
+
+    def dns(entries):
+        return {e.dn.lower() for e in entries}
+
+    assert search(f'(nsrole={managed.dn})') == dns(managed_users)
+    assert search(f'(nsrole={filtered.dn})') == dns(filtered_users)
+    assert search(f'(nsrole={nested.dn})') == dns(managed_users + filtered_users)
+    assert search(f'(&(nsrole={nested.dn})(!(nsrole={managed.dn})))') == dns(filtered_users)
+    assert search(f'(|(nsrole={managed.dn})(uid={other_user.get_attr_val_utf8("uid")}))') == \
+        dns(managed_users + [other_user])
+
+    def fin():
+        for entry in managed_users + filtered_users + [other_user, nested, filtered, managed]:
+            if entry.exists():
+                entry.delete()
+
+    request.addfinalizer(fin)
+
 if __name__ == "__main__":
     CURRENT_FILE = os.path.realpath(__file__)
     pytest.main("-s -v %s" % CURRENT_FILE)
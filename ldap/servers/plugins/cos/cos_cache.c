@@ -109,9 +109,20 @@ void *cos_get_plugin_identity(void);
 #define COSTYPE_INDIRECT 3
 #define COS_DEF_ERROR_NO_TEMPLATES -2
 
-/* both variables are protected by change_lock */
+/* what a change to an entry means for the cache */
+#define COS_CHANGE_NONE 0
+#define COS_CHANGE_TEMPLATE 1   /* only the templates below the entry need a new look */
+#define COS_CHANGE_DEFINITION 2 /* the whole cache must be rebuilt */
+
+/* past this many changed templates a rebuild does not try to reuse anything */
+#define COS_MAX_CHANGED_TMPLS 1024
+
+/* these variables are protected by change_lock */
 static int cos_cache_notify_flag = 0;
 static PRBool cos_cache_at_work = PR_FALSE;
+static int cos_cache_full_rebuild = 0;
+static char **cos_cache_changed_tmpls = NULL; /* ndns of the changed templates */
+static int cos_cache_changed_count = 0;
 
 /* service definition cache structs */
 
@@ -199,7 +210,7 @@ typedef struct _cos_cache cosCache;
 static cosCache *pCache; /* always the current global cache, only use getref to get */
 
 /* the place to start if you want a new cache */
-static int cos_cache_create_unlock(void);
+static int cos_cache_create_unlock(int full_rebuild);
 static int cos_cache_creation_lock(void);
 
 /* cache index related functions */
@@ -229,6 +240,10 @@ static int cos_cache_cmp_attr(cosAttributes *pAttr, Slapi_Value *test_this, int
 /* cosTemplates manipulation */
 static int cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls);
 static int cos_cache_add_tmpl(cosTemplates **pTemplates, cosAttrValue *dn, cosAttrValue *objclasses, cosAttrValue *pCosSpecifier, cosAttributes *pAttrs, cosAttrValue *cosPriority);
+static int cos_cache_reuse_dn_tmpls(char *dn, cosAttrValue *pDefDn, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls);
+static int cos_cache_attrval_list_equal(cosAttrValue *pVal1, cosAttrValue *pVal2);
+static cosAttrValue *cos_cache_dup_attrval_list(cosAttrValue *pVal);
+static cosAttributes *cos_cache_dup_attr_list(cosAttributes *pAttrs);
 
 /* cosDefinitions manipulation */
 static int cos_cache_build_definition_list(cosDefinitions **pDefs, int *vattr_cacheable);
@@ -277,6 +292,14 @@ static Slapi_CondVar *something_changed = NULL;
 static Slapi_CondVar *start_cond = NULL;
 static vattr_sp_handle *vattr_handle = NULL;
 
+/*
+ * Set while a cache is being built from a previous one: the old cache
+ * and the ndns of the templates changed since it was built.  Only the
+ * thread that set cos_cache_at_work touches them.
+ */
+static cosCache *cos_cache_reuse_from = NULL;
+static char **cos_cache_reuse_changed = NULL;
+
 /*
     cos_cache_init
     --------------
@@ -415,10 +438,14 @@ cos_cache_wait_on_change(void *arg __attribute__((unused)))
          * (notify when noone is waiting == no-op).
          * before we go running off doing lots of stuff lets check if we should stop
         */
+        /*
+         * Reset the flag before building: a change notified while the
+         * cache is being built must trigger another pass.
+         */
+        cos_cache_notify_flag = 0;
         if (keeprunning) {
             cos_cache_creation_lock();
         }
-        cos_cache_notify_flag = 0; /* Dealt with it */
     }                              /* while */
 
     /* shut down the cache */
@@ -436,11 +463,13 @@ cos_cache_wait_on_change(void *arg __attribute__((unused)))
     Once created, it swaps the new cache for the old one,
     releasing its refcount to the old cache and allowing it
     to be destroyed.
+    Unless full_rebuild is set, the templates of the old cache
+    that did not change are copied rather than searched again.
 
         called while change_lock is NOT held
 */
 static int
-cos_cache_create_unlock(void)
+cos_cache_create_unlock(int full_rebuild)
 {
     int ret = -1;
     cosCache *pNewCache;
@@ -455,7 +484,20 @@ cos_cache_create_unlock(void)
         pNewCache->refCount = 1;        /* 1 is for us */
         pNewCache->vattr_cacheable = 0; /* default is not cacheable */
 
+        if (!full_rebuild) {
+            slapi_lock_mutex(cache_lock);
+            cos_cache_reuse_from = pCache;
+            if (cos_cache_reuse_from)
+                cos_cache_reuse_from->refCount++;
+            slapi_unlock_mutex(cache_lock);
+        }
+
         ret = cos_cache_build_definition_list(&(pNewCache->pDefs), &(pNewCache->vattr_cacheable));
+
+        if (cos_cache_reuse_from) {
+            cos_cache_release(cos_cache_reuse_from);
+            cos_cache_reuse_from = NULL;
+        }
         if (!ret) {
             /* OK, we have a cache, lets add indexing for
             that faster than slow feeling */
@@ -562,6 +604,8 @@ cos_cache_create_unlock(void)
  *
  * A solution is to use a flag 'cos_cache_at_work' protected by change_lock,
  * release change_lock, recreate the cos_cache, acquire change_lock reset the flag.
+ * The changes notified so far are taken along while change_lock is held, so
+ * the ones notified during the rebuild are left for the next one.
  *
  * returned value: result of cos_cache_create_unlock
  *
@@ -571,6 +615,7 @@ cos_cache_creation_lock(void)
 {
     int ret = -1;
     int max_tries = 10;
+    int full_rebuild = 0;
 
     for (; max_tries != 0; max_tries--) {
         /* if the cos_cache is already under work (cos_cache_create_unlock)
@@ -582,9 +627,16 @@ cos_cache_creation_lock(void)
             continue;
         }
         cos_cache_at_work = PR_TRUE;
+        full_rebuild = cos_cache_full_rebuild;
+        cos_cache_reuse_changed = cos_cache_changed_tmpls;
+        cos_cache_full_rebuild = 0;
+        cos_cache_changed_tmpls = NULL;
+        cos_cache_changed_count = 0;
         slapi_unlock_mutex(change_lock);
-        ret = cos_cache_create_unlock();
+        ret = cos_cache_create_unlock(full_rebuild);
         slapi_lock_mutex(change_lock);
+        slapi_ch_array_free(cos_cache_reuse_changed);
+        cos_cache_reuse_changed = NULL;
         cos_cache_at_work = PR_FALSE;
         break;
     }
@@ -1277,6 +1329,89 @@ cos_cache_add_dn_tmpls(char *dn, cosAttrValue *pCosSpecifier, cosAttrValue *pAtt
     return (info.ret);
 }
 
+/*
+    cos_cache_reuse_dn_tmpls
+    ------------------------
+    copies the templates found below dn by the previous cache into
+    pTmpls, provided the previous cache had the same definition and
+    no template below dn changed since it was built
+
+    Returns: zero if at least one tmpl was copied.
+            positive: the previous cache had no tmpl there either.
+            negative: nothing to reuse, dn must be searched.
+*/
+static int
+cos_cache_reuse_dn_tmpls(char *dn, cosAttrValue *pDefDn, cosAttrValue *pCosSpecifier, cosAttrValue *pAttrs, cosTemplates **pTmpls)
+{
+    int ret = -1;
+    int idx;
+    Slapi_DN *tmplSdn = NULL;
+    Slapi_DN *defSdn = NULL;
+    cosDefinitions *pOldDef = NULL;
+    cosTemplates *pOldTmpl = NULL;
+
+    if (cos_cache_reuse_from == NULL || pDefDn == NULL)
+        return ret;
+
+    tmplSdn = slapi_sdn_new_dn_byref(dn);
+
+    /* templates are searched one level below dn, or at dn for pointer schemes */
+    for (idx = 0; cos_cache_reuse_changed && cos_cache_reuse_changed[idx]; idx++) {
+        Slapi_DN *changedSdn = slapi_sdn_new_ndn_byref(cos_cache_reuse_changed[idx]);
+        int changed = !slapi_sdn_compare(changedSdn, tmplSdn) ||
+                      slapi_sdn_isparent(tmplSdn, changedSdn);
+
+        slapi_sdn_free(&changedSdn);
+        if (changed)
+            goto bail;
+    }
+
+    defSdn = slapi_sdn_new_dn_byref(pDefDn->val);
+    for (pOldDef = cos_cache_reuse_from->pDefs; pOldDef; pOldDef = pOldDef->list.pNext) {
+        Slapi_DN *oldSdn = slapi_sdn_new_dn_byref(pOldDef->pDn->val);
+        int found = !slapi_sdn_compare(oldSdn, defSdn);
+
+        slapi_sdn_free(&oldSdn);
+        if (found)
+            break;
+    }
+    slapi_sdn_free(&defSdn);
+
+    /* the old templates hold what the specifier and the attributes selected */
+    if (pOldDef == NULL ||
+        !cos_cache_attrval_list_equal(pOldDef->pCosSpecifier, pCosSpecifier) ||
+        !cos_cache_attrval_list_equal(pOldDef->pCosAttrs, pAttrs)) {
+        goto bail;
+    }
+
+    ret = 1;
+    for (pOldTmpl = pOldDef->pCosTmps; pOldTmpl; pOldTmpl = pOldTmpl->list.pNext) {
+        Slapi_DN *oldSdn = slapi_sdn_new_dn_byref(pOldTmpl->pDn->val);
+        int below = pCosSpecifier ? slapi_sdn_isparent(tmplSdn, oldSdn) : !slapi_sdn_compare(tmplSdn, oldSdn);
+        cosTemplates *theTemp;
+
+        slapi_sdn_free(&oldSdn);
+        if (!below)
+            continue;
+
+        theTemp = (cosTemplates *)slapi_ch_calloc(1, sizeof(cosTemplates));
+        theTemp->pDn = cos_cache_dup_attrval_list(pOldTmpl->pDn);
+        theTemp->pObjectclasses = cos_cache_dup_attrval_list(pOldTmpl->pObjectclasses);
+        theTemp->pAttrs = cos_cache_dup_attr_list(pOldTmpl->pAttrs);
+        theTemp->cosGrade = slapi_ch_strdup(pOldTmpl->cosGrade);
+        theTemp->template_default = pOldTmpl->template_default;
+        theTemp->cosPriority = pOldTmpl->cosPriority;
+
+        cos_cache_add_ll_entry((void **)pTmpls, theTemp, NULL);
+        slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM, "cos_cache_reuse_dn_tmpls - Reused template %s\n", theTemp->pDn->val);
+        ret = 0;
+    }
+
+bail:
+    slapi_sdn_free(&tmplSdn);
+    return ret;
+}
+
 /*
     cos_cache_add_defn
     ------------------
@@ -1358,8 +1493,11 @@ cos_cache_add_defn(
                           (*dn)->val);
 
             while (pTmpTmplDn && cosType != COSTYPE_INDIRECT) {
-                /* create the template */
-                if (!cos_cache_add_dn_tmpls(pTmpTmplDn->val, *spec, *pAttrs, &(theDef->pCosTmps)))
+                /* create the template, from the previous cache if it did not change */
+                int tmpl_ret = cos_cache_reuse_dn_tmpls(pTmpTmplDn->val, *dn, *spec, *pAttrs, &(theDef->pCosTmps));
+                if (tmpl_ret < 0)
+                    tmpl_ret = cos_cache_add_dn_tmpls(pTmpTmplDn->val, *spec, *pAttrs, &(theDef->pCosTmps));
+                if (!tmpl_ret)
                     tmplCount++;
 
                 pTmpTmplDn = pTmpTmplDn->list.pNext;
@@ -1457,6 +1595,71 @@ cos_cache_del_attrval_list(cosAttrValue **pVal)
 }
 
 
+/*
+    cos_cache_attrval_list_equal
+    ----------------------------
+    returns 1 if both lists hold the same values in the same order
+*/
+static int
+cos_cache_attrval_list_equal(cosAttrValue *pVal1, cosAttrValue *pVal2)
+{
+    while (pVal1 && pVal2) {
+        if (slapi_utf8casecmp((unsigned char *)pVal1->val, (unsigned char *)pVal2->val))
+            return 0;
+
+        pVal1 = pVal1->list.pNext;
+        pVal2 = pVal2->list.pNext;
+    }
+
+    return (pVal1 == NULL && pVal2 == NULL);
+}
+
+/*
+    cos_cache_dup_attrval_list
+    --------------------------
+    returns a copy of the list, in the same order
+*/
+static cosAttrValue *
+cos_cache_dup_attrval_list(cosAttrValue *pVal)
+{
+    cosAttrValue *pHead = NULL;
+    cosAttrValue **ppTail = &pHead;
+
+    for (; pVal; pVal = pVal->list.pNext) {
+        cosAttrValue *theVal = (cosAttrValue *)slapi_ch_calloc(1, sizeof(cosAttrValue));
+
+        theVal->val = slapi_ch_strdup(pVal->val);
+        *ppTail = theVal;
+        ppTail = (cosAttrValue **)&(theVal->list.pNext);
+    }
+
+    return pHead;
+}
+
+/*
+    cos_cache_dup_attr_list
+    -----------------------
+    returns a copy of the attribute names and values, in the same
+    order - the schema and the override flags are set when indexing
+*/
+static cosAttributes *
+cos_cache_dup_attr_list(cosAttributes *pAttrs)
+{
+    cosAttributes *pHead = NULL;
+    cosAttributes **ppTail = &pHead;
+
+    for (; pAttrs; pAttrs = pAttrs->list.pNext) {
+        cosAttributes *theAttr = (cosAttributes *)slapi_ch_calloc(1, sizeof(cosAttributes));
+
+        theAttr->pAttrName = slapi_ch_strdup(pAttrs->pAttrName);
+        theAttr->pAttrValue = cos_cache_dup_attrval_list(pAttrs->pAttrValue);
+        *ppTail = theAttr;
+        ppTail = (cosAttributes **)&(theAttr->list.pNext);
+    }
+
+    return pHead;
+}
+
 /*
     cos_cache_add_attrval
     ---------------------
@@ -3166,7 +3369,7 @@ cos_cache_change_notify(Slapi_PBlock *pb)
 {
     const char *dn;
     Slapi_DN *sdn = NULL;
-    int do_update = 0;
+    int do_update = COS_CHANGE_NONE;
     struct slapi_entry *e;
     Slapi_Backend *be = NULL;
     int rc = 0;
@@ -3198,8 +3401,8 @@ cos_cache_change_notify(Slapi_PBlock *pb)
     /*
      * For DELETE, MODIFY, MODRDN: see if the pre-op entry was cos significant.
      * For ADD, MODIFY, MODRDN: see if the post-op was cos significant.
-     * Touching a cos significant entry triggers the update
-     * of the whole cache.
+     * Touching a cos definition triggers the update of the whole
+     * cache, touching a template only that of the templates next to it.
     */
     slapi_pblock_get(pb, SLAPI_OPERATION_TYPE, &optype);
     if (optype == SLAPI_OPERATION_DELETE ||
@@ -3207,22 +3410,27 @@ cos_cache_change_notify(Slapi_PBlock *pb)
         optype == SLAPI_OPERATION_MODRDN) {
 
         slapi_pblock_get(pb, SLAPI_ENTRY_PRE_OP, &e);
-        if (cos_cache_entry_is_cos_related(e)) {
-            do_update = 1;
-        }
+        do_update = cos_cache_entry_is_cos_related(e);
     }
-    if (!do_update &&
+    if (do_update != COS_CHANGE_DEFINITION &&
         (optype == SLAPI_OPERATION_ADD ||
          optype == SLAPI_OPERATION_MODIFY ||
          optype == SLAPI_OPERATION_MODRDN)) {
+        int post_update;
 
         /* Adds have null pre-op entries */
         slapi_pblock_get(pb, SLAPI_ENTRY_POST_OP, &e);
-        if (cos_cache_entry_is_cos_related(e)) {
-            do_update = 1;
+        post_update = cos_cache_entry_is_cos_related(e);
+        if (post_update > do_update) {
+            do_update = post_update;
         }
     }
 
+    /* a renamed template moves between template trees */
+    if (do_update && optype == SLAPI_OPERATION_MODRDN) {
+        do_update = COS_CHANGE_DEFINITION;
+    }
+
     /*
      * Check if this was an entry in a template tree (dn contains
      * the old dn value).
@@ -3241,12 +3449,22 @@ cos_cache_change_notify(Slapi_PBlock *pb)
         slapi_log_err(SLAPI_LOG_PLUGIN, COS_PLUGIN_SUBSYSTEM, "cos_cache_change_notify - "
                                                               "Updating due to indirect template change(%s)\n",
                       dn);
-        do_update = 1;
+        do_update = COS_CHANGE_DEFINITION;
     }
 
     /* Do the update if required */
     if (do_update) {
         slapi_lock_mutex(change_lock);
+        if (do_update == COS_CHANGE_TEMPLATE && !cos_cache_full_rebuild &&
+            cos_cache_changed_count < COS_MAX_CHANGED_TMPLS) {
+            slapi_ch_array_add(&cos_cache_changed_tmpls, slapi_ch_strdup(slapi_sdn_get_ndn(sdn)));
+            cos_cache_changed_count++;
+        } else {
+            cos_cache_full_rebuild = 1;
+            slapi_ch_array_free(cos_cache_changed_tmpls);
+            cos_cache_changed_tmpls = NULL;
+            cos_cache_changed_count = 0;
+        }
         slapi_notify_condvar(something_changed, 1);
         cos_cache_notify_flag = 1;
         slapi_unlock_mutex(change_lock);
@@ -3433,33 +3651,35 @@ cos_cache_backend_state_change(void *handle __attribute__((unused)),
                                int new_be_state __attribute__((unused)))
 {
     slapi_lock_mutex(change_lock);
+    cos_cache_full_rebuild = 1;
     slapi_notify_condvar(something_changed, 1);
     slapi_unlock_mutex(change_lock);
 }
 
 /*
- * returns non-zero: entry is cos significant (note does not detect indirect
- *                    template entries).
- *             0       : entry is not cos significant.
+ * returns COS_CHANGE_DEFINITION: entry is a cos definition, or unknown.
+ *         COS_CHANGE_TEMPLATE: entry is a cos template (note does not
+ *                    detect indirect template entries).
+ *         COS_CHANGE_NONE: entry is not cos significant.
  */
 static int
 cos_cache_entry_is_cos_related(Slapi_Entry *e)
 {
 
-    int rc = 0;
+    int rc = COS_CHANGE_NONE;
     Slapi_Attr *pObjclasses = NULL;
 
     if (e == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM, "cos_cache_entry_is_cos_related - "
                                                            "Modified entry is NULL--updating cache just in case\n");
-        rc = 1;
+        rc = COS_CHANGE_DEFINITION;
     } else {
 
         if (slapi_entry_attr_find(e, "objectclass", &pObjclasses)) {
             slapi_log_err(SLAPI_LOG_ERR, COS_PLUGIN_SUBSYSTEM, "cos_cache_entry_is_cos_related - "
                                                                "Failed to get objectclass from %s\n",
                           slapi_entry_get_dn(e));
-            rc = 0;
+            rc = COS_CHANGE_NONE;
         } else {
 
             Slapi_Value *val = NULL;
@@ -3469,13 +3689,14 @@ cos_cache_entry_is_cos_related(Slapi_Entry *e)
             /* check out the object classes to see if this was a cosDefinition */
 
             index = slapi_attr_first_value(pObjclasses, &val);
-            while (!rc && val) {
+            while (rc != COS_CHANGE_DEFINITION && val) {
                 pObj = (char *)slapi_value_get_string(val);
 
                 if (!strcasecmp(pObj, "cosdefinition") ||
-                    !strcasecmp(pObj, "cossuperdefinition") ||
-                    !strcasecmp(pObj, "costemplate")) {
-                    rc = 1;
+                    !strcasecmp(pObj, "cossuperdefinition")) {
+                    rc = COS_CHANGE_DEFINITION;
+                } else if (!strcasecmp(pObj, "costemplate")) {
+                    rc = COS_CHANGE_TEMPLATE;
                 }
 
                 index = slapi_attr_next_value(pObjclasses, index, &val);
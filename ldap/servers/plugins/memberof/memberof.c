@@ -24,10 +24,18 @@
  * cn: mytask
  * basedn: dc=example, dc=com
  * filter: (uid=test4)
+ * threads: 8
  *
  * where "basedn" is required and refers to the top most node to perform the
- * task on, and where "filter" is an optional attribute that provides a filter
- * describing the entries to be worked on
+ * task on, where "filter" is an optional attribute that provides a filter
+ * describing the entries to be worked on, and where "threads" optionally sets
+ * the number of worker threads (4 by default, 1 to 64)
+ *
+ * The task commits its updates in batches of entries, not in one transaction:
+ * if it stops on an error or a shutdown, the entries already fixed up keep
+ * their new memberof list and the others keep their previous one. Each entry
+ * is rebuilt from the group membership, never from its current memberof
+ * values, so running the task again completes the fixup.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -35,7 +43,9 @@
 #endif
 
 #include <ctype.h>
+#include <errno.h>
 #include <time.h>
+#include <pthread.h>
 #include "slapi-plugin.h"
 #include "string.h"
 #include "nspr.h"
@@ -90,6 +100,7 @@ typedef struct _task_data
     char *dn;
     char *bind_dn;
     char *filter_str;
+    int threads;
 } task_data;
 
 /*** function prototypes ***/
@@ -143,8 +154,9 @@ static int memberof_modop_one_replace_r(Slapi_PBlock *pb, MemberOfConfig *config
 static int memberof_task_add(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *eAfter, int *returncode, char *returntext, void *arg);
 static void memberof_task_destructor(Slapi_Task *task);
 static void memberof_fixup_task_thread(void *arg);
-static int memberof_fix_memberof(MemberOfConfig *config, Slapi_Task *task, task_data *td);
+static int memberof_fix_memberof(MemberOfConfig *config, Slapi_Task *task, task_data *td, Slapi_Backend *be);
 static int memberof_fix_memberof_callback(Slapi_Entry *e, void *callback_data);
+static int memberof_add_delta(MemberOfConfig *config, Slapi_DN *group_sdn, Slapi_Entry *e);
 static int memberof_entry_in_scope(MemberOfConfig *config, Slapi_DN *sdn);
 static int memberof_add_objectclass(char *auto_add_oc, const char *dn);
 static int memberof_add_memberof_attr(LDAPMod **mods, const char *dn, char *add_oc);
@@ -557,6 +569,8 @@ typedef struct _memberof_del_dn_data
     char *type;
 } memberof_del_dn_data;
 
+static int memberof_del_dn_type(Slapi_DN *sdn, memberof_del_dn_data *data);
+
 /* Deletes a member dn from all groups that refer to it. */
 static int
 memberof_del_dn_from_groups(Slapi_PBlock *pb, MemberOfConfig *config, Slapi_DN *sdn)
@@ -588,6 +602,13 @@ memberof_del_dn_from_groups(Slapi_PBlock *pb, MemberOfConfig *config, Slapi_DN *
 
 int
 memberof_del_dn_type_callback(Slapi_Entry *e, void *callback_data)
+{
+    return memberof_del_dn_type(slapi_entry_get_sdn(e), (memberof_del_dn_data *)callback_data);
+}
+
+/* Deletes the values (all of them when data->dn is NULL) of data->type from sdn */
+static int
+memberof_del_dn_type(Slapi_DN *sdn, memberof_del_dn_data *data)
 {
     int rc = 0;
     LDAPMod mod;
@@ -600,15 +621,15 @@ memberof_del_dn_type_callback(Slapi_Entry *e, void *callback_data)
     mods[0] = &mod;
     mods[1] = 0;
 
-    val[0] = ((memberof_del_dn_data *)callback_data)->dn;
+    val[0] = data->dn;
     val[1] = 0;
 
     mod.mod_op = LDAP_MOD_DELETE;
-    mod.mod_type = ((memberof_del_dn_data *)callback_data)->type;
+    mod.mod_type = data->type;
     mod.mod_values = val;
 
     slapi_modify_internal_set_pb_ext(
-        mod_pb, slapi_entry_get_sdn(e),
+        mod_pb, sdn,
         mods, 0, 0,
         memberof_get_plugin_id(), SLAPI_OP_FLAG_BYPASS_REFERRALS);
 
@@ -1488,6 +1509,7 @@ memberof_modop_one_replace_r(Slapi_PBlock *pb, MemberOfConfig *config, int mod_o
     const char *op_this;
     Slapi_Value *to_dn_val = NULL;
     Slapi_Value *this_dn_val = NULL;
+    char **attrs = NULL;
 
     op_to = slapi_sdn_get_ndn(op_to_sdn);
     op_this = slapi_sdn_get_ndn(op_this_sdn);
@@ -1524,7 +1546,9 @@ memberof_modop_one_replace_r(Slapi_PBlock *pb, MemberOfConfig *config, int mod_o
     }
 
     /* determine if this is a group op or single entry */
-    slapi_search_get_entry(&entry_pb, op_to_sdn, config->groupattrs, &e, memberof_get_plugin_id());
+    attrs = slapi_ch_array_dup(config->groupattrs);
+    slapi_ch_array_add(&attrs, slapi_ch_strdup(config->memberof_attr));
+    slapi_search_get_entry(&entry_pb, op_to_sdn, attrs, &e, memberof_get_plugin_id());
     if (!e) {
         /* In the case of a delete, we need to worry about the
          * missing entry being a nested group.  There's a small
@@ -1696,9 +1720,13 @@ memberof_modop_one_replace_r(Slapi_PBlock *pb, MemberOfConfig *config, int mod_o
             goto bail;
         }
 
-        /* For add and del modify operations, we just regenerate the
-         * memberOf attribute. */
-        if (LDAP_MOD_DELETE == mod_op || LDAP_MOD_ADD == mod_op) {
+        /* Adding a member can only add memberships: push the new ones
+         * down to the entry. With skipped nesting the indirect members
+         * keep their direct groups only, so just regenerate them. For
+         * del modify operations, we just regenerate the memberOf attribute. */
+        if (LDAP_MOD_ADD == mod_op && !config->skip_nested) {
+            rc = memberof_add_delta(config, op_this_sdn, e);
+        } else if (LDAP_MOD_DELETE == mod_op || LDAP_MOD_ADD == mod_op) {
             /* find parent groups and replace our member attr */
             rc = memberof_fix_memberof_callback(e, config);
         } else {
@@ -1760,6 +1788,119 @@ bail:
     slapi_value_free(&to_dn_val);
     slapi_value_free(&this_dn_val);
     slapi_search_get_entry_done(&entry_pb);
+    slapi_ch_array_free(attrs);
+    return rc;
+}
+
+/*
+ * memberof_load_delta()
+ *
+ * Loads in config the memberships gained by the (direct or nested)
+ * members of group_sdn: the group itself and its ancestors. They are
+ * computed once per operation.
+ */
+static void
+memberof_load_delta(MemberOfConfig *config, Slapi_DN *group_sdn)
+{
+    const char *group_ndn = slapi_sdn_get_ndn(group_sdn);
+    Slapi_ValueSet *groups = NULL;
+    Slapi_Value *val = NULL;
+    int hint;
+
+    if (config->delta_group && strcmp(config->delta_group, group_ndn) == 0) {
+        return;
+    }
+    slapi_ch_free_string(&config->delta_group);
+    slapi_ch_array_free(config->delta_dns);
+    slapi_ch_array_free(config->delta_ndns);
+    config->delta_dns = NULL;
+    config->delta_ndns = NULL;
+
+    config->delta_group = slapi_ch_strdup(group_ndn);
+    slapi_ch_array_add(&config->delta_dns, slapi_ch_strdup(slapi_sdn_get_dn(group_sdn)));
+    slapi_ch_array_add(&config->delta_ndns, slapi_ch_strdup(group_ndn));
+
+    groups = memberof_get_groups(config, group_sdn);
+    for (hint = slapi_valueset_first_value(groups, &val); val;
+         hint = slapi_valueset_next_value(groups, hint, &val)) {
+        Slapi_DN *sdn = slapi_sdn_new_dn_byref(slapi_value_get_string(val));
+
+        if (strcmp(slapi_sdn_get_ndn(sdn), group_ndn)) {
+            slapi_ch_array_add(&config->delta_dns, slapi_ch_strdup(slapi_sdn_get_dn(sdn)));
+            slapi_ch_array_add(&config->delta_ndns, slapi_ch_strdup(slapi_sdn_get_ndn(sdn)));
+        }
+        slapi_sdn_free(&sdn);
+    }
+    slapi_valueset_free(groups);
+}
+
+/*
+ * memberof_add_delta()
+ *
+ * Adds to e the memberOf values it gained by becoming a (possibly nested)
+ * member of group_sdn. Unlike memberof_fix_memberof_callback(), the other
+ * groups of e are not searched, as adding a member never removes one of
+ * its memberships.
+ */
+static int
+memberof_add_delta(MemberOfConfig *config, Slapi_DN *group_sdn, Slapi_Entry *e)
+{
+    const char *ndn = slapi_entry_get_ndn(e);
+    Slapi_Attr *memberof_attr = NULL;
+    char **vals = NULL;
+    size_t nvals = 0;
+    int rc = 0;
+
+    if (!memberof_entry_in_scope(config, slapi_entry_get_sdn(e))) {
+        /* out of scope entries do not get memberships */
+        return memberof_fix_memberof_callback(e, config);
+    }
+    if (config->fixup_cache && PL_HashTableLookupConst(config->fixup_cache, (void *)ndn)) {
+        /* already regenerated during this operation */
+        return 0;
+    }
+
+    memberof_load_delta(config, group_sdn);
+    slapi_entry_attr_find(e, config->memberof_attr, &memberof_attr);
+    for (size_t i = 0; config->delta_dns && config->delta_dns[i]; i++) {
+        struct berval bv;
+
+        /* a group is never its own member, even in a loop */
+        if (strcmp(config->delta_ndns[i], ndn) == 0) {
+            continue;
+        }
+        bv.bv_val = config->delta_dns[i];
+        bv.bv_len = strlen(config->delta_dns[i]);
+        if (memberof_attr && slapi_attr_value_find(memberof_attr, &bv) == 0) {
+            continue;
+        }
+        if (vals == NULL) {
+            size_t ndelta = i;
+            while (config->delta_dns[ndelta]) {
+                ndelta++;
+            }
+            vals = (char **)slapi_ch_calloc(ndelta + 1, sizeof(char *));
+        }
+        vals[nvals++] = config->delta_dns[i];
+    }
+
+    if (nvals) {
+        LDAPMod mod;
+        LDAPMod *mods[2];
+
+        mod.mod_op = LDAP_MOD_ADD;
+        mod.mod_type = config->memberof_attr;
+        mod.mod_values = vals;
+        mods[0] = &mod;
+        mods[1] = NULL;
+        rc = memberof_add_memberof_attr(mods, slapi_entry_get_dn(e), config->auto_add_oc);
+        if (rc == LDAP_TYPE_OR_VALUE_EXISTS) {
+            /* the entry changed since it was read, regenerate it */
+            rc = memberof_fix_memberof_callback(e, config);
+        }
+    }
+    slapi_ch_free((void **)&vals);
+
     return rc;
 }
 
@@ -2358,7 +2499,7 @@ memberof_get_groups_callback(Slapi_Entry *e, void *callback_data)
         already_seen_ndn_val = slapi_value_new_string(group_ndn);
         slapi_valueset_add_value_ext(already_seen_ndn_vals, already_seen_ndn_val, SLAPI_VALUE_FLAG_PASSIN);
     }
-    if (!config->skip_nested || config->fixup_task) {
+    if (!config->skip_nested) {
         /* now recurse to find ancestors groups of e */
         memberof_get_groups_r(((memberof_get_groups_data *)callback_data)->config,
                               group_sdn, callback_data);
@@ -2815,7 +2956,7 @@ memberof_fixup_task_thread(void *arg)
     Slapi_Task *task = (Slapi_Task *)arg;
     task_data *td = NULL;
     int rc = 0;
-    Slapi_PBlock *fixup_pb = NULL;
+    Slapi_Backend *be = NULL;
 
     if (!task) {
         return; /* no task */
@@ -2844,23 +2985,13 @@ memberof_fixup_task_thread(void *arg)
     memberof_copy_config(&configCopy, memberof_get_config());
     memberof_unlock_config();
 
-    /* Mark this as a task operation */
-    configCopy.fixup_task = 1;
-
     if (usetxn) {
+        /* The updates are applied by the fixup workers, each of them
+         * committing its own batches in a transaction of this backend */
         Slapi_DN *sdn = slapi_sdn_new_dn_byref(td->dn);
-        Slapi_Backend *be = slapi_be_select_exact(sdn);
+        be = slapi_be_select_exact(sdn);
         slapi_sdn_free(&sdn);
-        if (be) {
-            fixup_pb = slapi_pblock_new();
-            slapi_pblock_set(fixup_pb, SLAPI_BACKEND, be);
-            rc = slapi_back_transaction_begin(fixup_pb);
-            if (rc) {
-                slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
-                              "memberof_fixup_task_thread - Failed to start transaction\n");
-                goto done;
-            }
-        } else {
+        if (be == NULL) {
             slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
                           "memberof_fixup_task_thread - Failed to get be backend from (%s)\n",
                           td->dn);
@@ -2872,17 +3003,9 @@ memberof_fixup_task_thread(void *arg)
     }
 
     /* do real work */
-    rc = memberof_fix_memberof(&configCopy, task, td);
+    rc = memberof_fix_memberof(&configCopy, task, td, be);
 
 done:
-    if (usetxn && fixup_pb) {
-        if (rc) { /* failed */
-            slapi_back_transaction_abort(fixup_pb);
-        } else {
-            slapi_back_transaction_commit(fixup_pb);
-        }
-        slapi_pblock_destroy(fixup_pb);
-    }
     memberof_free_config(&configCopy);
 
     slapi_task_log_notice(task, "Memberof task finished.\n");
@@ -2901,7 +3024,7 @@ memberof_task_add(Slapi_PBlock *pb,
                   Slapi_Entry *e,
                   Slapi_Entry *eAfter __attribute__((unused)),
                   int *returncode,
-                  char *returntext __attribute__((unused)),
+                  char *returntext,
                   void *arg)
 {
     PRThread *thread = NULL;
@@ -2911,6 +3034,9 @@ memberof_task_add(Slapi_PBlock *pb,
     char *bind_dn;
     const char *filter;
     const char *dn = 0;
+    const char *threads_str;
+    char *endp = NULL;
+    long threads;
 
     *returncode = LDAP_SUCCESS;
 
@@ -2927,6 +3053,21 @@ memberof_task_add(Slapi_PBlock *pb,
         goto out;
     }
 
+    threads_str = slapi_fetch_attr(e, "threads", STRINGIFYDEFINE(MEMBEROF_FIXUP_DEFAULT_THREADS));
+    errno = 0;
+    threads = strtol(threads_str, &endp, 10);
+    if (errno || endp == threads_str || *endp != '\0' ||
+        threads < 1 || threads > MEMBEROF_FIXUP_MAX_THREADS) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_task_add - Invalid threads value (%s)\n", threads_str);
+        PR_snprintf(returntext, SLAPI_DSE_RETURNTEXT_SIZE,
+                    "Invalid threads value (%s), it must be between 1 and %d",
+                    threads_str, MEMBEROF_FIXUP_MAX_THREADS);
+        *returncode = LDAP_UNWILLING_TO_PERFORM;
+        rv = SLAPI_DSE_CALLBACK_ERROR;
+        goto out;
+    }
+
     /* setup our task data */
     slapi_pblock_get(pb, SLAPI_REQUESTOR_DN, &bind_dn);
     mytaskdata = (task_data *)slapi_ch_malloc(sizeof(task_data));
@@ -2938,6 +3079,7 @@ memberof_task_add(Slapi_PBlock *pb,
     mytaskdata->dn = slapi_ch_strdup(dn);
     mytaskdata->filter_str = slapi_ch_strdup(filter);
     mytaskdata->bind_dn = slapi_ch_strdup(bind_dn);
+    mytaskdata->threads = (int)threads;
 
     /* allocate new task now */
     task = slapi_plugin_new_task(slapi_entry_get_ndn(e), arg);
@@ -2989,23 +3131,573 @@ memberof_task_destructor(Slapi_Task *task)
                   "memberof_task_destructor <--\n");
 }
 
+/*
+ * Fixup task engine
+ *
+ * The group graph of the fixup scope is loaded once with a single search:
+ * every in-scope group gets an index, and every DN found in a grouping
+ * attribute records the indexes of the groups it is a direct member of.
+ * The ancestors of each group are then computed by the worker threads,
+ * each one walking a contiguous range of group indexes. Finally the task
+ * search feeds the target DNs to the workers, which compute the memberOf
+ * values from the graph and apply them in batched transactions.
+ */
+typedef struct _memberof_fixup_node
+{
+    char *ndn;          /* hash key */
+    char *dn;           /* only set for groups */
+    int32_t group;      /* group index, -1 if the node is not a group */
+    int32_t *parents;   /* groups this node is a direct member of */
+    size_t nparents;
+    size_t maxparents;
+    int32_t *ancestors; /* groups only: transitive closure of parents */
+    size_t nancestors;
+} memberof_fixup_node;
+
+typedef struct _memberof_fixup_graph
+{
+    MemberOfConfig *config;
+    PLHashTable *nodes;           /* ndn -> memberof_fixup_node */
+    memberof_fixup_node **groups; /* group index -> node */
+    size_t ngroups;
+    size_t maxgroups;
+    size_t nedges;
+} memberof_fixup_graph;
+
+typedef struct _memberof_fixup_ctx
+{
+    MemberOfConfig *config;
+    memberof_fixup_graph *graph;
+    Slapi_Task *task;
+    Slapi_Backend *be; /* set when the updates run in backend transactions */
+    char *bind_dn;
+    pthread_mutex_t lock;
+    pthread_cond_t cvar;
+    char *queue[MEMBEROF_FIXUP_QUEUE_SIZE]; /* DNs waiting for a worker */
+    size_t head;
+    size_t count;
+    int done;           /* no more DNs will be queued */
+    int rc;             /* first failure, stops the task */
+    unsigned long queued;
+    unsigned long fixed;
+    time_t start;
+} memberof_fixup_ctx;
+
+typedef struct _memberof_fixup_worker
+{
+    memberof_fixup_ctx *ctx;
+    PRThread *tid;
+    size_t first; /* range of groups whose ancestors this worker computes */
+    size_t last;
+    uint8_t *seen; /* group index -> already collected */
+    int32_t *found;
+} memberof_fixup_worker;
+
+static memberof_fixup_node *
+memberof_fixup_get_node(memberof_fixup_graph *graph, const char *ndn)
+{
+    memberof_fixup_node *node;
+
+    node = (memberof_fixup_node *)PL_HashTableLookupConst(graph->nodes, ndn);
+    if (node == NULL) {
+        node = (memberof_fixup_node *)slapi_ch_calloc(1, sizeof(memberof_fixup_node));
+        node->ndn = slapi_ch_strdup(ndn);
+        node->group = -1;
+        PL_HashTableAdd(graph->nodes, node->ndn, node);
+    }
+    return node;
+}
+
+static int
+memberof_fixup_graph_callback(Slapi_Entry *e, void *callback_data)
+{
+    memberof_fixup_graph *graph = (memberof_fixup_graph *)callback_data;
+    MemberOfConfig *config = graph->config;
+    memberof_fixup_node *group;
+    int32_t idx;
+
+    if (slapi_is_shutting_down()) {
+        return -1;
+    }
+    if (!memberof_entry_in_scope(config, slapi_entry_get_sdn(e))) {
+        return 0;
+    }
+    group = memberof_fixup_get_node(graph, slapi_entry_get_ndn(e));
+    if (group->group >= 0) {
+        /* already loaded through an overlapping scope */
+        return 0;
+    }
+    if (graph->ngroups == graph->maxgroups) {
+        graph->maxgroups = graph->maxgroups ? 2 * graph->maxgroups : 1024;
+        graph->groups = (memberof_fixup_node **)slapi_ch_realloc((char *)graph->groups,
+                                                                 graph->maxgroups * sizeof(memberof_fixup_node *));
+    }
+    idx = (int32_t)graph->ngroups++;
+    graph->groups[idx] = group;
+    group->group = idx;
+    group->dn = slapi_ch_strdup(slapi_entry_get_dn(e));
+
+    for (size_t i = 0; config->groupattrs && config->groupattrs[i]; i++) {
+        Slapi_Attr *attr = NULL;
+        Slapi_Value *val = NULL;
+        int hint;
+
+        if (slapi_entry_attr_find(e, config->groupattrs[i], &attr)) {
+            continue;
+        }
+        for (hint = slapi_attr_first_value(attr, &val); val; hint = slapi_attr_next_value(attr, hint, &val)) {
+            Slapi_DN *member_sdn = slapi_sdn_new_dn_byref(slapi_value_get_string(val));
+            memberof_fixup_node *member = memberof_fixup_get_node(graph, slapi_sdn_get_ndn(member_sdn));
+
+            if (member->nparents == 0 || member->parents[member->nparents - 1] != idx) {
+                if (member->nparents == member->maxparents) {
+                    member->maxparents = member->maxparents ? 2 * member->maxparents : 4;
+                    member->parents = (int32_t *)slapi_ch_realloc((char *)member->parents,
+                                                                  member->maxparents * sizeof(int32_t));
+                }
+                member->parents[member->nparents++] = idx;
+                graph->nedges++;
+            }
+            slapi_sdn_free(&member_sdn);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Loads every group that memberof_get_groups() could reach from the
+ * entries under td->dn: the same backends and scopes are searched.
+ */
+static int
+memberof_fixup_load_graph(MemberOfConfig *config, task_data *td, memberof_fixup_graph *graph)
+{
+    Slapi_PBlock *search_pb = slapi_pblock_new();
+    Slapi_DN *task_sdn = slapi_sdn_new_dn_byref(td->dn);
+    Slapi_Backend *be = NULL;
+    char *filter_str = slapi_ch_strdup("(|");
+    char *cookie = NULL;
+    int rc = 0;
+
+    for (size_t i = 0; config->groupattrs && config->groupattrs[i]; i++) {
+        char *tmp = slapi_ch_smprintf("%s(%s=*)", filter_str, config->groupattrs[i]);
+        slapi_ch_free_string(&filter_str);
+        filter_str = tmp;
+    }
+    filter_str = slapi_ch_realloc(filter_str, strlen(filter_str) + 2);
+    strcat(filter_str, ")");
+
+    if (config->allBackends) {
+        be = slapi_get_first_backend(&cookie);
+    } else {
+        be = slapi_be_select(task_sdn);
+    }
+    while (be && rc == 0) {
+        Slapi_DN *base_sdn = (Slapi_DN *)slapi_be_getsuffix(be, 0);
+
+        if (base_sdn && memberof_entry_in_scope(config, base_sdn)) {
+            slapi_search_internal_set_pb(search_pb, slapi_sdn_get_dn(base_sdn),
+                                         LDAP_SCOPE_SUBTREE, filter_str, 0, 0, 0, 0,
+                                         memberof_get_plugin_id(), 0);
+            slapi_search_internal_callback_pb(search_pb, graph, 0, memberof_fixup_graph_callback, 0);
+            slapi_pblock_get(search_pb, SLAPI_PLUGIN_INTOP_RESULT, &rc);
+            slapi_pblock_init(search_pb);
+        } else if (base_sdn && config->entryScopes) {
+            /* Search each include scope of this backend */
+            for (size_t i = 0; config->entryScopes[i] && rc == 0; i++) {
+                if (slapi_sdn_issuffix(config->entryScopes[i], base_sdn)) {
+                    slapi_search_internal_set_pb(search_pb, slapi_sdn_get_dn(config->entryScopes[i]),
+                                                 LDAP_SCOPE_SUBTREE, filter_str, 0, 0, 0, 0,
+                                                 memberof_get_plugin_id(), 0);
+                    slapi_search_internal_callback_pb(search_pb, graph, 0, memberof_fixup_graph_callback, 0);
+                    slapi_pblock_get(search_pb, SLAPI_PLUGIN_INTOP_RESULT, &rc);
+                    slapi_pblock_init(search_pb);
+                }
+            }
+        }
+        if (!config->allBackends) {
+            break;
+        }
+        be = slapi_get_next_backend(cookie);
+    }
+    if (rc == LDAP_SUCCESS && slapi_is_shutting_down()) {
+        rc = -1;
+    }
+
+    slapi_pblock_destroy(search_pb);
+    slapi_sdn_free(&task_sdn);
+    slapi_ch_free((void **)&cookie);
+    slapi_ch_free_string(&filter_str);
+
+    return rc;
+}
+
+static PRIntn
+memberof_fixup_node_free(PLHashEntry *he, PRIntn index __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    memberof_fixup_node *node = (memberof_fixup_node *)he->value;
+
+    slapi_ch_free_string(&node->ndn);
+    slapi_ch_free_string(&node->dn);
+    slapi_ch_free((void **)&node->parents);
+    slapi_ch_free((void **)&node->ancestors);
+    slapi_ch_free((void **)&node);
+
+    return HT_ENUMERATE_REMOVE;
+}
+
+/*
+ * Collects in found the groups node belongs to, directly or not.
+ * Until the ancestors of all groups are known (use_ancestors not set)
+ * the graph is walked up to the top; afterwards the walk stops at the
+ * direct groups and reuses their ancestors. A group is never its own
+ * ancestor, even when it belongs to a membership loop.
+ */
+static size_t
+memberof_fixup_closure(memberof_fixup_graph *graph, memberof_fixup_node *node, uint8_t *seen, int32_t *found, int use_ancestors)
+{
+    size_t nfound = 0;
+
+#define MEMBEROF_FIXUP_COLLECT(idx)                          \
+    do {                                                     \
+        int32_t _idx = (idx);                                \
+        if (_idx != node->group && !seen[_idx]) {            \
+            seen[_idx] = 1;                                  \
+            found[nfound++] = _idx;                          \
+        }                                                    \
+    } while (0)
+
+    for (size_t i = 0; i < node->nparents; i++) {
+        MEMBEROF_FIXUP_COLLECT(node->parents[i]);
+        if (use_ancestors) {
+            memberof_fixup_node *parent = graph->groups[node->parents[i]];
+            for (size_t j = 0; j < parent->nancestors; j++) {
+                MEMBEROF_FIXUP_COLLECT(parent->ancestors[j]);
+            }
+        }
+    }
+    if (!use_ancestors) {
+        /* found is also the queue of the groups left to walk */
+        for (size_t next = 0; next < nfound; next++) {
+            memberof_fixup_node *group = graph->groups[found[next]];
+            for (size_t i = 0; i < group->nparents; i++) {
+                MEMBEROF_FIXUP_COLLECT(group->parents[i]);
+            }
+        }
+    }
+#undef MEMBEROF_FIXUP_COLLECT
+
+    for (size_t i = 0; i < nfound; i++) {
+        seen[found[i]] = 0;
+    }
+    return nfound;
+}
+
+static void
+memberof_fixup_closure_thread(void *arg)
+{
+    memberof_fixup_worker *worker = (memberof_fixup_worker *)arg;
+    memberof_fixup_graph *graph = worker->ctx->graph;
+
+    for (size_t i = worker->first; i < worker->last; i++) {
+        memberof_fixup_node *group = graph->groups[i];
+        size_t nfound = memberof_fixup_closure(graph, group, worker->seen, worker->found, 0);
+
+        if (nfound) {
+            group->ancestors = (int32_t *)slapi_ch_malloc(nfound * sizeof(int32_t));
+            memcpy(group->ancestors, worker->found, nfound * sizeof(int32_t));
+            group->nancestors = nfound;
+        }
+    }
+}
+
+/* Replaces the memberOf values of dn with the groups found in the graph */
+static int
+memberof_fixup_entry(memberof_fixup_worker *worker, const char *dn)
+{
+    memberof_fixup_ctx *ctx = worker->ctx;
+    MemberOfConfig *config = ctx->config;
+    Slapi_DN *sdn = slapi_sdn_new_dn_byref(dn);
+    memberof_fixup_node *node = NULL;
+    size_t nfound = 0;
+    int rc = 0;
+
+    /* Like memberof_get_groups(), an entry out of scope belongs to no group */
+    if (memberof_entry_in_scope(config, sdn)) {
+        node = (memberof_fixup_node *)PL_HashTableLookupConst(ctx->graph->nodes, slapi_sdn_get_ndn(sdn));
+    }
+    if (node) {
+        nfound = memberof_fixup_closure(ctx->graph, node, worker->seen, worker->found, 1);
+    }
+
+    if (nfound) {
+        LDAPMod mod;
+        LDAPMod *mods[2];
+        char **vals = (char **)slapi_ch_malloc((nfound + 1) * sizeof(char *));
+
+        for (size_t i = 0; i < nfound; i++) {
+            vals[i] = ctx->graph->groups[worker->found[i]]->dn;
+        }
+        vals[nfound] = NULL;
+        mod.mod_op = LDAP_MOD_REPLACE;
+        mod.mod_type = config->memberof_attr;
+        mod.mod_values = vals;
+        mods[0] = &mod;
+        mods[1] = NULL;
+
+        rc = memberof_add_memberof_attr(mods, dn, config->auto_add_oc);
+        slapi_ch_free((void **)&vals);
+    } else {
+        /* No groups were found, so remove the memberOf attribute
+         * from this entry. */
+        memberof_del_dn_data del_data = {0, config->memberof_attr};
+        memberof_del_dn_type(sdn, &del_data);
+    }
+    slapi_sdn_free(&sdn);
+
+    return rc;
+}
+
+static int
+memberof_fixup_batch(memberof_fixup_worker *worker, char **batch, size_t nbatch)
+{
+    memberof_fixup_ctx *ctx = worker->ctx;
+    Slapi_PBlock *txn_pb = NULL;
+    int rc = 0;
+
+    if (ctx->be) {
+        txn_pb = slapi_pblock_new();
+        slapi_pblock_set(txn_pb, SLAPI_BACKEND, ctx->be);
+        rc = slapi_back_transaction_begin(txn_pb);
+        if (rc) {
+            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_fixup_batch - Failed to start transaction\n");
+            slapi_pblock_destroy(txn_pb);
+            return rc;
+        }
+    }
+    for (size_t i = 0; i < nbatch && rc == 0; i++) {
+        if (slapi_is_shutting_down()) {
+            rc = -1;
+        } else {
+            rc = memberof_fixup_entry(worker, batch[i]);
+        }
+    }
+    if (txn_pb) {
+        if (rc) {
+            slapi_back_transaction_abort(txn_pb);
+        } else {
+            rc = slapi_back_transaction_commit(txn_pb);
+        }
+        slapi_pblock_destroy(txn_pb);
+    }
+    return rc;
+}
+
+static void
+memberof_fixup_update_thread(void *arg)
+{
+    memberof_fixup_worker *worker = (memberof_fixup_worker *)arg;
+    memberof_fixup_ctx *ctx = worker->ctx;
+    char *batch[MEMBEROF_FIXUP_BATCH];
+
+    /* set bind DN in the thread data */
+    slapi_td_set_dn(slapi_ch_strdup(ctx->bind_dn));
+
+    while (1) {
+        size_t nbatch = 0;
+        int rc;
+
+        pthread_mutex_lock(&ctx->lock);
+        while (ctx->count == 0 && !ctx->done && !ctx->rc) {
+            pthread_cond_wait(&ctx->cvar, &ctx->lock);
+        }
+        while (ctx->count && !ctx->rc && nbatch < MEMBEROF_FIXUP_BATCH) {
+            batch[nbatch++] = ctx->queue[ctx->head];
+            ctx->head = (ctx->head + 1) % MEMBEROF_FIXUP_QUEUE_SIZE;
+            ctx->count--;
+        }
+        pthread_cond_broadcast(&ctx->cvar);
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (nbatch == 0) {
+            /* the search is over or a worker failed */
+            break;
+        }
+        rc = memberof_fixup_batch(worker, batch, nbatch);
+        for (size_t i = 0; i < nbatch; i++) {
+            slapi_ch_free_string(&batch[i]);
+        }
+
+        pthread_mutex_lock(&ctx->lock);
+        if (rc) {
+            if (ctx->rc == 0) {
+                ctx->rc = rc;
+            }
+        } else {
+            ctx->fixed += nbatch;
+        }
+        pthread_cond_broadcast(&ctx->cvar);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+/* Queues the entries returned by the task search for the update workers */
+static int
+memberof_fixup_queue_callback(Slapi_Entry *e, void *callback_data)
+{
+    memberof_fixup_ctx *ctx = (memberof_fixup_ctx *)callback_data;
+    unsigned long fixed;
+    int report;
+    int rc;
+
+    /*
+     * If the server is ordered to shutdown, stop the fixup and return an error.
+     */
+    if (slapi_is_shutting_down()) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->count == MEMBEROF_FIXUP_QUEUE_SIZE && !ctx->rc) {
+        pthread_cond_wait(&ctx->cvar, &ctx->lock);
+    }
+    rc = ctx->rc;
+    if (rc == 0) {
+        ctx->queue[(ctx->head + ctx->count) % MEMBEROF_FIXUP_QUEUE_SIZE] = slapi_ch_strdup(slapi_entry_get_dn(e));
+        ctx->count++;
+        ctx->queued++;
+        pthread_cond_broadcast(&ctx->cvar);
+    }
+    report = (ctx->queued % MEMBEROF_FIXUP_REPORT_INTERVAL) == 0;
+    fixed = ctx->fixed;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (rc) {
+        return -1;
+    }
+    if (report) {
+        time_t elapsed = slapi_current_rel_time_t() - ctx->start;
+        slapi_task_log_status(ctx->task, "Memberof task: %lu entries fixed up (%lu entries/sec)",
+                              fixed, fixed / (elapsed > 0 ? elapsed : 1));
+    }
+    return 0;
+}
+
+static int
+memberof_fixup_start_workers(memberof_fixup_worker *workers, size_t nworkers, void (*fn)(void *))
+{
+    for (size_t i = 0; i < nworkers; i++) {
+        workers[i].tid = PR_CreateThread(PR_USER_THREAD, fn, &workers[i],
+                                         PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD, PR_JOINABLE_THREAD,
+                                         SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (workers[i].tid == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                          "memberof_fixup_start_workers - Unable to create worker thread\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void
+memberof_fixup_join_workers(memberof_fixup_worker *workers, size_t nworkers)
+{
+    for (size_t i = 0; i < nworkers; i++) {
+        if (workers[i].tid) {
+            PR_JoinThread(workers[i].tid);
+            workers[i].tid = NULL;
+        }
+    }
+}
+
 int
-memberof_fix_memberof(MemberOfConfig *config, Slapi_Task *task, task_data *td)
+memberof_fix_memberof(MemberOfConfig *config, Slapi_Task *task, task_data *td, Slapi_Backend *be)
 {
+    memberof_fixup_graph graph = {0};
+    memberof_fixup_ctx ctx = {0};
+    memberof_fixup_worker *workers = NULL;
+    size_t nworkers = td->threads;
+    Slapi_PBlock *search_pb = NULL;
+    time_t elapsed;
     int rc = 0;
-    Slapi_PBlock *search_pb = slapi_pblock_new();
 
+    graph.config = config;
+    graph.nodes = PL_NewHashTable(MEMBEROF_HASHTABLE_SIZE, PL_HashString, PL_CompareStrings,
+                                  PL_CompareValues, NULL, NULL);
+    ctx.config = config;
+    ctx.graph = &graph;
+    ctx.task = task;
+    ctx.be = be;
+    ctx.bind_dn = td->bind_dn;
+    ctx.start = slapi_current_rel_time_t();
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.cvar, NULL);
+
+    /* 1. Load the group graph */
+    slapi_task_log_status(task, "Memberof task: loading groups");
+    rc = memberof_fixup_load_graph(config, td, &graph);
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_fix_memberof - Failed to load the groups (%d)\n", rc);
+        slapi_task_log_notice(task, "Memberof task failed to load the groups (%d)", rc);
+        goto done;
+    }
+    slapi_task_log_notice(task, "Memberof task: loaded %lu groups and %lu memberships",
+                          (unsigned long)graph.ngroups, (unsigned long)graph.nedges);
+
+    /* 2. Compute the ancestors of every group, one range of groups per worker */
+    if (nworkers > graph.ngroups && graph.ngroups > 0) {
+        nworkers = graph.ngroups;
+    }
+    workers = (memberof_fixup_worker *)slapi_ch_calloc(nworkers, sizeof(memberof_fixup_worker));
+    for (size_t i = 0; i < nworkers; i++) {
+        workers[i].ctx = &ctx;
+        workers[i].first = graph.ngroups * i / nworkers;
+        workers[i].last = graph.ngroups * (i + 1) / nworkers;
+        workers[i].seen = (uint8_t *)slapi_ch_calloc(graph.ngroups + 1, sizeof(uint8_t));
+        workers[i].found = (int32_t *)slapi_ch_malloc((graph.ngroups + 1) * sizeof(int32_t));
+    }
+    rc = memberof_fixup_start_workers(workers, nworkers, memberof_fixup_closure_thread);
+    memberof_fixup_join_workers(workers, nworkers);
+    if (rc) {
+        slapi_task_log_notice(task, "Memberof task failed to start its worker threads");
+        goto done;
+    }
+
+    /* 3. Apply the memberOf values to the entries matching the task filter */
+    slapi_task_log_status(task, "Memberof task: updating entries");
+    if (memberof_fixup_start_workers(workers, nworkers, memberof_fixup_update_thread)) {
+        pthread_mutex_lock(&ctx.lock);
+        ctx.rc = -1;
+        pthread_cond_broadcast(&ctx.cvar);
+        pthread_mutex_unlock(&ctx.lock);
+        memberof_fixup_join_workers(workers, nworkers);
+        slapi_task_log_notice(task, "Memberof task failed to start its worker threads");
+        rc = -1;
+        goto done;
+    }
+
+    search_pb = slapi_pblock_new();
     slapi_search_internal_set_pb(search_pb, td->dn,
                                  LDAP_SCOPE_SUBTREE, td->filter_str, 0, 0,
                                  0, 0,
                                  memberof_get_plugin_id(),
                                  0);
-
-    rc = slapi_search_internal_callback_pb(search_pb,
-                                           config,
-                                           0, memberof_fix_memberof_callback,
+    rc = slapi_search_internal_callback_pb(search_pb, &ctx,
+                                           0, memberof_fixup_queue_callback,
                                            0);
-    if (rc) {
+    pthread_mutex_lock(&ctx.lock);
+    ctx.done = 1;
+    pthread_cond_broadcast(&ctx.cvar);
+    pthread_mutex_unlock(&ctx.lock);
+    memberof_fixup_join_workers(workers, nworkers);
+
+    if (ctx.rc) {
+        rc = ctx.rc;
+        slapi_log_err(SLAPI_LOG_ERR, MEMBEROF_PLUGIN_SUBSYSTEM,
+                      "memberof_fix_memberof - Failed to update an entry (%d)\n", rc);
+        slapi_task_log_notice(task, "Memberof task failed to update an entry (%d)", rc);
+    } else if (rc) {
         char *errmsg;
         int result;
 
@@ -3015,8 +3707,38 @@ memberof_fix_memberof(MemberOfConfig *config, Slapi_Task *task, task_data *td)
                       "memberof_fix_memberof - Failed (%s)\n", errmsg);
         slapi_task_log_notice(task, "Memberof task failed (%s)", errmsg);
     }
+    if (rc) {
+        /* the committed batches stay: a new run rebuilds the remaining entries */
+        slapi_task_log_notice(task, "Memberof task stopped after fixing up %lu of %lu entries, "
+                                    "run it again to fix up the remaining ones",
+                              ctx.fixed, ctx.queued);
+    }
+
+    elapsed = slapi_current_rel_time_t() - ctx.start;
+    slapi_task_log_notice(task, "Memberof task: %lu entries fixed up in %ld seconds (%lu entries/sec)",
+                          ctx.fixed, (long)elapsed, ctx.fixed / (elapsed > 0 ? elapsed : 1));
+    slapi_log_err(SLAPI_LOG_INFO, MEMBEROF_PLUGIN_SUBSYSTEM,
+                  "memberof_fix_memberof - %lu entries fixed up in %ld seconds with %lu threads\n",
+                  ctx.fixed, (long)elapsed, (unsigned long)nworkers);
 
+done:
+    /* DNs left behind by a failure */
+    while (ctx.count) {
+        slapi_ch_free_string(&ctx.queue[ctx.head]);
+        ctx.head = (ctx.head + 1) % MEMBEROF_FIXUP_QUEUE_SIZE;
+        ctx.count--;
+    }
+    for (size_t i = 0; workers && i < nworkers; i++) {
+        slapi_ch_free((void **)&workers[i].seen);
+        slapi_ch_free((void **)&workers[i].found);
+    }
+    slapi_ch_free((void **)&workers);
     slapi_pblock_destroy(search_pb);
+    PL_HashTableEnumerateEntries(graph.nodes, memberof_fixup_node_free, NULL);
+    PL_HashTableDestroy(graph.nodes);
+    slapi_ch_free((void **)&graph.groups);
+    pthread_cond_destroy(&ctx.cvar);
+    pthread_mutex_destroy(&ctx.lock);
 
     return rc;
 }
@@ -45,6 +45,14 @@
 #define MEMBEROF_ENTRY_SCOPE_EXCLUDE_SUBTREE "memberOfEntryScopeExcludeSubtree"
 #define DN_SYNTAX_OID             "1.3.6.1.4.1.1466.115.121.1.12"
 #define NAME_OPT_UID_SYNTAX_OID   "1.3.6.1.4.1.1466.115.121.1.34"
+#define MEMBEROF_HASHTABLE_SIZE   1000
+
+/* fixup task */
+#define MEMBEROF_FIXUP_DEFAULT_THREADS 4
+#define MEMBEROF_FIXUP_MAX_THREADS     64
+#define MEMBEROF_FIXUP_BATCH           100   /* entries updated per transaction */
+#define MEMBEROF_FIXUP_QUEUE_SIZE      1024  /* DNs waiting for the workers */
+#define MEMBEROF_FIXUP_REPORT_INTERVAL 10000 /* entries between two status updates */
 
 
 /*
@@ -62,10 +70,12 @@ typedef struct memberofconfig
     Slapi_Filter *group_filter;
     Slapi_Attr **group_slapiattrs;
     int skip_nested;
-    int fixup_task;
     char *auto_add_oc;
     PLHashTable *ancestors_cache;
     PLHashTable *fixup_cache;
+    char *delta_group;  /* ndn of the group whose memberships are in delta_dns */
+    char **delta_dns;   /* delta_group and its ancestors */
+    char **delta_ndns;
 } MemberOfConfig;
 
 /* The key to access the hash table is the normalized DN
@@ -19,7 +19,6 @@
 #include "memberof.h"
 
 #define MEMBEROF_CONFIG_FILTER "(objectclass=*)"
-#define MEMBEROF_HASHTABLE_SIZE 1000
 
 /*
  * The configuration attributes are contained in the plugin entry e.g.
@@ -804,6 +803,9 @@ memberof_free_config(MemberOfConfig *config)
             ancestor_hashtable_empty(config, "memberof_free_config empty group_ancestors_hashtable");
             PL_HashTableDestroy(config->ancestors_cache);
         }
+        slapi_ch_free_string(&config->delta_group);
+        slapi_ch_array_free(config->delta_dns);
+        slapi_ch_array_free(config->delta_ndns);
     }
 }
 
@@ -30,6 +30,7 @@
 #define REFERINT_ATTR_LOGFILE     "referint-logfile"
 #define REFERINT_ATTR_MEMBERSHIP  "referint-membership-attr"
 #define MAX_LINE     2048
+#define REFERINT_MAX_MODS_PER_OP 256 /* values updated by one internal modify */
 #define READ_BUFSIZE 4096
 #define MY_EOF  0
 #define STARTUP 2
@@ -729,261 +730,74 @@ _do_modify(Slapi_PBlock *mod_pb, Slapi_DN *entrySDN, LDAPMod **mods)
 }
 
 /*
- * update one attribute value per _do_modify
+ * Flush the mods collected for an entry
  */
 static int
-_update_one_per_mod(Slapi_DN *entrySDN, /* DN of the searched entry */
-                    Slapi_Attr *attr,   /* referred attribute */
-                    char *attrName,
-                    Slapi_DN *origDN,        /* original DN that was modified */
-                    char *newRDN,            /* new RDN from modrdn */
-                    const char *newsuperior, /* new superior from modrdn */
-                    Slapi_PBlock *mod_pb)
+_flush_entry_mods(Slapi_DN *entrySDN, Slapi_Mods *smods, Slapi_PBlock *mod_pb)
 {
-    LDAPMod attribute1, attribute2;
-    LDAPMod *list_of_mods[3];
-    char *values_del[2];
-    char *values_add[2];
-    char *newDN = NULL;
-    char **dnParts = NULL;
-    char *sval = NULL;
-    char *newvalue = NULL;
-    char *p = NULL;
-    size_t dnlen = 0;
     int rc = 0;
 
-    if (NULL == newRDN && NULL == newsuperior) {
-        /* in delete mode */
-        /* delete old dn so set that up */
-        values_del[0] = (char *)slapi_sdn_get_dn(origDN);
-        values_del[1] = NULL;
-        attribute1.mod_type = attrName;
-        attribute1.mod_op = LDAP_MOD_DELETE;
-        attribute1.mod_values = values_del;
-        list_of_mods[0] = &attribute1;
-        /* terminate list of mods. */
-        list_of_mods[1] = NULL;
-        rc = _do_modify(mod_pb, entrySDN, list_of_mods);
-        if (rc) {
-            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                          "_update_one_per_mod - Entry %s: deleting \"%s: %s\" failed (%d)"
-                          "\n",
-                          slapi_sdn_get_dn(entrySDN), attrName, slapi_sdn_get_dn(origDN), rc);
-        }
-    } else {
-        /* in modrdn mode */
-        const char *superior = NULL;
-        int nval = 0;
-        Slapi_Value *v = NULL;
-
-        if (NULL == origDN) {
-            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                          "_update_one_per_mod - NULL dn was passed\n");
-            goto bail;
-        }
-        /* need to put together rdn into a dn */
-        dnParts = slapi_ldap_explode_dn(slapi_sdn_get_dn(origDN), 0);
-        if (NULL == dnParts) {
-            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                          "_update_one_per_mod - Failed to explode dn %s\n",
-                          slapi_sdn_get_dn(origDN));
-            goto bail;
-        }
-        if (NULL == newRDN) {
-            newRDN = dnParts[0];
-        }
-        if (newsuperior) {
-            superior = newsuperior;
-        } else {
-            /* do not free superior */
-            superior = slapi_dn_find_parent(slapi_sdn_get_dn(origDN));
-        }
-        /* newRDN and superior are already normalized. */
-        newDN = slapi_ch_smprintf("%s,%s", newRDN, superior);
-        slapi_dn_ignore_case(newDN);
-        /*
-         * Compare the modified dn with the value of
-         * the target attribute of referint to find out
-         * the modified dn is the ancestor (case 2) or
-         * the value itself (case 1).
-         *
-         * E.g.,
-         * (case 1)
-         * modrdn: uid=A,ou=B,o=C --> uid=A',ou=B',o=C
-         *            (origDN)             (newDN)
-         * member: uid=A,ou=B,ou=C --> uid=A',ou=B',ou=C
-         *            (sval)               (newDN)
-         *
-         * (case 2)
-         * modrdn: ou=B,o=C --> ou=B',o=C
-         *         (origDN)      (newDN)
-         * member: uid=A,ou=B,ou=C --> uid=A,ou=B',ou=C
-         *         (sval)              (sval' + newDN)
-         */
-        for (nval = slapi_attr_first_value(attr, &v); nval != -1;
-             nval = slapi_attr_next_value(attr, nval, &v)) {
-            int normalize_rc;
-            p = NULL;
-            dnlen = 0;
-
-            /* DN syntax, which should be a string */
-            sval = slapi_ch_strdup(slapi_value_get_string(v));
-            normalize_rc = slapi_dn_normalize_case_ext(sval, 0, &p, &dnlen);
-            if (normalize_rc == 0) { /* sval is passed in; not terminated */
-                *(p + dnlen) = '\0';
-                sval = p;
-            } else if (normalize_rc > 0) {
-                slapi_ch_free_string(&sval);
-                sval = p;
-            }
-            /* else: (normalize_rc < 0) Ignore the DN normalization error for now. */
-
-            p = PL_strstr(sval, slapi_sdn_get_ndn(origDN));
-            if (p == sval) {
-                /* (case 1) */
-                values_del[0] = sval;
-                values_del[1] = NULL;
-                attribute1.mod_type = attrName;
-                attribute1.mod_op = LDAP_MOD_DELETE;
-                attribute1.mod_values = values_del;
-                list_of_mods[0] = &attribute1;
-
-                values_add[0] = newDN;
-                values_add[1] = NULL;
-                attribute2.mod_type = attrName;
-                attribute2.mod_op = LDAP_MOD_ADD;
-                attribute2.mod_values = values_add;
-                list_of_mods[1] = &attribute2;
-                list_of_mods[2] = NULL;
-                rc = _do_modify(mod_pb, entrySDN, list_of_mods);
-                if (rc) {
-                    slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                                  "_update_one_per_mod - Entry %s: replacing \"%s: %s\" "
-                                  "with \"%s: %s\" failed (%d)\n",
-                                  slapi_sdn_get_dn(entrySDN), attrName,
-                                  slapi_sdn_get_dn(origDN), attrName, newDN, rc);
-                }
-            } else if (p) {
-                char bak;
-                /* (case 2) */
-                values_del[0] = sval;
-                values_del[1] = NULL;
-                attribute1.mod_type = attrName;
-                attribute1.mod_op = LDAP_MOD_DELETE;
-                attribute1.mod_values = values_del;
-                list_of_mods[0] = &attribute1;
-
-                bak = *p;
-                *p = '\0';
-                /* newRDN and superior are already normalized. */
-                newvalue = slapi_ch_smprintf("%s%s", sval, newDN);
-                *p = bak;
-                values_add[0] = newvalue;
-                values_add[1] = NULL;
-                attribute2.mod_type = attrName;
-                attribute2.mod_op = LDAP_MOD_ADD;
-                attribute2.mod_values = values_add;
-                list_of_mods[1] = &attribute2;
-                list_of_mods[2] = NULL;
-                rc = _do_modify(mod_pb, entrySDN, list_of_mods);
-                if (rc) {
-                    slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                                  "_update_one_per_mod - Entry %s: replacing \"%s: %s\" "
-                                  "with \"%s: %s\" failed (%d)\n",
-                                  slapi_sdn_get_dn(entrySDN), attrName, sval, attrName, newvalue, rc);
-                }
-                slapi_ch_free_string(&newvalue);
-            }
-            /* else: value does not include the modified DN.  Ignore it. */
-            slapi_ch_free_string(&sval);
-        }
-
-        /* cleanup memory allocated for dnParts and newDN */
-        if (dnParts) {
-            slapi_ldap_value_free(dnParts);
-            dnParts = NULL;
-        }
-        slapi_ch_free_string(&newDN);
+    if (slapi_mods_get_num_mods(smods) == 0) {
+        return rc;
     }
-bail:
+    rc = _do_modify(mod_pb, entrySDN, slapi_mods_get_ldapmods_byref(smods));
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
+                      "_flush_entry_mods - Entry %s: updating %d values failed (%d)\n",
+                      slapi_sdn_get_dn(entrySDN), slapi_mods_get_num_mods(smods), rc);
+    }
+    slapi_mods_done(smods);
+    slapi_mods_init(smods, 0);
+
     return rc;
 }
 
 /*
- * update multiple attribute values per _do_modify
+ * Collect in smods the updates of one referring attribute, so that all
+ * the attributes of an entry are updated with a single modify.
+ * If an entry contains 1000s of values which need to be updated by the
+ * referint plugin (e.g., renaming the parent of 1000s of members), the
+ * mods are flushed every REFERINT_MAX_MODS_PER_OP to avoid allocating too
+ * many mods in one "modify" call.
  */
 static int
-_update_all_per_mod(Slapi_DN *entrySDN, /* DN of the searched entry */
-                    Slapi_Attr *attr,   /* referred attribute */
-                    char *attrName,
-                    Slapi_DN *origDN,        /* original DN that was modified */
-                    char *newRDN,            /* new RDN from modrdn */
-                    const char *newsuperior, /* new superior from modrdn */
-                    Slapi_PBlock *mod_pb)
+_update_entry_attr(Slapi_DN *entrySDN, /* DN of the searched entry */
+                   Slapi_Attr *attr,   /* referred attribute */
+                   char *attrName,
+                   Slapi_DN *origDN,        /* original DN that was modified */
+                   const char *newDN,       /* new DN from modrdn, NULL on delete */
+                   Slapi_Mods *smods,
+                   Slapi_PBlock *mod_pb)
 {
-    Slapi_Mods *smods = NULL;
-    char *newDN = NULL;
-    char **dnParts = NULL;
     char *sval = NULL;
     char *newvalue = NULL;
     char *p = NULL;
     size_t dnlen = 0;
+    int nval = 0;
+    Slapi_Value *v = NULL;
     int rc = 0;
 
-    if (NULL == newRDN && NULL == newsuperior) {
-        /* in delete mode */
-        LDAPMod *mods[2];
-        char *values_del[2];
-        LDAPMod attribute1;
-
-        /* delete old dn so set that up */
-        values_del[0] = (char *)slapi_sdn_get_dn(origDN);
-        values_del[1] = NULL;
-        attribute1.mod_type = attrName;
-        attribute1.mod_op = LDAP_MOD_DELETE;
-        attribute1.mod_values = values_del;
-        mods[0] = &attribute1;
-        /* terminate list of mods. */
-        mods[1] = NULL;
-        rc = _do_modify(mod_pb, entrySDN, mods);
-        if (rc) {
-            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                          "_update_all_per_mod - Entry %s: deleting \"%s: %s\" failed (%d)"
-                          "\n",
-                          slapi_sdn_get_dn(entrySDN), attrName, slapi_sdn_get_dn(origDN), rc);
-        }
-    } else {
-        /* in modrdn mode */
-        const char *superior = NULL;
-        int nval = 0;
-        Slapi_Value *v = NULL;
+    if (NULL == newDN) {
+        /*
+         * in delete mode
+         *
+         * The entry was found through any of the membership attributes:
+         * only delete the old dn from the attributes that hold it, else
+         * the modify fails with LDAP_NO_SUCH_ATTRIBUTE. The lookup uses the
+         * values the attribute syntax already normalized, and the backend
+         * matches the delete the same way.
+         */
+        struct berval bv;
 
-        if (NULL == origDN) {
-            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                          "_update_all_per_mod - NULL dn was passed\n");
-            goto bail;
+        bv.bv_val = (char *)slapi_sdn_get_ndn(origDN);
+        bv.bv_len = slapi_sdn_get_ndn_len(origDN);
+        if (slapi_attr_value_find(attr, &bv) == 0) {
+            slapi_mods_add_string(smods, LDAP_MOD_DELETE, attrName, slapi_sdn_get_dn(origDN));
         }
-        /* need to put together rdn into a dn */
-        dnParts = slapi_ldap_explode_dn(slapi_sdn_get_dn(origDN), 0);
-        if (NULL == dnParts) {
-            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                          "_update_all_per_mod - Failed to explode dn %s\n",
-                          slapi_sdn_get_dn(origDN));
-            goto bail;
-        }
-        if (NULL == newRDN) {
-            newRDN = dnParts[0];
-        }
-        if (newsuperior) {
-            superior = newsuperior;
-        } else {
-            /* do not free superior */
-            superior = slapi_dn_find_parent(slapi_sdn_get_dn(origDN));
-        }
-        /* newRDN and superior are already normalized. */
-        newDN = slapi_ch_smprintf("%s,%s", newRDN, superior);
-        slapi_dn_ignore_case(newDN);
+    } else {
         /*
+         * in modrdn mode
+         *
          * Compare the modified dn with the value of
          * the target attribute of referint to find out
          * the modified dn is the ancestor (case 2) or
@@ -1002,12 +816,8 @@ _update_all_per_mod(Slapi_DN *entrySDN, /* DN of the searched entry */
          * member: uid=A,ou=B,ou=C --> uid=A,ou=B',ou=C
          *         (sval)              (sval' + newDN)
          */
-        slapi_attr_get_numvalues(attr, &nval);
-        smods = slapi_mods_new();
-        slapi_mods_init(smods, 2 * nval + 1);
-
         for (nval = slapi_attr_first_value(attr, &v);
-             nval != -1;
+             nval != -1 && rc == 0;
              nval = slapi_attr_next_value(attr, nval, &v)) {
             int normalize_rc;
             p = NULL;
@@ -1041,27 +851,50 @@ _update_all_per_mod(Slapi_DN *entrySDN, /* DN of the searched entry */
             }
             /* else: value does not include the modified DN.  Ignore it. */
             slapi_ch_free_string(&sval);
-        }
-        rc = _do_modify(mod_pb, entrySDN, slapi_mods_get_ldapmods_byref(smods));
-        if (rc) {
-            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                          "_update_all_per_mod - Entry %s failed (%d)\n",
-                          slapi_sdn_get_dn(entrySDN), rc);
-        }
 
-        /* cleanup memory allocated for dnParts and newDN */
-        if (dnParts) {
-            slapi_ldap_value_free(dnParts);
-            dnParts = NULL;
+            if (slapi_mods_get_num_mods(smods) >= REFERINT_MAX_MODS_PER_OP) {
+                rc = _flush_entry_mods(entrySDN, smods, mod_pb);
+            }
         }
-        slapi_ch_free_string(&newDN);
-        slapi_mods_free(&smods);
     }
 
-bail:
     return rc;
 }
 
+/*
+ * Build the filter matching the entries referring to origDN (or to one of
+ * its descendants when renaming) through any of the membership attributes
+ */
+static char *
+_referint_filter(char **membership_attrs, const char *origDN, int subtree)
+{
+    char *filter = slapi_ch_strdup("(|");
+    char *tmp_filter;
+
+    for (size_t i = 0; membership_attrs[i] != NULL; i++) {
+        char *term;
+        char *tmp;
+
+        if (subtree) {
+            /* we need to check the children of the old dn, so use a wildcard */
+            term = slapi_filter_sprintf("(%s=*%s%s)", membership_attrs[i], ESC_NEXT_VAL, origDN);
+        } else {
+            term = slapi_filter_sprintf("(%s=%s%s)", membership_attrs[i], ESC_NEXT_VAL, origDN);
+        }
+        if (term == NULL) {
+            slapi_ch_free_string(&filter);
+            return NULL;
+        }
+        tmp = slapi_ch_smprintf("%s%s", filter, term);
+        slapi_ch_free_string(&filter);
+        slapi_ch_free_string(&term);
+        filter = tmp;
+    }
+    tmp_filter = slapi_ch_smprintf("%s)", filter);
+    slapi_ch_free_string(&filter);
+    return tmp_filter;
+}
+
 int
 update_integrity(Slapi_DN *origSDN,
                  char *newrDN,
@@ -1071,6 +904,7 @@ update_integrity(Slapi_DN *origSDN,
     Slapi_PBlock *search_result_pb = NULL;
     Slapi_PBlock *mod_pb = slapi_pblock_new();
     Slapi_Entry **search_entries = NULL;
+    Slapi_Mods *smods = NULL;
     Slapi_DN *sdn = NULL;
     Slapi_Attr *attr = NULL;
     void *node = NULL;
@@ -1078,19 +912,47 @@ update_integrity(Slapi_DN *origSDN,
     const char *search_base = NULL;
     char *attrName = NULL;
     char *filter = NULL;
-    char *attrs[2];
+    char *newDN = NULL;
     char **membership_attrs = NULL;
     int search_result;
-    int nval = 0;
     int i, j;
     int rc = SLAPI_PLUGIN_SUCCESS;
 
     membership_attrs = referint_get_attrs();
-    /*
-     *  For now, just putting attributes to keep integrity on in conf file,
-     *  until resolve the other timing mode issue
-     */
+    if (membership_attrs == NULL || membership_attrs[0] == NULL) {
+        goto free_and_return;
+    }
+
+    if (newrDN || newsuperior) {
+        /* in modrdn mode, need to put together the new dn */
+        const char *superior = slapi_sdn_get_dn(newsuperior);
+        char **dnParts = NULL;
+
+        dnParts = slapi_ldap_explode_dn(origDN, 0);
+        if (NULL == dnParts) {
+            slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
+                          "update_integrity - Failed to explode dn %s\n", origDN);
+            goto free_and_return;
+        }
+        if (NULL == superior) {
+            /* do not free superior */
+            superior = slapi_dn_find_parent(origDN);
+        }
+        /* newRDN and superior are already normalized. */
+        newDN = slapi_ch_smprintf("%s,%s", newrDN ? newrDN : dnParts[0], superior);
+        slapi_dn_ignore_case(newDN);
+        slapi_ldap_value_free(dnParts);
+    }
+
+    /* A single search per naming context looks for all the membership
+     * attributes, and each referring entry is updated with one modify */
+    filter = _referint_filter(membership_attrs, origDN, newrDN != NULL);
+    if (filter == NULL) {
+        goto free_and_return;
+    }
     search_result_pb = slapi_pblock_new();
+    smods = slapi_mods_new();
+    slapi_mods_init(smods, 0);
 
     /* Search each namingContext in turn
      * or use the defined scope(s)
@@ -1104,113 +966,82 @@ update_integrity(Slapi_DN *origSDN,
         Slapi_Backend *be = slapi_be_select(sdn);
         search_base = slapi_sdn_get_dn(sdn);
 
-        for (i = 0; membership_attrs[i] != NULL; i++) {
-            if (newrDN) {
-                /* we need to check the children of the old dn, so use a wildcard */
-                filter = slapi_filter_sprintf("(%s=*%s%s)", membership_attrs[i], ESC_NEXT_VAL, origDN);
-            } else {
-                filter = slapi_filter_sprintf("(%s=%s%s)", membership_attrs[i], ESC_NEXT_VAL, origDN);
-            }
-            if (filter) {
-                /* Need only the current attribute and its subtypes */
-                attrs[0] = membership_attrs[i];
-                attrs[1] = NULL;
-
-                /* Use new search API */
-                slapi_pblock_init(search_result_pb);
-                slapi_pblock_set(search_result_pb, SLAPI_BACKEND, be);
-                slapi_search_internal_set_pb(search_result_pb, search_base,
-                                             LDAP_SCOPE_SUBTREE, filter, attrs, 0 /* attrs only */,
-                                             NULL, NULL, referint_plugin_identity, 0);
-                slapi_search_internal_pb(search_result_pb);
-
-                slapi_pblock_get(search_result_pb, SLAPI_PLUGIN_INTOP_RESULT, &search_result);
-
-                /* if search successfull then do integrity update */
-                if (search_result == LDAP_SUCCESS) {
-                    slapi_pblock_get(search_result_pb, SLAPI_PLUGIN_INTOP_SEARCH_ENTRIES,
-                                     &search_entries);
-
-                    for (j = 0; search_entries[j] != NULL; j++) {
-                        attr = NULL;
-                        attrName = NULL;
-                        /*
-                         *  Loop over all the attributes of the entry and search
-                         *  for the integrity attribute and its subtypes
-                         */
-                        for (slapi_entry_first_attr(search_entries[j], &attr); attr;
-                             slapi_entry_next_attr(search_entries[j], attr, &attr)) {
-                            /*
-                             *  Take into account only the subtypes of the attribute
-                             *  in argv[i] having the necessary value  - origDN
-                             */
-                            slapi_attr_get_type(attr, &attrName);
-                            if (slapi_attr_type_cmp(membership_attrs[i], attrName,
-                                                    SLAPI_TYPE_CMP_SUBTYPE) == 0) {
-                                nval = 0;
-                                slapi_attr_get_numvalues(attr, &nval);
-                                /*
-                                 * We want to reduce the "modify" call as much as
-                                 * possible. But if an entry contains 1000s of
-                                 * attributes which need to be updated by the
-                                 * referint plugin (e.g., a group containing 1000s
-                                 * of members), we want to avoid to allocate too
-                                 * many mods * in one "modify" call.
-                                 * This is a compromise: If an attribute type has
-                                 * more than 128 values, we update the attribute
-                                 * value one by one. Otherwise, update all values
-                                 * in one "modify" call.
-                                 */
-                                if (nval > 128) {
-                                    rc = _update_one_per_mod(
-                                        slapi_entry_get_sdn(search_entries[j]),
-                                        attr, attrName, origSDN, newrDN,
-                                        slapi_sdn_get_dn(newsuperior),
-                                        mod_pb);
-                                } else {
-                                    rc = _update_all_per_mod(
-                                        slapi_entry_get_sdn(search_entries[j]),
-                                        attr, attrName, origSDN, newrDN,
-                                        slapi_sdn_get_dn(newsuperior),
-                                        mod_pb);
-                                }
-                                if (rc) {
-                                    if (use_txn) {
-                                        /*
-                                         * We're using backend transactions,
-                                         * so we need to stop on failure.
-                                         */
-                                        if (pb) {
-                                            /* Set the error code of the failure */
-                                            slapi_pblock_set(pb, SLAPI_RESULT_CODE, &rc);
-                                        }
-                                        rc = SLAPI_PLUGIN_FAILURE;
-                                        goto free_and_return;
-                                    } else {
-                                        rc = SLAPI_PLUGIN_SUCCESS;
-                                    }
-                                }
-                            }
+        /* Need only the membership attributes and their subtypes */
+        slapi_pblock_init(search_result_pb);
+        slapi_pblock_set(search_result_pb, SLAPI_BACKEND, be);
+        slapi_search_internal_set_pb(search_result_pb, search_base,
+                                     LDAP_SCOPE_SUBTREE, filter, membership_attrs, 0 /* attrs only */,
+                                     NULL, NULL, referint_plugin_identity, 0);
+        slapi_search_internal_pb(search_result_pb);
+
+        slapi_pblock_get(search_result_pb, SLAPI_PLUGIN_INTOP_RESULT, &search_result);
+
+        /* if search successfull then do integrity update */
+        if (search_result == LDAP_SUCCESS) {
+            slapi_pblock_get(search_result_pb, SLAPI_PLUGIN_INTOP_SEARCH_ENTRIES,
+                             &search_entries);
+
+            for (j = 0; search_entries[j] != NULL; j++) {
+                Slapi_DN *entrySDN = slapi_entry_get_sdn(search_entries[j]);
+
+                attr = NULL;
+                attrName = NULL;
+                /*
+                 *  Loop over all the attributes of the entry and search
+                 *  for the integrity attributes and their subtypes
+                 */
+                for (slapi_entry_first_attr(search_entries[j], &attr); attr && rc == 0;
+                     slapi_entry_next_attr(search_entries[j], attr, &attr)) {
+                    slapi_attr_get_type(attr, &attrName);
+                    for (i = 0; membership_attrs[i] != NULL; i++) {
+                        if (slapi_attr_type_cmp(membership_attrs[i], attrName,
+                                                SLAPI_TYPE_CMP_SUBTYPE) == 0) {
+                            rc = _update_entry_attr(entrySDN, attr, attrName, origSDN,
+                                                    newDN, smods, mod_pb);
+                            break;
                         }
                     }
+                }
+                if (rc == 0) {
+                    rc = _flush_entry_mods(entrySDN, smods, mod_pb);
                 } else {
-                    if (isFatalSearchError(search_result)) {
-                        slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
-                                      "update_integrity - Search (base=%s filter=%s) returned "
-                                      "error %d\n",
-                                      search_base, filter, search_result);
-                        slapi_free_search_results_internal(search_result_pb);
+                    slapi_mods_done(smods);
+                    slapi_mods_init(smods, 0);
+                }
+                if (rc) {
+                    if (use_txn) {
+                        /*
+                         * We're using backend transactions,
+                         * so we need to stop on failure.
+                         */
                         if (pb) {
-                            slapi_pblock_set(pb, SLAPI_RESULT_CODE, &search_result);
+                            /* Set the error code of the failure */
+                            slapi_pblock_set(pb, SLAPI_RESULT_CODE, &rc);
                         }
                         rc = SLAPI_PLUGIN_FAILURE;
+                        slapi_free_search_results_internal(search_result_pb);
                         goto free_and_return;
+                    } else {
+                        rc = SLAPI_PLUGIN_SUCCESS;
                     }
                 }
-                slapi_ch_free_string(&filter);
+            }
+        } else {
+            if (isFatalSearchError(search_result)) {
+                slapi_log_err(SLAPI_LOG_ERR, REFERINT_PLUGIN_SUBSYSTEM,
+                              "update_integrity - Search (base=%s filter=%s) returned "
+                              "error %d\n",
+                              search_base, filter, search_result);
                 slapi_free_search_results_internal(search_result_pb);
+                if (pb) {
+                    slapi_pblock_set(pb, SLAPI_RESULT_CODE, &search_result);
+                }
+                rc = SLAPI_PLUGIN_FAILURE;
+                goto free_and_return;
             }
         }
+        slapi_free_search_results_internal(search_result_pb);
+
         if (plugin_ContainerScope) {
             /* at the moment only a single scope is supported
              * so the loop ends after the first iteration
@@ -1225,7 +1056,9 @@ update_integrity(Slapi_DN *origSDN,
 free_and_return:
     /* free filter and search_results_pb */
     slapi_ch_free_string(&filter);
+    slapi_ch_free_string(&newDN);
     slapi_ch_array_free(membership_attrs);
+    slapi_mods_free(&smods);
 
     slapi_pblock_destroy(mod_pb);
     slapi_pblock_destroy(search_result_pb);
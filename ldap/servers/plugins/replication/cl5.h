@@ -28,6 +28,8 @@ typedef struct changelog5Config
     /* configuration of changelog encryption */
     char *encryptionAlgorithm;
     char *symmetricKey;
+    /* deflate new changelog records */
+    int32_t compression;
 } changelog5Config;
 
 /* upgrade changelog*/
@@ -32,13 +32,17 @@
 #include "plhash.h"
 #include "plstr.h"
 #include <pthread.h>
+#include <zlib.h>
 #include "cl5_clcache.h" /* To use the Changelog Cache */
+#include "cl5_compress.h"
 #include "repl5.h"       /* for agmt_get_consumer_rid() */
 
 #define GUARDIAN_FILE "guardian" /* name of the guardian file */
 #define VERSION_FILE "DBVERSION" /* name of the version file  */
 #define V_5 5                    /* changelog entry version */
 #define V_6 6                    /* changelog entry version that includes encrypted flag */
+#define V_7 7                    /* changelog entry version with a flags byte and an optionally compressed body */
+#define CL5_COMPRESS_MIN_SIZE 64 /* bodies smaller than this are never worth compressing */
 #define CHUNK_SIZE 64 * 1024
 #define DBID_SIZE 64
 #define FILE_SEP "_" /* separates parts of the db file name */
@@ -102,6 +106,7 @@ typedef struct cl5config
     int maxEntries;      /* maximum number of entries across all changelog files */
     int trimInterval;    /* trimming interval */
     char *encryptionAlgorithm; /* nsslapd-encryptionalgorithm */
+    int32_t compression; /* nsslapd-changelogcompression */
 } CL5Config;
 
 /* this structure represents one changelog file, Each changelog file contains
@@ -169,7 +174,9 @@ static int _cl5DispatchTrimThread(Replica *replica);
 static int _cl5ExportFile(PRFileDesc *prFile, cldb_Handle *cldb);
 
 /* data storage and retrieval */
-static int _cl5Entry2DBData(const CL5Entry *entry, char **data, PRUint32 *len, void *clcrypt_handle);
+static int _cl5Entry2DBData(const CL5Entry *entry, char **data, PRUint32 *len, void *clcrypt_handle, int32_t compress);
+static void _cl5CompressEntryData(char **data, PRUint32 *len, PRUint32 hdrlen);
+static int _cl5UncompressEntryData(const char *cdata, PRUint32 clen, char **body);
 static int _cl5WriteOperation(cldb_Handle *cldb, const slapi_operation_parameters *op);
 static int _cl5WriteOperationTxn(cldb_Handle *cldb, const slapi_operation_parameters *op, void *txn);
 static int _cl5GetFirstEntry(cldb_Handle *cldb, CL5Entry *entry, void **iterator, dbi_txn_t *txnid);
@@ -311,6 +318,8 @@ _cldb_DeleteDB(Replica *replica)
 
     be = slapi_be_select(replica_get_root(replica));
  
+    /* the changes kept in memory are gone with the db */
+    clcache_reset_ring(cldb->db);
     slapi_back_ctrl_info(be, BACK_INFO_DBENV_CLDB_REMOVE, (void *)(cldb->db));
     cldb->db = NULL;
 
@@ -747,6 +756,31 @@ cl5ConfigTrimming(Replica *replica, int maxEntries, const char *maxAge, int trim
     return CL5_SUCCESS;
 }
 
+/* Name:        cl5ConfigCompression
+   Description: enables or disables the compression of new changelog records;
+                changelog must be open.
+   Parameters:  compression - non zero to compress new records.
+   Return:      CL5_SUCCESS if successful;
+                CL5_BAD_STATE if changelog is not open
+ */
+int
+cl5ConfigCompression(Replica *replica, int32_t compression)
+{
+    cldb_Handle *cldb = replica_get_cl_info(replica);
+
+    if (cldb->dbState == CL5_STATE_CLOSED) {
+        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name_cl,
+                      "cl5ConfigCompression - Changelog is not initialized\n");
+        return CL5_BAD_STATE;
+    }
+
+    pthread_mutex_lock(&(cldb->clLock));
+    cldb->clConf.compression = compression;
+    pthread_mutex_unlock(&(cldb->clLock));
+
+    return CL5_SUCCESS;
+}
+
 /* Name:        cl5DestroyIterator
    Description: destroys iterator once iteration through changelog is done
    Parameters:  iterator - iterator to destroy
@@ -1076,7 +1110,8 @@ cl5GetNextOperationToReplay(CL5ReplayIterator *iterator, CL5Entry *entry)
 
     /* there is an entry we should return */
     /* Callers of this function should cl5_operation_parameters_done(op) */
-    if (0 != cl5DBData2Entry(data, datalen, entry, iterator->it_cldb->clcrypt_handle)) {
+    rc = cl5DBData2Entry(data, datalen, entry, iterator->it_cldb->clcrypt_handle);
+    if (0 != rc) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name_cl,
                       "cl5GetNextOperationToReplay - %s - Failed to format entry rc=%d\n", agmt_name, rc);
         return rc;
@@ -1328,6 +1363,7 @@ cldb_SetReplicaDB(Replica *replica, void *arg)
         cldb->clConf.encryptionAlgorithm = config.encryptionAlgorithm;
         cldb->clcrypt_handle = clcrypt_init(config.encryptionAlgorithm, be);
     }
+    cldb->clConf.compression = config.compression;
     changelog5_config_done(&config);
 
     slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name_cl,
@@ -1426,6 +1462,10 @@ _cldb_CheckAndSetEnv(Slapi_Backend *be, cldb_Handle *cldb)
    <null terminated uniqueid><null terminated targetdn>
    [<null terminated newrdn><1 byte deleteoldrdn>][<4 byte mod count><mod1><mod2>....]
 
+   Version 7 replaces "encrypted" by a flags byte (CL5_FLAG_*). When
+   CL5_FLAG_COMPRESSED is set everything following the csn is deflated:
+   <1 byte version><1 byte flags><1 byte change_type><sizeof time_t time><null terminated csn>
+   <4 byte uncompressed size><deflated uniqueid, targetdn, ... mods>
 
    mod format:
    -----------
@@ -1433,9 +1473,10 @@ _cldb_CheckAndSetEnv(Slapi_Backend *be, cldb_Handle *cldb)
    <4 byte value size><value1><4 byte value size><value2>
 */
 static int
-_cl5Entry2DBData(const CL5Entry *entry, char **data, PRUint32 *len, void *clcrypt_handle)
+_cl5Entry2DBData(const CL5Entry *entry, char **data, PRUint32 *len, void *clcrypt_handle, int32_t compress)
 {
     int size = 1 /* version */ + 1 /* operation type */ + sizeof(time_t);
+    PRUint32 hdrlen;
     char *pos;
     PRUint32 t;
     slapi_operation_parameters *op;
@@ -1531,6 +1572,7 @@ _cl5Entry2DBData(const CL5Entry *entry, char **data, PRUint32 *len, void *clcryp
     pos += sizeof(t);
     /* write csn */
     _cl5WriteString(csn_as_string(op->csn, PR_FALSE, s), &pos);
+    hdrlen = pos - *data;
     /* write UniqueID */
     _cl5WriteString(op->target_address.uniqueid, &pos);
 
@@ -1574,6 +1616,114 @@ _cl5Entry2DBData(const CL5Entry *entry, char **data, PRUint32 *len, void *clcryp
         return CL5_MEMORY_ERROR;
     }
 
+    if (compress) {
+        _cl5CompressEntryData(data, len, hdrlen);
+    }
+
+    return CL5_SUCCESS;
+}
+
+/*
+ * Turn a V_6 record built by _cl5Entry2DBData into a compressed V_7 record.
+ * hdrlen is the length of the part that stays in clear (up to and including
+ * the csn). The record is left as is if deflating does not make it smaller.
+ */
+static void
+_cl5CompressEntryData(char **data, PRUint32 *len, PRUint32 hdrlen)
+{
+    z_stream zs = {0};
+    PRUint32 body_len = *len - hdrlen;
+    PRUint32 nbody_len;
+    uLong bound;
+    char *cdata;
+
+    if (body_len < CL5_COMPRESS_MIN_SIZE) {
+        return;
+    }
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name_cl,
+                      "_cl5CompressEntryData - Failed to initialize compression, writing entry uncompressed\n");
+        return;
+    }
+    deflateSetDictionary(&zs, (const Bytef *)cl5_compress_dict, sizeof(cl5_compress_dict) - 1);
+    bound = deflateBound(&zs, body_len);
+    cdata = slapi_ch_malloc(hdrlen + sizeof(nbody_len) + bound);
+
+    zs.next_in = (Bytef *)(*data + hdrlen);
+    zs.avail_in = body_len;
+    zs.next_out = (Bytef *)(cdata + hdrlen + sizeof(nbody_len));
+    zs.avail_out = bound;
+    if ((deflate(&zs, Z_FINISH) != Z_STREAM_END) ||
+        (zs.total_out + sizeof(nbody_len) >= body_len)) {
+        /* Failed or not worth it, keep the V_6 record */
+        deflateEnd(&zs);
+        slapi_ch_free_string(&cdata);
+        return;
+    }
+
+    memcpy(cdata, *data, hdrlen);
+    cdata[0] = V_7;
+    cdata[1] = ((*data)[1] ? CL5_FLAG_ENCRYPTED : 0) | CL5_FLAG_COMPRESSED;
+    nbody_len = PR_htonl(body_len);
+    memcpy(cdata + hdrlen, &nbody_len, sizeof(nbody_len));
+    *len = hdrlen + sizeof(nbody_len) + zs.total_out;
+    deflateEnd(&zs);
+
+    slapi_ch_free_string(data);
+    *data = cdata;
+}
+
+/*
+ * Inflate the body of a compressed V_7 record. cdata points right after the
+ * csn and clen is the number of bytes left in the record. On success *body
+ * is an allocated buffer holding the V_6 body that the caller must free.
+ */
+static int
+_cl5UncompressEntryData(const char *cdata, PRUint32 clen, char **body)
+{
+    z_stream zs = {0};
+    PRUint32 body_len;
+    int rc;
+
+    *body = NULL;
+    if (clen < sizeof(body_len)) {
+        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name_cl,
+                      "_cl5UncompressEntryData - Truncated compressed entry\n");
+        return CL5_BAD_FORMAT;
+    }
+    memcpy((char *)&body_len, cdata, sizeof(body_len));
+    body_len = PR_ntohl(body_len);
+    if (!cl5_compress_body_len_ok(body_len, clen - sizeof(body_len))) {
+        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name_cl,
+                      "_cl5UncompressEntryData - Invalid uncompressed size %u for %u bytes\n",
+                      body_len, clen);
+        return CL5_BAD_FORMAT;
+    }
+
+    if (inflateInit(&zs) != Z_OK) {
+        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name_cl,
+                      "_cl5UncompressEntryData - Failed to initialize decompression\n");
+        return CL5_MEMORY_ERROR;
+    }
+    *body = slapi_ch_malloc(body_len);
+    zs.next_in = (Bytef *)(cdata + sizeof(body_len));
+    zs.avail_in = clen - sizeof(body_len);
+    zs.next_out = (Bytef *)*body;
+    zs.avail_out = body_len;
+    rc = inflate(&zs, Z_FINISH);
+    if (rc == Z_NEED_DICT) {
+        inflateSetDictionary(&zs, (const Bytef *)cl5_compress_dict, sizeof(cl5_compress_dict) - 1);
+        rc = inflate(&zs, Z_FINISH);
+    }
+    if ((rc != Z_STREAM_END) || (zs.total_out != body_len)) {
+        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name_cl,
+                      "_cl5UncompressEntryData - Failed to decompress entry (%d)\n", rc);
+        inflateEnd(&zs);
+        slapi_ch_free_string(body);
+        return CL5_BAD_FORMAT;
+    }
+    inflateEnd(&zs);
+
     return CL5_SUCCESS;
 }
 
@@ -1589,6 +1739,9 @@ _cl5Entry2DBData(const CL5Entry *entry, char **data, PRUint32 *len, void *clcryp
    <null terminated uniqueid><null terminated targetdn>
    [<null terminated newrdn><1 byte deleteoldrdn>][<4 byte mod count><mod1><mod2>....]
 
+   Version 7 replaces "encrypted" by a flags byte and may deflate the body:
+   <1 byte version><1 byte flags><1 byte change_type><sizeof time_t time><null terminated csn>
+   <4 byte uncompressed size><deflated uniqueid, targetdn, ... mods>
 
    mod format:
    -----------
@@ -1598,11 +1751,12 @@ _cl5Entry2DBData(const CL5Entry *entry, char **data, PRUint32 *len, void *clcryp
 
 
 int
-cl5DBData2Entry(const char *data, PRUint32 len __attribute__((unused)), CL5Entry *entry, void *clcrypt_handle)
+cl5DBData2Entry(const char *data, PRUint32 len, CL5Entry *entry, void *clcrypt_handle)
 {
     int rc;
     PRUint8 version;
     PRUint8 encrypted = 0;
+    char *body = NULL;
     char *pos = (char *)data;
     char *strCSN;
     PRUint32 thetime;
@@ -1618,14 +1772,21 @@ cl5DBData2Entry(const char *data, PRUint32 len __attribute__((unused)), CL5Entry
 
     /* read byte of version */
     version = (PRUint8)(*pos);
-    if (version != V_5 && version != V_6) {
+    if (version != V_5 && version != V_6 && version != V_7) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name_cl,
                       "cl5DBData2Entry - Invalid data version: %d\n", version);
         return CL5_BAD_FORMAT;
     }
     pos += sizeof(version);
 
-    if (version == V_6) {
+    if (version == V_7) {
+        /* In version 7 the flags byte tells whether it is encrypted and/or compressed */
+        encrypted = (PRUint8)(*pos);
+        pos += sizeof(encrypted);
+        if (!(encrypted & CL5_FLAG_ENCRYPTED)) {
+            clcrypt_handle = NULL;
+        }
+    } else if (version == V_6) {
         /* In version 6 we set a flag to note if the changes are encrypted */
         encrypted = (PRUint8)(*pos);
         pos += sizeof(encrypted);
@@ -1652,6 +1813,15 @@ cl5DBData2Entry(const char *data, PRUint32 len __attribute__((unused)), CL5Entry
     }
     slapi_ch_free((void **)&strCSN);
 
+    if (version == V_7 && (encrypted & CL5_FLAG_COMPRESSED)) {
+        /* the rest of the record is deflated, continue from the inflated copy */
+        rc = _cl5UncompressEntryData(pos, len - (pos - data), &body);
+        if (rc != CL5_SUCCESS) {
+            return rc;
+        }
+        pos = body;
+    }
+
     /* read UniqueID */
     _cl5ReadString(&op->target_address.uniqueid, &pos);
 
@@ -1698,6 +1868,7 @@ cl5DBData2Entry(const char *data, PRUint32 len __attribute__((unused)), CL5Entry
                       "cl5DBData2Entry - Failed to format entry\n");
         break;
     }
+    slapi_ch_free_string(&body);
 
     return rc;
 }
@@ -3591,7 +3762,7 @@ _cl5WriteOperationTxn(cldb_Handle *cldb, const slapi_operation_parameters *op, v
     dblayer_value_set_buffer(cldb->be, &key, csnStr, CSN_STRSIZE);
 
     /* construct the data */
-    rc = _cl5Entry2DBData(&entry, &edata, &esize, cldb->clcrypt_handle);
+    rc = _cl5Entry2DBData(&entry, &edata, &esize, cldb->clcrypt_handle, cldb->clConf.compression);
     if (rc != CL5_SUCCESS) {
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name_cl,
                       "_cl5WriteOperationTxn - Failed to convert entry with csn (%s) "
@@ -197,6 +197,15 @@ int cl5ImportLDIF(const char *clDir, const char *ldifFile, Replica *replica);
  */
 int cl5ConfigTrimming(Replica *replica, int maxEntries, const char *maxAge, int trimInterval);
 
+/* Name:        cl5ConfigCompression
+   Description: enables or disables the compression of new changelog records;
+                existing records are read back whatever their format.
+   Parameters:  compression - non zero to compress new records.
+   Return:      CL5_SUCCESS if successful;
+                CL5_BAD_STATE if changelog has not been open
+ */
+int cl5ConfigCompression(Replica *replica, int32_t compression);
+
 void cl5DestroyIterator(void *iterator);
 
 /* Name:        cl5WriteOperationTxn
@@ -14,6 +14,7 @@
 #include "errno.h" /* ENOMEM, EVAL used by Berkeley DB */
 #include "cl5.h"   /* changelog5Config */
 #include "cl5_clcache.h"
+#include "cl5_clring.h"
 #include "slap.h"
 #include "proto-slap.h"
 
@@ -33,6 +34,18 @@
 #define DEFAULT_CLC_BUFFER_PAGE_SIZE 1024
 #define WORK_CLC_BUFFER_PAGE_SIZE 8 * DEFAULT_CLC_BUFFER_PAGE_SIZE
 
+/*
+ * Constants for the shared ring of recently read changes:
+ *
+ * DEFAULT_CLC_RING_SIZE
+ *        Max number of changes kept per changelog.
+ *
+ * DEFAULT_CLC_RING_BATCH
+ *        Max number of changes a buffer takes from the ring per load.
+ */
+#define DEFAULT_CLC_RING_SIZE 2048
+#define DEFAULT_CLC_RING_BATCH 64
+
 enum
 {
     CLC_STATE_READY = 0,         /* ready to iterate */
@@ -83,6 +96,11 @@ struct clc_buffer
     char buf_bulkdata[WORK_CLC_BUFFER_PAGE_SIZE];  /* default buf_bulk storage */
     char buf_keydata[CSN_STRSIZE+1];               /* buf_key storage */
 
+    /* changes taken from the shared ring, used instead of buf_bulk if any */
+    struct clc_ring_entry **buf_ring_batch;
+    int buf_ring_cnt;
+    int buf_ring_pos;
+
     /* fields for control the CSN sequence sent to the consumer */
     struct csn_seq_ctrl_block **buf_cscbs;
     int buf_num_cscbs; /* number of csn sequence ctrl blocks */
@@ -96,6 +114,7 @@ struct clc_buffer
     int buf_skipped_up_to_date;         /* number of changes skipped due to consumer being up-to-date for the given rid */
     int buf_skipped_csn_gt_ruv;         /* number of changes skipped due to preceedents are not covered by local RUV snapshot */
     int buf_skipped_csn_covered;        /* number of changes skipped due to CSNs already covered by consumer RUV */
+    int buf_ring_load_cnt;              /* number of loads served by the shared ring */
 
     /*
      * fields that should be accessed via bl_lock or pl_lock
@@ -114,6 +133,7 @@ struct clc_busy_list
     CLC_Buffer *bl_buffers; /* busy buffers of this list */
     CLC_Busy_List *bl_next; /* next busy list in the pool */
     Slapi_Backend *bl_be;   /* backend (to use dbimpl API) */
+    struct clc_ring bl_ring; /* changes recently read, accessed via bl_lock */
 };
 
 /*
@@ -149,6 +169,10 @@ static CLC_Busy_List *clcache_new_busy_list(void);
 static void clcache_delete_busy_list(CLC_Busy_List **bl);
 static int clcache_enqueue_busy_list(Replica *replica, dbi_db_t *db, CLC_Buffer *buf);
 static void csn_dup_or_init_by_csn(CSN **csn1, CSN *csn2);
+static int clcache_ring_load(CLC_Buffer *buf, dbi_op_t dbop);
+static void clcache_ring_fill(CLC_Buffer *buf, dbi_op_t dbop);
+static void clcache_ring_release_batch(CLC_Buffer *buf);
+static int clcache_next_record(CLC_Buffer *buf, dbi_val_t *key, dbi_val_t *data);
 
 /*
  * Initiates the process buffer pool. This should be done
@@ -232,6 +256,7 @@ clcache_get_buffer(Replica *replica, CLC_Buffer **buf, dbi_db_t *db, ReplicaId c
         (*buf)->buf_skipped_up_to_date = 0;
         (*buf)->buf_skipped_csn_gt_ruv = 0;
         (*buf)->buf_skipped_csn_covered = 0;
+        (*buf)->buf_ring_load_cnt = 0;
         (*buf)->buf_cscbs = (struct csn_seq_ctrl_block **)slapi_ch_calloc(MAX_NUM_OF_SUPPLIERS + 1,
                                                                           sizeof(struct csn_seq_ctrl_block *));
         (*buf)->buf_num_cscbs = 0;
@@ -291,14 +316,20 @@ clcache_return_buffer(CLC_Buffer **buf)
     slapi_log_err(SLAPI_LOG_REPL, (*buf)->buf_agmt_name,
                   "clcache_return_buffer - session end: state=%d load=%d sent=%d skipped=%d skipped_new_rid=%d "
                   "skipped_csn_gt_cons_maxcsn=%d skipped_up_to_date=%d "
-                  "skipped_csn_gt_ruv=%d skipped_csn_covered=%d\n",
+                  "skipped_csn_gt_ruv=%d skipped_csn_covered=%d ring_load=%d\n",
                   (*buf)->buf_state,
                   (*buf)->buf_load_cnt,
                   (*buf)->buf_record_cnt - (*buf)->buf_record_skipped,
                   (*buf)->buf_record_skipped, (*buf)->buf_skipped_new_rid,
                   (*buf)->buf_skipped_csn_gt_cons_maxcsn,
                   (*buf)->buf_skipped_up_to_date, (*buf)->buf_skipped_csn_gt_ruv,
-                  (*buf)->buf_skipped_csn_covered);
+                  (*buf)->buf_skipped_csn_covered, (*buf)->buf_ring_load_cnt);
+
+    if ((*buf)->buf_ring_cnt) {
+        PR_Lock((*buf)->buf_busy_list->bl_lock);
+        clcache_ring_release_batch(*buf);
+        PR_Unlock((*buf)->buf_busy_list->bl_lock);
+    }
 
     for (i = 0; i < (*buf)->buf_num_cscbs; i++) {
         clcache_free_cscb(&(*buf)->buf_cscbs[i]);
@@ -460,6 +491,13 @@ clcache_load_buffer_bulk(CLC_Buffer *buf, dbi_op_t dbop)
     }
 
     PR_Lock(buf->buf_busy_list->bl_lock);
+    clcache_ring_release_batch(buf);
+    if (clcache_ring_load(buf, dbop)) {
+        PR_Unlock(buf->buf_busy_list->bl_lock);
+        buf->buf_load_cnt++;
+        buf->buf_ring_load_cnt++;
+        return 0;
+    }
 retry:
     if (0 == (rc = clcache_open_cursor(txn, buf, &cursor))) {
 
@@ -480,6 +518,9 @@ retry:
             rc = clcache_cursor_get(&cursor, buf, use_dbop);
         }
         dblayer_bulk_start(&buf->buf_bulk);
+        if (0 == rc) {
+            clcache_ring_fill(buf, use_dbop);
+        }
     }
 
     /*
@@ -529,19 +570,21 @@ clcache_get_next_change(CLC_Buffer *buf, void **key, size_t *keylen, void **data
     int rc = 0;
 
     do {
-        rc = dblayer_bulk_nextrecord(&buf->buf_bulk, &dbi_key, &dbi_data);
+        rc = clcache_next_record(buf, &dbi_key, &dbi_data);
         if (rc == DBI_RC_NOTFOUND && CLC_STATE_READY == buf->buf_state) {
             /*
              * We're done with the current buffer. Now load the next chunk.
              */
             rc = clcache_load_buffer(buf, NULL, NULL, initial_starting_csn);
             if (0 == rc) {
-                rc = dblayer_bulk_nextrecord(&buf->buf_bulk, &dbi_key, &dbi_data);
+                rc = clcache_next_record(buf, &dbi_key, &dbi_data);
             }
         }
 
         *key = dbi_key.data;
+        *keylen = dbi_key.size;
         *data = dbi_data.data;
+        *datalen = dbi_data.size;
 
         /* Compare the new change to the local and remote RUVs */
         if (NULL != *key) {
@@ -955,6 +998,8 @@ clcache_new_buffer(ReplicaId consumer_rid)
         buf->buf_max_cscbs = MAX_NUM_OF_SUPPLIERS;
         buf->buf_cscbs = (struct csn_seq_ctrl_block **)slapi_ch_calloc(MAX_NUM_OF_SUPPLIERS + 1,
                                                                        sizeof(struct csn_seq_ctrl_block *));
+        buf->buf_ring_batch = (struct clc_ring_entry **)slapi_ch_calloc(DEFAULT_CLC_RING_BATCH,
+                                                                        sizeof(struct clc_ring_entry *));
 
         welldone = 1;
 
@@ -981,6 +1026,9 @@ clcache_delete_buffer(CLC_Buffer **buf)
         if (bulkdata->data != (*buf)->buf_bulkdata) {
             slapi_ch_free(&bulkdata->data);
         }
+        /* the busy list lock, if any, is held by the caller */
+        clcache_ring_release_batch(*buf);
+        slapi_ch_free((void **)&(*buf)->buf_ring_batch);
         csn_free(&((*buf)->buf_current_csn));
         csn_free(&((*buf)->buf_missing_csn));
         csn_free(&((*buf)->buf_prev_missing_csn));
@@ -1001,6 +1049,8 @@ clcache_new_busy_list(void)
         if (NULL == (bl->bl_lock = PR_NewLock()))
             break;
 
+        clcache_ring_init(&bl->bl_ring, DEFAULT_CLC_RING_SIZE);
+
         /*
         if ( NULL == (bl->bl_max_csn = csn_new ()) )
             break;
@@ -1032,6 +1082,7 @@ clcache_delete_busy_list(CLC_Busy_List **bl)
         }
         (*bl)->bl_buffers = NULL;
         (*bl)->bl_db = NULL;
+        clcache_ring_destroy(&(*bl)->bl_ring);
         if ((*bl)->bl_lock) {
             PR_Unlock((*bl)->bl_lock);
             PR_DestroyLock((*bl)->bl_lock);
@@ -1145,6 +1196,173 @@ clcache_cursor_get(dbi_cursor_t *cursor, CLC_Buffer *buf, dbi_op_t dbop)
     return rc;
 }
 
+/*
+ * Returns the changes taken from the ring by the previous load.
+ * The busy list lock must be held.
+ */
+static void
+clcache_ring_release_batch(CLC_Buffer *buf)
+{
+    int i;
+
+    for (i = 0; i < buf->buf_ring_cnt; i++) {
+        clcache_ring_release_entry(buf->buf_ring_batch[i]);
+        buf->buf_ring_batch[i] = NULL;
+    }
+    buf->buf_ring_cnt = 0;
+    buf->buf_ring_pos = 0;
+}
+
+/*
+ * Tells whether the snapshot of the load that read a change covers
+ * the local RUV snapshot of the buffer, in which case the buffer
+ * can't miss any change it would send by using the ring.
+ */
+static int
+clcache_ring_stamp_covers(CLC_Buffer *buf, struct clc_ring_stamp *stamp)
+{
+    int i, j;
+
+    for (i = 0; i < buf->buf_num_cscbs; i++) {
+        struct csn_seq_ctrl_block *cscb = buf->buf_cscbs[i];
+
+        if (cscb->local_maxcsn == NULL) {
+            continue;
+        }
+        for (j = 0; j < stamp->rs_num && stamp->rs_rids[j] != cscb->rid; j++)
+            ;
+        if (j >= stamp->rs_num || csn_compare(cscb->local_maxcsn, stamp->rs_maxcsns[j]) > 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Takes the changes following the anchor csn (buf->buf_key) from the
+ * shared ring. Returns the number of changes taken, 0 meaning the
+ * buffer has to be loaded from the db.
+ * The busy list lock must be held.
+ */
+static int
+clcache_ring_load(CLC_Buffer *buf, dbi_op_t dbop)
+{
+    struct clc_ring *ring = &buf->buf_busy_list->bl_ring;
+    struct clc_ring_stamp *checked = NULL;
+    int anchor;
+    int i;
+
+    if (dbop != DBI_OP_NEXT && dbop != DBI_OP_MOVE_TO_KEY) {
+        return 0;
+    }
+    anchor = clcache_ring_find(ring, (char *)buf->buf_key.data);
+    if (anchor < 0) {
+        return 0;
+    }
+
+    i = (dbop == DBI_OP_NEXT) ? anchor + 1 : anchor;
+    for (; i < ring->ring_count && buf->buf_ring_cnt < DEFAULT_CLC_RING_BATCH; i++) {
+        struct clc_ring_entry *entry = clcache_ring_entry(ring, i);
+
+        /* what precedes the anchor itself does not matter */
+        if (i > anchor && entry->re_stamp != checked) {
+            if (!clcache_ring_stamp_covers(buf, entry->re_stamp)) {
+                break;
+            }
+            checked = entry->re_stamp;
+        }
+        entry->re_refcnt++;
+        buf->buf_ring_batch[buf->buf_ring_cnt++] = entry;
+    }
+
+    return buf->buf_ring_cnt;
+}
+
+/*
+ * Adds the changes just read from the db to the shared ring, if they
+ * follow the changes of the ring or are more recent than all of them.
+ * Agreements lagging behind leave the ring as it is.
+ * The busy list lock must be held.
+ */
+static void
+clcache_ring_fill(CLC_Buffer *buf, dbi_op_t dbop)
+{
+    struct clc_ring *ring = &buf->buf_busy_list->bl_ring;
+    struct clc_ring_stamp *stamp;
+    dbi_val_t key = {0};
+    dbi_val_t data = {0};
+    char lastkey[CSN_STRSIZE + 1] = {0};
+    int anchor = -1;
+    int count = 0;
+    int i;
+
+    while (dblayer_bulk_nextrecord(&buf->buf_bulk, &key, &data) == 0) {
+        if (key.size > CSN_STRSIZE) {
+            /* not a change record, don't cache this load */
+            dblayer_bulk_start(&buf->buf_bulk);
+            return;
+        }
+        memcpy(lastkey, key.data, key.size);
+        lastkey[key.size] = '\0';
+        count++;
+    }
+    dblayer_bulk_start(&buf->buf_bulk);
+    if (count == 0) {
+        return;
+    }
+
+    if (dbop == DBI_OP_NEXT) {
+        anchor = clcache_ring_find(ring, (char *)buf->buf_key.data);
+    }
+    if (anchor >= 0) {
+        /* replace what followed the anchor by the fresh read */
+        clcache_ring_truncate(ring, anchor + 1);
+    } else if (ring->ring_count == 0 ||
+               strcmp(lastkey, clcache_ring_entry(ring, ring->ring_count - 1)->re_key) > 0) {
+        clcache_ring_clear(ring);
+    } else {
+        return;
+    }
+
+    stamp = clcache_ring_new_stamp();
+    for (i = 0; i < buf->buf_num_cscbs && stamp->rs_num <= MAX_NUM_OF_SUPPLIERS; i++) {
+        if (buf->buf_cscbs[i]->local_maxcsn) {
+            stamp->rs_rids[stamp->rs_num] = buf->buf_cscbs[i]->rid;
+            stamp->rs_maxcsns[stamp->rs_num] = csn_dup(buf->buf_cscbs[i]->local_maxcsn);
+            stamp->rs_num++;
+        }
+    }
+
+    while (dblayer_bulk_nextrecord(&buf->buf_bulk, &key, &data) == 0) {
+        clcache_ring_append(ring, stamp, key.data, key.size, data.data, data.size);
+    }
+    dblayer_bulk_start(&buf->buf_bulk);
+    clcache_ring_release_stamp(stamp);
+}
+
+/*
+ * Gets the next change of the current load, from the shared ring
+ * or from the bulk buffer.
+ */
+static int
+clcache_next_record(CLC_Buffer *buf, dbi_val_t *key, dbi_val_t *data)
+{
+    struct clc_ring_entry *entry;
+
+    if (buf->buf_ring_cnt == 0) {
+        return dblayer_bulk_nextrecord(&buf->buf_bulk, key, data);
+    }
+    if (buf->buf_ring_pos >= buf->buf_ring_cnt) {
+        return DBI_RC_NOTFOUND;
+    }
+    entry = buf->buf_ring_batch[buf->buf_ring_pos++];
+    key->data = entry->re_key;
+    key->size = entry->re_keylen;
+    data->data = entry->re_data;
+    data->size = entry->re_datalen;
+    return 0;
+}
+
 static void
 csn_dup_or_init_by_csn(CSN **csn1, CSN *csn2)
 {
@@ -1153,6 +1371,29 @@ csn_dup_or_init_by_csn(CSN **csn1, CSN *csn2)
     csn_init_by_csn(*csn1, csn2);
 }
 
+/*
+ * Drops the changes of a changelog kept in the shared ring.
+ * This is called when the changelog db is removed.
+ */
+void
+clcache_reset_ring(dbi_db_t *db)
+{
+    CLC_Busy_List *bl;
+
+    if (_pool == NULL) {
+        return;
+    }
+    slapi_rwlock_rdlock(_pool->pl_lock);
+    for (bl = _pool->pl_busy_lists; bl && bl->bl_db != db; bl = bl->bl_next)
+        ;
+    if (bl) {
+        PR_Lock(bl->bl_lock);
+        clcache_ring_clear(&bl->bl_ring);
+        PR_Unlock(bl->bl_lock);
+    }
+    slapi_rwlock_unlock(_pool->pl_lock);
+}
+
 void
 clcache_destroy()
 {
@@ -0,0 +1,142 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* cl5_clring.c - ring of the changes recently read from a changelog */
+
+#include "cl5_clring.h"
+
+void
+clcache_ring_init(struct clc_ring *ring, int size)
+{
+    ring->ring_size = size;
+    ring->ring_first = 0;
+    ring->ring_count = 0;
+    ring->ring_entries = (struct clc_ring_entry **)slapi_ch_calloc(size, sizeof(struct clc_ring_entry *));
+}
+
+void
+clcache_ring_destroy(struct clc_ring *ring)
+{
+    if (ring->ring_entries) {
+        clcache_ring_clear(ring);
+        slapi_ch_free((void **)&ring->ring_entries);
+    }
+}
+
+/* Returns a stamp with no RUV, held once by the caller */
+struct clc_ring_stamp *
+clcache_ring_new_stamp(void)
+{
+    struct clc_ring_stamp *stamp;
+
+    stamp = (struct clc_ring_stamp *)slapi_ch_calloc(1, sizeof(struct clc_ring_stamp));
+    stamp->rs_refcnt = 1;
+    return stamp;
+}
+
+void
+clcache_ring_release_stamp(struct clc_ring_stamp *stamp)
+{
+    int i;
+
+    if (--stamp->rs_refcnt > 0) {
+        return;
+    }
+    for (i = 0; i < stamp->rs_num; i++) {
+        csn_free(&stamp->rs_maxcsns[i]);
+    }
+    slapi_ch_free((void **)&stamp);
+}
+
+void
+clcache_ring_release_entry(struct clc_ring_entry *entry)
+{
+    if (--entry->re_refcnt > 0) {
+        return;
+    }
+    clcache_ring_release_stamp(entry->re_stamp);
+    slapi_ch_free(&entry->re_data);
+    slapi_ch_free((void **)&entry);
+}
+
+struct clc_ring_entry *
+clcache_ring_entry(struct clc_ring *ring, int i)
+{
+    return ring->ring_entries[(ring->ring_first + i) % ring->ring_size];
+}
+
+/* Drops the changes from position i to the end of the ring */
+void
+clcache_ring_truncate(struct clc_ring *ring, int i)
+{
+    while (ring->ring_count > i) {
+        ring->ring_count--;
+        clcache_ring_release_entry(clcache_ring_entry(ring, ring->ring_count));
+    }
+}
+
+void
+clcache_ring_clear(struct clc_ring *ring)
+{
+    clcache_ring_truncate(ring, 0);
+    ring->ring_first = 0;
+}
+
+/* Returns the position of the change with the given key, or -1 */
+int
+clcache_ring_find(struct clc_ring *ring, const char *key)
+{
+    int low = 0;
+    int high = ring->ring_count - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int cmp = strcmp(clcache_ring_entry(ring, mid)->re_key, key);
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Appends a copy of a change. When the ring is full the oldest change is
+ * evicted: the buffers still replaying it keep it until they release it.
+ */
+void
+clcache_ring_append(struct clc_ring *ring, struct clc_ring_stamp *stamp, const void *key, size_t keylen, const void *data, size_t datalen)
+{
+    struct clc_ring_entry *entry;
+
+    if (ring->ring_count == ring->ring_size) {
+        /* evict the oldest change */
+        clcache_ring_release_entry(ring->ring_entries[ring->ring_first]);
+        ring->ring_first = (ring->ring_first + 1) % ring->ring_size;
+        ring->ring_count--;
+    }
+
+    entry = (struct clc_ring_entry *)slapi_ch_calloc(1, sizeof(struct clc_ring_entry));
+    entry->re_refcnt = 1;
+    memcpy(entry->re_key, key, keylen);
+    entry->re_keylen = keylen;
+    entry->re_data = slapi_ch_malloc(datalen);
+    memcpy(entry->re_data, data, datalen);
+    entry->re_datalen = datalen;
+    entry->re_stamp = stamp;
+    stamp->rs_refcnt++;
+    ring->ring_entries[(ring->ring_first + ring->ring_count) % ring->ring_size] = entry;
+    ring->ring_count++;
+}
@@ -0,0 +1,78 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* cl5_clring.h - ring of the changes recently read from a changelog,
+ * shared by the changelog buffers (see cl5_clcache.c) */
+
+#ifndef CL5_CLRING_H
+#define CL5_CLRING_H
+
+#include "slapi-private.h"
+#include "repl5.h"
+
+/*
+ * Snapshot of the local RUV taken by the buffer that read a change from
+ * the db. Changes of a RID up to its maxcsn were committed before the
+ * read, so for these RIDs the db held nothing between the change and
+ * the one preceding it in the ring.
+ */
+struct clc_ring_stamp
+{
+    int rs_refcnt;
+    int rs_num;
+    ReplicaId rs_rids[MAX_NUM_OF_SUPPLIERS + 1];
+    CSN *rs_maxcsns[MAX_NUM_OF_SUPPLIERS + 1];
+};
+
+/*
+ * A change read from the db, shared by the ring and the buffers
+ * replaying it.
+ */
+struct clc_ring_entry
+{
+    int re_refcnt;
+    char re_key[CSN_STRSIZE + 1];
+    size_t re_keylen;
+    void *re_data;
+    size_t re_datalen;
+    struct clc_ring_stamp *re_stamp; /* read by the same load */
+};
+
+/*
+ * Consecutive changes of a changelog, in key order, recently read by
+ * any of its buffers. Agreements near the head of the changelog load
+ * from the ring instead of reading and copying the same changes again.
+ */
+struct clc_ring
+{
+    struct clc_ring_entry **ring_entries; /* circular array */
+    int ring_first;
+    int ring_count;
+    int ring_size;
+};
+
+/*
+ * None of these functions lock: the ring and the reference counts are
+ * protected by the lock of the busy list owning the ring.
+ */
+void clcache_ring_init(struct clc_ring *ring, int size);
+void clcache_ring_destroy(struct clc_ring *ring);
+struct clc_ring_stamp *clcache_ring_new_stamp(void);
+void clcache_ring_release_stamp(struct clc_ring_stamp *stamp);
+void clcache_ring_release_entry(struct clc_ring_entry *entry);
+struct clc_ring_entry *clcache_ring_entry(struct clc_ring *ring, int i);
+int clcache_ring_find(struct clc_ring *ring, const char *key);
+void clcache_ring_truncate(struct clc_ring *ring, int i);
+void clcache_ring_clear(struct clc_ring *ring);
+void clcache_ring_append(struct clc_ring *ring, struct clc_ring_stamp *stamp, const void *key, size_t keylen, const void *data, size_t datalen);
+
+#endif /* CL5_CLRING_H */
@@ -0,0 +1,57 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+/*
+ * Compressed changelog records (V_7), shared by the changelog and dbscan.
+ */
+
+#ifndef _CL5_COMPRESS_H_
+#define _CL5_COMPRESS_H_
+
+#include <stdint.h>
+
+#define CL5_FLAG_ENCRYPTED 0x01  /* V_7 flags: the mod values are encrypted */
+#define CL5_FLAG_COMPRESSED 0x02 /* V_7 flags: the body following the csn is deflated */
+
+/*
+ * Bounds of the uncompressed size stored in a record, checked before
+ * allocating the body: deflate cannot expand data more than about 1032
+ * times, and no change comes close to a gigabyte.
+ */
+#define CL5_COMPRESS_MAX_RATIO 1032
+#define CL5_COMPRESS_MAX_BODY (1U << 30)
+
+/*
+ * Preset dictionary used to deflate the changelog records. Most records are
+ * small modifies, so priming the compressor with the attribute names and
+ * values that show up in nearly every change is what makes them shrink.
+ * zlib favours the end of the dictionary, the most frequent strings go last.
+ *
+ * This is part of the V_7 on-disk format: it must never be changed.
+ */
+static const char cl5_compress_dict[] =
+    "nsAccountLock\0passwordExpirationTime\0passwordHistory\0userPassword\0"
+    "unhashed#user#password\0pwdUpdateTime\0passwordRetryCount\0retryCountResetTime\0"
+    "nsUniqueId\0parentuniqueid\0nsTombstone\0nsParentUniqueId\0entryusn\0"
+    "top\0person\0organizationalPerson\0inetOrgPerson\0posixAccount\0groupOfNames\0"
+    "groupOfUniqueNames\0nsMemberOf\0inetUser\0objectClass\0cn\0sn\0uid\0mail\0"
+    "givenName\0displayName\0description\0telephoneNumber\0uniqueMember\0member\0memberOf\0"
+    "ou=People,\0ou=Groups,\0cn=directory manager\0cn=Directory Manager\0"
+    "creatorsName\0createTimestamp\0lastLoginTime\0"
+    "cn=MemberOf Plugin,cn=plugins,cn=config\0cn=ldbm database,cn=plugins,cn=config\0"
+    "internalModifiersName\0internalModifyTimestamp\0modifiersName\0modifyTimestamp\0";
+
+/* Tells whether body_len is a plausible uncompressed size for clen deflated bytes */
+static inline int
+cl5_compress_body_len_ok(uint32_t body_len, uint32_t clen)
+{
+    return body_len > 0 && body_len <= CL5_COMPRESS_MAX_BODY &&
+           (uint64_t)body_len <= (uint64_t)clen * CL5_COMPRESS_MAX_RATIO;
+}
+
+#endif /* _CL5_COMPRESS_H_ */
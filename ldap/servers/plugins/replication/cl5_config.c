@@ -318,6 +318,18 @@ cldb_config_modify(Slapi_PBlock *pb, Slapi_Entry *e, Slapi_Entry *entryAfter, in
                     /* We should allow the operation to succeed but it requires
                      * a restart to take effect. */
                     goto done;
+                } else if (strcasecmp(config_attr, CONFIG_CHANGELOG_COMPRESSION_ATTRIBUTE) == 0) {
+                    /* Only new records are affected, the change can take effect right away */
+                    rc = cl5ConfigCompression(replica,
+                                              slapi_entry_attr_get_bool(entryAfter, CONFIG_CHANGELOG_COMPRESSION_ATTRIBUTE));
+                    if (rc != CL5_SUCCESS) {
+                        *returncode = 1;
+                        if (returntext) {
+                            PR_snprintf(returntext, SLAPI_DSE_RETURNTEXT_SIZE,
+                                        "failed to configure changelog compression; error - %d", rc);
+                        }
+                        goto done;
+                    }
                 } else {
                     *returncode = LDAP_UNWILLING_TO_PERFORM;
                     if (returntext) {
@@ -460,6 +472,10 @@ changelog5_extract_config(Slapi_Entry *entry, changelog5Config *config)
     } else {
         config->symmetricKey = NULL; /* no symmetric key */
     }
+    /*
+     * changelog compression
+     */
+    config->compression = slapi_entry_attr_get_bool(entry, CONFIG_CHANGELOG_COMPRESSION_ATTRIBUTE);
 }
 
 /* register functions handling attempted operations on the changelog config entries */
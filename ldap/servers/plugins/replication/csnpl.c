@@ -13,18 +13,30 @@
 
 
 #include "csnpl.h"
-#include "llist.h"
+
+/*
+ * The pending CSNs are kept in a circular array, in ascending order
+ * since they are always inserted in that order. Committing a CSN is a
+ * binary search, and rolling up pops the committed CSNs at the head.
+ * A removed CSN stays in place, so that the array remains sorted,
+ * until it reaches the head or the tail of the list.
+ */
+#define CSNPL_INITIAL_SIZE 64
 
 struct csnpl
 {
-    LList *csnList;        /* pending list */
-    Slapi_RWLock *csnLock; /* lock to serialize access to PL */
+    struct _csnpldata **csnRing; /* pending list */
+    size_t csnFirst;             /* position of the smallest pending CSN */
+    size_t csnCount;             /* number of CSNs in the list */
+    size_t csnSize;              /* number of slots of csnRing */
+    pthread_mutex_t csnLock;     /* lock to serialize access to PL */
 };
 
 
 typedef struct _csnpldata
 {
     PRBool committed;      /* True if CSN committed */
+    PRBool removed;        /* True if CSN removed, waiting to be popped */
     CSN *csn;              /* The actual CSN */
     Replica *prim_replica; /* The replica where the prom csn was generated */
     const CSN *prim_csn;   /* The primary CSN of an operation consising of multiple sub ops*/
@@ -37,34 +49,28 @@ static PRBool csn_primary_or_nested(csnpldata *csn_data, const CSNPL_CTX *csn_ct
 static void _csnplDumpContentNoLock(CSNPL *csnpl, const char *caller);
 #endif
 
+/* Returns the i-th CSN of the list */
+#define CSNPL_AT(csnpl, i) ((csnpl)->csnRing[((csnpl)->csnFirst + (i)) % (csnpl)->csnSize])
+
 CSNPL *
 csnplNew()
 {
     CSNPL *csnpl;
 
-    csnpl = (CSNPL *)slapi_ch_malloc(sizeof(CSNPL));
+    csnpl = (CSNPL *)slapi_ch_calloc(1, sizeof(CSNPL));
     if (csnpl == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
                       "csnplNew - Failed to allocate pending list\n");
         return NULL;
     }
 
-    csnpl->csnList = llistNew();
-    if (csnpl->csnList == NULL) {
-        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
-                      "csnplNew - Failed to allocate pending list\n");
-        slapi_ch_free((void **)&csnpl);
-        return NULL;
-    }
-
-    /* ONREPL: do locks need different names */
-    csnpl->csnLock = slapi_new_rwlock();
+    csnpl->csnSize = CSNPL_INITIAL_SIZE;
+    csnpl->csnRing = (csnpldata **)slapi_ch_calloc(csnpl->csnSize, sizeof(csnpldata *));
 
-    if (csnpl->csnLock == NULL) {
+    if (pthread_mutex_init(&(csnpl->csnLock), NULL) != 0) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
-                      "csnplNew - Failed to create lock; NSPR error - %d\n",
-                      PR_GetError());
-        slapi_ch_free((void **)&(csnpl->csnList));
+                      "csnplNew - Failed to create lock\n");
+        slapi_ch_free((void **)&(csnpl->csnRing));
         slapi_ch_free((void **)&csnpl);
         return NULL;
     }
@@ -87,18 +93,68 @@ csnpldata_free(csnpldata **data_to_free)
 void
 csnplFree(CSNPL **csnpl)
 {
+    size_t i;
+
     if ((csnpl == NULL) || (*csnpl == NULL))
         return;
 
     /* free all remaining nodes */
-    llistDestroy(&((*csnpl)->csnList), (FNFree)csnpldata_free);
+    for (i = 0; i < (*csnpl)->csnCount; i++) {
+        csnpldata_free(&CSNPL_AT(*csnpl, i));
+    }
+    slapi_ch_free((void **)&((*csnpl)->csnRing));
 
-    if ((*csnpl)->csnLock)
-        slapi_destroy_rwlock((*csnpl)->csnLock);
+    pthread_mutex_destroy(&((*csnpl)->csnLock));
 
     slapi_ch_free((void **)csnpl);
 }
 
+/*
+ * Returns the position of the csn in the list, or -1 if it is not
+ * in the list. The lock must be held.
+ */
+static ssize_t
+_csnplFindNoLock(CSNPL *csnpl, const CSN *csn)
+{
+    ssize_t low = 0;
+    ssize_t high = (ssize_t)csnpl->csnCount - 1;
+
+    while (low <= high) {
+        ssize_t mid = (low + high) / 2;
+        int cmp = csn_compare(CSNPL_AT(csnpl, mid)->csn, csn);
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Frees the removed CSNs found at both ends of the list, so that
+ * the head and the tail of the list are always pending CSNs.
+ * The lock must be held.
+ */
+static void
+_csnplTrimRemovedNoLock(CSNPL *csnpl)
+{
+    while (csnpl->csnCount && CSNPL_AT(csnpl, 0)->removed) {
+        csnpldata_free(&CSNPL_AT(csnpl, 0));
+        csnpl->csnFirst = (csnpl->csnFirst + 1) % csnpl->csnSize;
+        csnpl->csnCount--;
+    }
+    while (csnpl->csnCount && CSNPL_AT(csnpl, csnpl->csnCount - 1)->removed) {
+        csnpldata_free(&CSNPL_AT(csnpl, csnpl->csnCount - 1));
+        csnpl->csnCount--;
+    }
+    if (csnpl->csnCount == 0) {
+        csnpl->csnFirst = 0;
+    }
+}
+
 /* This function isnerts a CSN into the pending list
  * Returns: 0 if the csn was successfully inserted
  *          1 if the csn has already been seen
@@ -107,9 +163,7 @@ csnplFree(CSNPL **csnpl)
 int
 csnplInsert(CSNPL *csnpl, const CSN *csn, const CSNPL_CTX *prim_csn)
 {
-    int rc;
     csnpldata *csnplnode;
-    char csn_str[CSN_STRSIZE];
 
     if (csnpl == NULL || csn == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
@@ -117,17 +171,32 @@ csnplInsert(CSNPL *csnpl, const CSN *csn, const CSNPL_CTX *prim_csn)
         return -1;
     }
 
-    slapi_rwlock_wrlock(csnpl->csnLock);
+    pthread_mutex_lock(&(csnpl->csnLock));
 
     /* check to see if this csn is larger than the last csn in the
        pending list. It has to be if we have not seen it since
        the csns are always added in the accending order. */
-    csnplnode = llistGetTail(csnpl->csnList);
-    if (csnplnode && csn_compare(csnplnode->csn, csn) >= 0) {
-        slapi_rwlock_unlock(csnpl->csnLock);
+    if (csnpl->csnCount &&
+        csn_compare(CSNPL_AT(csnpl, csnpl->csnCount - 1)->csn, csn) >= 0) {
+        pthread_mutex_unlock(&(csnpl->csnLock));
         return 1;
     }
 
+    if (csnpl->csnCount == csnpl->csnSize) {
+        /* grow the ring, moving the list at the beginning of it */
+        size_t newSize = csnpl->csnSize * 2;
+        csnpldata **newRing = (csnpldata **)slapi_ch_calloc(newSize, sizeof(csnpldata *));
+        size_t i;
+
+        for (i = 0; i < csnpl->csnCount; i++) {
+            newRing[i] = CSNPL_AT(csnpl, i);
+        }
+        slapi_ch_free((void **)&(csnpl->csnRing));
+        csnpl->csnRing = newRing;
+        csnpl->csnSize = newSize;
+        csnpl->csnFirst = 0;
+    }
+
     csnplnode = (csnpldata *)slapi_ch_calloc(1, sizeof(csnpldata));
     csnplnode->committed = PR_FALSE;
     csnplnode->csn = csn_dup(csn);
@@ -135,22 +204,14 @@ csnplInsert(CSNPL *csnpl, const CSN *csn, const CSNPL_CTX *prim_csn)
         csnplnode->prim_csn = prim_csn->prim_csn;
         csnplnode->prim_replica = prim_csn->prim_repl;
     }
-    csn_as_string(csn, PR_FALSE, csn_str);
-    rc = llistInsertTail(csnpl->csnList, csn_str, csnplnode);
+    CSNPL_AT(csnpl, csnpl->csnCount) = csnplnode;
+    csnpl->csnCount++;
 
 #ifdef DEBUG
     _csnplDumpContentNoLock(csnpl, "csnplInsert");
 #endif
 
-    slapi_rwlock_unlock(csnpl->csnLock);
-    if (rc != 0) {
-        char s[CSN_STRSIZE];
-        if (slapi_is_loglevel_set(SLAPI_LOG_REPL)) {
-            slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
-                          "csnplInsert - Failed to insert csn (%s) into pending list\n", csn_as_string(csn, PR_FALSE, s));
-        }
-        return -1;
-    }
+    pthread_mutex_unlock(&(csnpl->csnLock));
 
     return 0;
 }
@@ -158,8 +219,7 @@ csnplInsert(CSNPL *csnpl, const CSN *csn, const CSNPL_CTX *prim_csn)
 int
 csnplRemove(CSNPL *csnpl, const CSN *csn)
 {
-    csnpldata *data;
-    char csn_str[CSN_STRSIZE];
+    ssize_t i;
 
     if (csnpl == NULL || csn == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
@@ -167,23 +227,21 @@ csnplRemove(CSNPL *csnpl, const CSN *csn)
         return -1;
     }
 
-    csn_as_string(csn, PR_FALSE, csn_str);
-    slapi_rwlock_wrlock(csnpl->csnLock);
+    pthread_mutex_lock(&(csnpl->csnLock));
 
-    data = (csnpldata *)llistRemove(csnpl->csnList, csn_str);
-    if (data == NULL) {
-        slapi_rwlock_unlock(csnpl->csnLock);
+    i = _csnplFindNoLock(csnpl, csn);
+    if (i < 0 || CSNPL_AT(csnpl, i)->removed) {
+        pthread_mutex_unlock(&(csnpl->csnLock));
         return -1;
     }
+    CSNPL_AT(csnpl, i)->removed = PR_TRUE;
+    _csnplTrimRemovedNoLock(csnpl);
 
 #ifdef DEBUG
     _csnplDumpContentNoLock(csnpl, "csnplRemove");
 #endif
 
-    csn_free(&data->csn);
-    slapi_ch_free((void **)&data);
-
-    slapi_rwlock_unlock(csnpl->csnLock);
+    pthread_mutex_unlock(&(csnpl->csnLock));
 
     return 0;
 }
@@ -244,22 +302,20 @@ int
 csnplRemoveAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx)
 {
     csnpldata *data;
-    void *iterator;
+    size_t i;
 
-    slapi_rwlock_wrlock(csnpl->csnLock);
-    data = (csnpldata *)llistGetFirst(csnpl->csnList, &iterator);
-    while (NULL != data) {
-        if (csn_primary_or_nested(data, csn_ctx)) {
-            csnpldata_free(&data);
-            data = (csnpldata *)llistRemoveCurrentAndGetNext(csnpl->csnList, &iterator);
-        } else {
-            data = (csnpldata *)llistGetNext(csnpl->csnList, &iterator);
+    pthread_mutex_lock(&(csnpl->csnLock));
+    for (i = 0; i < csnpl->csnCount; i++) {
+        data = CSNPL_AT(csnpl, i);
+        if (!data->removed && csn_primary_or_nested(data, csn_ctx)) {
+            data->removed = PR_TRUE;
         }
     }
+    _csnplTrimRemovedNoLock(csnpl);
 #ifdef DEBUG
     _csnplDumpContentNoLock(csnpl, "csnplRemoveAll");
 #endif
-    slapi_rwlock_unlock(csnpl->csnLock);
+    pthread_mutex_unlock(&(csnpl->csnLock));
     return 0;
 }
 
@@ -268,31 +324,37 @@ int
 csnplCommitAll(CSNPL *csnpl, const CSNPL_CTX *csn_ctx)
 {
     csnpldata *data;
-    void *iterator;
     char csn_str[CSN_STRSIZE];
+    size_t i;
 
-    csn_as_string(csn_ctx->prim_csn, PR_FALSE, csn_str);
-    slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
-                  "csnplCommitALL: committing all csns for csn %s\n", csn_str);
-    slapi_rwlock_wrlock(csnpl->csnLock);
-    data = (csnpldata *)llistGetFirst(csnpl->csnList, &iterator);
-    while (NULL != data) {
-        csn_as_string(data->csn, PR_FALSE, csn_str);
+    if (slapi_is_loglevel_set(SLAPI_LOG_REPL)) {
+        csn_as_string(csn_ctx->prim_csn, PR_FALSE, csn_str);
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
-                      "csnplCommitALL: processing data csn %s\n", csn_str);
+                      "csnplCommitALL: committing all csns for csn %s\n", csn_str);
+    }
+    pthread_mutex_lock(&(csnpl->csnLock));
+    for (i = 0; i < csnpl->csnCount; i++) {
+        data = CSNPL_AT(csnpl, i);
+        if (data->removed) {
+            continue;
+        }
+        if (slapi_is_loglevel_set(SLAPI_LOG_REPL)) {
+            csn_as_string(data->csn, PR_FALSE, csn_str);
+            slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
+                          "csnplCommitALL: processing data csn %s\n", csn_str);
+        }
         if (csn_primary_or_nested(data, csn_ctx)) {
             data->committed = PR_TRUE;
         }
-        data = (csnpldata *)llistGetNext(csnpl->csnList, &iterator);
     }
-    slapi_rwlock_unlock(csnpl->csnLock);
+    pthread_mutex_unlock(&(csnpl->csnLock));
     return 0;
 }
 
 int
 csnplCommit(CSNPL *csnpl, const CSN *csn)
 {
-    csnpldata *data;
+    ssize_t i;
     char csn_str[CSN_STRSIZE];
 
     if (csnpl == NULL || csn == NULL) {
@@ -300,16 +362,15 @@ csnplCommit(CSNPL *csnpl, const CSN *csn)
                       "csnplCommit: invalid argument\n");
         return -1;
     }
-    csn_as_string(csn, PR_FALSE, csn_str);
 
-    slapi_rwlock_wrlock(csnpl->csnLock);
+    pthread_mutex_lock(&(csnpl->csnLock));
 
 #ifdef DEBUG
     _csnplDumpContentNoLock(csnpl, "csnplCommit");
 #endif
 
-    data = (csnpldata *)llistGet(csnpl->csnList, csn_str);
-    if (data == NULL) {
+    i = _csnplFindNoLock(csnpl, csn);
+    if (i < 0 || CSNPL_AT(csnpl, i)->removed) {
         /*
          * In the scenario "4.x supplier -> 6.x legacy-consumer -> 6.x consumer"
          * csn will have rid=65535. Hence 6.x consumer will get here trying
@@ -318,17 +379,17 @@ csnplCommit(CSNPL *csnpl, const CSN *csn)
          * Exclude READ-ONLY replica ID here from error logging.
          */
         ReplicaId rid = csn_get_replicaid(csn);
+        pthread_mutex_unlock(&(csnpl->csnLock));
         if (rid < MAX_REPLICA_ID) {
             slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
-                          "csnplCommit: can't find csn %s\n", csn_str);
+                          "csnplCommit: can't find csn %s\n", csn_as_string(csn, PR_FALSE, csn_str));
         }
-        slapi_rwlock_unlock(csnpl->csnLock);
         return -1;
     } else {
-        data->committed = PR_TRUE;
+        CSNPL_AT(csnpl, i)->committed = PR_TRUE;
     }
 
-    slapi_rwlock_unlock(csnpl->csnLock);
+    pthread_mutex_unlock(&(csnpl->csnLock));
 
     return 0;
 }
@@ -339,14 +400,15 @@ csnplGetMinCSN(CSNPL *csnpl, PRBool *committed)
 {
     csnpldata *data;
     CSN *csn = NULL;
-    slapi_rwlock_rdlock(csnpl->csnLock);
-    if ((data = (csnpldata *)llistGetHead(csnpl->csnList)) != NULL) {
+    pthread_mutex_lock(&(csnpl->csnLock));
+    if (csnpl->csnCount) {
+        data = CSNPL_AT(csnpl, 0);
         csn = csn_dup(data->csn);
         if (NULL != committed) {
             *committed = data->committed;
         }
     }
-    slapi_rwlock_unlock(csnpl->csnLock);
+    pthread_mutex_unlock(&(csnpl->csnLock));
 
     return csn;
 }
@@ -365,15 +427,13 @@ csnplRollUp(CSNPL *csnpl, CSN **first_commited)
     CSN *largest_committed_csn = NULL;
     csnpldata *data;
     PRBool freeit = PR_TRUE;
-    void *iterator;
 
-    slapi_rwlock_wrlock(csnpl->csnLock);
+    pthread_mutex_lock(&(csnpl->csnLock));
     if (first_commited) {
         /* Avoid non-initialization issues due to careless callers */
         *first_commited = NULL;
     }
-    data = (csnpldata *)llistGetFirst(csnpl->csnList, &iterator);
-    while (NULL != data && data->committed) {
+    while (csnpl->csnCount && (data = CSNPL_AT(csnpl, 0))->committed) {
         if (NULL != largest_committed_csn && freeit) {
             csn_free(&largest_committed_csn);
         }
@@ -383,18 +443,20 @@ csnplRollUp(CSNPL *csnpl, CSN **first_commited)
             *first_commited = data->csn;
             freeit = PR_FALSE;
         }
-        /* llistRemoveCurrentAndGetNext will detach the current node
-               so we have to free the data associated with it, but not the csn */
+        /* the csn now belongs to the caller, free the rest of the node */
         data->csn = NULL;
-        csnpldata_free(&data);
-        data = (csnpldata *)llistRemoveCurrentAndGetNext(csnpl->csnList, &iterator);
+        csnpldata_free(&CSNPL_AT(csnpl, 0));
+        csnpl->csnFirst = (csnpl->csnFirst + 1) % csnpl->csnSize;
+        csnpl->csnCount--;
+        /* skip the CSNs removed meanwhile */
+        _csnplTrimRemovedNoLock(csnpl);
     }
 
 #ifdef DEBUG
     _csnplDumpContentNoLock(csnpl, "csnplRollUp");
 #endif
 
-    slapi_rwlock_unlock(csnpl->csnLock);
+    pthread_mutex_unlock(&(csnpl->csnLock));
     return largest_committed_csn;
 }
 
@@ -404,9 +466,9 @@ void
 csnplDumpContent(CSNPL *csnpl, const char *caller)
 {
     if (csnpl) {
-        slapi_rwlock_rdlock(csnpl->csnLock);
+        pthread_mutex_lock(&(csnpl->csnLock));
         _csnplDumpContentNoLock(csnpl, caller);
-        slapi_rwlock_unlock(csnpl->csnLock);
+        pthread_mutex_unlock(&(csnpl->csnLock));
     }
 }
 
@@ -415,21 +477,23 @@ static void
 _csnplDumpContentNoLock(CSNPL *csnpl, const char *caller)
 {
     csnpldata *data;
-    void *iterator;
     char csn_str[CSN_STRSIZE];
     char primcsn_str[CSN_STRSIZE];
+    size_t i;
 
-    data = (csnpldata *)llistGetFirst(csnpl->csnList, &iterator);
-    if (data) {
+    if (csnpl->csnCount) {
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name, "%s: CSN Pending list content:\n",
                       caller ? caller : "");
     }
-    while (data) {
+    for (i = 0; i < csnpl->csnCount; i++) {
+        data = CSNPL_AT(csnpl, i);
+        if (data->removed) {
+            continue;
+        }
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name, "%s,(prim %s), %s\n",
                       csn_as_string(data->csn, PR_FALSE, csn_str),
                       data->prim_csn ? csn_as_string(data->prim_csn, PR_FALSE, primcsn_str) : " ",
                       data->committed ? "committed" : "not committed");
-        data = (csnpldata *)llistGetNext(csnpl->csnList, &iterator);
     }
 }
 #endif
@@ -71,7 +71,8 @@ typedef struct result_data
 {
     Private_Repl_Protocol *prp;
     int rc;
-    PRLock *lock;                             /* Lock to protect access to this structure, the message id list and to force memory barriers */
+    pthread_mutex_t lock;                     /* Lock to protect access to this structure, the message id list and to force memory barriers */
+    pthread_cond_t ack_cvar;                  /* Signalled by the result thread each time acknowledgements are read */
     PRThread *result_tid;                     /* The async result thread */
     repl5_inc_operation *operation_list_head; /* List of IDs for outstanding operations */
     repl5_inc_operation *operation_list_tail; /* List of IDs for outstanding operations */
@@ -159,7 +160,7 @@ static void
 repl5_int_push_operation(result_data *rd, repl5_inc_operation *it)
 {
     repl5_inc_operation *tail = NULL;
-    PR_Lock(rd->lock);
+    pthread_mutex_lock(&(rd->lock));
     tail = rd->operation_list_tail;
     if (tail) {
         tail->next = it;
@@ -168,7 +169,7 @@ repl5_int_push_operation(result_data *rd, repl5_inc_operation *it)
         rd->operation_list_head = it;
     }
     rd->operation_list_tail = it;
-    PR_Unlock(rd->lock);
+    pthread_mutex_unlock(&(rd->lock));
 }
 
 /* Pop the next operation in line to respond from the list */
@@ -178,7 +179,7 @@ repl5_inc_pop_operation(result_data *rd)
 {
     repl5_inc_operation *head = NULL;
     repl5_inc_operation *ret = NULL;
-    PR_Lock(rd->lock);
+    pthread_mutex_lock(&(rd->lock));
     head = rd->operation_list_head;
     if (head) {
         ret = head;
@@ -187,7 +188,7 @@ repl5_inc_pop_operation(result_data *rd)
             rd->operation_list_tail = NULL;
         }
     }
-    PR_Unlock(rd->lock);
+    pthread_mutex_unlock(&(rd->lock));
     return ret;
 }
 
@@ -287,11 +288,11 @@ repl5_inc_result_threadmain(void *param)
                     backoff_time <<= 1;
                 }
                 /* Should we stop ? */
-                PR_Lock(rd->lock);
+                pthread_mutex_lock(&(rd->lock));
                 if (rd->stop_result_thread) {
                     finished = 1;
                 }
-                PR_Unlock(rd->lock);
+                pthread_mutex_unlock(&(rd->lock));
             } else {
                 /*
                  * Something other than a timeout, so we exit the loop.
@@ -311,7 +312,10 @@ repl5_inc_result_threadmain(void *param)
             int return_value;
             int should_finish = 0;
             if (message_id) {
+                pthread_mutex_lock(&(rd->lock));
                 rd->last_message_id_received = message_id;
+                pthread_cond_broadcast(&(rd->ack_cvar));
+                pthread_mutex_unlock(&(rd->lock));
             }
             /* Handle any error etc */
 
@@ -335,10 +339,11 @@ repl5_inc_result_threadmain(void *param)
                               "repl5_inc_result_threadmain - Got op result %d should finish %d\n",
                               return_value, should_finish);
                 /* If so then we need to take steps to abort the update process */
-                PR_Lock(rd->lock);
+                pthread_mutex_lock(&(rd->lock));
                 rd->result = return_value;
                 rd->abort = ABORT_SESSION;
-                PR_Unlock(rd->lock);
+                pthread_cond_broadcast(&(rd->ack_cvar));
+                pthread_mutex_unlock(&(rd->lock));
                 /*
                  * We also need to log the error, including details stored from
                  * when the operation was sent.  We cannot finish yet - we still
@@ -356,7 +361,7 @@ repl5_inc_result_threadmain(void *param)
         }
 
         /* Should we stop ? */
-        PR_Lock(rd->lock);
+        pthread_mutex_lock(&(rd->lock));
         if (!finished && yield_session && rd->abort != SESSION_ABORTED && rd->abort_time == 0) {
             rd->abort_time = slapi_current_rel_time_t();
             rd->abort = SESSION_ABORTED; /* only set the abort time once */
@@ -367,7 +372,7 @@ repl5_inc_result_threadmain(void *param)
         if (rd->stop_result_thread) {
             finished = 1;
         }
-        PR_Unlock(rd->lock);
+        pthread_mutex_unlock(&(rd->lock));
         if (op) {
             repl5_inc_op_free(op);
         }
@@ -379,15 +384,27 @@ static result_data *
 repl5_inc_rd_new(Private_Repl_Protocol *prp)
 {
     result_data *res = NULL;
+    pthread_condattr_t cattr;
+
     res = (result_data *)slapi_ch_calloc(1, sizeof(result_data));
-    if (res) {
-        res->prp = prp;
-        res->lock = PR_NewLock();
-        if (NULL == res->lock) {
-            slapi_ch_free((void **)&res);
-            res = NULL;
-        }
+    res->prp = prp;
+    if (pthread_mutex_init(&(res->lock), NULL) != 0) {
+        slapi_ch_free((void **)&res);
+        return NULL;
+    }
+    if (pthread_condattr_init(&cattr) != 0) {
+        pthread_mutex_destroy(&(res->lock));
+        slapi_ch_free((void **)&res);
+        return NULL;
     }
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    if (pthread_cond_init(&(res->ack_cvar), &cattr) != 0) {
+        pthread_condattr_destroy(&cattr);
+        pthread_mutex_destroy(&(res->lock));
+        slapi_ch_free((void **)&res);
+        return NULL;
+    }
+    pthread_condattr_destroy(&cattr);
     return res;
 }
 
@@ -405,9 +422,8 @@ static void
 repl5_inc_rd_destroy(result_data **pres)
 {
     result_data *res = *pres;
-    if (res->lock) {
-        PR_DestroyLock(res->lock);
-    }
+    pthread_cond_destroy(&(res->ack_cvar));
+    pthread_mutex_destroy(&(res->lock));
     /* Delete the linked list if we have one */
     /* Begin at the head */
     repl5_inc_rd_list_destroy(res->operation_list_head);
@@ -441,44 +457,100 @@ repl5_inc_destroy_async_result_thread(result_data *rd)
     int retval = 0;
     PRThread *tid = rd->result_tid;
     if (tid) {
-        PR_Lock(rd->lock);
+        pthread_mutex_lock(&(rd->lock));
         rd->stop_result_thread = 1;
-        PR_Unlock(rd->lock);
+        pthread_cond_broadcast(&(rd->ack_cvar));
+        pthread_mutex_unlock(&(rd->lock));
         (void)PR_JoinThread(tid);
     }
     return retval;
 }
 
+/*
+ * Compute the absolute monotonic deadline 'msec' milliseconds from now,
+ * suitable for pthread_cond_timedwait() on rd->ack_cvar.
+ */
+static void
+repl5_inc_ack_deadline(struct timespec *deadline, long msec)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += msec / 1000;
+    deadline->tv_nsec += (msec % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/* Must be called with rd->lock held */
+static int
+repl5_inc_window_is_full(result_data *rd, long window)
+{
+    return (rd->last_message_id_received <= rd->last_message_id_sent) &&
+           ((rd->last_message_id_sent - rd->last_message_id_received) >= window);
+}
+
 /* The interest of this routine is to give time to the receiver
  * to apply the sent updates and return the acks.
  * So the caller should not hold the replication connection lock
  * to let the RA.reader receives the acks.
+ *
+ * The sender resumes as soon as the result thread has read enough acks
+ * to reopen the window, the flow control pause is only an upper bound.
+ * On high latency links a fixed sleep leaves the connection idle long
+ * after the acks are back.
  */
 static void
 repl5_inc_flow_control_results(Repl_Agmt *agmt, result_data *rd)
 {
-    PR_Lock(rd->lock);
-    if ((rd->last_message_id_received <= rd->last_message_id_sent) &&
-        ((rd->last_message_id_sent - rd->last_message_id_received) >= agmt_get_flowcontrolwindow(agmt))) {
+    long window = agmt_get_flowcontrolwindow(agmt);
+    struct timespec deadline = {0};
+
+    pthread_mutex_lock(&(rd->lock));
+    if (repl5_inc_window_is_full(rd, window)) {
         rd->flowcontrol_detection++;
-        PR_Unlock(rd->lock);
-        DS_Sleep(PR_MillisecondsToInterval(agmt_get_flowcontrolpause(agmt)));
-    } else {
-        PR_Unlock(rd->lock);
+        repl5_inc_ack_deadline(&deadline, agmt_get_flowcontrolpause(agmt));
+        while (repl5_inc_window_is_full(rd, window) &&
+               !rd->abort && !rd->stop_result_thread) {
+            if (pthread_cond_timedwait(&(rd->ack_cvar), &(rd->lock), &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
     }
+    pthread_mutex_unlock(&(rd->lock));
 }
 
 static int
 repl5_inc_waitfor_async_results(result_data *rd)
 {
     int done = 0;
-    int loops = 0;
+    int first = 1;
+    int timedout = 0;
     int rc = UPDATE_NO_MORE_UPDATES;
+    struct timespec giveup = {0};
+    struct timespec now = {0};
+
+    /*
+     * Arbitrary delay of 300 waits: basically we should only expect to wait as
+     * long as it takes to process a few operations, which should be on the order
+     * of a second at most.  The acks wake us up earlier but do not extend it.
+     */
+    repl5_inc_ack_deadline(&giveup, 300L * rd->WaitForAsyncResults);
 
     /* Keep pulling results off the LDAP connection until we catch up to the last message id stored in the rd */
     while (!done && !slapi_is_shutting_down()) {
         /* Lock the structure to force memory barrier */
-        PR_Lock(rd->lock);
+        pthread_mutex_lock(&(rd->lock));
+        if (!first && rd->last_message_id_received < rd->last_message_id_sent) {
+            /* Not caught up yet, wait for the result thread to read more acks */
+            struct timespec deadline = {0};
+            repl5_inc_ack_deadline(&deadline, rd->WaitForAsyncResults);
+            pthread_cond_timedwait(&(rd->ack_cvar), &(rd->lock), &deadline);
+        }
+        first = 0;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timedout = (now.tv_sec > giveup.tv_sec) ||
+                   (now.tv_sec == giveup.tv_sec && now.tv_nsec >= giveup.tv_nsec);
         /* Are we caught up ? */
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
                       "repl5_inc_waitfor_async_results - %d %d\n",
@@ -493,15 +565,9 @@ repl5_inc_waitfor_async_results(result_data *rd)
          * Return the last operation result
          */
         rc = rd->result;
-        PR_Unlock(rd->lock);
-        if (!done) {
-            /* If not then sleep a bit */
-            DS_Sleep(PR_MillisecondsToInterval(rd->WaitForAsyncResults));
-        }
-        loops++;
+        pthread_mutex_unlock(&(rd->lock));
         /* If we sleep forever then we can conclude that something bad happened, and bail... */
-        /* Arbitrary 30 second delay : basically we should only expect to wait as long as it takes to process a few operations, which should be on the order of a second at most */
-        if (!done && (loops > 300)) {
+        if (!done && timedout) {
             /* Log a warning */
             slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
                           "repl5_inc_waitfor_async_results  - Timed out waiting for responses: %d %d\n",
@@ -1884,7 +1950,7 @@ send_updates(Private_Repl_Protocol *prp, RUV *remote_update_vector, PRUint32 *nu
                 return_value = UPDATE_YIELD;
                 finished = 1;
             }
-            PR_Lock(rd->lock);
+            pthread_mutex_lock(&(rd->lock));
             /* See if the result thread has hit a problem */
 
             if (!finished && rd->abort_time) {
@@ -1903,7 +1969,7 @@ send_updates(Private_Repl_Protocol *prp, RUV *remote_update_vector, PRUint32 *nu
                 return_value = rd->result;
                 finished = 1;
             }
-            PR_Unlock(rd->lock);
+            pthread_mutex_unlock(&(rd->lock));
         } while (!finished);
 
         if (fractional_repl && subentry_update_needed) {
@@ -1956,7 +2022,7 @@ send_updates(Private_Repl_Protocol *prp, RUV *remote_update_vector, PRUint32 *nu
             }
             *num_changes_sent = rd->num_changes_sent;
         }
-        PR_Lock(rd->lock);
+        pthread_mutex_lock(&(rd->lock));
         if (rd->flowcontrol_detection) {
             slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
                           "send_updates - %s: Incremental update flow control triggered %d times\n"
@@ -1966,7 +2032,7 @@ send_updates(Private_Repl_Protocol *prp, RUV *remote_update_vector, PRUint32 *nu
                           type_nsds5ReplicaFlowControlPause,
                           type_nsds5ReplicaFlowControlWindow);
         }
-        PR_Unlock(rd->lock);
+        pthread_mutex_unlock(&(rd->lock));
         repl5_inc_rd_destroy(&rd);
 
         cl5_operation_parameters_done(entry.op);
@@ -42,7 +42,7 @@ typedef struct callback_data
 {
     Private_Repl_Protocol *prp;
     int rc;
-    unsigned long num_entries;
+    uint64_t num_entries; /* Entries sent, updated by the sender thread (atomic) */
     time_t sleep_on_busy;
     time_t last_busy;
     pthread_mutex_t lock;                    /* Lock to protect access to this structure, the message id list and to force memory barriers */
@@ -50,11 +50,24 @@ typedef struct callback_data
     operation_id_list_item *message_id_list; /* List of IDs for outstanding operations */
     int abort;                               /* Flag used to tell the sending thread asyncronously that it should abort (because an error came up in a result) */
     int stop_result_thread;                  /* Flag used to tell the result thread to exit */
-    int last_message_id_sent;
-    int last_message_id_received;
+    int32_t last_message_id_sent;     /* Written by the sender thread, read by the others (atomic) */
+    int32_t last_message_id_received; /* Written by the result thread, read by the others (atomic) */
     int flowcontrol_detection;
+    /* entries encoded by the search thread, waiting for the sender thread */
+    PRThread *sender_tid;     /* The sender thread */
+    pthread_cond_t queue_cvar; /* Signaled when an entry is queued or dequeued */
+    struct berval **queue;
+    int queue_head;
+    int queue_count;
+    int queue_done; /* Flag used to tell the sender thread no more entry will be queued */
+    int send_rc;    /* ConnResult of the first failed send */
 } callback_data;
 
+/*
+ * Number of encoded entries the search can get ahead of the sender thread
+ */
+#define TOT_SEND_QUEUE_SIZE 512
+
 /*
  * Number of window seconds to wait until we programmatically decide
  * that the replica has got out of BUSY state
@@ -64,6 +77,7 @@ typedef struct callback_data
 /* Helper functions */
 static void get_result(int rc, void *cb_data);
 static int send_entry(Slapi_Entry *e, void *callback_data);
+static int send_entry_bv(callback_data *cb_data, struct berval *bv);
 static void repl5_tot_delete(Private_Repl_Protocol **prp);
 
 #define LOST_CONN_ERR(xx) ((xx == -2) || (xx == LDAP_SERVER_DOWN) || (xx == LDAP_CONNECT_ERROR))
@@ -154,7 +168,7 @@ repl5_tot_result_threadmain(void *param)
         }
 
         if (message_id) {
-            cb->last_message_id_received = message_id;
+            slapi_atomic_store_32(&(cb->last_message_id_received), message_id, __ATOMIC_RELEASE);
         }
         conn_get_error_ex(conn, &operation_code, &connection_error, &ldap_error_string);
 
@@ -217,6 +231,95 @@ repl5_tot_destroy_async_result_thread(callback_data *cb_data)
     return retval;
 }
 
+/*
+ * Thread that sends the entries queued by send_entry, so that reading
+ * and encoding the entries overlaps with writing them to the consumer
+ * and with the flow control pauses.
+ */
+static void
+repl5_tot_sender_threadmain(void *param)
+{
+    callback_data *cb = (callback_data *)param;
+    struct berval *bv = NULL;
+    int rc = CONN_OPERATION_SUCCESS;
+    int abort = 0;
+
+    while (1) {
+        pthread_mutex_lock(&(cb->lock));
+        while (cb->queue_count == 0 && !cb->queue_done) {
+            pthread_cond_wait(&(cb->queue_cvar), &(cb->lock));
+        }
+        if (cb->queue_count == 0) {
+            pthread_mutex_unlock(&(cb->lock));
+            break;
+        }
+        bv = cb->queue[cb->queue_head];
+        cb->queue[cb->queue_head] = NULL;
+        cb->queue_head = (cb->queue_head + 1) % TOT_SEND_QUEUE_SIZE;
+        cb->queue_count--;
+        abort = cb->abort;
+        pthread_cond_broadcast(&(cb->queue_cvar));
+        pthread_mutex_unlock(&(cb->lock));
+
+        /* once aborted, the search thread reports the failure */
+        if (rc == CONN_OPERATION_SUCCESS && !abort) {
+            rc = send_entry_bv(cb, bv);
+            if (rc != CONN_OPERATION_SUCCESS) {
+                /* stop the search, the remaining entries are only freed */
+                pthread_mutex_lock(&(cb->lock));
+                cb->send_rc = rc;
+                pthread_cond_broadcast(&(cb->queue_cvar));
+                pthread_mutex_unlock(&(cb->lock));
+            }
+        }
+        ber_bvfree(bv);
+    }
+}
+
+static int
+repl5_tot_create_sender_thread(callback_data *cb_data)
+{
+    int retval = 0;
+    PRThread *tid = NULL;
+
+    cb_data->queue = (struct berval **)slapi_ch_calloc(TOT_SEND_QUEUE_SIZE, sizeof(struct berval *));
+    pthread_cond_init(&(cb_data->queue_cvar), NULL);
+    tid = PR_CreateThread(PR_USER_THREAD,
+                          repl5_tot_sender_threadmain, (void *)cb_data,
+                          PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD, PR_JOINABLE_THREAD,
+                          SLAPD_DEFAULT_THREAD_STACKSIZE);
+    if (NULL == tid) {
+        slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
+                      "repl5_tot_create_sender_thread - Failed. " SLAPI_COMPONENT_NAME_NSPR " error %d (%s)\n",
+                      PR_GetError(), slapd_pr_strerror(PR_GetError()));
+        pthread_cond_destroy(&(cb_data->queue_cvar));
+        slapi_ch_free((void **)&cb_data->queue);
+        retval = -1;
+    } else {
+        cb_data->sender_tid = tid;
+    }
+    return retval;
+}
+
+/* Waits for the queued entries to be sent and returns the send status */
+static int
+repl5_tot_destroy_sender_thread(callback_data *cb_data)
+{
+    PRThread *tid = cb_data->sender_tid;
+
+    if (tid) {
+        pthread_mutex_lock(&(cb_data->lock));
+        cb_data->queue_done = 1;
+        pthread_cond_broadcast(&(cb_data->queue_cvar));
+        pthread_mutex_unlock(&(cb_data->lock));
+        (void)PR_JoinThread(tid);
+        cb_data->sender_tid = NULL;
+        pthread_cond_destroy(&(cb_data->queue_cvar));
+        slapi_ch_free((void **)&cb_data->queue);
+    }
+    return cb_data->send_rc;
+}
+
 /* Called when in compatibility mode, to get the next result from the wire
  * The operation thread will not send a second operation until it has read the
  * previous result. */
@@ -243,17 +346,21 @@ repl5_tot_waitfor_async_results(callback_data *cb_data)
 {
     int done = 0;
     int loops = 0;
-    int last_entry = 0;
+    int32_t last_entry = 0;
+    int32_t received;
+    int32_t sent;
 
     /* Keep pulling results off the LDAP connection until we catch up to the last message id stored in the rd */
     while (!done) {
         /* Lock the structure to force memory barrier */
         pthread_mutex_lock(&(cb_data->lock));
         /* Are we caught up ? */
+        received = slapi_atomic_load_32(&(cb_data->last_message_id_received), __ATOMIC_ACQUIRE);
+        sent = slapi_atomic_load_32(&(cb_data->last_message_id_sent), __ATOMIC_ACQUIRE);
         slapi_log_err(SLAPI_LOG_REPL, repl_plugin_name,
                       "repl5_tot_waitfor_async_results - %d %d\n",
-                      cb_data->last_message_id_received, cb_data->last_message_id_sent);
-        if (cb_data->last_message_id_received >= cb_data->last_message_id_sent) {
+                      received, sent);
+        if (received >= sent) {
             /* If so then we're done */
             done = 1;
         }
@@ -265,11 +372,11 @@ repl5_tot_waitfor_async_results(callback_data *cb_data)
         DS_Sleep(PR_SecondsToInterval(1));
         loops++;
 
-        if (last_entry < cb_data->last_message_id_received) {
+        if (last_entry < received) {
             /* we are making progress - reset the loop counter */
             loops = 0;
         }
-        last_entry = cb_data->last_message_id_received;
+        last_entry = received;
 
         /* If we sleep forever then we can conclude that something bad happened, and bail... */
         /* Arbitrary 30 second delay : basically we should only expect to wait as long as it takes to process a few operations, which should be on the order of a second at most */
@@ -277,7 +384,7 @@ repl5_tot_waitfor_async_results(callback_data *cb_data)
             /* Log a warning */
             slapi_log_err(SLAPI_LOG_WARNING, repl_plugin_name,
                           "repl5_tot_waitfor_async_results - Timed out waiting for responses: %d %d\n",
-                          cb_data->last_message_id_received, cb_data->last_message_id_sent);
+                          received, sent);
             done = 1;
         }
     }
@@ -480,7 +587,7 @@ retry:
 
         cb_data.prp = prp;
         cb_data.rc = 0;
-        cb_data.num_entries = 1UL;
+        slapi_atomic_store_64(&(cb_data.num_entries), 1, __ATOMIC_RELEASE);
         cb_data.sleep_on_busy = 0UL;
         cb_data.last_busy = slapi_current_rel_time_t();
         cb_data.flowcontrol_detection = 0;
@@ -517,7 +624,7 @@ retry:
         slapi_search_internal_set_pb(pb, slapi_sdn_get_dn(area_sdn),
                                      LDAP_SCOPE_SUBTREE, "(parentid>=1)", NULL, 0, ctrls, NULL,
                                      repl_get_plugin_identity(PLUGIN_MULTISUPPLIER_REPLICATION), OP_FLAG_BULK_IMPORT);
-        cb_data.num_entries = 0UL;
+        slapi_atomic_store_64(&(cb_data.num_entries), 0, __ATOMIC_RELEASE);
         slapi_search_get_entry_done(&suffix_pb);
     } else {
         /* Original total update */
@@ -539,7 +646,7 @@ retry:
 
         cb_data.prp = prp;
         cb_data.rc = 0;
-        cb_data.num_entries = 0UL;
+        slapi_atomic_store_64(&(cb_data.num_entries), 0, __ATOMIC_RELEASE);
         cb_data.sleep_on_busy = 0UL;
         cb_data.last_busy = slapi_current_rel_time_t();
         cb_data.flowcontrol_detection = 0;
@@ -566,6 +673,19 @@ retry:
         }
     }
 
+    /* Stream the entries: the search thread encodes them while the
+     * sender thread writes them to the consumer.
+     */
+    if (!prp->repl50consumer) {
+        rc = repl5_tot_create_sender_thread(&cb_data);
+        if (rc) {
+            slapi_log_err(SLAPI_LOG_WARNING, repl_plugin_name, "repl5_tot_run - %s - "
+                                                               "repl5_tot_create_sender_thread failed; "
+                                                               "sending entries from the search thread\n",
+                          agmt_get_long_name(prp->agmt));
+        }
+    }
+
     /* this search get all the entries from the replicated area including tombstones
        and referrals
        Note that cb_data.rc contains values from ConnResult
@@ -575,6 +695,11 @@ retry:
                                       send_entry /* entry callback */,
                                       NULL /* referral callback*/);
 
+    rc = repl5_tot_destroy_sender_thread(&cb_data);
+    if (rc != CONN_OPERATION_SUCCESS) {
+        cb_data.rc = (CONN_NOT_CONNECTED == rc) ? -2 : rc;
+    }
+
     /*
      * After completing the sending operation (or optionally failing), we need to clean up
      * the async propagation stuff:
@@ -613,8 +738,9 @@ retry:
         agmt_set_last_init_status(prp->agmt, 0, 0, rc, "Total update aborted");
     } else {
         slapi_log_err(SLAPI_LOG_INFO, repl_plugin_name, "repl5_tot_run - Finished total update of replica "
-                                                        "\"%s\". Sent %lu entries.\n",
-                      agmt_get_long_name(prp->agmt), cb_data.num_entries);
+                                                        "\"%s\". Sent %" PRIu64 " entries.\n",
+                      agmt_get_long_name(prp->agmt),
+                      slapi_atomic_load_64(&(cb_data.num_entries), __ATOMIC_ACQUIRE));
         agmt_set_last_init_status(prp->agmt, 0, 0, 0, "Total update succeeded");
         agmt_set_last_update_status(prp->agmt, 0, 0, NULL);
     }
@@ -778,7 +904,7 @@ repl5_tot_last_rcv_msgid(Repl_Connection *conn)
     if (cb_data == NULL) {
         return -1;
     } else {
-        return cb_data->last_message_id_received;
+        return slapi_atomic_load_32(&(cb_data->last_message_id_received), __ATOMIC_ACQUIRE);
     }
 }
 
@@ -799,6 +925,83 @@ repl5_tot_flowcontrol_detection(Repl_Connection *conn, int increment)
     }
 }
 
+/*
+ * Sends an encoded entry to the consumer.
+ * Returns the ConnResult of the operation.
+ */
+static int
+send_entry_bv(callback_data *cb_data, struct berval *bv)
+{
+    Private_Repl_Protocol *prp = cb_data->prp;
+    int message_id = 0;
+    int rc;
+
+    do {
+        /* push the entry to the consumer */
+        rc = conn_send_extended_operation(prp->conn, REPL_NSDS50_REPLICATION_ENTRY_REQUEST_OID,
+                                          bv /* payload */, NULL /* update_control */, &message_id);
+
+        if (message_id) {
+            slapi_atomic_store_32(&(cb_data->last_message_id_sent), message_id, __ATOMIC_RELEASE);
+        }
+
+        /* If we are talking to a 5.0 type consumer, we need to wait here and retrieve the
+         * response. Reason is that it can return LDAP_BUSY, indicating that its queue has
+         * filled up. This completely breaks pipelineing, and so we need to fall back to
+         * sync transmission for those consumers, in case they pull the LDAP_BUSY stunt on us :( */
+
+        if (prp->repl50consumer) {
+            /* Get the response here */
+            rc = repl5_tot_get_next_result(cb_data);
+        }
+
+        if (rc == CONN_BUSY) {
+            time_t now = slapi_current_rel_time_t();
+            if ((now - cb_data->last_busy) < (cb_data->sleep_on_busy + 10)) {
+                cb_data->sleep_on_busy += 5;
+            } else {
+                cb_data->sleep_on_busy = 5;
+            }
+            cb_data->last_busy = now;
+
+            slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
+                          "send_entry - Replica \"%s\" is busy. Waiting %lds while"
+                          " it finishes processing its current import queue\n",
+                          agmt_get_long_name(prp->agmt), cb_data->sleep_on_busy);
+            DS_Sleep(PR_SecondsToInterval(cb_data->sleep_on_busy));
+        }
+    } while (rc == CONN_BUSY);
+
+    slapi_atomic_incr_64(&(cb_data->num_entries), __ATOMIC_RELEASE);
+
+    return rc;
+}
+
+/*
+ * Queues an encoded entry for the sender thread, waiting while the
+ * queue is full. Returns non zero if the sender thread failed.
+ */
+static int
+queue_entry_bv(callback_data *cb_data, struct berval *bv)
+{
+    int rc;
+
+    pthread_mutex_lock(&(cb_data->lock));
+    while (cb_data->queue_count == TOT_SEND_QUEUE_SIZE &&
+           cb_data->send_rc == CONN_OPERATION_SUCCESS && !cb_data->abort) {
+        pthread_cond_wait(&(cb_data->queue_cvar), &(cb_data->lock));
+    }
+    rc = (cb_data->send_rc != CONN_OPERATION_SUCCESS) || cb_data->abort;
+    if (!rc) {
+        cb_data->queue[(cb_data->queue_head + cb_data->queue_count) % TOT_SEND_QUEUE_SIZE] = bv;
+        cb_data->queue_count++;
+        pthread_cond_broadcast(&(cb_data->queue_cvar));
+    }
+    pthread_mutex_unlock(&(cb_data->lock));
+
+    return rc;
+}
+
 static int
 send_entry(Slapi_Entry *e, void *cb_data)
 {
@@ -806,19 +1009,12 @@ send_entry(Slapi_Entry *e, void *cb_data)
     Private_Repl_Protocol *prp;
     BerElement *bere;
     struct berval *bv;
-    unsigned long *num_entriesp;
-    time_t *sleep_on_busyp;
-    time_t *last_busyp;
-    int message_id = 0;
     int retval = 0;
     char **frac_excluded_attrs = NULL;
 
     PR_ASSERT(cb_data);
 
     prp = ((callback_data *)cb_data)->prp;
-    num_entriesp = &((callback_data *)cb_data)->num_entries;
-    sleep_on_busyp = &((callback_data *)cb_data)->sleep_on_busy;
-    last_busyp = &((callback_data *)cb_data)->last_busy;
     PR_ASSERT(prp);
 
     if (prp->terminate) {
@@ -874,44 +1070,18 @@ send_entry(Slapi_Entry *e, void *cb_data)
         goto error;
     }
 
-    do {
-        /* push the entry to the consumer */
-        rc = conn_send_extended_operation(prp->conn, REPL_NSDS50_REPLICATION_ENTRY_REQUEST_OID,
-                                          bv /* payload */, NULL /* update_control */, &message_id);
-
-        if (message_id) {
-            ((callback_data *)cb_data)->last_message_id_sent = message_id;
-        }
-
-        /* If we are talking to a 5.0 type consumer, we need to wait here and retrieve the
-         * response. Reason is that it can return LDAP_BUSY, indicating that its queue has
-         * filled up. This completely breaks pipelineing, and so we need to fall back to
-         * sync transmission for those consumers, in case they pull the LDAP_BUSY stunt on us :( */
-
-        if (prp->repl50consumer) {
-            /* Get the response here */
-            rc = repl5_tot_get_next_result((callback_data *)cb_data);
-        }
-
-        if (rc == CONN_BUSY) {
-            time_t now = slapi_current_rel_time_t();
-            if ((now - *last_busyp) < (*sleep_on_busyp + 10)) {
-                *sleep_on_busyp += 5;
-            } else {
-                *sleep_on_busyp = 5;
-            }
-            *last_busyp = now;
-
-            slapi_log_err(SLAPI_LOG_ERR, repl_plugin_name,
-                          "send_entry - Replica \"%s\" is busy. Waiting %lds while"
-                          " it finishes processing its current import queue\n",
-                          agmt_get_long_name(prp->agmt), *sleep_on_busyp);
-            DS_Sleep(PR_SecondsToInterval(*sleep_on_busyp));
+    if (((callback_data *)cb_data)->sender_tid) {
+        /* the sender thread owns the entry now */
+        if (queue_entry_bv((callback_data *)cb_data, bv)) {
+            ber_bvfree(bv);
+            ((callback_data *)cb_data)->rc = -1;
+            retval = -1;
         }
-    } while (rc == CONN_BUSY);
+        return retval;
+    }
 
+    rc = send_entry_bv((callback_data *)cb_data, bv);
     ber_bvfree(bv);
-    (*num_entriesp)++;
 
     /* if the connection has been closed, we need to stop
        sending entries and set a special rc value to let
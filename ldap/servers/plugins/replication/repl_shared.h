@@ -35,6 +35,7 @@
 /* Changelog Internal Configuration Parameters -> Changelog Cache related */
 #define CONFIG_CHANGELOG_ENCRYPTION_ALGORITHM "nsslapd-encryptionalgorithm"
 #define CONFIG_CHANGELOG_SYMMETRIC_KEY "nsSymmetricKey"
+#define CONFIG_CHANGELOG_COMPRESSION_ATTRIBUTE "nsslapd-changelogcompression"
 
 #define T_CHANGETYPESTR "changetype"
 #define T_CHANGETYPE 1
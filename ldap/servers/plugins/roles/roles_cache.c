@@ -27,6 +27,7 @@
 #include "prerror.h"
 #include "prcvar.h"
 #include "prio.h"
+#include "plhash.h"
 #include "avl.h"
 #include "vattr_spi.h"
 #include "roles_cache.h"
@@ -63,6 +64,13 @@ typedef struct _role_object
     Avlnode *avl_tree;     /* if ROLE_TYPE_NESTED: tree of nested DNs (avl_data is a role_object_nested struct) */
 } role_object;
 
+/* nsRole values computed for an entry */
+typedef struct _roles_membership
+{
+    PRUint64 fingerprint;          /* hash of the entry content the values were computed from */
+    Slapi_ValueSet *nsrole_values; /* NULL if the entry has no role */
+} roles_membership;
+
 /* Structure containing the roles definitions for a given suffix */
 typedef struct _roles_cache_def
 {
@@ -89,6 +97,12 @@ typedef struct _roles_cache_def
      */
     Avlnode *avl_tree;
 
+    /* nsRole values of the entries of the suffix, keyed by ndn
+       (roles_membership values), emptied whenever avl_tree changes */
+    PLHashTable *membership;
+    Slapi_Mutex *membership_lock;
+    int membership_count;
+
     /* Next roles suffix definitions */
     struct _roles_cache_def *next;
 
@@ -105,6 +119,9 @@ static roles_cache_def *roles_list = NULL;
 
 static Slapi_RWLock *global_lock = NULL;
 
+/* Max number of entries whose nsRole is kept per suffix, 0 to compute it on each read */
+static int roles_membership_max = 0;
+
 /* Structure holding the nsrole values */
 typedef struct _roles_cache_build_result
 {
@@ -112,6 +129,7 @@ typedef struct _roles_cache_build_result
     Slapi_Entry *requested_entry;   /* entry to get nsrole from */
     int has_value;                  /* flag to determine if a new value has been added to the result */
     int need_value;                 /* flag to determine if we need the result */
+    int loop_detected;              /* flag to determine if the result is incomplete */
     vattr_context *context;         /* vattr context */
 } roles_cache_build_result;
 
@@ -130,6 +148,15 @@ typedef struct _roles_cache_search_roles
     int rc; /* to check the depth of the nested */
 } roles_cache_search_roles;
 
+/* Structure used to build the candidates filter of a nested role */
+typedef struct _roles_cache_candidates
+{
+    roles_cache_def *roles_cache;
+    Slapi_Filter *filter; /* OR of the candidates filters of the nested roles */
+    int depth;            /* to check the depth of the nested */
+    int failed;           /* a nested role has no candidates filter */
+} roles_cache_candidates;
+
 static roles_cache_def *roles_cache_create_suffix(Slapi_DN *sdn);
 static int roles_cache_add_roles_from_suffix(Slapi_DN *suffix_dn, roles_cache_def *suffix_def);
 static void roles_cache_wait_on_change(void *arg);
@@ -162,6 +189,18 @@ static int roles_cache_dump(caddr_t data, caddr_t arg);
 static int roles_cache_add_entry_cb(Slapi_Entry *e, void *callback_data);
 static void roles_cache_result_cb(int rc, void *callback_data);
 static Slapi_DN *roles_cache_get_top_suffix(Slapi_DN *suffix);
+static PRUint64 roles_cache_entry_fingerprint(Slapi_Entry *entry);
+static int roles_cache_membership_get(roles_cache_def *roles_cache, Slapi_Entry *entry, PRUint64 fingerprint, int return_values, Slapi_ValueSet **valueset_out);
+static void roles_cache_membership_put(roles_cache_def *roles_cache, Slapi_Entry *entry, PRUint64 fingerprint, Slapi_ValueSet *nsrole_values);
+static void roles_cache_membership_flush(roles_cache_def *roles_cache);
+static int roles_cache_is_view_entry(Slapi_Entry *entry);
+static Slapi_Filter *roles_cache_role_candidates(roles_cache_def *roles_cache, role_object *this_role, int depth);
+static int roles_cache_nested_candidates(caddr_t data, caddr_t arg);
+static int roles_cache_filter_has_vattr(Slapi_Filter *f, void *arg);
+static int roles_cache_filter_is_marked(Slapi_Filter *f, void *arg);
+static void roles_cache_filter_mark(Slapi_Filter *f);
+static void roles_cache_filter_add(Slapi_Filter *f, Slapi_Filter *candidates);
+static int roles_cache_filter_add_candidates(Slapi_Filter *f, void *arg);
 
 /*     ============== FUNCTIONS ================ */
 
@@ -275,7 +314,9 @@ roles_cache_create_suffix(Slapi_DN *sdn)
     new_suffix->change_lock = slapi_new_mutex();
     new_suffix->stop_lock = slapi_new_mutex();
     new_suffix->create_lock = slapi_new_mutex();
+    new_suffix->membership_lock = slapi_new_mutex();
     if (new_suffix->stop_lock == NULL ||
+        new_suffix->membership_lock == NULL ||
         new_suffix->change_lock == NULL ||
         new_suffix->cache_lock == NULL ||
         new_suffix->create_lock == NULL) {
@@ -285,6 +326,11 @@ roles_cache_create_suffix(Slapi_DN *sdn)
         return (NULL);
     }
 
+    if (roles_membership_max > 0) {
+        new_suffix->membership = PL_NewHashTable(0, PL_HashString, PL_CompareStrings,
+                                                 PL_CompareValues, NULL, NULL);
+    }
+
     new_suffix->something_changed = slapi_new_condvar(new_suffix->change_lock);
     if (new_suffix->something_changed == NULL) {
         slapi_log_err(SLAPI_LOG_ERR, ROLES_PLUGIN_SUBSYSTEM,
@@ -594,6 +640,8 @@ roles_cache_update(roles_cache_def *suffix_to_update)
         }
         suffix_to_update->notified_entry = NULL;
     }
+    /* the nsRole values computed so far may be wrong now */
+    roles_cache_membership_flush(suffix_to_update);
 done:
     slapi_rwlock_unlock(suffix_to_update->cache_lock);
     if (dn != NULL) {
@@ -706,6 +754,20 @@ roles_cache_is_role_entry(struct slapi_entry *entry)
     return (1);
 }
 
+/* roles_cache_is_view_entry
+   -------------------------
+    return 1: entry is a view
+    return 0: entry is not a view
+*/
+static int
+roles_cache_is_view_entry(Slapi_Entry *entry)
+{
+    if (entry == NULL) {
+        return (0);
+    }
+    return (slapi_entry_attr_hasvalue(entry, "objectclass", "nsView"));
+}
+
 /* roles_cache_change_notify
    -------------------------
    determines if the change effects the cache and if so
@@ -800,6 +862,20 @@ roles_cache_change_notify(Slapi_PBlock *pb)
         return;
     }
 
+    /* views scope roles too: a view change may change the nsrole of any entry */
+    if ((roles_membership_max > 0) &&
+        (roles_cache_is_view_entry(e) || roles_cache_is_view_entry(pre))) {
+        roles_cache_def *current_role = NULL;
+
+        slapi_rwlock_rdlock(global_lock);
+        for (current_role = roles_list; current_role; current_role = current_role->next) {
+            slapi_rwlock_wrlock(current_role->cache_lock);
+            roles_cache_membership_flush(current_role);
+            slapi_rwlock_unlock(current_role->cache_lock);
+        }
+        slapi_rwlock_unlock(global_lock);
+    }
+
     if (operation != SLAPI_OPERATION_MODIFY) {
         if (roles_cache_is_role_entry(e) != 1) {
             slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM, "<-- roles_cache_change_notify - Not a role entry\n");
@@ -1505,12 +1581,30 @@ roles_cache_listroles_ext(vattr_context *c, Slapi_Entry *entry, int return_value
             arg.need_value = return_values;
             arg.requested_entry = entry;
             arg.has_value = 0;
+            arg.loop_detected = 0;
             arg.context = c;
 
             /* XXX really need a mutex for this read operation ? */
             slapi_rwlock_rdlock(roles_cache->cache_lock);
 
-            avl_apply(roles_cache->avl_tree, (IFP)roles_cache_build_nsrole, &arg, -1, AVL_INORDER);
+            if (roles_cache->membership) {
+                PRUint64 fingerprint = roles_cache_entry_fingerprint(entry);
+                int cached = roles_cache_membership_get(roles_cache, entry, fingerprint,
+                                                        return_values, valueset_out);
+
+                if (cached >= 0) {
+                    arg.has_value = cached;
+                } else {
+                    avl_apply(roles_cache->avl_tree, (IFP)roles_cache_build_nsrole, &arg, -1, AVL_INORDER);
+                    /* without the values, the traversal stopped at the first role */
+                    if (return_values && !arg.loop_detected) {
+                        roles_cache_membership_put(roles_cache, entry, fingerprint,
+                                                   arg.has_value ? *valueset_out : NULL);
+                    }
+                }
+            } else {
+                avl_apply(roles_cache->avl_tree, (IFP)roles_cache_build_nsrole, &arg, -1, AVL_INORDER);
+            }
 
             slapi_rwlock_unlock(roles_cache->cache_lock);
 
@@ -1571,6 +1665,7 @@ roles_cache_build_nsrole(caddr_t data, caddr_t arg)
     if (SLAPI_VIRTUALATTRS_LOOP_DETECTED == tmprc) {
         /* all we want to detect and return is loop/stack overflow */
         rc = tmprc;
+        result->loop_detected = 1;
     }
 
     /* If so, add its DN to the attribute */
@@ -1596,6 +1691,155 @@ roles_cache_build_nsrole(caddr_t data, caddr_t arg)
 }
 
 
+/* roles_cache_entry_fingerprint
+   -----------------------------
+   Hash (FNV-1a) the attributes of an entry: a change to the entry
+   changes the fingerprint, so nsRole values computed before it are
+   not used anymore
+ */
+static PRUint64
+roles_cache_entry_fingerprint(Slapi_Entry *entry)
+{
+    PRUint64 hash = 14695981039346656037ULL;
+    Slapi_Attr *attr = NULL;
+    int rc;
+
+    for (rc = slapi_entry_first_attr(entry, &attr); rc == 0 && attr;
+         rc = slapi_entry_next_attr(entry, attr, &attr)) {
+        Slapi_Value *value = NULL;
+        char *type = NULL;
+        const unsigned char *p;
+        int i;
+
+        slapi_attr_get_type(attr, &type);
+        for (p = (const unsigned char *)type; p && *p; p++) {
+            hash = (hash ^ *p) * 1099511628211ULL;
+        }
+        /* separate the type from its values */
+        hash = (hash ^ ':') * 1099511628211ULL;
+
+        for (i = slapi_attr_first_value(attr, &value); i != -1;
+             i = slapi_attr_next_value(attr, i, &value)) {
+            const struct berval *bv = slapi_value_get_berval(value);
+            ber_len_t len;
+
+            for (len = 0; bv && len < bv->bv_len; len++) {
+                hash = (hash ^ (unsigned char)bv->bv_val[len]) * 1099511628211ULL;
+            }
+            hash = (hash ^ '\n') * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+/* roles_cache_membership_get
+   --------------------------
+   Look for the nsRole values computed for the entry, when it had the same
+   content. If return_values, the values are added to valueset_out
+    return -1: nothing computed for that entry
+    return 0: the entry has no nsrole
+    return 1: the entry has nsrole
+ */
+static int
+roles_cache_membership_get(roles_cache_def *roles_cache, Slapi_Entry *entry, PRUint64 fingerprint, int return_values, Slapi_ValueSet **valueset_out)
+{
+    roles_membership *membership = NULL;
+    int rc = -1;
+
+    slapi_lock_mutex(roles_cache->membership_lock);
+    membership = (roles_membership *)PL_HashTableLookup(roles_cache->membership,
+                                                        slapi_entry_get_ndn(entry));
+    if (membership && membership->fingerprint == fingerprint) {
+        if (membership->nsrole_values) {
+            if (return_values) {
+                slapi_valueset_set_valueset(*valueset_out, membership->nsrole_values);
+            }
+            rc = 1;
+        } else {
+            rc = 0;
+        }
+    }
+    slapi_unlock_mutex(roles_cache->membership_lock);
+
+    return rc;
+}
+
+/* roles_cache_membership_clear
+   ----------------------------
+   Free a roles_membership, membership_lock must be held
+ */
+static PRIntn
+roles_cache_membership_clear(PLHashEntry *he, PRIntn i __attribute__((unused)), void *arg __attribute__((unused)))
+{
+    roles_membership *membership = (roles_membership *)he->value;
+
+    slapi_valueset_free(membership->nsrole_values);
+    slapi_ch_free((void **)&membership);
+    slapi_ch_free((void **)&he->key);
+    return HT_ENUMERATE_REMOVE;
+}
+
+/* roles_cache_membership_put
+   --------------------------
+   Keep the nsRole values computed for the entry, nsrole_values is
+   NULL if the entry has no role
+ */
+static void
+roles_cache_membership_put(roles_cache_def *roles_cache, Slapi_Entry *entry, PRUint64 fingerprint, Slapi_ValueSet *nsrole_values)
+{
+    const char *ndn = slapi_entry_get_ndn(entry);
+    roles_membership *membership = NULL;
+
+    slapi_lock_mutex(roles_cache->membership_lock);
+    membership = (roles_membership *)PL_HashTableLookup(roles_cache->membership, ndn);
+    if (membership == NULL) {
+        if (roles_cache->membership_count >= roles_membership_max) {
+            /* start over rather than tracking which entry is the oldest */
+            PL_HashTableEnumerateEntries(roles_cache->membership, roles_cache_membership_clear, NULL);
+            roles_cache->membership_count = 0;
+        }
+        membership = (roles_membership *)slapi_ch_calloc(1, sizeof(roles_membership));
+        PL_HashTableAdd(roles_cache->membership, slapi_ch_strdup(ndn), membership);
+        roles_cache->membership_count++;
+    } else if (membership->nsrole_values) {
+        slapi_valueset_free(membership->nsrole_values);
+        membership->nsrole_values = NULL;
+    }
+    membership->fingerprint = fingerprint;
+    if (nsrole_values) {
+        membership->nsrole_values = slapi_valueset_new();
+        slapi_valueset_set_valueset(membership->nsrole_values, nsrole_values);
+    }
+    slapi_unlock_mutex(roles_cache->membership_lock);
+}
+
+/* roles_cache_membership_flush
+   ----------------------------
+   Forget the nsRole values computed for the entries of a suffix
+ */
+static void
+roles_cache_membership_flush(roles_cache_def *roles_cache)
+{
+    if (roles_cache->membership == NULL) {
+        return;
+    }
+    slapi_lock_mutex(roles_cache->membership_lock);
+    PL_HashTableEnumerateEntries(roles_cache->membership, roles_cache_membership_clear, NULL);
+    roles_cache->membership_count = 0;
+    slapi_unlock_mutex(roles_cache->membership_lock);
+}
+
+/* roles_cache_set_membership_max
+   ------------------------------
+   Set how many entries may have their nsRole kept per suffix,
+   to be called before roles_cache_init
+ */
+void
+roles_cache_set_membership_max(int max_entries)
+{
+    roles_membership_max = max_entries > 0 ? max_entries : 0;
+}
+
 /* roles_check
    -----------
    Checks if an entry has a presented role, assuming that we've already verified
@@ -1653,6 +1897,253 @@ roles_check(Slapi_Entry *entry_to_check, Slapi_DN *role_dn, int *present)
     return rc;
 }
 
+/* roles_cache_filter_rewriter
+   ---------------------------
+   Search rewriter: nsRole is computed, so a filter on it can not use the
+   indexes. Each (nsRole=<role dn>) component becomes
+   (&(nsRole=<role dn>)<candidates>) where <candidates> is a filter on real
+   attributes that all the members of the role match: nsRoleDN for a
+   managed role, the role filter for a filtered role and the OR of them for
+   a nested role. The backend gets its candidates from the indexes of
+   <candidates>, the component itself is flagged SLAPI_FILTER_CANDIDATES_ONLY
+   so that only nsRole decides if an entry matches.
+ */
+int
+roles_cache_filter_rewriter(Slapi_PBlock *pb)
+{
+    Slapi_Filter *filter = NULL;
+    int error_code = 0;
+
+    if (roles_list == NULL) {
+        return SEARCH_REWRITE_CALLBACK_CONTINUE;
+    }
+
+    slapi_pblock_get(pb, SLAPI_SEARCH_FILTER, &filter);
+    if (filter == NULL) {
+        return SEARCH_REWRITE_CALLBACK_CONTINUE;
+    }
+
+    /* the filter may have been rewritten already, do not do it twice */
+    if (slapi_filter_apply(filter, roles_cache_filter_is_marked, NULL, &error_code) == SLAPI_FILTER_SCAN_STOP) {
+        return SEARCH_REWRITE_CALLBACK_CONTINUE;
+    }
+
+    slapi_filter_apply(filter, roles_cache_filter_add_candidates, NULL, &error_code);
+
+    return SEARCH_REWRITE_CALLBACK_CONTINUE;
+}
+
+/* roles_cache_filter_add_candidates
+   ---------------------------------
+   filter_apply callback: add the candidates filter of the role to a
+   (nsRole=<role dn>) component
+ */
+static int
+roles_cache_filter_add_candidates(Slapi_Filter *f, void *arg __attribute__((unused)))
+{
+    char *type = NULL;
+    struct berval *bval = NULL;
+    char *role_ndn = NULL;
+    Slapi_DN *role_dn = NULL;
+    roles_cache_def *roles_cache = NULL;
+    role_object *this_role = NULL;
+    Slapi_Filter *candidates = NULL;
+
+    if (slapi_filter_get_choice(f) != LDAP_FILTER_EQUALITY ||
+        slapi_filter_get_ava(f, &type, &bval) != 0 ||
+        strcasecmp(type, NSROLEATTR) != 0 ||
+        bval == NULL || bval->bv_len == 0) {
+        return SLAPI_FILTER_SCAN_CONTINUE;
+    }
+
+    role_ndn = (char *)slapi_ch_malloc(bval->bv_len + 1);
+    memcpy(role_ndn, bval->bv_val, bval->bv_len);
+    role_ndn[bval->bv_len] = '\0';
+    role_dn = slapi_sdn_new_dn_passin(role_ndn);
+
+    slapi_rwlock_rdlock(global_lock);
+    roles_cache_find_roles_in_suffix(role_dn, &roles_cache);
+    slapi_rwlock_unlock(global_lock);
+
+    if (roles_cache != NULL) {
+        slapi_rwlock_rdlock(roles_cache->cache_lock);
+        this_role = (role_object *)avl_find(roles_cache->avl_tree, role_dn, (IFP)roles_cache_find_node);
+        if (this_role) {
+            candidates = roles_cache_role_candidates(roles_cache, this_role, 0);
+        }
+        slapi_rwlock_unlock(roles_cache->cache_lock);
+    }
+
+    if (candidates) {
+        slapi_log_err(SLAPI_LOG_PLUGIN, ROLES_PLUGIN_SUBSYSTEM,
+                      "roles_cache_filter_add_candidates - search on role %s uses the indexes\n",
+                      slapi_sdn_get_dn(role_dn));
+        roles_cache_filter_add(f, candidates);
+    }
+    slapi_sdn_free(&role_dn);
+
+    return SLAPI_FILTER_SCAN_CONTINUE;
+}
+
+/* roles_cache_filter_add
+   ----------------------
+   Turn the component f into (&f<candidates>), in place since the parent
+   of f holds it
+ */
+static void
+roles_cache_filter_add(Slapi_Filter *f, Slapi_Filter *candidates)
+{
+    struct slapi_filter *next = f->f_next;
+    struct slapi_filter *and = NULL;
+    struct slapi_filter swap;
+
+    roles_cache_filter_mark(candidates);
+    and = slapi_filter_join_ex(LDAP_FILTER_AND, slapi_filter_dup(f), candidates, 1);
+
+    swap = *f;
+    *f = *and;
+    *and = swap;
+
+    f->f_next = next;
+    /* the join moved the flag of the candidates up */
+    f->f_flags &= ~SLAPI_FILTER_CANDIDATES_ONLY;
+    and->f_next = NULL;
+    slapi_filter_free(and, 1);
+}
+
+/* roles_cache_filter_mark
+   -----------------------
+   Flag every component of the candidates filter, so that none of them
+   is evaluated even if the backend reorganizes the filter
+ */
+static void
+roles_cache_filter_mark(Slapi_Filter *f)
+{
+    Slapi_Filter *child = NULL;
+
+    f->f_flags |= SLAPI_FILTER_CANDIDATES_ONLY;
+    for (child = slapi_filter_list_first(f); child; child = slapi_filter_list_next(f, child)) {
+        roles_cache_filter_mark(child);
+    }
+}
+
+static int
+roles_cache_filter_is_marked(Slapi_Filter *f, void *arg __attribute__((unused)))
+{
+    return (f->f_flags & SLAPI_FILTER_CANDIDATES_ONLY) ? SLAPI_FILTER_SCAN_STOP : SLAPI_FILTER_SCAN_CONTINUE;
+}
+
+/* roles_cache_filter_has_vattr
+   ----------------------------
+   filter_apply callback: stop on a component the indexes can not resolve
+   because its attribute is computed
+ */
+static int
+roles_cache_filter_has_vattr(Slapi_Filter *f, void *arg)
+{
+    char *type = NULL;
+
+    if (slapi_filter_get_attribute_type(f, &type) != 0 || type == NULL ||
+        slapi_vattr_is_virtual_type((Slapi_DN *)arg, type)) {
+        return SLAPI_FILTER_SCAN_STOP;
+    }
+    return SLAPI_FILTER_SCAN_CONTINUE;
+}
+
+/* roles_cache_role_candidates
+   ---------------------------
+   Build a filter on real attributes that every member of the role matches.
+   The cache_lock of the suffix must be held.
+    return NULL if there is no such filter
+ */
+static Slapi_Filter *
+roles_cache_role_candidates(roles_cache_def *roles_cache, role_object *this_role, int depth)
+{
+    Slapi_Filter *filter = NULL;
+    char *filter_str = NULL;
+    int error_code = 0;
+    roles_cache_candidates arg;
+
+    if (depth > MAX_NESTED_ROLES) {
+        return NULL;
+    }
+
+    switch (this_role->type) {
+    case ROLE_TYPE_MANAGED:
+        /* a CoS may provide nsRoleDN */
+        if (!slapi_vattr_is_virtual_type(roles_cache->suffix_dn, ROLE_MANAGED_ATTR_NAME)) {
+            filter_str = slapi_filter_sprintf("(%s=%s%s)", ROLE_MANAGED_ATTR_NAME, ESC_NEXT_VAL,
+                                              slapi_sdn_get_ndn(this_role->dn));
+            filter = slapi_str2filter(filter_str);
+            slapi_ch_free_string(&filter_str);
+        }
+        break;
+    case ROLE_TYPE_FILTERED:
+        if (this_role->filter &&
+            slapi_filter_apply(this_role->filter, roles_cache_filter_has_vattr,
+                               roles_cache->suffix_dn, &error_code) == SLAPI_FILTER_SCAN_NOMORE) {
+            filter = slapi_filter_dup(this_role->filter);
+        }
+        break;
+    case ROLE_TYPE_NESTED:
+        arg.roles_cache = roles_cache;
+        arg.filter = NULL;
+        arg.depth = depth;
+        arg.failed = 0;
+        avl_apply(this_role->avl_tree, (IFP)roles_cache_nested_candidates, &arg, -1, AVL_INORDER);
+        if (arg.failed) {
+            slapi_filter_free(arg.filter, 1);
+        } else {
+            filter = arg.filter;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return filter;
+}
+
+/* roles_cache_nested_candidates
+   -----------------------------
+   avl_apply callback: add the candidates filter of a nested role
+ */
+static int
+roles_cache_nested_candidates(caddr_t data, caddr_t arg)
+{
+    role_object_nested *nested = (role_object_nested *)data;
+    roles_cache_candidates *candidates = (roles_cache_candidates *)arg;
+    roles_cache_def *roles_cache = NULL;
+    role_object *this_role = NULL;
+    Slapi_Filter *filter = NULL;
+
+    /* only the roles of the same suffix are under the cache_lock we hold */
+    if (roles_cache_find_roles_in_suffix(nested->dn, &roles_cache) != 0 ||
+        roles_cache != candidates->roles_cache) {
+        candidates->failed = 1;
+        return -1;
+    }
+
+    this_role = (role_object *)avl_find(roles_cache->avl_tree, nested->dn, (IFP)roles_cache_find_node);
+    if (this_role == NULL) {
+        /* an unknown role has no member */
+        return 0;
+    }
+
+    filter = roles_cache_role_candidates(candidates->roles_cache, this_role, candidates->depth + 1);
+    if (filter == NULL) {
+        candidates->failed = 1;
+        return -1;
+    }
+    if (candidates->filter) {
+        candidates->filter = slapi_filter_join(LDAP_FILTER_OR, candidates->filter, filter);
+    } else {
+        candidates->filter = filter;
+    }
+
+    return 0;
+}
+
 /* roles_cache_find_node:
    ---------------------
    Comparison function to add a new node in the avl tree
@@ -2027,6 +2518,15 @@ roles_cache_role_def_free(roles_cache_def *role_def)
     slapi_lock_mutex(role_def->stop_lock);
 
     avl_free(role_def->avl_tree, (IFP)roles_cache_role_object_free);
+    if (role_def->membership) {
+        roles_cache_membership_flush(role_def);
+        PL_HashTableDestroy(role_def->membership);
+        role_def->membership = NULL;
+    }
+    if (role_def->membership_lock) {
+        slapi_destroy_mutex(role_def->membership_lock);
+        role_def->membership_lock = NULL;
+    }
     slapi_sdn_free(&(role_def->suffix_dn));
     slapi_destroy_rwlock(role_def->cache_lock);
     role_def->cache_lock = NULL;
@@ -35,6 +35,9 @@
 
 #define ROLE_SCOPE_DN "nsRoleScopeDN"
 
+/* Plugin config: number of entries per suffix whose nsRole is kept, 0 (default) to compute it on each read */
+#define ROLE_MEMBERSHIP_CACHE_ATTR "nsRoleMembershipCacheSize"
+
 #define SLAPI_ROLE_ERROR_NO_FILTER_SPECIFIED -1
 #define SLAPI_ROLE_ERROR_FILTER_BAD -2
 #define SLAPI_ROLE_DEFINITION_DOESNT_EXIST -3
@@ -47,6 +50,8 @@ void roles_cache_stop(void);
 void roles_cache_change_notify(Slapi_PBlock *pb);
 int roles_cache_listroles(Slapi_Entry *entry, int return_value, Slapi_ValueSet **valueset_out);
 int roles_cache_listroles_ext(vattr_context *c, Slapi_Entry *entry, int return_value, Slapi_ValueSet **valueset_out);
+void roles_cache_set_membership_max(int max_entries);
+int roles_cache_filter_rewriter(Slapi_PBlock *pb);
 
 int roles_check(Slapi_Entry *entry_to_check, Slapi_DN *role_dn, int *present);
 
@@ -119,6 +119,7 @@ roles_init(Slapi_PBlock *pb)
     if ((slapi_pblock_get(pb, SLAPI_PLUGIN_CONFIG_ENTRY, &plugin_entry) == 0) &&
         plugin_entry) {
         is_betxn = slapi_entry_attr_get_bool(plugin_entry, "nsslapd-pluginbetxn");
+        roles_cache_set_membership_max(slapi_entry_attr_get_int(plugin_entry, ROLE_MEMBERSHIP_CACHE_ATTR));
     }
 
     if (slapi_pblock_set(pb, SLAPI_PLUGIN_VERSION,
@@ -173,6 +174,9 @@ roles_start(Slapi_PBlock *pb __attribute__((unused)))
 
     roles_cache_init();
 
+    /* register the rewriter getting the candidates of nsRole searches from the indexes */
+    slapi_compute_add_search_rewriter(roles_cache_filter_rewriter);
+
     /* from Pete Rowley for vcache
      * PLUGIN DEPENDENCY ON STATECHANGE PLUGIN
      *
@@ -43,7 +43,10 @@ int ldap_quote_filter_value(
     int *outLen);
 
 
-static int search_one_berval(Slapi_DN *baseDN, const char **attrNames, const struct berval *value, const char *requiredObjectClass, Slapi_DN *target, Slapi_DN **excludes);
+/* Values looked up by a single internal search */
+#define UNIQUE_SEARCH_MAX_VALUES 64
+
+static int search_values(Slapi_DN *baseDN, const char **attrNames, const struct berval **values, const char *requiredObjectClass, Slapi_DN *target, Slapi_DN **excludes);
 
 /*
  * ISSUES:
@@ -447,12 +450,12 @@ uid_op_error(int internal_error)
 
 /* ------------------------------------------------------------ */
 /*
- * Create an LDAP search filter from the attribute
- *   name and value supplied.
+ * Create an LDAP search filter matching any of the attribute
+ *   names with any of the values supplied.
  */
 
 static char *
-create_filter(const char **attributes, const struct berval *value, const char *requiredObjectClass)
+create_filter(const char **attributes, const struct berval **values, const char *requiredObjectClass)
 {
     char *filter = NULL;
     char *fp;
@@ -460,45 +463,47 @@ create_filter(const char **attributes, const struct berval *value, const char *r
     int *attrLen = NULL;
     int totalAttrLen = 0;
     int attrCount = 0;
+    int valueCount = 0;
+    int totalValueLen = 0;
     int valueLen;
     int classLen = 0;
     int filterLen;
+    int terms;
     int i = 0;
+    int j = 0;
 
     PR_ASSERT(attributes);
 
     /* Compute the length of the required buffer */
     for (attrCount = 0; attributes && attributes[attrCount]; attrCount++)
         ;
-    attrCount++;
-    attrLen = (int *)slapi_ch_calloc(attrCount, sizeof(int));
+    attrLen = (int *)slapi_ch_calloc(attrCount + 1, sizeof(int));
     for (i = 0; attributes && attributes[i]; i++) {
         attrLen[i] += strlen(attributes[i]);
         totalAttrLen += attrLen[i];
     }
 
-    /* if attrCount is 1, attrLen is already corect for usage.*/
-    if (attrCount > 1) {
-        /* Filter will be (|(attr=value)(attr=value)) */
-        /* 3 for the (| ) */
-        /* 3 for each attr for (=) not in attr or value */
-        totalAttrLen += 3 + (attrCount * 3);
-    } else {
-        totalAttrLen += 3;
+    for (valueCount = 0; values[valueCount]; valueCount++) {
+        if (ldap_quote_filter_value(values[valueCount]->bv_val, values[valueCount]->bv_len, 0, 0, &valueLen)) {
+            slapi_ch_free((void **)&attrLen);
+            return filter;
+        }
+        totalValueLen += valueLen;
     }
+    terms = attrCount * valueCount;
 
-    if (ldap_quote_filter_value(value->bv_val, value->bv_len, 0, 0, &valueLen)) {
-        slapi_ch_free((void **)&attrLen);
-        return filter;
+    /* Filter will be (|(attr=value)(attr=value)...) unless there
+     * is a single (attr=value) term: 3 for each (=) and 3 for the (|) */
+    filterLen = (totalAttrLen * valueCount) + (totalValueLen * attrCount) + (terms * 3);
+    if (terms > 1) {
+        filterLen += 3;
     }
-
     if (requiredObjectClass) {
         classLen = strlen(requiredObjectClass);
         /* "(&(objectClass=)<Filter here>)" == 17 */
-        filterLen = totalAttrLen + 1 + (valueLen * attrCount) + classLen + 17 + 1;
-    } else {
-        filterLen = totalAttrLen + 1 + (valueLen * attrCount) + 1;
+        filterLen += classLen + 17;
     }
+    filterLen++;
 
     /* Allocate the buffer */
     filter = (char *)slapi_ch_calloc(1, filterLen + 1);
@@ -514,30 +519,13 @@ create_filter(const char **attributes, const struct berval *value, const char *r
         *fp++ = ')';
     }
 
-    if (attrCount == 1) {
-        *fp++ = '(';
-        /* Place attribute name in filter */
-        strcpy(fp, attributes[0]);
-        fp += attrLen[0];
-
-        /* Place comparison operator */
-        *fp++ = '=';
-
-        /* Place value in filter */
-        if (ldap_quote_filter_value(value->bv_val, value->bv_len, fp, max - fp, &valueLen)) {
-            slapi_ch_free_string(&filter);
-            slapi_ch_free((void **)&attrLen);
-            return 0;
-        }
-        fp += valueLen;
-        *fp++ = ')';
-    } else {
+    if (terms > 1) {
         strcpy(fp, "(|");
         fp += 2;
-
+    }
+    for (j = 0; j < valueCount; j++) {
         for (i = 0; attributes && attributes[i]; i++) {
-            strcpy(fp, "(");
-            fp += 1;
+            *fp++ = '(';
             /* Place attribute name in filter */
             strcpy(fp, attributes[i]);
             fp += attrLen[i];
@@ -546,18 +534,17 @@ create_filter(const char **attributes, const struct berval *value, const char *r
             *fp++ = '=';
 
             /* Place value in filter */
-            if (ldap_quote_filter_value(value->bv_val, value->bv_len, fp, max - fp, &valueLen)) {
+            if (ldap_quote_filter_value(values[j]->bv_val, values[j]->bv_len, fp, max - fp, &valueLen)) {
                 slapi_ch_free_string(&filter);
                 slapi_ch_free((void **)&attrLen);
                 return 0;
             }
             fp += valueLen;
-
-            strcpy(fp, ")");
-            fp += 1;
+            *fp++ = ')';
         }
-        strcpy(fp, ")");
-        fp += 1;
+    }
+    if (terms > 1) {
+        *fp++ = ')';
     }
 
     /* Close AND expression if a requiredObjectClass was set */
@@ -582,6 +569,10 @@ create_filter(const char **attributes, const struct berval *value, const char *r
  * If 'attr' is NULL, the values are taken from 'values'.
  * If 'attr' is non-NULL, the values are taken from 'attr'.
  *
+ * All the values are looked up with a single search (or one search
+ * per UNIQUE_SEARCH_MAX_VALUES values), whose OR filter is resolved by
+ * the backend with one equality index read per value.
+ *
  * Return:
  *   LDAP_SUCCESS - no matches, or the attribute matches the
  *     target dn.
@@ -592,6 +583,8 @@ create_filter(const char **attributes, const struct berval *value, const char *r
 static int
 search(Slapi_DN *baseDN, const char **attrNames, Slapi_Attr *attr, struct berval **values, const char *requiredObjectClass, Slapi_DN *target, Slapi_DN **excludes)
 {
+    const struct berval *batch[UNIQUE_SEARCH_MAX_VALUES + 1];
+    int nbatch = 0;
     int result;
 
 #ifdef DEBUG
@@ -607,13 +600,6 @@ search(Slapi_DN *baseDN, const char **attrNames, Slapi_Attr *attr, struct berval
     if ((Slapi_Attr *)NULL == attr && (struct berval **)NULL == values)
         return result;
 
-    /*
-   * Perform the search for each value provided
-   *
-   * Another possibility would be to search for all the values at once.
-   * However, this is more complex (for filter creation) and unique
-   * attributes values are probably only changed one at a time anyway.
-   */
     if ((Slapi_Attr *)NULL != attr) {
         Slapi_Value *v = NULL;
         int vhint = -1;
@@ -621,16 +607,27 @@ search(Slapi_DN *baseDN, const char **attrNames, Slapi_Attr *attr, struct berval
         for (vhint = slapi_attr_first_value(attr, &v);
              vhint != -1 && LDAP_SUCCESS == result;
              vhint = slapi_attr_next_value(attr, vhint, &v)) {
-            result = search_one_berval(baseDN, attrNames,
-                                       slapi_value_get_berval(v),
-                                       requiredObjectClass, target, excludes);
+            batch[nbatch++] = slapi_value_get_berval(v);
+            if (nbatch == UNIQUE_SEARCH_MAX_VALUES) {
+                batch[nbatch] = NULL;
+                result = search_values(baseDN, attrNames, batch, requiredObjectClass, target, excludes);
+                nbatch = 0;
+            }
         }
     } else {
         for (; *values != NULL && LDAP_SUCCESS == result; values++) {
-            result = search_one_berval(baseDN, attrNames, *values, requiredObjectClass,
-                                       target, excludes);
+            batch[nbatch++] = *values;
+            if (nbatch == UNIQUE_SEARCH_MAX_VALUES) {
+                batch[nbatch] = NULL;
+                result = search_values(baseDN, attrNames, batch, requiredObjectClass, target, excludes);
+                nbatch = 0;
+            }
         }
     }
+    if (nbatch && LDAP_SUCCESS == result) {
+        batch[nbatch] = NULL;
+        result = search_values(baseDN, attrNames, batch, requiredObjectClass, target, excludes);
+    }
 
 #ifdef DEBUG
     slapi_log_err(SLAPI_LOG_PLUGIN, plugin_name,
@@ -642,7 +639,7 @@ search(Slapi_DN *baseDN, const char **attrNames, Slapi_Attr *attr, struct berval
 
 
 static int
-search_one_berval(Slapi_DN *baseDN, const char **attrNames, const struct berval *value, const char *requiredObjectClass, Slapi_DN *target, Slapi_DN **excludes)
+search_values(Slapi_DN *baseDN, const char **attrNames, const struct berval **values, const char *requiredObjectClass, Slapi_DN *target, Slapi_DN **excludes)
 {
     int result;
     char *filter;
@@ -651,7 +648,7 @@ search_one_berval(Slapi_DN *baseDN, const char **attrNames, const struct berval
     result = LDAP_SUCCESS;
 
     /* If no value, can't possibly be a conflict */
-    if ((struct berval *)NULL == value)
+    if ((const struct berval **)NULL == values || NULL == values[0])
         return result;
 
     filter = 0;
@@ -664,11 +661,11 @@ search_one_berval(Slapi_DN *baseDN, const char **attrNames, const struct berval
     static char *attrs[] = {"1.1", 0};
 
     /* Create the filter - this needs to be freed */
-    filter = create_filter(attrNames, value, requiredObjectClass);
+    filter = create_filter(attrNames, values, requiredObjectClass);
 
 #ifdef DEBUG
     slapi_log_err(SLAPI_LOG_PLUGIN, plugin_name,
-                  "search_one_berval - SEARCH filter=%s\n", filter);
+                  "search_values - SEARCH filter=%s\n", filter);
 #endif
 
     /* Perform the search using the new internal API */
@@ -712,7 +709,7 @@ search_one_berval(Slapi_DN *baseDN, const char **attrNames, const struct berval
     for (; *entries; entries++) {
 #ifdef DEBUG
         slapi_log_err(SLAPI_LOG_PLUGIN, plugin_name,
-                      "search_one_berval - SEARCH entry dn=%s\n", slapi_entry_get_dn(*entries));
+                      "search_values - SEARCH entry dn=%s\n", slapi_entry_get_dn(*entries));
 #endif
 
         /*
@@ -743,7 +740,7 @@ search_one_berval(Slapi_DN *baseDN, const char **attrNames, const struct berval
 
 #ifdef DEBUG
     slapi_log_err(SLAPI_LOG_PLUGIN, plugin_name,
-                  "search_one_berval - SEARCH complete result=%d\n", result);
+                  "search_values - SEARCH complete result=%d\n", result);
 #endif
     END
 
@@ -134,6 +134,7 @@ ldbm_restart_temporary_closed_instances(Slapi_PBlock *pb)
                 slapi_task_log_notice(task, "Unable to restart '%s'", inst->inst_name);
             }
         } else {
+            ldbm_bloom_build_instance(inst);
             slapi_mtn_be_enable(inst->inst_be);
             instance_set_not_busy(inst);
         }
@@ -311,6 +312,7 @@ ldbm_back_archive2ldbm(Slapi_PBlock *pb)
                     slapi_task_log_notice(task, "Unable to restart '%s'", inst->inst_name);
                 }
             } else {
+                ldbm_bloom_build_instance(inst);
                 slapi_mtn_be_enable(inst->inst_be);
                 instance_set_not_busy(inst);
             }
@@ -332,6 +334,8 @@ ldbm_back_ldbm2archive(Slapi_PBlock *pb)
     char *rawdirectory = NULL; /* -a <directory> */
     char *directory = NULL;    /* normalized */
     char *dir_bak = NULL;
+    char *rawbase = NULL;      /* incremental backup base */
+    char *base = NULL;         /* normalized */
     int return_value = -1;
     int task_flags = 0;
     int run_from_cmdline = 0;
@@ -340,6 +344,7 @@ ldbm_back_ldbm2archive(Slapi_PBlock *pb)
 
     slapi_pblock_get(pb, SLAPI_PLUGIN_PRIVATE, &li);
     slapi_pblock_get(pb, SLAPI_SEQ_VAL, &rawdirectory);
+    slapi_pblock_get(pb, SLAPI_BACKUP_INCREMENTAL_BASE, &rawbase);
     slapi_pblock_get(pb, SLAPI_TASK_FLAGS, &task_flags);
     li->li_flags = run_from_cmdline = (task_flags & SLAPI_TASK_RUNNING_FROM_COMMANDLINE);
 
@@ -377,6 +382,20 @@ ldbm_back_ldbm2archive(Slapi_PBlock *pb)
     /* Initialize directory */
     directory = rel2abspath(rawdirectory);
 
+    if (rawbase && *rawbase) {
+        base = rel2abspath(rawbase);
+        if (slapd_comp_path(base, directory) == 0) {
+            slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_ldbm2archive",
+                          "The base of an incremental backup cannot be the backup directory.\n");
+            if (task) {
+                slapi_task_log_notice(task,
+                                      "The base of an incremental backup cannot be the backup directory.");
+            }
+            return_value = -1;
+            goto out;
+        }
+    }
+
     if (stat(directory, &sbuf) == 0) {
         if (slapd_comp_path(directory, li->li_directory) == 0) {
             slapi_log_err(SLAPI_LOG_ERR,
@@ -487,7 +506,9 @@ ldbm_back_ldbm2archive(Slapi_PBlock *pb)
     }
 
     /* tell it to archive */
+    li->li_backup_base = base;
     return_value = dblayer_backup(li, directory, task);
+    li->li_backup_base = NULL;
     if (return_value) {
         slapi_log_err(SLAPI_LOG_BACKLDBM,
                       "ldbm_back_ldbm2archive", "dblayer_backup failed (%d).\n", return_value);
@@ -555,5 +576,6 @@ out:
 
     slapi_ch_free_string(&dir_bak);
     slapi_ch_free_string(&directory);
+    slapi_ch_free_string(&base);
     return return_value;
 }
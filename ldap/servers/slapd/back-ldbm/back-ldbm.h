@@ -228,6 +228,12 @@ typedef u_int32_t ID;
  */
 #define ID_WARNING_THRESHOLD (MAXID * 0.9)
 
+/*
+ * number of IDs reserved at once by the threads applying replicated adds
+ * (see next_id_block)
+ */
+#define NEXTID_BLOCK_SIZE 64
+
 /*
  * Use this to count and index into an array of ID.
  */
@@ -253,6 +259,15 @@ typedef uint32_t NIDS;
 /* Default to holding 8 ids for idl_fetch_ext */
 #define IDLIST_MIN_BLOCK_SIZE 8
 
+/*
+ * In a packed index, each record of a key is a block of increasing ids:
+ * the first id is stored as in a plain record, the next ones as varint
+ * coded deltas. A plain record is a block holding a single id.
+ * Blocks must stay below the lmdb maximum key size.
+ */
+#define IDL_PACKED_BLOCK_MAXSIZE 256
+#define IDL_PACKED_BLOCK_MAXIDS  (IDL_PACKED_BLOCK_MAXSIZE - sizeof(ID) + 1)
+
 typedef struct block
 {
     NIDS b_nmax;        /* max number of ids in this list  */
@@ -421,6 +436,8 @@ typedef struct attrcrypt_private   attrcrypt_private;
 #define INDEX_ATTR_SUBSTRBEGIN  "nsSubStrBegin"
 #define INDEX_ATTR_SUBSTRMIDDLE "nsSubStrMiddle"
 #define INDEX_ATTR_SUBSTREND    "nsSubStrEnd"
+#define INDEX_ATTR_IDLISTFORMAT "nsIndexIDListFormat"
+#define INDEX_ATTR_BLOOMFILTER  "nsIndexBloomFilter"
 
 #define INDEX_SUBSTRBEGIN  0
 #define INDEX_SUBSTRMIDDLE 1
@@ -489,6 +506,11 @@ struct attrinfo
                              */
     Slapi_Attr ai_sattr;                 /* interface to syntax and matching rule plugins */
     DataList *ai_idlistinfo;             /* fine grained id list */
+    int ai_idl_format;                   /* how the ids of a key are stored */
+#define IDL_FORMAT_PLAIN  0 /* one record per id */
+#define IDL_FORMAT_PACKED 1 /* packed id blocks */
+    int ai_bloom_filter;                 /* nsIndexBloomFilter: filter the equality keys */
+    struct ldbm_bloom *ai_bloom;         /* equality keys filter (see ldbm_bloom.c) */
 };
 
 struct id_array
@@ -565,6 +587,7 @@ struct ldbminfo
     dblayer_private *li_dblayer_private; /* session ptr for databases */
     void *li_dblayer_config;             /* pointer to specific backend implementation */
     char *li_backend_implement;          /* low layer backend implementation */
+    char *li_backup_base;                /* base backup directory while an incremental backup runs */
     int li_noparentcheck;                /* check if parent exists on add */
 
     /* db lock monitoring */
@@ -770,7 +793,8 @@ typedef struct ldbm_instance
     struct cache inst_cache; /* The entry cache for this instance. */
 
     PRLock *inst_nextid_mutex;
-    ID inst_nextid;
+    ID inst_nextid; /* handed out with atomic operations (see nextid.c) */
+    uint64_t inst_nextid_gen; /* changes each time inst_nextid is reset */
 
     PRCondVar *inst_indexer_cv; /* indexer thread cond var */
     PRThread *inst_indexer_tid; /* for the indexer thread */
@@ -783,6 +807,9 @@ typedef struct ldbm_instance
     int require_index;               /* set to 1 to require an index be used in search */
     int require_internalop_index;    /* set to 1 to require an index be used in an internal search */
     struct cache inst_dncache;       /* The dn cache for this instance. */
+    uint64_t inst_online_index_mark; /* last ID indexed by an online db2index */
+    uint64_t inst_online_index_last; /* last ID it has to index, 0 when idle */
+    char *inst_online_index_attrs;   /* attributes it builds (inst_config_mutex) */
 } ldbm_instance;
 
 /*
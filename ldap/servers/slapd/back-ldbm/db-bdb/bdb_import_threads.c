@@ -105,20 +105,26 @@ bdb_import_generate_tombstone_csn(Slapi_Entry *e)
 /* like the function in libldif, except this one doesn't need to use
  * FILE (which breaks on various platforms for >4G files or large numbers
  * of open files)
+ * The file is read in large chunks and entry boundaries are found with
+ * memchr. Each entry is then copied once into a buffer of its own size
+ * because str2entry needs a writable string that the worker frees.
  */
-#define LDIF_BUFFER_SIZE 8192
+#define LDIF_BUFFER_SIZE (1024 * 1024)
 
 typedef struct
 {
-    char *b;       /* buffer */
-    size_t size;   /* how full the buffer is */
-    size_t offset; /* where the current entry starts */
+    char *b;        /* buffer */
+    size_t bufsize; /* how large the buffer is */
+    size_t size;    /* how full the buffer is */
+    size_t offset;  /* where the current entry starts */
+    int eof;        /* nothing left to read after size */
 } ldif_context;
 
 static void
 bdb_import_init_ldif(ldif_context *c)
 {
-    c->size = c->offset = 0;
+    c->bufsize = c->size = c->offset = 0;
+    c->eof = 0;
     c->b = NULL;
 }
 
@@ -130,129 +136,108 @@ bdb_import_free_ldif(ldif_context *c)
     bdb_import_init_ldif(c);
 }
 
-static char *
-bdb_import_get_entry(ldif_context *c, int fd, int *lineno)
+/* Read more data after the current entry start. Returns -1 on error */
+static int
+bdb_import_fill_ldif(ldif_context *c, int fd)
 {
-    int ret;
-    int done = 0, got_lf = 0;
-    size_t bufSize = 0, bufOffset = 0, i;
-    char *buf = NULL;
-
-    while (!done) {
-
-        /* If there's no data in the buffer, get some */
-        if ((c->size == 0) || (c->offset == c->size)) {
-            /* Do we even have a buffer ? */
-            if (!c->b) {
-                c->b = slapi_ch_malloc(LDIF_BUFFER_SIZE);
-                if (!c->b)
-                    return NULL;
-            }
-            ret = read(fd, c->b, LDIF_BUFFER_SIZE);
-            if (ret < 0) {
-                /* Must be error */
-                goto error;
-            } else if (ret == 0) {
-                /* eof */
-                if (buf) {
-                    /* last entry */
-                    buf[bufOffset] = 0;
-                    return buf;
-                }
-                return NULL;
-            } else {
-                /* read completed OK */
-                c->size = ret;
-                c->offset = 0;
-            }
-        }
+    ssize_t ret;
+
+    if (c->offset > 0) {
+        memmove(c->b, c->b + c->offset, c->size - c->offset);
+        c->size -= c->offset;
+        c->offset = 0;
+    }
+    if (c->size == c->bufsize) {
+        /* the entry does not fit in the buffer */
+        c->bufsize = c->bufsize ? 2 * c->bufsize : LDIF_BUFFER_SIZE;
+        c->b = slapi_ch_realloc(c->b, c->bufsize);
+    }
+    do {
+        ret = read(fd, c->b + c->size, c->bufsize - c->size);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret == 0) {
+        c->eof = 1;
+    }
+    c->size += ret;
+    return 0;
+}
 
-        /* skip blank lines at start of entry */
-        if (bufOffset == 0) {
-            size_t n;
-            char *p;
+/*
+ * Find the blank line ending an entry, starting the search at 'from'.
+ * Returns the offset following the blank line, 0 if it is not in the buffer
+ */
+static size_t
+bdb_import_find_entry_end(ldif_context *c, size_t from)
+{
+    char *end = c->b + c->size;
+    char *p = c->b + from;
 
-            for (n = c->offset, p = c->b + n; n < c->size; n++, p++) {
-                if (!(*p == '\r' || *p == '\n' || *p == ' ' || *p == '\t'))
-                    break;
-            }
-            c->offset = n;
-            if (c->offset == c->size)
-                continue;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        if (++p >= end) {
+            break;
+        }
+        if (*p == '\n') {
+            return p + 1 - c->b;
         }
+        if (*p == '\r' && p + 1 < end && p[1] == '\n') {
+            return p + 2 - c->b;
+        }
+    }
+    return 0;
+}
 
-        i = c->offset;
-        while (!done && (i < c->size)) {
-            /* scan forward in the buffer, looking for the end of the entry */
-            while ((i < c->size) && (c->b[i] != '\n'))
-                i++;
+static char *
+bdb_import_get_entry(ldif_context *c, int fd, int *lineno)
+{
+    size_t scanned = 0; /* bytes after offset known not to hold the entry end */
+    size_t end = 0;
+    size_t len;
+    char *buf, *p;
 
-            if ((i < c->size) && (c->b[i] == '\n')) {
-                if (got_lf && ((i == 0) || ((i == 1) && (c->b[0] == '\r')))) {
-                    /* saw an lf at the end of the last buffer */
-                    i++, (*lineno)++;
-                    done = 1;
-                    got_lf = 0;
-                    break;
-                }
-                got_lf = 0;
-                (*lineno)++;
-                /* is this the end?  (need another linefeed) */
-                if (++i < c->size) {
-                    if (c->b[i] == '\n') {
-                        /* gotcha! */
-                        i++, (*lineno)++;
-                        done = 1;
-                    } else if (c->b[i] == '\r') {
-                        if (++i < c->size) {
-                            if (c->b[i] == '\n') {
-                                /* gotcha! (nt) */
-                                i++, (*lineno)++;
-                                done = 1;
-                            }
-                        } else {
-                            got_lf = 1;
-                        }
-                    }
-                } else {
-                    /* lf at the very end of the buffer */
-                    got_lf = 1;
-                }
+    for (;;) {
+        /* skip blank lines at start of entry */
+        while (c->offset < c->size &&
+               (c->b[c->offset] == '\r' || c->b[c->offset] == '\n' ||
+                c->b[c->offset] == ' ' || c->b[c->offset] == '\t')) {
+            c->offset++;
+        }
+        if (c->offset < c->size) {
+            end = bdb_import_find_entry_end(c, c->offset + scanned);
+            if (end) {
+                break;
             }
+            /* the end may straddle the buffer end: rescan the last 2 bytes */
+            scanned = c->size - c->offset;
+            scanned = (scanned > 2) ? scanned - 2 : 0;
         }
-
-        /* copy what we did so far into the output buffer */
-        /* (first, make sure the output buffer is large enough) */
-        if (bufSize - bufOffset < i - c->offset + 1) {
-            char *newbuf = NULL;
-            size_t newsize = (buf ? bufSize * 2 : LDIF_BUFFER_SIZE);
-
-            newbuf = slapi_ch_malloc(newsize);
-            if (!newbuf)
-                goto error;
-            /* copy over the old data (if there was any) */
-            if (buf) {
-                memmove(newbuf, buf, bufOffset);
-                slapi_ch_free((void **)&buf);
+        if (c->eof) {
+            if (c->offset == c->size) {
+                /* ready for the next file */
+                c->size = c->offset = 0;
+                c->eof = 0;
+                return NULL;
             }
-            buf = newbuf;
-            bufSize = newsize;
+            /* last entry */
+            end = c->size;
+            break;
+        }
+        if (bdb_import_fill_ldif(c, fd)) {
+            return NULL;
         }
-        if (!buf)        /*  This test is always false but make GCC Static Analyzer happy */
-            goto error;
-        memmove(buf + bufOffset, c->b + c->offset, i - c->offset);
-        bufOffset += (i - c->offset);
-        c->offset = i;
     }
 
-    /* add terminating NUL char */
-    buf[bufOffset] = 0;
+    len = end - c->offset;
+    buf = slapi_ch_malloc(len + 1);
+    memcpy(buf, c->b + c->offset, len);
+    buf[len] = 0;
+    c->offset = end;
+    for (p = buf; (p = memchr(p, '\n', buf + len - p)) != NULL; p++) {
+        (*lineno)++;
+    }
     return buf;
-
-error:
-    if (buf)
-        slapi_ch_free((void **)&buf);
-    return NULL;
 }
 
 
@@ -445,6 +430,10 @@ bdb_import_producer(void *param)
             } else {
                 int o_flag = O_RDONLY;
                 fd = bdb_open_huge_file(curr_filename, o_flag, 0);
+                if (fd >= 0) {
+                    /* the file is read once, from start to end */
+                    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                }
             }
             if (fd < 0) {
                 import_log_notice(job, SLAPI_LOG_ERR, "bdb_import_producer",
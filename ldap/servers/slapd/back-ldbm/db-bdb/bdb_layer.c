@@ -1757,7 +1757,7 @@ bdb_instance_start(backend *be, int mode)
      * check if nextid is valid: it only matters if the database is either
      * being imported or is in normal mode
      */
-    if (inst->inst_nextid > MAXID && !(mode & DBLAYER_EXPORT_MODE)) {
+    if (__atomic_load_n(&inst->inst_nextid, __ATOMIC_RELAXED) > MAXID && !(mode & DBLAYER_EXPORT_MODE)) {
         slapi_log_err(SLAPI_LOG_CRIT, "bdb_instance_start", "Backend '%s' "
                                                                 "has no IDs left. DATABASE MUST BE REBUILT.\n",
                       be->be_name);
@@ -5065,6 +5065,15 @@ bdb_backup(struct ldbminfo *li, char *dest_dir, Slapi_Task *task)
     priv = li->li_dblayer_private;
     PR_ASSERT(NULL != priv);
 
+    if (li->li_backup_base) {
+        slapi_log_err(SLAPI_LOG_ERR,
+                      "dblayer_backup", "Incremental backup is not supported with bdb\n");
+        if (task) {
+            slapi_task_log_notice(task, "Incremental backup is not supported with bdb");
+        }
+        return return_value;
+    }
+
     db_dir = bdb_get_db_dir(li);
 
     home_dir = bdb_get_home_dir(li, NULL);
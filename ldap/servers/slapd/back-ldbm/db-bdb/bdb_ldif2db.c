@@ -2185,6 +2185,9 @@ err_min:
     instance_set_not_busy(inst);
 
     if (return_value == 0) {
+        if (!run_from_cmdline) {
+            ldbm_bloom_build_instance(inst);
+        }
         if (task) {
             slapi_task_log_status(task, "%s: Finished indexing.",
                     inst->inst_name);
@@ -165,12 +165,21 @@ bdb_verify(Slapi_PBlock *pb)
     int rval_main = 0;
     char **instance_names = NULL;
     char *dbdir = NULL;
+    Slapi_Task *task = NULL;
+    int task_flags = 0;
 
     slapi_log_err(SLAPI_LOG_TRACE, "bdb_verify", "Verifying db files...\n");
     slapi_pblock_get(pb, SLAPI_BACKEND_INSTANCE_NAME, &instance_names);
     slapi_pblock_get(pb, SLAPI_SEQ_TYPE, &verbose);
     slapi_pblock_get(pb, SLAPI_PLUGIN_PRIVATE, &li);
     slapi_pblock_get(pb, SLAPI_DBVERIFY_DBDIR, &dbdir);
+    slapi_pblock_get(pb, SLAPI_TASK_FLAGS, &task_flags);
+    slapi_pblock_get(pb, SLAPI_BACKEND_TASK, &task);
+    if (!(task_flags & SLAPI_TASK_RUNNING_FROM_COMMANDLINE)) {
+        slapi_log_err(SLAPI_LOG_ERR, "bdb_verify", "Online verify is not supported with bdb\n");
+        slapi_task_log_notice(task, "Online verify is not supported with bdb");
+        return rval;
+    }
     bdb_config_load_dse_info(li);
     bdb_config_internal_set(li, CONFIG_DB_TRANSACTION_LOGGING, "off");
 
@@ -0,0 +1,572 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "mdb_layer.h"
+
+/*
+ * Full and incremental backup of the database map.
+ *
+ * The map is copied by mdb_env_copyfd2 into a pipe. A reader thread splits
+ * the copy in chunks and computes a checksum for each chunk. The checksums
+ * are stored in DBMAPSUMFILE next to the copy.
+ * A full backup writes every chunk in DBMAPFILE.
+ * An incremental backup compares each chunk with the checksums of its base
+ * backup and only writes the chunks that changed in DBMAPDELTAFILE.
+ * A non compacting copy keeps every page at its offset, so the map is
+ * restored by rebuilding the base map then overwriting the changed chunks.
+ * The restored map is then checked against the backup checksums.
+ */
+
+#define DBMDB_BACKUP_CHUNK      (64 * 1024)
+#define DBMDB_BACKUP_MAX_CHAIN  64           /* Max number of incremental backups on top of a full one */
+#define DBMDB_SUMS_MAGIC        "MDBSUMS1"
+#define DBMDB_DELTA_MAGIC       "MDBDELT1"
+
+/* DBMAPSUMFILE header (followed by nbchunks checksums) */
+typedef struct {
+    char magic[8];
+    uint64_t chunksize;
+    uint64_t mapsize;             /* Size of the map copy */
+    uint64_t nbchunks;
+} dbmdb_sums_hdr_t;
+
+/* DBMAPDELTAFILE header (followed by the base directory then by the records) */
+typedef struct {
+    char magic[8];
+    uint64_t chunksize;
+    uint64_t mapsize;             /* Size of the map copy */
+    uint64_t basesum;             /* Checksum of the base backup checksums */
+    uint64_t baselen;             /* Length of the base backup directory */
+} dbmdb_delta_hdr_t;
+
+/* DBMAPDELTAFILE record (followed by len bytes of data) */
+typedef struct {
+    uint64_t chunk;
+    uint64_t len;
+    uint64_t sum;
+} dbmdb_delta_rec_t;
+
+typedef struct {
+    dbmdb_sums_hdr_t hdr;
+    uint64_t *sums;
+    uint64_t maxchunks;
+} dbmdb_sums_t;
+
+typedef struct {
+    int fd;                       /* Read end of the pipe */
+    int outfd;                    /* DBMAPFILE or DBMAPDELTAFILE */
+    dbmdb_sums_t *base;           /* Base backup checksums (incremental backup) */
+    dbmdb_sums_t sums;            /* Checksums of the new copy */
+    uint64_t nbwritten;           /* Number of chunks written */
+    int rc;
+} dbmdb_backup_ctx_t;
+
+/* 64 bits checksum of a chunk */
+static uint64_t
+dbmdb_backup_checksum(const char *data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ len;
+    uint64_t w;
+    size_t i;
+
+    for (i = 0; i + sizeof w <= len; i += sizeof w) {
+        memcpy(&w, data + i, sizeof w);
+        h ^= w;
+        h *= 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    for (; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* Read up to len bytes: returns less than len only at end of file, -1 on error */
+static ssize_t
+dbmdb_backup_read(int fd, void *buf, size_t len)
+{
+    size_t done = 0;
+    ssize_t rc;
+
+    while (done < len) {
+        rc = read(fd, (char *)buf + done, len - done);
+        if (rc == 0) {
+            break;
+        }
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += rc;
+    }
+    return done;
+}
+
+/* Write len bytes: returns 0 or an errno */
+static int
+dbmdb_backup_write(int fd, const void *buf, size_t len)
+{
+    size_t done = 0;
+    ssize_t rc;
+
+    while (done < len) {
+        rc = write(fd, (const char *)buf + done, len - done);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        done += rc;
+    }
+    return 0;
+}
+
+static void
+dbmdb_backup_free_sums(dbmdb_sums_t *sums)
+{
+    slapi_ch_free((void **)&sums->sums);
+    sums->maxchunks = 0;
+}
+
+static int
+dbmdb_backup_read_sums(const char *dir, dbmdb_sums_t *sums)
+{
+    char *path = slapi_ch_smprintf("%s/%s", dir, DBMAPSUMFILE);
+    size_t len;
+    int rc = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        rc = errno;
+        goto done;
+    }
+    if (dbmdb_backup_read(fd, &sums->hdr, sizeof sums->hdr) != sizeof sums->hdr ||
+        memcmp(sums->hdr.magic, DBMDB_SUMS_MAGIC, sizeof sums->hdr.magic) ||
+        sums->hdr.chunksize != DBMDB_BACKUP_CHUNK) {
+        rc = EINVAL;
+        goto done;
+    }
+    len = sums->hdr.nbchunks * sizeof(uint64_t);
+    sums->maxchunks = sums->hdr.nbchunks;
+    sums->sums = (uint64_t *)slapi_ch_malloc(len ? len : 1);
+    if (dbmdb_backup_read(fd, sums->sums, len) != len) {
+        rc = EINVAL;
+    }
+done:
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup_read_sums",
+                      "Failed to read backup checksums file %s. err=%d %s\n",
+                      path, rc, strerror(rc));
+        dbmdb_backup_free_sums(sums);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    slapi_ch_free_string(&path);
+    return rc;
+}
+
+static int
+dbmdb_backup_write_sums(const char *dir, dbmdb_sums_t *sums, int mode)
+{
+    char *path = slapi_ch_smprintf("%s/%s", dir, DBMAPSUMFILE);
+    int rc = 0;
+    int fd;
+
+    memcpy(sums->hdr.magic, DBMDB_SUMS_MAGIC, sizeof sums->hdr.magic);
+    sums->hdr.chunksize = DBMDB_BACKUP_CHUNK;
+    fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, mode);
+    if (fd < 0) {
+        rc = errno;
+    } else {
+        rc = dbmdb_backup_write(fd, &sums->hdr, sizeof sums->hdr);
+        if (!rc) {
+            rc = dbmdb_backup_write(fd, sums->sums, sums->hdr.nbchunks * sizeof(uint64_t));
+        }
+        if (!rc && fsync(fd)) {
+            rc = errno;
+        }
+        close(fd);
+    }
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup_write_sums",
+                      "Failed to write backup checksums file %s. err=%d %s\n",
+                      path, rc, strerror(rc));
+    }
+    slapi_ch_free_string(&path);
+    return rc;
+}
+
+static uint64_t
+dbmdb_backup_sums_checksum(dbmdb_sums_t *sums)
+{
+    return dbmdb_backup_checksum((const char *)sums->sums, sums->hdr.nbchunks * sizeof(uint64_t));
+}
+
+/* Consume the map copy from the pipe */
+static void *
+dbmdb_backup_reader(void *arg)
+{
+    dbmdb_backup_ctx_t *bctx = arg;
+    char *buf = slapi_ch_malloc(DBMDB_BACKUP_CHUNK);
+    dbmdb_sums_t *base = bctx->base;
+    dbmdb_delta_rec_t rec = {0};
+    uint64_t chunk = 0;
+    uint64_t sum;
+    ssize_t len;
+
+    /* Always read the whole copy so that mdb_env_copyfd2 does not block even if a write failed */
+    while ((len = dbmdb_backup_read(bctx->fd, buf, DBMDB_BACKUP_CHUNK)) > 0) {
+        sum = dbmdb_backup_checksum(buf, len);
+        if (chunk >= bctx->sums.maxchunks) {
+            bctx->sums.maxchunks = bctx->sums.maxchunks ? 2 * bctx->sums.maxchunks : 1024;
+            bctx->sums.sums = (uint64_t *)slapi_ch_realloc((char *)bctx->sums.sums,
+                                                           bctx->sums.maxchunks * sizeof(uint64_t));
+        }
+        bctx->sums.sums[chunk] = sum;
+        if (bctx->rc == 0) {
+            if (!base) {
+                bctx->rc = dbmdb_backup_write(bctx->outfd, buf, len);
+                bctx->nbwritten++;
+            } else if (chunk >= base->hdr.nbchunks || base->sums[chunk] != sum) {
+                rec.chunk = chunk;
+                rec.len = len;
+                rec.sum = sum;
+                bctx->rc = dbmdb_backup_write(bctx->outfd, &rec, sizeof rec);
+                if (bctx->rc == 0) {
+                    bctx->rc = dbmdb_backup_write(bctx->outfd, buf, len);
+                }
+                bctx->nbwritten++;
+            }
+        }
+        bctx->sums.hdr.mapsize += len;
+        chunk++;
+    }
+    if (len < 0 && bctx->rc == 0) {
+        bctx->rc = errno;
+    }
+    bctx->sums.hdr.nbchunks = chunk;
+    slapi_ch_free_string(&buf);
+    return NULL;
+}
+
+/*
+ * Copy the database map in dest_dir.
+ * If base_dir is set, only the chunks that changed since the backup in
+ * base_dir are stored.
+ */
+int
+dbmdb_backup_map(dbmdb_ctx_t *ctx, const char *dest_dir, const char *base_dir, int mode, Slapi_Task *task)
+{
+    dbmdb_backup_ctx_t bctx = {0};
+    dbmdb_sums_t base = {0};
+    dbmdb_delta_hdr_t dhdr = {0};
+    int pipefd[2] = {-1, -1};
+    char *path = NULL;
+    pthread_t tid;
+    int rc = 0;
+
+    bctx.outfd = -1;
+    if (base_dir) {
+        rc = dbmdb_backup_read_sums(base_dir, &base);
+        if (rc) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup_map",
+                          "%s cannot be used as the base of an incremental backup.\n", base_dir);
+            if (task) {
+                slapi_task_log_notice(task, "%s cannot be used as the base of an incremental backup.", base_dir);
+            }
+            return rc;
+        }
+        bctx.base = &base;
+    }
+
+    path = slapi_ch_smprintf("%s/%s", dest_dir, base_dir ? DBMAPDELTAFILE : DBMAPFILE);
+    bctx.outfd = open(path, O_CREAT | O_WRONLY | O_TRUNC, mode);
+    if (bctx.outfd < 0) {
+        rc = errno;
+        goto done;
+    }
+    if (base_dir) {
+        /* mapsize is only known at the end of the copy: the header is rewritten then */
+        memcpy(dhdr.magic, DBMDB_DELTA_MAGIC, sizeof dhdr.magic);
+        dhdr.chunksize = DBMDB_BACKUP_CHUNK;
+        dhdr.basesum = dbmdb_backup_sums_checksum(&base);
+        dhdr.baselen = strlen(base_dir);
+        rc = dbmdb_backup_write(bctx.outfd, &dhdr, sizeof dhdr);
+        if (rc == 0) {
+            rc = dbmdb_backup_write(bctx.outfd, base_dir, dhdr.baselen);
+        }
+        if (rc) {
+            goto done;
+        }
+    }
+
+    if (pipe(pipefd)) {
+        rc = errno;
+        goto done;
+    }
+    bctx.fd = pipefd[0];
+    rc = pthread_create(&tid, NULL, dbmdb_backup_reader, &bctx);
+    if (rc) {
+        goto done;
+    }
+    rc = mdb_env_copyfd2(ctx->env, pipefd[1], 0);
+    close(pipefd[1]);
+    pipefd[1] = -1;
+    pthread_join(tid, NULL);
+    if (rc == 0) {
+        rc = bctx.rc;
+    }
+
+    if (rc == 0 && base_dir) {
+        dhdr.mapsize = bctx.sums.hdr.mapsize;
+        if (pwrite(bctx.outfd, &dhdr, sizeof dhdr, 0) != sizeof dhdr) {
+            rc = errno;
+        }
+    }
+    if (rc == 0 && fsync(bctx.outfd)) {
+        rc = errno;
+    }
+    if (rc == 0) {
+        rc = dbmdb_backup_write_sums(dest_dir, &bctx.sums, mode);
+    }
+    if (rc == 0) {
+        slapi_log_err(SLAPI_LOG_INFO, "dbmdb_backup_map",
+                      "Backed up %" PRIu64 " of %" PRIu64 " chunks of the database map to %s\n",
+                      bctx.nbwritten, bctx.sums.hdr.nbchunks, path);
+        if (task) {
+            slapi_task_log_notice(task, "Backed up %" PRIu64 " of %" PRIu64 " chunks of the database map to %s",
+                                  bctx.nbwritten, bctx.sums.hdr.nbchunks, path);
+        }
+    }
+
+done:
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup_map",
+                      "Failed to backup the database map to %s. err=%d %s\n",
+                      path, rc, mdb_strerror(rc));
+    }
+    if (pipefd[0] >= 0) {
+        close(pipefd[0]);
+    }
+    if (pipefd[1] >= 0) {
+        close(pipefd[1]);
+    }
+    if (bctx.outfd >= 0) {
+        close(bctx.outfd);
+    }
+    dbmdb_backup_free_sums(&bctx.sums);
+    dbmdb_backup_free_sums(&base);
+    slapi_ch_free_string(&path);
+    return rc;
+}
+
+/* Tells whether the backup in src_dir is an incremental one */
+int
+dbmdb_backup_is_incremental(const char *src_dir)
+{
+    char *path = slapi_ch_smprintf("%s/%s", src_dir, DBMAPDELTAFILE);
+    struct stat sbuf;
+    int rc = (stat(path, &sbuf) == 0);
+
+    slapi_ch_free_string(&path);
+    return rc;
+}
+
+/* Rebuild the map file dest from the backup in src_dir and from its bases */
+static int
+dbmdb_restore_map_file(const char *src_dir, char *dest, int mode, int depth, Slapi_Task *task)
+{
+    dbmdb_delta_hdr_t dhdr = {0};
+    dbmdb_delta_rec_t rec = {0};
+    dbmdb_sums_t base = {0};
+    char *buf = NULL;
+    char *base_dir = NULL;
+    char *path = NULL;
+    int destfd = -1;
+    int rc = 0;
+    int fd = -1;
+
+    if (!dbmdb_backup_is_incremental(src_dir)) {
+        path = slapi_ch_smprintf("%s/%s", src_dir, DBMAPFILE);
+        rc = dbmdb_copyfile(path, dest, PR_TRUE, mode) ? EIO : 0;
+        goto done;
+    }
+    if (depth >= DBMDB_BACKUP_MAX_CHAIN) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore_map",
+                      "Too many incremental backups on top of each other (in %s).\n", src_dir);
+        rc = EINVAL;
+        goto done;
+    }
+
+    path = slapi_ch_smprintf("%s/%s", src_dir, DBMAPDELTAFILE);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        rc = errno;
+        goto done;
+    }
+    if (dbmdb_backup_read(fd, &dhdr, sizeof dhdr) != sizeof dhdr ||
+        memcmp(dhdr.magic, DBMDB_DELTA_MAGIC, sizeof dhdr.magic) ||
+        dhdr.chunksize != DBMDB_BACKUP_CHUNK || dhdr.baselen >= MAXPATHLEN) {
+        rc = EINVAL;
+        goto done;
+    }
+    base_dir = slapi_ch_calloc(1, dhdr.baselen + 1);
+    if (dbmdb_backup_read(fd, base_dir, dhdr.baselen) != dhdr.baselen) {
+        rc = EINVAL;
+        goto done;
+    }
+
+    /* Check that the base is the one the delta was computed from */
+    rc = dbmdb_backup_read_sums(base_dir, &base);
+    if (rc == 0 && dbmdb_backup_sums_checksum(&base) != dhdr.basesum) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore_map",
+                      "Backup %s is not the base of incremental backup %s.\n", base_dir, src_dir);
+        rc = EINVAL;
+    }
+    if (rc == 0) {
+        rc = dbmdb_restore_map_file(base_dir, dest, mode, depth + 1, task);
+    }
+    if (rc) {
+        goto done;
+    }
+    slapi_log_err(SLAPI_LOG_INFO, "dbmdb_restore_map", "Applying incremental backup %s\n", src_dir);
+    if (task) {
+        slapi_task_log_notice(task, "Applying incremental backup %s", src_dir);
+    }
+
+    destfd = open(dest, O_WRONLY);
+    if (destfd < 0) {
+        rc = errno;
+        goto done;
+    }
+    buf = slapi_ch_malloc(DBMDB_BACKUP_CHUNK);
+    while ((rc = dbmdb_backup_read(fd, &rec, sizeof rec)) == sizeof rec) {
+        if (rec.len > DBMDB_BACKUP_CHUNK ||
+            dbmdb_backup_read(fd, buf, rec.len) != rec.len ||
+            dbmdb_backup_checksum(buf, rec.len) != rec.sum) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore_map",
+                          "Incremental backup %s is corrupted (chunk %" PRIu64 ").\n", path, rec.chunk);
+            rc = EINVAL;
+            goto done;
+        }
+        if (pwrite(destfd, buf, rec.len, rec.chunk * DBMDB_BACKUP_CHUNK) != rec.len) {
+            rc = errno;
+            goto done;
+        }
+    }
+    if (rc != 0) {
+        /* A partial record */
+        rc = EINVAL;
+        goto done;
+    }
+    if (ftruncate(destfd, dhdr.mapsize) || fsync(destfd)) {
+        rc = errno;
+    }
+
+done:
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore_map",
+                      "Failed to restore the database map from %s. err=%d %s\n",
+                      src_dir, rc, strerror(rc));
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (destfd >= 0) {
+        close(destfd);
+    }
+    dbmdb_backup_free_sums(&base);
+    slapi_ch_free_string(&buf);
+    slapi_ch_free_string(&base_dir);
+    slapi_ch_free_string(&path);
+    return rc;
+}
+
+/* Check the restored map against the checksums of the backup */
+static int
+dbmdb_restore_verify_map(const char *src_dir, const char *dest)
+{
+    dbmdb_sums_t sums = {0};
+    char *buf = NULL;
+    uint64_t chunk = 0;
+    uint64_t size = 0;
+    ssize_t len;
+    int rc = 0;
+    int fd = -1;
+
+    rc = dbmdb_backup_read_sums(src_dir, &sums);
+    if (rc) {
+        goto done;
+    }
+    fd = open(dest, O_RDONLY);
+    if (fd < 0) {
+        rc = errno;
+        goto done;
+    }
+    buf = slapi_ch_malloc(DBMDB_BACKUP_CHUNK);
+    while ((len = dbmdb_backup_read(fd, buf, DBMDB_BACKUP_CHUNK)) > 0) {
+        if (chunk >= sums.hdr.nbchunks || dbmdb_backup_checksum(buf, len) != sums.sums[chunk]) {
+            rc = EINVAL;
+            break;
+        }
+        size += len;
+        chunk++;
+    }
+    if (len < 0) {
+        rc = errno;
+    } else if (rc == 0 && (chunk != sums.hdr.nbchunks || size != sums.hdr.mapsize)) {
+        rc = EINVAL;
+    }
+    if (rc == EINVAL) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore_verify_map",
+                      "Restored database map %s does not match the checksums of backup %s (chunk %" PRIu64 ").\n",
+                      dest, src_dir, chunk);
+    }
+
+done:
+    if (fd >= 0) {
+        close(fd);
+    }
+    dbmdb_backup_free_sums(&sums);
+    slapi_ch_free_string(&buf);
+    return rc;
+}
+
+/* Restore the database map from a full or from an incremental backup */
+int
+dbmdb_restore_map(struct ldbminfo *li, const char *src_dir, Slapi_Task *task)
+{
+    char *dest = slapi_ch_smprintf("%s/%s", MDB_CONFIG(li)->home, DBMAPFILE);
+    char *sums = slapi_ch_smprintf("%s/%s", src_dir, DBMAPSUMFILE);
+    struct stat sbuf;
+    int rc;
+
+    rc = dbmdb_restore_map_file(src_dir, dest, li->li_mode, 0, task);
+    /* Backups done before the checksums were introduced cannot be verified */
+    if (rc == 0 && stat(sums, &sbuf) == 0) {
+        rc = dbmdb_restore_verify_map(src_dir, dest);
+    }
+    if (rc) {
+        if (task) {
+            slapi_task_log_notice(task, "Restore: Failed to restore the database map from %s.", src_dir);
+        }
+    }
+    slapi_ch_free_string(&sums);
+    slapi_ch_free_string(&dest);
+    return rc;
+}
@@ -62,6 +62,7 @@ static flagsdesc_t mdb_dbi_flags_desc[] = {
     { "MDB_OPEN_DIRTY_DBI", MDB_OPEN_DIRTY_DBI},
     { "MDB_MARK_DIRTY_DBI", MDB_MARK_DIRTY_DBI},
     { "MDB_TRUNCATE_DBI", MDB_TRUNCATE_DBI},
+    { "MDB_IDL_PACKED_DBI", MDB_IDL_PACKED_DBI},
     { 0 }
 };
 
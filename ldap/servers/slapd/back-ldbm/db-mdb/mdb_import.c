@@ -692,6 +692,8 @@ dbmdb_import_all_done(ImportJob *job, int ret)
             /* Reset USN slapi_counter with the last key of the entryUSN index */
             ldbm_set_last_usn(inst->inst_be);
 
+            ldbm_bloom_build_instance(inst);
+
             /* bring backend online again */
             slapi_mtn_be_enable(inst->inst_be);
         }
@@ -744,6 +746,11 @@ dbmdb_public_dbmdb_import_main(void *arg)
     PR_ASSERT(inst != NULL);
     beginning = slapi_current_rel_time_t();
 
+    if (job->flags & FLAG_ONLINE) {
+        /* The indexes are rewritten: the bloom filters are rebuilt once it is done */
+        ldbm_bloom_invalidate_instance(inst);
+    }
+
     /* Decide which indexes are needed */
     if (job->flags & FLAG_INDEX_ATTRS) {
         /* Here, we get an AVL tree which contains nodes for all attributes
@@ -58,6 +58,17 @@ typedef struct {
     volatile WriterQueueData_t *outlist;    /* processing list */
 } WriterQueue_t;
 
+/* Index records kept by the writer thread to be written in sorted order */
+typedef struct {
+    WriterQueueData_t **recs;   /* records not yet spilled */
+    size_t nbrecs;
+    size_t maxrecs;
+    size_t size;                /* memory used by recs */
+    size_t maxsize;             /* recs are spilled in a run past that size */
+    FILE **runs;                /* sorted runs spilled on disk */
+    int nbruns;
+} ImportSorter_t;
+
 
 #define IQ_GET_SLOT(q, idx, _struct)	((_struct *)(&(q)->slots[(idx)*(q)->slot_size]))
 
@@ -141,6 +152,7 @@ struct importctx {
     struct backentry *(*prepare_worker_entry_fn)(WorkerQueueData_t *wqelmnt);
     void (*producer_fn)(void *arg);
     ImportWorkerInfo writer;
+    ImportSorter_t sorter;  /* only used by the writer thread */
     ImportWorkerGlobalContext_t wgc;
     char **indexAttrs;  /* reindex index to rebuild */
     ID idsuffix;
@@ -196,20 +196,26 @@ dbmdb_import_generate_tombstone_csn(Slapi_Entry *e)
 /* like the function in libldif, except this one doesn't need to use
  * FILE (which breaks on various platforms for >4G files or large numbers
  * of open files)
+ * The file is read in large chunks and entry boundaries are found with
+ * memchr. Each entry is then copied once into a buffer of its own size
+ * because str2entry needs a writable string that the worker frees.
  */
-#define LDIF_BUFFER_SIZE 8192
+#define LDIF_BUFFER_SIZE (1024 * 1024)
 
 typedef struct
 {
-    char *b;       /* buffer */
-    size_t size;   /* how full the buffer is */
-    size_t offset; /* where the current entry starts */
+    char *b;        /* buffer */
+    size_t bufsize; /* how large the buffer is */
+    size_t size;    /* how full the buffer is */
+    size_t offset;  /* where the current entry starts */
+    int eof;        /* nothing left to read after size */
 } ldif_context;
 
 static void
 dbmdb_import_init_ldif(ldif_context *c)
 {
-    c->size = c->offset = 0;
+    c->bufsize = c->size = c->offset = 0;
+    c->eof = 0;
     c->b = NULL;
 }
 
@@ -221,132 +227,108 @@ dbmdb_import_free_ldif(ldif_context *c)
     dbmdb_import_init_ldif(c);
 }
 
-static char *
-dbmdb_import_get_entry(ldif_context *c, int fd, int *lineno)
+/* Read more data after the current entry start. Returns -1 on error */
+static int
+dbmdb_import_fill_ldif(ldif_context *c, int fd)
 {
-    int ret;
-    int done = 0, got_lf = 0;
-    size_t bufSize = 0, bufOffset = 0, i;
-    char *buf = NULL;
-
-    while (!done) {
-        /* If there's no data in the buffer, get some */
-        if ((c->size == 0) || (c->offset == c->size)) {
-            /* Do we even have a buffer ? */
-            if (!c->b) {
-                c->b = slapi_ch_malloc(LDIF_BUFFER_SIZE);
-                if (!c->b)
-                    return NULL;
-            }
-            ret = read(fd, c->b, LDIF_BUFFER_SIZE);
-            if (ret < 0) {
-                /* Must be error */
-                goto error;
-            } else if (ret == 0) {
-                /* eof */
-                if (buf) {
-                    /* last entry */
-                    buf[bufOffset] = 0;
-                    return buf;
-                }
-                return NULL;
-            } else {
-                /* read completed OK */
-                c->size = ret;
-                c->offset = 0;
-            }
-        }
+    ssize_t ret;
 
-        /* skip blank lines at start of entry */
-        if (bufOffset == 0) {
-            size_t n;
-            char *p;
-
-            for (n = c->offset, p = c->b + n; n < c->size; n++, p++) {
-                if (!(*p == '\r' || *p == '\n' || *p == ' ' || *p == '\t'))
-                    break;
-            }
-            c->offset = n;
-            if (c->offset == c->size)
-                continue;
-        }
+    if (c->offset > 0) {
+        memmove(c->b, c->b + c->offset, c->size - c->offset);
+        c->size -= c->offset;
+        c->offset = 0;
+    }
+    if (c->size == c->bufsize) {
+        /* the entry does not fit in the buffer */
+        c->bufsize = c->bufsize ? 2 * c->bufsize : LDIF_BUFFER_SIZE;
+        c->b = slapi_ch_realloc(c->b, c->bufsize);
+    }
+    do {
+        ret = read(fd, c->b + c->size, c->bufsize - c->size);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret == 0) {
+        c->eof = 1;
+    }
+    c->size += ret;
+    return 0;
+}
 
-        i = c->offset;
-        while (!done && (i < c->size)) {
-            /* scan forward in the buffer, looking for the end of the entry */
-            while ((i < c->size) && (c->b[i] != '\n'))
-                i++;
+/*
+ * Find the blank line ending an entry, starting the search at 'from'.
+ * Returns the offset following the blank line, 0 if it is not in the buffer
+ */
+static size_t
+dbmdb_import_find_entry_end(ldif_context *c, size_t from)
+{
+    char *end = c->b + c->size;
+    char *p = c->b + from;
 
-            if ((i < c->size) && (c->b[i] == '\n')) {
-                if (got_lf && ((i == 0) || ((i == 1) && (c->b[0] == '\r')))) {
-                    /* saw an lf at the end of the last buffer */
-                    i++, (*lineno)++;
-                    done = 1;
-                    got_lf = 0;
-                    break;
-                }
-                got_lf = 0;
-                (*lineno)++;
-                /* is this the end?  (need another linefeed) */
-                if (++i < c->size) {
-                    if (c->b[i] == '\n') {
-                        /* gotcha! */
-                        i++, (*lineno)++;
-                        done = 1;
-                    } else if (c->b[i] == '\r') {
-                        if (++i < c->size) {
-                            if (c->b[i] == '\n') {
-                                /* gotcha! (nt) */
-                                i++, (*lineno)++;
-                                done = 1;
-                            }
-                        } else {
-                            got_lf = 1;
-                        }
-                    }
-                } else {
-                    /* lf at the very end of the buffer */
-                    got_lf = 1;
-                }
-            }
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        if (++p >= end) {
+            break;
+        }
+        if (*p == '\n') {
+            return p + 1 - c->b;
         }
+        if (*p == '\r' && p + 1 < end && p[1] == '\n') {
+            return p + 2 - c->b;
+        }
+    }
+    return 0;
+}
 
-        /* copy what we did so far into the output buffer */
-        /* (first, make sure the output buffer is large enough) */
-        if (bufSize - bufOffset < i - c->offset + 1) {
-            char *newbuf = NULL;
-            size_t newsize = (buf ? bufSize * 2 : LDIF_BUFFER_SIZE);
+static char *
+dbmdb_import_get_entry(ldif_context *c, int fd, int *lineno)
+{
+    size_t scanned = 0; /* bytes after offset known not to hold the entry end */
+    size_t end = 0;
+    size_t len;
+    char *buf, *p;
 
-            newbuf = slapi_ch_malloc(newsize);
-            if (!newbuf)
-                goto error;
-            /* copy over the old data (if there was any) */
-            if (buf) {
-                memmove(newbuf, buf, bufOffset);
-                slapi_ch_free((void **)&buf);
+    for (;;) {
+        /* skip blank lines at start of entry */
+        while (c->offset < c->size &&
+               (c->b[c->offset] == '\r' || c->b[c->offset] == '\n' ||
+                c->b[c->offset] == ' ' || c->b[c->offset] == '\t')) {
+            c->offset++;
+        }
+        if (c->offset < c->size) {
+            end = dbmdb_import_find_entry_end(c, c->offset + scanned);
+            if (end) {
+                break;
+            }
+            /* the end may straddle the buffer end: rescan the last 2 bytes */
+            scanned = c->size - c->offset;
+            scanned = (scanned > 2) ? scanned - 2 : 0;
+        }
+        if (c->eof) {
+            if (c->offset == c->size) {
+                /* ready for the next file */
+                c->size = c->offset = 0;
+                c->eof = 0;
+                return NULL;
             }
-            buf = newbuf;
-            bufSize = newsize;
+            /* last entry */
+            end = c->size;
+            break;
         }
-        if (!buf) {
-            /* Test always false (buf get initialized in first iteration
-             * but it makes gcc -fanalyzer happy
-             */
+        if (dbmdb_import_fill_ldif(c, fd)) {
             return NULL;
         }
-        memmove(buf + bufOffset, c->b + c->offset, i - c->offset);
-        bufOffset += (i - c->offset);
-        c->offset = i;
     }
 
-    /* add terminating NUL char */
-    buf[bufOffset] = 0;
+    len = end - c->offset;
+    buf = slapi_ch_malloc(len + 1);
+    memcpy(buf, c->b + c->offset, len);
+    buf[len] = 0;
+    c->offset = end;
+    for (p = buf; (p = memchr(p, '\n', buf + len - p)) != NULL; p++) {
+        (*lineno)++;
+    }
     return buf;
-
-error:
-    if (buf)
-        slapi_ch_free((void **)&buf);
-    return NULL;
 }
 
 
@@ -524,6 +506,10 @@ dbmdb_import_producer(void *param)
             } else {
                 int o_flag = O_RDONLY;
                 fd = dbmdb_open_huge_file(curr_filename, o_flag, 0);
+                if (fd >= 0) {
+                    /* the file is read once, from start to end */
+                    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                }
             }
             if (fd < 0) {
                 import_log_notice(job, SLAPI_LOG_ERR, "dbmdb_import_producer",
@@ -2795,7 +2781,11 @@ dbmdb_add_import_index(ImportCtx_t *ctx, const char *name, IndexInfo *ii)
         }
     }
 
-    dbmdb_open_dbi_from_filename(&mii->dbi, job->inst->inst_be, mii->name, NULL, dbi_flags);
+    if (dbmdb_dbi_idl_format_mismatch(job->inst->inst_be, mii->name, mii->ai)) {
+        /* The id list format changed: the database must be recreated */
+        dblayer_erase_index_file(job->inst->inst_be, mii->ai, PR_TRUE, 1);
+    }
+    dbmdb_open_dbi_from_filename(&mii->dbi, job->inst->inst_be, mii->name, mii->ai, dbi_flags);
     avl_insert(&ctx->indexes, mii, cmp_mii, NULL);
 }
 
@@ -3212,6 +3202,463 @@ cas_pt(volatile void *addr, volatile void *old, volatile void *new)
     return __sync_bool_compare_and_swap_8((void**)addr, (int64_t)old, (int64_t)(new));
 }
 
+/*
+ * Sorted index writes:
+ * Index records (every dbi with integer duplicates, that is all indexes
+ * but entryrdn) are not written in arrival order. The writer thread keeps
+ * them, sorts them by dbi, key and id, and spills them in a sorted run
+ * file each time job_index_buffer_size is reached. Once the workers are
+ * done, the runs are merged and the records are appended to the dbis, so
+ * the b-trees are filled sequentially instead of being updated at random
+ * pages. id2entry and entryrdn are still written as they come because
+ * entryrdn is read back by the workers (through the rdn cache).
+ */
+
+#define SORTER_MIN_RUN_SIZE   (4*1024*1024)  /* smallest in memory run */
+#define SORTER_IOBUF_SIZE     (256*1024)     /* stdio buffer of a run file */
+#define SORTER_TXN_SIZE       50000          /* records appended per txn */
+
+typedef struct {
+    dbmdb_dbi_t *dbi;
+    uint32_t keylen;
+    uint32_t datalen;
+} SortedRecHeader_t;
+
+typedef struct {
+    FILE *fd;
+    WriterQueueData_t rec;  /* current record of the run */
+    char *buf;
+    size_t bufsize;
+} SortedRun_t;
+
+typedef struct {
+    ImportCtx_t *ctx;
+    MDB_txn *txn;
+    MDB_cursor *cursor;
+    dbmdb_dbi_t *dbi;       /* dbi of the cursor */
+    MDB_val lastkey;        /* last key appended in dbi */
+    size_t lastkeysize;
+    size_t nbputs;
+    ID ids[IDL_PACKED_BLOCK_MAXIDS]; /* pending ids of a packed key */
+    size_t nbids;
+    dbmdb_dbi_t *blockdbi;  /* dbi of the pending ids */
+    MDB_val blockkey;       /* key of the pending ids */
+    size_t blockkeysize;
+} SortedWriter_t;
+
+static inline int __attribute__((always_inline))
+sorter_accepts(WriterQueueData_t *wqd)
+{
+    return (wqd->dbi->state.flags & (MDB_INTEGERDUP | MDB_IDL_PACKED_DBI));
+}
+
+/* Compare keys the way lmdb does */
+static int
+sorter_cmp_key(dbmdb_dbi_t *dbi, const MDB_val *k1, const MDB_val *k2)
+{
+    size_t len = (k1->mv_size < k2->mv_size) ? k1->mv_size : k2->mv_size;
+    int rc;
+
+    if (dbi->cmp_fn) {
+        return dbmdb_dbicmp(dbi->dbi, k1, k2);
+    }
+    rc = memcmp(k1->mv_data, k2->mv_data, len);
+    if (rc == 0 && k1->mv_size != k2->mv_size) {
+        rc = (k1->mv_size < k2->mv_size) ? -1 : 1;
+    }
+    return rc;
+}
+
+static int
+sorter_cmp_rec(const WriterQueueData_t *r1, const WriterQueueData_t *r2)
+{
+    unsigned int id1 = 0;
+    unsigned int id2 = 0;
+    int rc;
+
+    if (r1->dbi->dbi != r2->dbi->dbi) {
+        return (r1->dbi->dbi < r2->dbi->dbi) ? -1 : 1;
+    }
+    rc = sorter_cmp_key(r1->dbi, &r1->key, &r2->key);
+    if (rc == 0) {
+        /* MDB_INTEGERDUP data */
+        memcpy(&id1, r1->data.mv_data, sizeof id1);
+        memcpy(&id2, r2->data.mv_data, sizeof id2);
+        rc = (id1 < id2) ? -1 : (id1 > id2);
+    }
+    return rc;
+}
+
+static int
+sorter_cmp_slots(const void *p1, const void *p2)
+{
+    return sorter_cmp_rec(*(WriterQueueData_t *const *)p1, *(WriterQueueData_t *const *)p2);
+}
+
+static void
+dbmdb_import_sorter_free(ImportCtx_t *ctx)
+{
+    ImportSorter_t *s = &ctx->sorter;
+
+    for (size_t i = 0; i < s->nbrecs; i++) {
+        slapi_ch_free((void **)&s->recs[i]);
+    }
+    slapi_ch_free((void **)&s->recs);
+    for (int i = 0; i < s->nbruns; i++) {
+        fclose(s->runs[i]);
+    }
+    slapi_ch_free((void **)&s->runs);
+    s->nbrecs = s->maxrecs = s->size = 0;
+    s->nbruns = 0;
+}
+
+/* Write the kept records, sorted, in a new run file */
+static int
+dbmdb_import_sorter_spill(ImportCtx_t *ctx)
+{
+    ImportSorter_t *s = &ctx->sorter;
+    char path[MAXPATHLEN];
+    FILE *fd = NULL;
+    int rc = 0;
+    int tmpfd;
+
+    PR_snprintf(path, sizeof(path), "%s/import_run_XXXXXX", ctx->ctx->home);
+    tmpfd = mkstemp(path);
+    if (tmpfd < 0) {
+        rc = errno;
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_import_sorter_spill",
+                      "Failed to create a sorted run file in %s. Error is %d: %s.\n",
+                      ctx->ctx->home, rc, slapd_system_strerror(rc));
+        return rc;
+    }
+    /* The run only lives as long as the file descriptor */
+    unlink(path);
+    fd = fdopen(tmpfd, "w+");
+    if (fd == NULL) {
+        rc = errno;
+        close(tmpfd);
+        return rc;
+    }
+    setvbuf(fd, NULL, _IOFBF, SORTER_IOBUF_SIZE);
+
+    qsort(s->recs, s->nbrecs, sizeof(WriterQueueData_t *), sorter_cmp_slots);
+    for (size_t i = 0; i < s->nbrecs; i++) {
+        WriterQueueData_t *rec = s->recs[i];
+        SortedRecHeader_t hdr = {rec->dbi, rec->key.mv_size, rec->data.mv_size};
+
+        if (rc == 0 &&
+            (fwrite(&hdr, sizeof(hdr), 1, fd) != 1 ||
+             fwrite(rec->key.mv_data, rec->key.mv_size, 1, fd) != 1 ||
+             fwrite(rec->data.mv_data, rec->data.mv_size, 1, fd) != 1)) {
+            rc = errno ? errno : EIO;
+        }
+        slapi_ch_free((void **)&s->recs[i]);
+    }
+    s->nbrecs = 0;
+    s->size = 0;
+    if (rc == 0 && (fflush(fd) != 0 || fseek(fd, 0L, SEEK_SET) != 0)) {
+        rc = errno ? errno : EIO;
+    }
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_import_sorter_spill",
+                      "Failed to write a sorted run file in %s. Error is %d: %s.\n",
+                      ctx->ctx->home, rc, slapd_system_strerror(rc));
+        fclose(fd);
+        return rc;
+    }
+    s->runs = (FILE **)slapi_ch_realloc((char *)s->runs, (s->nbruns + 1) * sizeof(FILE *));
+    s->runs[s->nbruns++] = fd;
+    return 0;
+}
+
+/*
+ * Keep an index record for the sorted writes.
+ * Returns 1 if the record is kept (and then owned by the sorter)
+ */
+static int
+dbmdb_import_sorter_add(ImportCtx_t *ctx, WriterQueueData_t *wqd)
+{
+    ImportSorter_t *s = &ctx->sorter;
+
+    if (!sorter_accepts(wqd)) {
+        return 0;
+    }
+    if (s->maxsize == 0) {
+        s->maxsize = ctx->job->job_index_buffer_size;
+        if (s->maxsize < SORTER_MIN_RUN_SIZE) {
+            s->maxsize = SORTER_MIN_RUN_SIZE;
+        }
+    }
+    if (s->nbrecs == s->maxrecs) {
+        s->maxrecs = s->maxrecs ? 2 * s->maxrecs : WRITER_SLOTS;
+        s->recs = (WriterQueueData_t **)slapi_ch_realloc((char *)s->recs, s->maxrecs * sizeof(WriterQueueData_t *));
+    }
+    s->recs[s->nbrecs++] = wqd;
+    s->size += sizeof(WriterQueueData_t) + sizeof(WriterQueueData_t *) + wqd->key.mv_size + wqd->data.mv_size;
+    return 1;
+}
+
+static int
+sorted_writer_end(SortedWriter_t *w, int rc)
+{
+    if (w->cursor) {
+        MDB_CURSOR_CLOSE(w->cursor);
+        w->cursor = NULL;
+    }
+    if (w->txn) {
+        if (rc) {
+            TXN_ABORT(w->txn);
+        } else {
+            rc = TXN_COMMIT(w->txn);
+        }
+        w->txn = NULL;
+    }
+    return rc;
+}
+
+/* Append a record in dbi, the records must come in sorter_cmp_rec order */
+static int
+sorted_writer_append(SortedWriter_t *w, dbmdb_dbi_t *dbi, MDB_val *key, MDB_val *data)
+{
+    int flags = MDB_APPENDDUP;
+    int rc = 0;
+
+    if (w->txn == NULL) {
+        rc = TXN_BEGIN(w->ctx->ctx->env, NULL, 0, &w->txn);
+        if (rc) {
+            w->txn = NULL;
+            return rc;
+        }
+    }
+    if (w->cursor == NULL || w->dbi != dbi) {
+        if (w->cursor) {
+            MDB_CURSOR_CLOSE(w->cursor);
+            w->cursor = NULL;
+        }
+        rc = MDB_CURSOR_OPEN(w->txn, dbi->dbi, &w->cursor);
+        if (rc) {
+            return rc;
+        }
+        if (w->dbi != dbi) {
+            w->dbi = dbi;
+            w->lastkey.mv_size = 0;
+            flags = MDB_APPEND;
+        }
+    }
+    if (flags != MDB_APPEND && sorter_cmp_key(dbi, &w->lastkey, key) != 0) {
+        flags = MDB_APPEND;
+    }
+    if (flags == MDB_APPEND) {
+        if (key->mv_size > w->lastkeysize) {
+            w->lastkeysize = key->mv_size;
+            w->lastkey.mv_data = slapi_ch_realloc(w->lastkey.mv_data, w->lastkeysize);
+        }
+        memcpy(w->lastkey.mv_data, key->mv_data, key->mv_size);
+        w->lastkey.mv_size = key->mv_size;
+    }
+    rc = MDB_CURSOR_PUT(w->cursor, key, data, flags);
+    if (rc == MDB_KEYEXIST) {
+        /* The dbi was not empty or the record is a duplicate */
+        rc = MDB_CURSOR_PUT(w->cursor, key, data, 0);
+    }
+    if (rc == 0 && (++w->nbputs % SORTER_TXN_SIZE) == 0) {
+        rc = sorted_writer_end(w, 0);
+    }
+    return rc;
+}
+
+/*
+ * Write the pending ids of a packed key as id blocks.
+ * Unless all is set, the last partial block is kept pending.
+ */
+static int
+sorted_writer_flush_ids(SortedWriter_t *w, int all)
+{
+    char block[IDL_PACKED_BLOCK_MAXSIZE];
+    MDB_val data = {0};
+    size_t size = 0;
+    size_t n = 0;
+    int rc = 0;
+
+    while (rc == 0 && w->nbids > 0) {
+        n = idl_packed_block_encode(w->ids, w->nbids, block, &size);
+        if (!all && n == w->nbids && w->nbids < IDL_PACKED_BLOCK_MAXIDS) {
+            break;
+        }
+        data.mv_data = block;
+        data.mv_size = size;
+        rc = sorted_writer_append(w, w->blockdbi, &w->blockkey, &data);
+        w->nbids -= n;
+        memmove(w->ids, w->ids + n, w->nbids * sizeof(ID));
+    }
+    return rc;
+}
+
+/* Write a record, the records must come in sorter_cmp_rec order */
+static int
+sorted_writer_put(SortedWriter_t *w, WriterQueueData_t *rec)
+{
+    ID id = 0;
+    int rc = 0;
+
+    if (w->nbids > 0 && (w->blockdbi != rec->dbi ||
+                         sorter_cmp_key(rec->dbi, &w->blockkey, &rec->key) != 0)) {
+        rc = sorted_writer_flush_ids(w, 1);
+        if (rc) {
+            return rc;
+        }
+    }
+    if (!(rec->dbi->state.flags & MDB_IDL_PACKED_DBI)) {
+        return sorted_writer_append(w, rec->dbi, &rec->key, &rec->data);
+    }
+    /* Gather the ids of the key to write them as packed blocks */
+    memcpy(&id, rec->data.mv_data, sizeof(ID));
+    if (w->nbids == 0) {
+        if (rec->key.mv_size > w->blockkeysize) {
+            w->blockkeysize = rec->key.mv_size;
+            w->blockkey.mv_data = slapi_ch_realloc(w->blockkey.mv_data, w->blockkeysize);
+        }
+        memcpy(w->blockkey.mv_data, rec->key.mv_data, rec->key.mv_size);
+        w->blockkey.mv_size = rec->key.mv_size;
+        w->blockdbi = rec->dbi;
+    } else if (id == w->ids[w->nbids - 1]) {
+        return 0; /* duplicate record */
+    }
+    w->ids[w->nbids++] = id;
+    if (w->nbids == IDL_PACKED_BLOCK_MAXIDS) {
+        rc = sorted_writer_flush_ids(w, 0);
+    }
+    return rc;
+}
+
+/* Read the next record of a run. Returns 1 if there is one, 0 at end of run */
+static int
+sorted_run_next(SortedRun_t *run, int *rc)
+{
+    SortedRecHeader_t hdr;
+    size_t len;
+
+    if (fread(&hdr, sizeof(hdr), 1, run->fd) != 1) {
+        if (ferror(run->fd)) {
+            *rc = EIO;
+        }
+        return 0;
+    }
+    len = hdr.keylen + hdr.datalen;
+    if (len > run->bufsize) {
+        run->bufsize = len;
+        run->buf = slapi_ch_realloc(run->buf, len);
+    }
+    if (len && fread(run->buf, len, 1, run->fd) != 1) {
+        *rc = EIO;
+        return 0;
+    }
+    run->rec.dbi = hdr.dbi;
+    run->rec.key.mv_data = run->buf;
+    run->rec.key.mv_size = hdr.keylen;
+    run->rec.data.mv_data = run->buf + hdr.keylen;
+    run->rec.data.mv_size = hdr.datalen;
+    return 1;
+}
+
+static void
+sorted_runs_sift_down(SortedRun_t **heap, int nb, int i)
+{
+    for (;;) {
+        int smallest = i;
+        int l = 2 * i + 1;
+        int r = l + 1;
+        SortedRun_t *tmp;
+
+        if (l < nb && sorter_cmp_rec(&heap[l]->rec, &heap[smallest]->rec) < 0) {
+            smallest = l;
+        }
+        if (r < nb && sorter_cmp_rec(&heap[r]->rec, &heap[smallest]->rec) < 0) {
+            smallest = r;
+        }
+        if (smallest == i) {
+            return;
+        }
+        tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+/* k-way merge of the runs */
+static int
+dbmdb_import_sorter_merge(ImportCtx_t *ctx, SortedWriter_t *w)
+{
+    ImportSorter_t *s = &ctx->sorter;
+    SortedRun_t *runs = (SortedRun_t *)slapi_ch_calloc(s->nbruns, sizeof(SortedRun_t));
+    SortedRun_t **heap = (SortedRun_t **)slapi_ch_calloc(s->nbruns, sizeof(SortedRun_t *));
+    int nb = 0;
+    int rc = 0;
+
+    for (int i = 0; rc == 0 && i < s->nbruns; i++) {
+        runs[i].fd = s->runs[i];
+        if (sorted_run_next(&runs[i], &rc)) {
+            heap[nb++] = &runs[i];
+        }
+    }
+    for (int i = nb / 2 - 1; i >= 0; i--) {
+        sorted_runs_sift_down(heap, nb, i);
+    }
+    while (rc == 0 && nb > 0) {
+        if (ctx->job->flags & FLAG_ABORT) {
+            rc = -1;
+            break;
+        }
+        rc = sorted_writer_put(w, &heap[0]->rec);
+        if (rc == 0 && !sorted_run_next(heap[0], &rc)) {
+            heap[0] = heap[--nb];
+        }
+        sorted_runs_sift_down(heap, nb, 0);
+    }
+
+    for (int i = 0; i < s->nbruns; i++) {
+        slapi_ch_free_string(&runs[i].buf);
+    }
+    slapi_ch_free((void **)&runs);
+    slapi_ch_free((void **)&heap);
+    return rc;
+}
+
+/* Write the index records kept by the sorter */
+static int
+dbmdb_import_sorter_finish(ImportCtx_t *ctx)
+{
+    ImportSorter_t *s = &ctx->sorter;
+    SortedWriter_t w = {0};
+    int rc = 0;
+
+    w.ctx = ctx;
+    if (s->nbruns == 0) {
+        qsort(s->recs, s->nbrecs, sizeof(WriterQueueData_t *), sorter_cmp_slots);
+        for (size_t i = 0; rc == 0 && i < s->nbrecs; i++) {
+            rc = sorted_writer_put(&w, s->recs[i]);
+        }
+    } else {
+        if (s->nbrecs) {
+            rc = dbmdb_import_sorter_spill(ctx);
+        }
+        if (rc == 0) {
+            import_log_notice(ctx->job, SLAPI_LOG_INFO, "dbmdb_import_writer",
+                              "Merging %d sorted runs of index keys.", s->nbruns);
+            rc = dbmdb_import_sorter_merge(ctx, &w);
+        }
+    }
+    if (rc == 0) {
+        rc = sorted_writer_flush_ids(&w, 1);
+    }
+    rc = sorted_writer_end(&w, rc);
+    slapi_ch_free(&w.lastkey.mv_data);
+    slapi_ch_free(&w.blockkey.mv_data);
+    dbmdb_import_sorter_free(ctx);
+    return rc;
+}
+
 /* writer.thread:
  * i go through the writer queue (unlike the other worker threads),
  * i'm responsible to write data in mdb database as I am the only
@@ -3276,10 +3723,13 @@ dbmdb_import_writer(void*param)
          * (another is to play with env file to limt the fsyncs during the import)
          */
         for (; slot; slot = nextslot) {
+            nextslot = slot->next;
+            if (!rc && dbmdb_import_sorter_add(ctx, slot)) {
+                continue;
+            }
             if (!rc) {
                 rc = MDB_PUT(txn, slot->dbi->dbi, &slot->key, &slot->data, 0);
             }
-            nextslot = slot->next;
             slapi_ch_free((void**)&slot);
         }
         if (rc) {
@@ -3287,6 +3737,9 @@ dbmdb_import_writer(void*param)
         } else {
             rc = TXN_COMMIT(txn);
         }
+        if (!rc && ctx->sorter.size >= ctx->sorter.maxsize) {
+            rc = dbmdb_import_sorter_spill(ctx);
+        }
         if (rc) {
             slapi_log_err(SLAPI_LOG_ERR, "dbmdb_import_writer",
                     "Failed to write in the database. Error is 0x%x: %s.\n",
@@ -3299,6 +3752,16 @@ dbmdb_import_writer(void*param)
         pthread_cond_broadcast(&ctx->writerq.cv);
     }
 
+    if (!(job->flags & FLAG_ABORT) && !(info->state & ABORTED)) {
+        rc = dbmdb_import_sorter_finish(ctx);
+        if (rc && !(job->flags & FLAG_ABORT)) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_import_writer",
+                    "Failed to write the sorted index keys in the database. Error is 0x%x: %s.\n",
+                    rc, mdb_strerror(rc));
+            thread_abort(info);
+        }
+    }
+    dbmdb_import_sorter_free(ctx);
     info_set_state(info);
 }
 
@@ -3456,6 +3919,7 @@ dbmdb_free_import_ctx(ImportJob *job)
     pthread_cond_destroy(&ctx->writerq.cv);
     free_writer_queue((WriterQueueData_t**)&ctx->writerq.list);
     free_writer_queue((WriterQueueData_t**)&ctx->writerq.outlist);
+    dbmdb_import_sorter_free(ctx);
     rdncache_free(&ctx->rdncache);
     avl_free(ctx->indexes, (IFP) free_ii);
     ctx->indexes = NULL;
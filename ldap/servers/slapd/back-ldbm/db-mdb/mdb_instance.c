@@ -209,6 +209,18 @@ int dbmdb_update_dbi_cmp_fn(dbmdb_ctx_t *ctx, dbmdb_dbi_t *dbi, value_compare_fn
     return rc;
 }
 
+/* Packed id blocks of a key are sorted by their first id (stored in native order) */
+static int
+dbmdb_idl_packed_compare_dups(const MDB_val *v1, const MDB_val *v2)
+{
+    ID id1 = 0;
+    ID id2 = 0;
+
+    memcpy(&id1, v1->mv_data, sizeof(ID));
+    memcpy(&id2, v2->mv_data, sizeof(ID));
+    return (id1 > id2) - (id1 < id2);
+}
+
 int add_dbi(dbi_open_ctx_t *octx, backend *be, const char *fname, int flags)
 {
     MDB_cmp_func *dupsort_fn = NULL;
@@ -233,12 +245,19 @@ int add_dbi(dbi_open_ctx_t *octx, backend *be, const char *fname, int flags)
 
     /* let create/open the dbi */
     dbmdb_get_file_params(treekey.dbname, &flags2, &dupsort_fn);
+    if ((flags2 & MDB_INTEGERDUP) && ((flags & MDB_IDL_PACKED_DBI) ||
+        (octx->ai && octx->ai->ai_idl_format == IDL_FORMAT_PACKED))) {
+        /* Variable size id blocks instead of fixed size ids */
+        flags2 = MDB_DUPSORT | MDB_IDL_PACKED_DBI;
+        flags &= ~(MDB_INTEGERDUP | MDB_DUPFIXED);
+        dupsort_fn = dbmdb_idl_packed_compare_dups;
+    }
     treekey.env = ctx->env;
     treekey.state.flags = flags | flags2;
     treekey.state.flags &= ~MDB_RDONLY;
     treekey.state.state = DBIST_CLEAN;
     treekey.state.dataversion = DBMDB_CURRENT_DATAVERSION;
-    octx->rc = MDB_DBI_OPEN(octx->txn, treekey.dbname, treekey.state.flags, &treekey.dbi);
+    octx->rc = MDB_DBI_OPEN(octx->txn, treekey.dbname, treekey.state.flags & MDB_DBIOPEN_MASK, &treekey.dbi);
     if (octx->rc) {
         slapi_log_err(SLAPI_LOG_ERR, "add_dbi", "Failed to open database instance %s. Error is %d: %s.\n",
                       treekey.dbname, octx->rc, mdb_strerror(octx->rc));
@@ -1100,6 +1119,26 @@ dbi_get_by_name(dbmdb_ctx_t *ctx, struct backend *be, const char *fname)
     return node ? *node : NULL;
 }
 
+/*
+ * Tells whether the existing index database does not have the id list
+ * format configured in ai (so it must be recreated when reindexing).
+ */
+int
+dbmdb_dbi_idl_format_mismatch(backend *be, const char *filename, struct attrinfo *ai)
+{
+    struct ldbminfo *li = (struct ldbminfo *)(be->be_database->plg_private);
+    dbmdb_dbi_t *dbi = dbi_get_by_name(MDB_CONFIG(li), be, filename);
+    int format = IDL_FORMAT_PLAIN;
+
+    if (!dbi || !ai || !(dbi->state.flags & (MDB_INTEGERDUP | MDB_IDL_PACKED_DBI))) {
+        return 0;
+    }
+    if (dbi->state.flags & MDB_IDL_PACKED_DBI) {
+        format = IDL_FORMAT_PACKED;
+    }
+    return format != ai->ai_idl_format;
+}
+
 int dbmdb_update_dbi_state(dbmdb_ctx_t *ctx, dbmdb_dbi_t *dbi, dbistate_t *state, dbi_txn_t *txn, int is_locked)
 {
     MDB_val data = {0};
@@ -82,6 +82,7 @@ static int dbmdb_force_checkpoint(struct ldbminfo *li);
 #define FLUSH_REMOTEOFF 0
 
 static const char *backupfilelists[] = { INFOFILE, DBMAPFILE, DSE_INSTANCE, DSE_INDEX, NULL };
+static const char *backupmapfilelists[] = { DBMAPSUMFILE, DBMAPDELTAFILE, NULL };
 
 /*
  * return nsslapd-db-home-directory (dbmdb_dbhome_directory), if exists.
@@ -258,7 +259,7 @@ dbmdb_instance_start(backend *be, int mode)
      * check if nextid is valid: it only matters if the database is either
      * being imported or is in normal mode
      */
-    if (inst->inst_nextid > MAXID && !(mode & DBLAYER_EXPORT_MODE)) {
+    if (__atomic_load_n(&inst->inst_nextid, __ATOMIC_RELAXED) > MAXID && !(mode & DBLAYER_EXPORT_MODE)) {
         slapi_log_err(SLAPI_LOG_CRIT, "dbmdb_instance_start", "Backend '%s' "
                                                                 "has no IDs left. DATABASE MUST BE REBUILT.\n",
                       be->be_name);
@@ -936,8 +937,8 @@ dbmdb_backup(struct ldbminfo *li, char *dest_dir, Slapi_Task *task)
         }
         goto error_out;
     }
-    /* Copy the mdb database */
-    return_value = mdb_env_copy(conf->env, dest_dir);
+    /* Copy the mdb database (only the chunks changed since li_backup_base if it is set) */
+    return_value = dbmdb_backup_map(conf, dest_dir, li->li_backup_base, li->li_mode | 0400, task);
     if (return_value) {
         slapi_log_err(SLAPI_LOG_ERR, "dbmdb_backup", "Failed to backup mdb database to %s.\n", dest_dir);
         if (task) {
@@ -983,6 +984,11 @@ error_out:
         unlink(pathname2);
         slapi_ch_free_string(&pathname2);
     }
+    for (pt=backupmapfilelists; *pt; pt++) {
+        pathname2 = slapi_ch_smprintf("%s/%s", dest_dir, *pt);
+        unlink(pathname2);
+        slapi_ch_free_string(&pathname2);
+    }
     rmdir(dest_dir);
     return_value = LDAP_UNWILLING_TO_PERFORM;
 bail:
@@ -1030,6 +1036,7 @@ dbmdb_restore(struct ldbminfo *li, char *src_dir, Slapi_Task *task)
     struct stat sbuf;
     const char **pt;
     char *pathname;
+    int incremental;
 
     PR_ASSERT(NULL != li);
     priv = li->li_dblayer_private;
@@ -1060,8 +1067,11 @@ dbmdb_restore(struct ldbminfo *li, char *src_dir, Slapi_Task *task)
     }
 
     /* Check that all files are present and not empty */
+    incremental = dbmdb_backup_is_incremental(src_dir);
     for (pt=backupfilelists; *pt; pt++) {
-        pathname = slapi_ch_smprintf("%s/%s", src_dir, *pt);
+        /* An incremental backup has a delta instead of the database map */
+        pathname = slapi_ch_smprintf("%s/%s", src_dir,
+                                     (incremental && strcmp(*pt, DBMAPFILE) == 0) ? DBMAPDELTAFILE : *pt);
         if (stat(pathname, &sbuf) < 0 || sbuf.st_size == 0) {
             slapi_log_err(SLAPI_LOG_ERR, "dbmdb_restore",
                 "Backup directory %s does not contain a complete backup.\n", src_dir);
@@ -1093,7 +1103,7 @@ dbmdb_restore(struct ldbminfo *li, char *src_dir, Slapi_Task *task)
     dbmdb_delete_db(li);
 
     /* Copy db and info files */
-    if (dbmdb_restore_file(li, task, src_dir, DBMAPFILE) ||
+    if (dbmdb_restore_map(li, src_dir, task) ||
         dbmdb_restore_file(li, task, src_dir, INFOFILE)) {
         return_value = -1;
         goto error_out;
@@ -2787,6 +2797,14 @@ dbmdb_public_clear_vlv_cache(Slapi_Backend *be, dbi_txn_t *txn, dbi_db_t *db)
     return rc;
 }
 
+int
+dbmdb_idl_packed(backend *be __attribute__((unused)), dbi_db_t *db, struct attrinfo *a __attribute__((unused)))
+{
+    dbmdb_dbi_t *dbi = db;
+
+    return (dbi->state.flags & MDB_IDL_PACKED_DBI) != 0;
+}
+
 int
 dbmdb_public_delete_db(Slapi_Backend *be, dbi_db_t *db)
 {
@@ -2845,6 +2863,29 @@ dbmdb_idl_new_fetch(backend *be, dbi_db_t *db, dbi_val_t *inkey, dbi_txn_t *txn,
     } else {
         idl = idl_alloc(IDLIST_MIN_BLOCK_SIZE);
     }
+    while (rc == 0 && (dbi->state.flags & MDB_IDL_PACKED_DBI)) {
+        /* count is the number of blocks: check the limit on the ids */
+        ID ids[IDL_PACKED_BLOCK_MAXIDS];
+        int nids = idl_packed_block_decode(data.mv_data, data.mv_size, ids, IDL_PACKED_BLOCK_MAXIDS);
+        if (nids < 0) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_idl_new_fetch",
+                          "Database index is corrupt; (attribute: %s) key %s has a malformed data item\n",
+                          index_id, (char *)key.mv_data);
+            rc = MDB_CORRUPTED;
+            goto error;
+        }
+        for (int i = 0; i < nids; i++) {
+            idl_append_extend(&idl, ids[i]);
+        }
+        if (allidslimit && idl->b_nids >= allidslimit) {
+            idl_free(&idl);
+            idl = idl_allids(be);
+            slapi_log_err(SLAPI_LOG_TRACE, "dbmdb_idl_new_fetch", "%s returns allids (attribute: %s)\n",
+                          (char *)key.mv_data, index_id);
+            goto error;
+        }
+        rc = MDB_CURSOR_GET(cursor, &key, &data, MDB_NEXT_DUP);
+    }
     while (rc == 0) {
         idl_append_extend(&idl, *(ID*)data.mv_data);
         rc = MDB_CURSOR_GET(cursor, &key, &data, MDB_NEXT_DUP);
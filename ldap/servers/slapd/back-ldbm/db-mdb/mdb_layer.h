@@ -57,11 +57,15 @@
 #define MDB_OPEN_DIRTY_DBI           0x10000000     /* Allow to open dirty flags */
 #define MDB_MARK_DIRTY_DBI           0x20000000     /* create/open a dbi in dirty mode (import/reindex case) */
 #define MDB_TRUNCATE_DBI             0x40000000     /* create/open a dbi and insure it is empty */
+/* dbistate_t flags: dbi stores packed id blocks (see nsIndexIDListFormat) */
+#define MDB_IDL_PACKED_DBI           0x08000000
 
 /* Files and database names */
 #define DSE_INSTANCE        "dse_instance.ldif"     /* dse file in backup */
 #define DSE_INDEX           "dse_index.ldif"        /* dse file in backup */
 #define DBMAPFILE           "data.mdb"
+#define DBMAPSUMFILE        "data.mdb.sums"         /* chunk checksums in backup */
+#define DBMAPDELTAFILE      "data.mdb.delta"        /* changed chunks in incremental backup */
 #define INFOFILE            "INFO.mdb"
 #define DBNAMES             "__DBNAMES"
 #define CHANGELOG_PATTERN   "changelog"   /* pattern in changelog dbi name */
@@ -321,6 +325,7 @@ dblayer_private_close_fn_t dbmdb_public_private_close;
 dblayer_compact_fn_t dbmdb_public_dblayer_compact;
 dblayer_clear_vlv_cache_fn_t dbmdb_public_clear_vlv_cache;
 dblayer_idl_new_fetch_fn_t dbmdb_idl_new_fetch;
+dblayer_idl_packed_fn_t dbmdb_idl_packed;
 
 
 /* instance functions */
@@ -329,6 +334,7 @@ int dbmdb_instance_config_set(ldbm_instance *inst, char *attrname, int mod_apply
 int dbmdb_instance_create(struct ldbm_instance *inst);
 int dbmdb_instance_search_callback(Slapi_Entry *e, int *returncode, char *returntext, ldbm_instance *inst);
 dbmdb_dbi_t *dbmdb_get_dbi_from_slot(int dbi);
+int dbmdb_dbicmp(int dbi, const MDB_val *v1, const MDB_val *v2);
 
 /* function for autotuning */
 int dbmdb_start_autotune(struct ldbminfo *li);
@@ -358,6 +364,9 @@ int dbmdb_idl_new_compare_dups(dbmdb_dbi_t * db __attribute__((unused)), const M
 int dbmdb_delete_indices(ldbm_instance *inst);
 uint32_t dbmdb_get_optimal_block_size(struct ldbminfo *li);
 int dbmdb_copyfile(char *source, char *destination, int overwrite, int mode);
+int dbmdb_backup_map(dbmdb_ctx_t *ctx, const char *dest_dir, const char *base_dir, int mode, Slapi_Task *task);
+int dbmdb_backup_is_incremental(const char *src_dir);
+int dbmdb_restore_map(struct ldbminfo *li, const char *src_dir, Slapi_Task *task);
 int dbmdb_delete_instance_dir(backend *be);
 uint64_t dbmdb_database_size(struct ldbminfo *li);
 
@@ -459,6 +468,7 @@ int dbmdb_count_config_entries(char *filter, int *nbentries);
 
 /* mdb_instance.c */
 int dbmdb_open_dbi_from_filename(dbmdb_dbi_t **dbi, backend *be, const char *filename, struct attrinfo *ai, int flags);
+int dbmdb_dbi_idl_format_mismatch(backend *be, const char *filename, struct attrinfo *ai);
 int dbmdb_open_all_files(dbmdb_ctx_t *ctx, backend *be);
 dbmdb_dbi_t **dbmdb_list_dbis(dbmdb_ctx_t *ctx, backend *be, char *fname, int islocked, int *size);
 int dbmdb_open_cursor(dbmdb_cursor_t *dbicur, dbmdb_ctx_t *ctx, dbmdb_dbi_t *dbi, int flags);
@@ -47,8 +47,51 @@ typedef struct _export_args
                                  its children's ID.  It happens when an entry
                                  is added and existing entries are moved under
                                  the newly added entry. */
+    struct _export_pipeline *pipeline; /* NULL: entries are formatted and written inline */
+    int write_error;                   /* first error writing an entry inline */
+    time_t starttime;
 } export_args;
 
+/*
+ * Export pipeline: the thread walking id2entry queues the entries in the
+ * order they have to be written (parents first), worker threads convert
+ * them to LDIF and a writer thread writes them back in that order.
+ */
+#define EXPORT_PIPELINE_SLOTS 1024
+#define EXPORT_MAX_WORKERS 16
+
+#define EXPORT_SLOT_FREE 0
+#define EXPORT_SLOT_QUEUED 1
+#define EXPORT_SLOT_FORMATTED 2
+
+typedef struct _export_slot
+{
+    struct backentry *ep;
+    char *ldif;
+    int len;
+    int state;
+} export_slot;
+
+typedef struct _export_pipeline
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cv; /* broadcast on every slot state change */
+    export_slot slots[EXPORT_PIPELINE_SLOTS];
+    uint64_t next_queue;  /* sequence of the next queued entry */
+    uint64_t next_format; /* sequence of the next entry to format */
+    uint64_t next_write;  /* sequence of the next entry to write */
+    int done;             /* no more entries will be queued */
+    int write_error;      /* errno of the first failed write */
+    struct ldbminfo *li;
+    ldbm_instance *inst;
+    int decrypt;
+    int options;
+    int printkey;
+    int fd;
+    int nthreads;
+    pthread_t threads[EXPORT_MAX_WORKERS + 1];
+} export_pipeline;
+
 /* static functions */
 
 static int dbmdb_ldbm_exclude_attr_from_export(struct ldbminfo *li,
@@ -427,51 +470,47 @@ dbmdb_fetch_subtrees(backend *be, char **include, int *err)
 }
 
 
-static int
-dbmdb_export_one_entry(struct ldbminfo *li,
-                 ldbm_instance *inst,
-                 export_args *expargs)
+/*
+ * Convert an entry to its LDIF text, with the excluded attributes removed
+ * and the encrypted ones decrypted if asked to. The entry is modified.
+ * Returns the text, with its final empty line, to be freed by the caller.
+ */
+static char *
+dbmdb_export_format_entry(struct ldbminfo *li,
+                          ldbm_instance *inst,
+                          struct backentry *ep,
+                          int decrypt,
+                          int options,
+                          int printkey,
+                          int *len)
 {
     backend *be = inst->inst_be;
     int rc = 0;
     Slapi_Attr *this_attr = NULL, *next_attr = NULL;
     char *type = NULL;
-    MDB_val data = {0};
-    int len = 0;
-
-    if (!dbmdb_back_ok_to_dump(backentry_get_ndn(expargs->ep),
-                              expargs->include_suffix,
-                              expargs->exclude_suffix)) {
-        goto bail; /* go to next loop */
-    }
-    if (!(expargs->options & SLAPI_DUMP_STATEINFO) &&
-        slapi_entry_flag_is_set(expargs->ep->ep_entry,
-                                SLAPI_ENTRY_FLAG_TOMBSTONE)) {
-        /* We only dump the tombstones if the user needs to create
-         * a replica from the ldif */
-        goto bail; /* go to next loop */
-    }
-    (*expargs->cnt)++;
+    char *entry_str = NULL;
+    char *ldif = NULL;
+    int entry_len = 0;
 
     /* do not output attributes that are in the "exclude" list */
     /* Also, decrypt any encrypted attributes, if we're asked to */
-    rc = slapi_entry_first_attr(expargs->ep->ep_entry, &this_attr);
+    rc = slapi_entry_first_attr(ep->ep_entry, &this_attr);
     while (0 == rc) {
-        int dump_uniqueid = (expargs->options & SLAPI_DUMP_UNIQUEID) ? 1 : 0;
-        rc = slapi_entry_next_attr(expargs->ep->ep_entry,
+        int dump_uniqueid = (options & SLAPI_DUMP_UNIQUEID) ? 1 : 0;
+        rc = slapi_entry_next_attr(ep->ep_entry,
                                    this_attr, &next_attr);
         slapi_attr_get_type(this_attr, &type);
         if (dbmdb_ldbm_exclude_attr_from_export(li, type, dump_uniqueid)) {
-            slapi_entry_delete_values(expargs->ep->ep_entry, type, NULL);
+            slapi_entry_delete_values(ep->ep_entry, type, NULL);
         }
         this_attr = next_attr;
     }
-    if (expargs->decrypt) {
+    if (decrypt) {
         /* Decrypt in place */
-        rc = attrcrypt_decrypt_entry(be, expargs->ep);
+        rc = attrcrypt_decrypt_entry(be, ep);
         if (rc) {
-            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_export_one_entry", "Failed to decrypt entry [%s] : %d\n",
-                          slapi_sdn_get_dn(&expargs->ep->ep_entry->e_sdn), rc);
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_export_format_entry", "Failed to decrypt entry [%s] : %d\n",
+                          slapi_sdn_get_dn(&ep->ep_entry->e_sdn), rc);
         }
     }
     /*
@@ -479,7 +518,7 @@ dbmdb_export_one_entry(struct ldbminfo *li,
      * If it is not, put "{CLEAR}" in front of the password value.
      */
     {
-        char *pw = slapi_entry_attr_get_charptr(expargs->ep->ep_entry,
+        char *pw = slapi_entry_attr_get_charptr(ep->ep_entry,
                                                 "userpassword");
         if (pw && !slapi_is_encoded(pw)) {
             /* clear password does not have {CLEAR} storage scheme */
@@ -489,37 +528,263 @@ dbmdb_export_one_entry(struct ldbminfo *li,
             val.bv_len = strlen(val.bv_val);
             vals[0] = &val;
             vals[1] = NULL;
-            rc = slapi_entry_attr_replace(expargs->ep->ep_entry,
+            rc = slapi_entry_attr_replace(ep->ep_entry,
                                           "userpassword", vals);
             if (rc) {
                 slapi_log_err(SLAPI_LOG_ERR,
-                              "dbmdb_export_one_entry", "%s: Failed to add clear password storage scheme: %d\n",
-                              slapi_sdn_get_dn(&expargs->ep->ep_entry->e_sdn), rc);
+                              "dbmdb_export_format_entry", "%s: Failed to add clear password storage scheme: %d\n",
+                              slapi_sdn_get_dn(&ep->ep_entry->e_sdn), rc);
             }
             slapi_ch_free_string(&val.bv_val);
         }
         slapi_ch_free_string(&pw);
     }
-    data.mv_data = slapi_entry2str_with_options(expargs->ep->ep_entry,
-                                             &len, expargs->options);
-    data.mv_size = len + 1;
+    entry_str = slapi_entry2str_with_options(ep->ep_entry, &entry_len, options);
 
-    if (expargs->printkey & EXPORT_PRINTKEY) {
-        char idstr[32];
+    if (printkey & EXPORT_PRINTKEY) {
+        ldif = slapi_ch_smprintf("# entry-id: %lu\n%s\n", (u_long)ep->ep_id, entry_str);
+        *len = strlen(ldif);
+        slapi_ch_free_string(&entry_str);
+    } else {
+        ldif = slapi_ch_realloc(entry_str, entry_len + 2);
+        ldif[entry_len] = '\n';
+        ldif[entry_len + 1] = '\0';
+        *len = entry_len + 1;
+    }
+    return ldif;
+}
 
-        sprintf(idstr, "# entry-id: %lu\n", (u_long)expargs->ep->ep_id);
-        rc = write(expargs->fd, idstr, strlen(idstr));
-        PR_ASSERT(rc > 0);
+static int
+dbmdb_export_write(int fd, const char *buf, int len)
+{
+    while (len > 0) {
+        ssize_t written = write(fd, buf, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        buf += written;
+        len -= written;
+    }
+    return 0;
+}
+
+static void *
+dbmdb_export_worker(void *arg)
+{
+    export_pipeline *pipeline = (export_pipeline *)arg;
+    export_slot *slot = NULL;
+    char *ldif = NULL;
+    int len = 0;
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (1) {
+        while (pipeline->next_format == pipeline->next_queue && !pipeline->done) {
+            pthread_cond_wait(&pipeline->cv, &pipeline->lock);
+        }
+        if (pipeline->next_format == pipeline->next_queue) {
+            break;
+        }
+        slot = &pipeline->slots[pipeline->next_format % EXPORT_PIPELINE_SLOTS];
+        pipeline->next_format++;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        ldif = dbmdb_export_format_entry(pipeline->li, pipeline->inst, slot->ep, pipeline->decrypt,
+                                         pipeline->options, pipeline->printkey, &len);
+        backentry_free(&slot->ep);
+
+        pthread_mutex_lock(&pipeline->lock);
+        slot->ldif = ldif;
+        slot->len = len;
+        slot->state = EXPORT_SLOT_FORMATTED;
+        pthread_cond_broadcast(&pipeline->cv);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+static void *
+dbmdb_export_writer(void *arg)
+{
+    export_pipeline *pipeline = (export_pipeline *)arg;
+    export_slot *slot = NULL;
+    int rc = 0;
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (1) {
+        slot = &pipeline->slots[pipeline->next_write % EXPORT_PIPELINE_SLOTS];
+        while (!(pipeline->next_write < pipeline->next_queue && slot->state == EXPORT_SLOT_FORMATTED) &&
+               !(pipeline->done && pipeline->next_write == pipeline->next_queue)) {
+            pthread_cond_wait(&pipeline->cv, &pipeline->lock);
+        }
+        if (pipeline->next_write == pipeline->next_queue) {
+            break;
+        }
+        pthread_mutex_unlock(&pipeline->lock);
+
+        rc = dbmdb_export_write(pipeline->fd, slot->ldif, slot->len);
+        slapi_ch_free_string(&slot->ldif);
+
+        pthread_mutex_lock(&pipeline->lock);
+        if (rc && !pipeline->write_error) {
+            pipeline->write_error = rc;
+        }
+        slot->state = EXPORT_SLOT_FREE;
+        pipeline->next_write++;
+        pthread_cond_broadcast(&pipeline->cv);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+/*
+ * Start the worker threads and the writer thread of an export.
+ * Returns NULL if there is no point in (or no way of) using threads,
+ * the entries are then written inline.
+ */
+static export_pipeline *
+dbmdb_export_pipeline_start(struct ldbminfo *li, ldbm_instance *inst, export_args *expargs)
+{
+    export_pipeline *pipeline = NULL;
+    long nworkers = util_get_capped_hardware_threads(1, EXPORT_MAX_WORKERS);
+    int i;
+
+    if (nworkers < 2) {
+        return NULL;
+    }
+    pipeline = (export_pipeline *)slapi_ch_calloc(1, sizeof(export_pipeline));
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pthread_cond_init(&pipeline->cv, NULL);
+    pipeline->li = li;
+    pipeline->inst = inst;
+    pipeline->decrypt = expargs->decrypt;
+    pipeline->options = expargs->options;
+    pipeline->printkey = expargs->printkey;
+    pipeline->fd = expargs->fd;
+
+    for (i = 0; i <= nworkers; i++) {
+        void *(*fn)(void *) = (i == 0) ? dbmdb_export_writer : dbmdb_export_worker;
+        if (pthread_create(&pipeline->threads[i], NULL, fn, pipeline) != 0) {
+            break;
+        }
+        pipeline->nthreads++;
+    }
+    if (pipeline->nthreads < 2) {
+        /* no writer or no worker: stop what was started and go inline */
+        slapi_log_err(SLAPI_LOG_WARNING, "dbmdb_export_pipeline_start",
+                      "%s: Unable to start the export threads, exporting with a single thread\n",
+                      inst->inst_name);
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->done = 1;
+        pthread_cond_broadcast(&pipeline->cv);
+        pthread_mutex_unlock(&pipeline->lock);
+        for (i = 0; i < pipeline->nthreads; i++) {
+            pthread_join(pipeline->threads[i], NULL);
+        }
+        pthread_cond_destroy(&pipeline->cv);
+        pthread_mutex_destroy(&pipeline->lock);
+        slapi_ch_free((void **)&pipeline);
+        return NULL;
+    }
+    slapi_log_err(SLAPI_LOG_INFO, "dbmdb_export_pipeline_start",
+                  "%s: Exporting with %d formatting threads\n",
+                  inst->inst_name, pipeline->nthreads - 1);
+    return pipeline;
+}
+
+/* Queue an entry, it now belongs to the pipeline */
+static void
+dbmdb_export_pipeline_queue(export_pipeline *pipeline, struct backentry *ep)
+{
+    export_slot *slot = NULL;
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (pipeline->next_queue - pipeline->next_write >= EXPORT_PIPELINE_SLOTS) {
+        pthread_cond_wait(&pipeline->cv, &pipeline->lock);
+    }
+    slot = &pipeline->slots[pipeline->next_queue % EXPORT_PIPELINE_SLOTS];
+    slot->ep = ep;
+    slot->state = EXPORT_SLOT_QUEUED;
+    pipeline->next_queue++;
+    pthread_cond_broadcast(&pipeline->cv);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+/* Wait for the queued entries to be written and free the pipeline */
+static int
+dbmdb_export_pipeline_stop(export_pipeline **pipeline)
+{
+    export_pipeline *p = *pipeline;
+    int rc = 0;
+    int i;
+
+    if (p == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&p->lock);
+    p->done = 1;
+    pthread_cond_broadcast(&p->cv);
+    pthread_mutex_unlock(&p->lock);
+    for (i = 0; i < p->nthreads; i++) {
+        pthread_join(p->threads[i], NULL);
+    }
+    rc = p->write_error;
+    pthread_cond_destroy(&p->cv);
+    pthread_mutex_destroy(&p->lock);
+    slapi_ch_free((void **)pipeline);
+    return rc;
+}
+
+static int
+dbmdb_export_one_entry(struct ldbminfo *li,
+                 ldbm_instance *inst,
+                 export_args *expargs)
+{
+    int rc = 0;
+    char *ldif = NULL;
+    int len = 0;
+
+    if (!dbmdb_back_ok_to_dump(backentry_get_ndn(expargs->ep),
+                              expargs->include_suffix,
+                              expargs->exclude_suffix)) {
+        goto bail; /* go to next loop */
+    }
+    if (!(expargs->options & SLAPI_DUMP_STATEINFO) &&
+        slapi_entry_flag_is_set(expargs->ep->ep_entry,
+                                SLAPI_ENTRY_FLAG_TOMBSTONE)) {
+        /* We only dump the tombstones if the user needs to create
+         * a replica from the ldif */
+        goto bail; /* go to next loop */
+    }
+    (*expargs->cnt)++;
+
+    if (expargs->pipeline) {
+        /* The caller keeps and frees its backentry: hand over its content */
+        struct backentry *ep = backentry_alloc();
+
+        ep->ep_entry = expargs->ep->ep_entry;
+        ep->ep_id = expargs->ep->ep_id;
+        expargs->ep->ep_entry = NULL;
+        dbmdb_export_pipeline_queue(expargs->pipeline, ep);
+    } else {
+        ldif = dbmdb_export_format_entry(li, inst, expargs->ep, expargs->decrypt,
+                                         expargs->options, expargs->printkey, &len);
+        rc = dbmdb_export_write(expargs->fd, ldif, len);
+        slapi_ch_free_string(&ldif);
+        if (rc) {
+            /* reported by dbmdb_db2ldif, as the pipeline errors */
+            if (!expargs->write_error) {
+                expargs->write_error = rc;
+            }
+            goto bail;
+        }
     }
-    rc = write(expargs->fd, data.mv_data, len);
-    PR_ASSERT(rc > 0);
-    rc = write(expargs->fd, "\n", 1);
-    PR_ASSERT(rc > 0);
-    slapi_ch_free(&data.mv_data);
-    data.mv_size = 0;
-    rc = 0;
     if ((*expargs->cnt) % 1000 == 0) {
         int percent;
+        time_t elapsed = slapi_current_rel_time_t() - expargs->starttime;
+        u_long rate = (u_long)(*expargs->cnt) / (elapsed > 0 ? elapsed : 1);
 
         if (expargs->idl) {
             percent = (expargs->idindex * 100 / expargs->idl->b_nids);
@@ -528,14 +793,14 @@ dbmdb_export_one_entry(struct ldbminfo *li,
         }
         if (expargs->task) {
             slapi_task_log_status(expargs->task,
-                                  "%s: Processed %d entries (%d%%).",
-                                  inst->inst_name, *expargs->cnt, percent);
+                                  "%s: Processed %d entries (%d%%, %lu entries/s).",
+                                  inst->inst_name, *expargs->cnt, percent, rate);
             slapi_task_log_notice(expargs->task,
-                                  "%s: Processed %d entries (%d%%).",
-                                  inst->inst_name, *expargs->cnt, percent);
+                                  "%s: Processed %d entries (%d%%, %lu entries/s).",
+                                  inst->inst_name, *expargs->cnt, percent, rate);
         }
-        slapi_log_err(SLAPI_LOG_INFO, "dbmdb_export_one_entry", "export %s: Processed %d entries (%d%%).\n",
-                      inst->inst_name, *expargs->cnt, percent);
+        slapi_log_err(SLAPI_LOG_INFO, "dbmdb_export_one_entry", "export %s: Processed %d entries (%d%%, %lu entries/s).\n",
+                      inst->inst_name, *expargs->cnt, percent, rate);
         *expargs->lastcnt = *expargs->cnt;
     }
 bail:
@@ -867,8 +1132,10 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
     eargs.task = task;
     eargs.include_suffix = include_suffix;
     eargs.exclude_suffix = exclude_suffix;
+    eargs.starttime = slapi_current_rel_time_t();
+    eargs.pipeline = dbmdb_export_pipeline_start(li, inst, &eargs);
 
-    while (keepgoing) {
+    while (keepgoing && !eargs.write_error) {
         /*
          * All database operations in a transactional environment,
          * including non-transactional reads can receive a return of
@@ -1119,19 +1386,42 @@ dbmdb_db2ldif(Slapi_PBlock *pb)
     if (return_value == MDB_NOTFOUND)
         return_value = 0;
 
+    /* the queued entries must be written before reporting */
+    rc = dbmdb_export_pipeline_stop(&eargs.pipeline);
+    if (!rc) {
+        rc = eargs.write_error;
+    }
+    if (rc) {
+        if (task) {
+            slapi_task_log_status(task, "%s: Failed to write %s: error %d (%s)",
+                                  inst->inst_name, fname, rc, slapi_system_strerror(rc));
+        }
+        slapi_task_log_notice(task, "%s: Failed to write %s: error %d (%s)",
+                              inst->inst_name, fname, rc, slapi_system_strerror(rc));
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_db2ldif", "db2ldif: %s: Failed to write %s: error %d (%s)\n",
+                      inst->inst_name, fname, rc, slapi_system_strerror(rc));
+        return_value = -1;
+    }
+
     /* done cycling thru entries to write */
     if (lastcnt != cnt) {
+        time_t elapsed = slapi_current_rel_time_t() - eargs.starttime;
+        u_long rate = (u_long)cnt / (elapsed > 0 ? elapsed : 1);
+
         if (task) {
-            slapi_task_log_status(task,
-                                  "%s: Processed %d entries (100%%).",
-                                  inst->inst_name, cnt);
+            if (return_value == 0) {
+                /* do not hide the failure */
+                slapi_task_log_status(task,
+                                      "%s: Processed %d entries (100%%, %lu entries/s).",
+                                      inst->inst_name, cnt, rate);
+            }
             slapi_task_log_notice(task,
-                                  "%s: Processed %d entries (100%%).",
-                                  inst->inst_name, cnt);
+                                  "%s: Processed %d entries (100%%, %lu entries/s).",
+                                  inst->inst_name, cnt, rate);
         }
         slapi_log_err(SLAPI_LOG_INFO, "dbmdb_db2ldif",
-                      "export %s: Processed %d entries (100%%).\n",
-                      inst->inst_name, cnt);
+                      "export %s: Processed %d entries (100%%, %lu entries/s).\n",
+                      inst->inst_name, cnt, rate);
     }
     if (run_from_cmdline && dump_changelog) {
         return_value = plugin_call_plugins(pb, SLAPI_PLUGIN_BE_POST_EXPORT_FN);
@@ -59,6 +59,7 @@ dbmdb_monitor_instance_search(Slapi_PBlock *pb __attribute__((unused)),
     uint64_t nentries;
     int64_t maxentries;
     uint64_t size, maxsize;
+    uint64_t lastid;
     dbmdb_stats_t *stats = NULL;
     int i, j, flags;
 
@@ -90,6 +91,26 @@ dbmdb_monitor_instance_search(Slapi_PBlock *pb __attribute__((unused)),
     PR_snprintf(buf, sizeof(buf), "%d", inst->inst_be->be_readonly);
     MSET("readOnly");
 
+    /* online index build progress */
+    lastid = slapi_atomic_load_64(&inst->inst_online_index_last, __ATOMIC_ACQUIRE);
+    if (lastid) {
+        PR_Lock(inst->inst_config_mutex);
+        PR_snprintf(buf, sizeof(buf), "%s", inst->inst_online_index_attrs ? inst->inst_online_index_attrs : "");
+        PR_Unlock(inst->inst_config_mutex);
+        MSET("onlineIndexAttributes");
+        sprintf(buf, "%" PRIu64, slapi_atomic_load_64(&inst->inst_online_index_mark, __ATOMIC_ACQUIRE));
+        MSET("onlineIndexHighWaterMark");
+        sprintf(buf, "%" PRIu64, lastid);
+        MSET("onlineIndexLastId");
+    } else {
+        attrlist_delete(&e->e_attrs, "onlineIndexAttributes");
+        attrlist_delete(&e->e_attrs, "onlineIndexHighWaterMark");
+        attrlist_delete(&e->e_attrs, "onlineIndexLastId");
+    }
+
+    /* bloom filters of the equality indexes */
+    ldbm_bloom_monitor(inst, e);
+
     /* fetch cache statistics */
     cache_get_stats(&(inst->inst_cache), &hits, &tries,
                     &nentries, &maxentries, &size, &maxsize);
@@ -14,8 +14,815 @@
 
 #include "mdb_layer.h"
 
+/*
+ * lmdb checks the structure of the map by itself, so verifying a backend
+ * is about the consistency between id2entry and the indexes:
+ *  - each index record must hold an ID that exists in id2entry
+ *  - the presence and equality keys of an index must match the values
+ *    of the entry (index -> entry)
+ *  - the values of the entries must have their presence and equality
+ *    keys in the indexes (entry -> index)
+ * id2entry and each index are walked in parallel by a pool of threads.
+ * Each walk runs in its own read txn, so it sees a snapshot of the
+ * database and the server can keep serving updates while it runs.
+ * The entries are decoded from the id2entry records of the snapshot and
+ * never go through the entry cache: a snapshot version must not replace
+ * a newer entry in the cache, nor a full walk evict the working set.
+ * An inconsistency found in a snapshot may be fixed by a later update
+ * so each suspect is checked again in a fresh txn before being reported.
+ * The cross checks may be sampled (one ID out of "sample" is checked).
+ */
+
+#define DBMDB_VERIFY_MAX_THREADS    16
+#define DBMDB_VERIFY_MAX_SUSPECTS   1000   /* Suspects rechecked per walk */
+#define DBMDB_VERIFY_MAX_LOGGED     10     /* Errors logged per walk (unless verbose) */
+
+/* Kind of inconsistency */
+#define DBMDB_VERIFY_DANGLING       1      /* Index ID has no entry */
+#define DBMDB_VERIFY_MISMATCH       2      /* Index key does not match the entry */
+#define DBMDB_VERIFY_MISSING        3      /* Entry value has no index key */
+
+typedef struct dbmdb_verify_item dbmdb_verify_item_t;
+
+typedef struct {
+    dbmdb_verify_item_t *item;      /* The index holding (or missing) the key */
+    struct berval key;
+    ID id;
+    int kind;
+} dbmdb_verify_suspect_t;
+
+struct dbmdb_verify_item {
+    const char *name;
+    struct attrinfo *ai;            /* NULL for id2entry */
+    dbmdb_dbi_t *dbi;
+    int idcheck;                    /* Data are IDs */
+    int crosscheck;                 /* Keys can be compared with the entry values */
+    dbmdb_verify_suspect_t *suspects;
+    int nbsuspects;
+    int nblogged;
+    uint64_t nbkeys;
+    uint64_t nbids;
+    uint64_t nbchecked;
+    uint64_t nbbad;
+    uint64_t nbdangling;            /* updated atomically */
+    uint64_t nbmismatch;            /* updated atomically */
+    uint64_t nbmissing;             /* updated atomically */
+    int rc;
+};
+
+typedef struct {
+    backend *be;
+    ldbm_instance *inst;
+    dbmdb_verify_item_t *items;     /* items[0] is id2entry */
+    int nbitems;
+    int next;                       /* Next item to walk (updated atomically) */
+    int sample;
+    int verbose;
+} dbmdb_verify_ctx_t;
+
+/* Presence and equality keys of an entry for an index */
+typedef struct {
+    struct berval *keys;
+    size_t nbkeys;
+    size_t maxkeys;
+} dbmdb_verify_keys_t;
+
+
+static void
+dbmdb_verify_keys_reset(dbmdb_verify_keys_t *keys)
+{
+    for (size_t i = 0; i < keys->nbkeys; i++) {
+        slapi_ch_free_string(&keys->keys[i].bv_val);
+    }
+    keys->nbkeys = 0;
+}
+
+static void
+dbmdb_verify_keys_free(dbmdb_verify_keys_t *keys)
+{
+    dbmdb_verify_keys_reset(keys);
+    slapi_ch_free((void **)&keys->keys);
+    keys->maxkeys = 0;
+}
+
+/* Add the db key of value val (NULL for presence) the way addordel_values_sv builds it */
+static void
+dbmdb_verify_keys_add(backend *be, struct attrinfo *ai, const char *indextype,
+                      const struct berval *val, dbmdb_verify_keys_t *keys)
+{
+    struct ldbminfo *li = (struct ldbminfo *)be->be_database->plg_private;
+    char *prefix = index_index2prefix(indextype);
+    struct berval *hashed = NULL;
+    struct berval *encrypted = NULL;
+    struct berval *key;
+    size_t plen, vlen;
+
+    if (val) {
+        if (val->bv_len >= li->li_max_key_len &&
+            attrcrypt_hash_large_index_key(be, &prefix, ai, val, &hashed) == 0 && hashed) {
+            val = hashed;
+        }
+        if (ai->ai_attrcrypt && attrcrypt_encrypt_index_key(be, ai, val, &encrypted) == 0 && encrypted) {
+            val = encrypted;
+        }
+    }
+    if (keys->nbkeys >= keys->maxkeys) {
+        keys->maxkeys = keys->maxkeys ? 2 * keys->maxkeys : 16;
+        keys->keys = (struct berval *)slapi_ch_realloc((char *)keys->keys,
+                                                       keys->maxkeys * sizeof(struct berval));
+    }
+    key = &keys->keys[keys->nbkeys++];
+    plen = strlen(prefix);
+    vlen = val ? val->bv_len : 0;
+    key->bv_len = plen + vlen + 1;
+    key->bv_val = slapi_ch_malloc(key->bv_len);
+    memcpy(key->bv_val, prefix, plen);
+    if (vlen) {
+        memcpy(key->bv_val + plen, val->bv_val, vlen);
+    }
+    key->bv_val[plen + vlen] = '\0';
+    if (hashed) {
+        ber_bvfree(hashed);
+    }
+    if (encrypted) {
+        ber_bvfree(encrypted);
+    }
+    index_free_prefix(prefix);
+}
+
+/* Compute the presence and equality keys that index ai should hold for entry e */
+static void
+dbmdb_verify_entry_keys(backend *be, struct attrinfo *ai, Slapi_Entry *e, dbmdb_verify_keys_t *keys)
+{
+    Slapi_Attr *attr = NULL;
+    char *type = NULL;
+    int present = 0;
+
+    dbmdb_verify_keys_reset(keys);
+    for (int r = slapi_entry_first_attr(e, &attr); r == 0; r = slapi_entry_next_attr(e, attr, &attr)) {
+        Slapi_Value **vals;
+        Slapi_Value **ivals = NULL;
+
+        slapi_attr_get_type(attr, &type);
+        if (slapi_attr_type_cmp(ai->ai_type, type, SLAPI_TYPE_CMP_BASE) != 0) {
+            continue;
+        }
+        vals = attr_get_present_values(attr);
+        if (vals == NULL || vals[0] == NULL) {
+            continue;
+        }
+        present = 1;
+        if (ai->ai_indexmask & INDEX_EQUALITY) {
+            slapi_attr_values2keys_sv(&ai->ai_sattr, vals, &ivals, LDAP_FILTER_EQUALITY);
+            for (Slapi_Value **pt = ivals ? ivals : vals; *pt; pt++) {
+                dbmdb_verify_keys_add(be, ai, indextype_EQUALITY, slapi_value_get_berval(*pt), keys);
+            }
+            valuearray_free(&ivals);
+        }
+    }
+    if (present && (ai->ai_indexmask & INDEX_PRESENCE)) {
+        dbmdb_verify_keys_add(be, ai, indextype_PRESENCE, NULL, keys);
+    }
+}
+
+static int
+dbmdb_verify_keys_has(dbmdb_verify_keys_t *keys, const MDB_val *key)
+{
+    for (size_t i = 0; i < keys->nbkeys; i++) {
+        if (keys->keys[i].bv_len == key->mv_size &&
+            memcmp(keys->keys[i].bv_val, key->mv_data, key->mv_size) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Tells whether key is a presence or an equality key */
+static int
+dbmdb_verify_is_entry_key(const MDB_val *key)
+{
+    const char *pt = key->mv_data;
+
+    if (key->mv_size > 1 && *pt == HASH_PREFIX) {
+        return pt[1] == EQ_PREFIX;
+    }
+    return key->mv_size > 0 && (*pt == EQ_PREFIX || *pt == PRES_PREFIX);
+}
+
+static int
+dbmdb_verify_has_record(dbi_txn_t *txn, dbmdb_verify_item_t *item, MDB_val *key, ID id)
+{
+    ID ids[IDL_PACKED_BLOCK_MAXIDS];
+    MDB_val data = {sizeof id, &id};
+    MDB_val k = *key;
+    MDB_cursor *cursor = NULL;
+    int nids = 0;
+    int rc;
+
+    rc = MDB_CURSOR_OPEN(TXN(txn), item->dbi->dbi, &cursor);
+    if (rc) {
+        return 0;
+    }
+    if (!(item->dbi->state.flags & MDB_IDL_PACKED_DBI)) {
+        /* Index data are ids in native order */
+        rc = MDB_CURSOR_GET(cursor, &k, &data, MDB_GET_BOTH);
+        MDB_CURSOR_CLOSE(cursor);
+        return rc == 0;
+    }
+    /* The id is in the last block whose first id is not greater */
+    rc = MDB_CURSOR_GET(cursor, &k, &data, MDB_GET_BOTH_RANGE);
+    if (rc == 0) {
+        memcpy(&ids[0], data.mv_data, sizeof(ID));
+    }
+    if (rc == 0 && ids[0] != id) {
+        rc = MDB_CURSOR_GET(cursor, &k, &data, MDB_PREV_DUP);
+    } else if (rc == MDB_NOTFOUND) {
+        rc = MDB_CURSOR_GET(cursor, &k, &data, MDB_SET_KEY);
+        if (rc == 0) {
+            rc = MDB_CURSOR_GET(cursor, &k, &data, MDB_LAST_DUP);
+        }
+    }
+    if (rc == 0) {
+        nids = idl_packed_block_decode(data.mv_data, data.mv_size, ids, IDL_PACKED_BLOCK_MAXIDS);
+    }
+    MDB_CURSOR_CLOSE(cursor);
+    for (int i = 0; i < nids; i++) {
+        if (ids[i] == id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Decode the entry of an id2entry record without the entry cache.
+ * The dn is only made of the rdn and the suffix (as when reindexing): the
+ * attribute keys do not depend on it.
+ */
+static struct backentry *
+dbmdb_verify_decode_entry(dbmdb_verify_ctx_t *vctx, ID id, const MDB_val *data)
+{
+    const char *suffix = slapi_sdn_get_dn(vctx->be->be_suffix);
+    uint32_t size = data->mv_size;
+    char *pt = slapi_ch_malloc(data->mv_size + 1);
+    struct backentry *ep = NULL;
+    Slapi_Entry *e = NULL;
+    char *normdn = NULL;
+    char *rdn = NULL;
+
+    memcpy(pt, data->mv_data, data->mv_size);
+    pt[data->mv_size] = 0;
+    /* call post-entry plugin */
+    plugin_call_entryfetch_plugins(&pt, &size);
+    if (get_value_from_string(pt, "rdn", &rdn)) {
+        /* pt may not include rdn: ..., try "dn: ..." */
+        e = slapi_str2entry(pt, SLAPI_STR2ENTRY_NO_ENTRYDN);
+    } else {
+        if (strcasecmp(rdn, suffix) == 0) {
+            normdn = slapi_ch_strdup(rdn);
+        } else {
+            normdn = slapi_ch_smprintf("%s,%s", rdn, suffix);
+        }
+        e = slapi_str2entry_ext(normdn, NULL, pt, SLAPI_STR2ENTRY_NO_ENTRYDN);
+        slapi_ch_free_string(&normdn);
+        slapi_ch_free_string(&rdn);
+    }
+    /* As in id2entry, the plugin owns the buffer it replaces */
+    slapi_ch_free_string(&pt);
+    if (e == NULL) {
+        return NULL;
+    }
+    ep = backentry_init(e);
+    ep->ep_id = id;
+    if (attrcrypt_decrypt_entry(vctx->be, ep)) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify", "%s: failed to decrypt entry %u\n",
+                      vctx->inst->inst_name, id);
+    }
+    return ep;
+}
+
+/* Check an (index key, id) record: returns 0 or the kind of inconsistency */
+static int
+dbmdb_verify_check_record(dbmdb_verify_ctx_t *vctx, dbmdb_verify_item_t *item, dbi_txn_t *txn,
+                          MDB_val *key, ID id, int crosscheck, dbmdb_verify_keys_t *keys)
+{
+    char stored[sizeof(ID)];
+    MDB_val ikey = {sizeof stored, stored};
+    MDB_val idata = {0};
+    struct backentry *ep;
+    int rc = 0;
+
+    id_internal_to_stored(id, stored);
+    if (MDB_GET(TXN(txn), vctx->items[0].dbi->dbi, &ikey, &idata) == MDB_NOTFOUND) {
+        return DBMDB_VERIFY_DANGLING;
+    }
+    if (!crosscheck) {
+        return 0;
+    }
+    ep = dbmdb_verify_decode_entry(vctx, id, &idata);
+    if (ep == NULL) {
+        return DBMDB_VERIFY_DANGLING;
+    }
+    dbmdb_verify_entry_keys(vctx->be, item->ai, ep->ep_entry, keys);
+    if (!dbmdb_verify_keys_has(keys, key)) {
+        rc = DBMDB_VERIFY_MISMATCH;
+    }
+    backentry_free(&ep);
+    return rc;
+}
+
+static void
+dbmdb_verify_log(dbmdb_verify_ctx_t *vctx, dbmdb_verify_item_t *walker, dbmdb_verify_item_t *item,
+                 MDB_val *key, ID id, const char *msg)
+{
+    char keystr[BUFSIZ];
+
+    if (!vctx->verbose && walker->nblogged >= DBMDB_VERIFY_MAX_LOGGED) {
+        return;
+    }
+    walker->nblogged++;
+    dbgval2str(keystr, sizeof keystr, key);
+    slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify", "%s: index %s key %s id %u: %s\n",
+                  vctx->inst->inst_name, item->name, keystr, id, msg);
+}
+
+static void
+dbmdb_verify_add_suspect(dbmdb_verify_ctx_t *vctx, dbmdb_verify_item_t *walker, dbmdb_verify_item_t *item,
+                         MDB_val *key, ID id, int kind)
+{
+    dbmdb_verify_suspect_t *s;
+
+    if (walker->nbsuspects >= DBMDB_VERIFY_MAX_SUSPECTS) {
+        /* Too many errors to recheck them all: report them as is */
+        switch (kind) {
+            case DBMDB_VERIFY_DANGLING:
+                __atomic_add_fetch(&item->nbdangling, 1, __ATOMIC_RELAXED);
+                break;
+            case DBMDB_VERIFY_MISMATCH:
+                __atomic_add_fetch(&item->nbmismatch, 1, __ATOMIC_RELAXED);
+                break;
+            default:
+                __atomic_add_fetch(&item->nbmissing, 1, __ATOMIC_RELAXED);
+                break;
+        }
+        dbmdb_verify_log(vctx, walker, item, key, id, "inconsistency (not rechecked)");
+        return;
+    }
+    if (walker->suspects == NULL) {
+        walker->suspects = (dbmdb_verify_suspect_t *)slapi_ch_calloc(DBMDB_VERIFY_MAX_SUSPECTS,
+                                                                     sizeof(dbmdb_verify_suspect_t));
+    }
+    s = &walker->suspects[walker->nbsuspects++];
+    s->item = item;
+    s->key.bv_len = key->mv_size;
+    s->key.bv_val = slapi_ch_malloc(key->mv_size + 1);
+    memcpy(s->key.bv_val, key->mv_data, key->mv_size);
+    s->id = id;
+    s->kind = kind;
+}
+
+/* Check the suspects again in a fresh txn and count the confirmed ones */
+static void
+dbmdb_verify_recheck(dbmdb_verify_ctx_t *vctx, dbmdb_verify_item_t *walker, dbmdb_verify_keys_t *keys)
+{
+    dbi_txn_t *txn = NULL;
+    int rc;
+
+    if (walker->nbsuspects == 0) {
+        return;
+    }
+    rc = START_TXN(&txn, NULL, TXNFL_RDONLY);
+    for (int i = 0; i < walker->nbsuspects; i++) {
+        dbmdb_verify_suspect_t *s = &walker->suspects[i];
+        MDB_val key = {s->key.bv_len, s->key.bv_val};
+        char stored[sizeof(ID)];
+        MDB_val ikey = {sizeof stored, stored};
+        MDB_val idata = {0};
+        struct backentry *ep = NULL;
+
+        if (rc == 0) {
+            if (s->kind == DBMDB_VERIFY_MISSING) {
+                /* Still missing and still in the entry ? */
+                if (dbmdb_verify_has_record(txn, s->item, &key, s->id)) {
+                    continue;
+                }
+                id_internal_to_stored(s->id, stored);
+                if (MDB_GET(TXN(txn), vctx->items[0].dbi->dbi, &ikey, &idata) == 0) {
+                    ep = dbmdb_verify_decode_entry(vctx, s->id, &idata);
+                }
+                if (ep == NULL || slapi_entry_flag_is_set(ep->ep_entry, SLAPI_ENTRY_FLAG_TOMBSTONE)) {
+                    backentry_free(&ep);
+                    continue;
+                }
+                dbmdb_verify_entry_keys(vctx->be, s->item->ai, ep->ep_entry, keys);
+                backentry_free(&ep);
+                if (!dbmdb_verify_keys_has(keys, &key)) {
+                    continue;
+                }
+            } else {
+                /* Still in the index and still inconsistent ? */
+                if (!dbmdb_verify_has_record(txn, s->item, &key, s->id) ||
+                    dbmdb_verify_check_record(vctx, s->item, txn, &key, s->id,
+                                              s->kind == DBMDB_VERIFY_MISMATCH, keys) == 0) {
+                    continue;
+                }
+            }
+        }
+        switch (s->kind) {
+            case DBMDB_VERIFY_DANGLING:
+                __atomic_add_fetch(&s->item->nbdangling, 1, __ATOMIC_RELAXED);
+                dbmdb_verify_log(vctx, walker, s->item, &key, s->id, "entry does not exist");
+                break;
+            case DBMDB_VERIFY_MISMATCH:
+                __atomic_add_fetch(&s->item->nbmismatch, 1, __ATOMIC_RELAXED);
+                dbmdb_verify_log(vctx, walker, s->item, &key, s->id, "key does not match the entry");
+                break;
+            default:
+                __atomic_add_fetch(&s->item->nbmissing, 1, __ATOMIC_RELAXED);
+                dbmdb_verify_log(vctx, walker, s->item, &key, s->id, "key is missing");
+                break;
+        }
+    }
+    END_TXN(&txn, 0);
+    for (int i = 0; i < walker->nbsuspects; i++) {
+        slapi_ch_free_string(&walker->suspects[i].key.bv_val);
+    }
+    slapi_ch_free((void **)&walker->suspects);
+    walker->nbsuspects = 0;
+}
+
+/* Walk an index: check the IDs and compare the keys with the entries */
+static int
+dbmdb_verify_index(dbmdb_verify_ctx_t *vctx, dbmdb_verify_item_t *item, dbi_txn_t *txn,
+                   dbmdb_verify_keys_t *keys)
+{
+    MDB_cursor *cursor = NULL;
+    MDB_val key = {0};
+    MDB_val data = {0};
+    int rc;
+
+    rc = MDB_CURSOR_OPEN(TXN(txn), item->dbi->dbi, &cursor);
+    if (rc == 0) {
+        rc = MDB_CURSOR_GET(cursor, &key, &data, MDB_FIRST);
+    }
+    while (rc == 0) {
+        item->nbkeys++;
+        do {
+            ID ids[IDL_PACKED_BLOCK_MAXIDS];
+            int nids = 1;
+
+            if (!item->idcheck) {
+                continue;
+            }
+            if (item->dbi->state.flags & MDB_IDL_PACKED_DBI) {
+                nids = idl_packed_block_decode(data.mv_data, data.mv_size, ids, IDL_PACKED_BLOCK_MAXIDS);
+            } else if (data.mv_size == sizeof(ID)) {
+                memcpy(&ids[0], data.mv_data, sizeof(ID));
+            } else {
+                nids = -1;
+            }
+            if (nids < 0) {
+                item->nbbad++;
+                dbmdb_verify_log(vctx, item, item, &key, 0, "record is not an ID");
+                continue;
+            }
+            for (int i = 0; i < nids; i++) {
+                int crosscheck;
+                int kind;
+
+                item->nbids++;
+                crosscheck = item->crosscheck && (item->nbids % vctx->sample) == 0 &&
+                             dbmdb_verify_is_entry_key(&key);
+                if (crosscheck) {
+                    item->nbchecked++;
+                }
+                kind = dbmdb_verify_check_record(vctx, item, txn, &key, ids[i], crosscheck, keys);
+                if (kind) {
+                    dbmdb_verify_add_suspect(vctx, item, item, &key, ids[i], kind);
+                }
+            }
+        } while (MDB_CURSOR_GET(cursor, &key, &data, MDB_NEXT_DUP) == 0);
+        if (slapi_is_shutting_down()) {
+            rc = -1;
+            break;
+        }
+        rc = MDB_CURSOR_GET(cursor, &key, &data, MDB_NEXT_NODUP);
+    }
+    MDB_CURSOR_CLOSE(cursor);
+    return (rc == MDB_NOTFOUND) ? 0 : rc;
+}
+
+/* Walk id2entry: check the records and look for the entry keys in the indexes */
+static int
+dbmdb_verify_id2entry(dbmdb_verify_ctx_t *vctx, dbmdb_verify_item_t *item, dbi_txn_t *txn,
+                      dbmdb_verify_keys_t *keys)
+{
+    MDB_cursor *cursor = NULL;
+    MDB_val key = {0};
+    MDB_val data = {0};
+    int rc;
+
+    rc = MDB_CURSOR_OPEN(TXN(txn), item->dbi->dbi, &cursor);
+    if (rc == 0) {
+        rc = MDB_CURSOR_GET(cursor, &key, &data, MDB_FIRST);
+    }
+    for (; rc == 0; rc = MDB_CURSOR_GET(cursor, &key, &data, MDB_NEXT)) {
+        struct backentry *ep;
+        ID id;
+
+        item->nbkeys++;
+        if (key.mv_size != sizeof(ID) || data.mv_size == 0) {
+            item->nbbad++;
+            dbmdb_verify_log(vctx, item, item, &key, 0, "invalid entry record");
+            continue;
+        }
+        item->nbids++;
+        if ((item->nbids % vctx->sample) != 0) {
+            continue;
+        }
+        id = id_stored_to_internal(key.mv_data);
+        ep = dbmdb_verify_decode_entry(vctx, id, &data);
+        if (ep == NULL) {
+            item->nbbad++;
+            dbmdb_verify_log(vctx, item, item, &key, id, "entry cannot be decoded");
+            continue;
+        }
+        /* Only a few attributes of the tombstones are indexed */
+        if (!slapi_entry_flag_is_set(ep->ep_entry, SLAPI_ENTRY_FLAG_TOMBSTONE)) {
+            item->nbchecked++;
+            for (int i = 1; i < vctx->nbitems; i++) {
+                dbmdb_verify_item_t *idx = &vctx->items[i];
+                if (!idx->crosscheck) {
+                    continue;
+                }
+                dbmdb_verify_entry_keys(vctx->be, idx->ai, ep->ep_entry, keys);
+                for (size_t k = 0; k < keys->nbkeys; k++) {
+                    MDB_val ikey = {keys->keys[k].bv_len, keys->keys[k].bv_val};
+                    if (!dbmdb_verify_has_record(txn, idx, &ikey, id)) {
+                        dbmdb_verify_add_suspect(vctx, item, idx, &ikey, id, DBMDB_VERIFY_MISSING);
+                    }
+                }
+            }
+        }
+        backentry_free(&ep);
+        if (slapi_is_shutting_down()) {
+            rc = -1;
+            break;
+        }
+    }
+    MDB_CURSOR_CLOSE(cursor);
+    return (rc == MDB_NOTFOUND) ? 0 : rc;
+}
+
+static void
+dbmdb_verify_worker(void *arg)
+{
+    dbmdb_verify_ctx_t *vctx = arg;
+    dbmdb_verify_keys_t keys = {0};
+    dbi_txn_t *txn = NULL;
+    int idx;
+
+    while ((idx = __atomic_fetch_add(&vctx->next, 1, __ATOMIC_ACQ_REL)) < vctx->nbitems) {
+        dbmdb_verify_item_t *item = &vctx->items[idx];
+
+        /* Each walk sees its own snapshot */
+        item->rc = START_TXN(&txn, NULL, TXNFL_RDONLY);
+        if (item->rc == 0) {
+            if (idx == 0) {
+                item->rc = dbmdb_verify_id2entry(vctx, item, txn, &keys);
+            } else {
+                item->rc = dbmdb_verify_index(vctx, item, txn, &keys);
+            }
+            END_TXN(&txn, 0);
+        }
+        dbmdb_verify_recheck(vctx, item, &keys);
+    }
+    dbmdb_verify_keys_free(&keys);
+}
+
+static int
+dbmdb_verify_add_item(caddr_t data, caddr_t arg)
+{
+    struct attrinfo *ai = (struct attrinfo *)data;
+    dbmdb_verify_ctx_t *vctx = (dbmdb_verify_ctx_t *)arg;
+    dbmdb_verify_item_t *item;
+    dbi_db_t *db = NULL;
+
+    if ((ai->ai_indexmask & ~INDEX_VLV) == 0 || (ai->ai_indexmask & INDEX_OFFLINE)) {
+        return 0;
+    }
+    if (dblayer_get_index_file(vctx->be, ai, &db, 0) != 0 || db == NULL) {
+        slapi_log_err(SLAPI_LOG_WARNING, "dbmdb_verify", "%s: index %s does not exist.\n",
+                      vctx->inst->inst_name, ai->ai_type);
+        return 0;
+    }
+    item = &vctx->items[vctx->nbitems++];
+    item->name = ai->ai_type;
+    item->ai = ai;
+    item->dbi = (dbmdb_dbi_t *)db;
+    /* entryrdn records are rdn elements */
+    item->idcheck = strcasecmp(ai->ai_type, LDBM_ENTRYRDN_STR) != 0;
+    /* Keys of the system indexes are not entry values */
+    item->crosscheck = item->idcheck &&
+                       (ai->ai_indexmask & (INDEX_PRESENCE | INDEX_EQUALITY)) &&
+                       strcasecmp(ai->ai_type, LDBM_ANCESTORID_STR) != 0 &&
+                       strcasecmp(ai->ai_type, LDBM_PARENTID_STR) != 0 &&
+                       strcasecmp(ai->ai_type, LDBM_ENTRYDN_STR) != 0;
+    return 0;
+}
+
+static int
+dbmdb_verify_count_attrs(caddr_t data __attribute__((unused)), caddr_t arg)
+{
+    (*(int *)arg)++;
+    return 0;
+}
+
+static int
+dbmdb_verify_instance(ldbm_instance *inst, int sample, int verbose, Slapi_Task *task)
+{
+    dbmdb_verify_ctx_t vctx = {0};
+    PRThread **threads = NULL;
+    dbi_db_t *db = NULL;
+    int nbthreads;
+    int nbattrs = 0;
+    int rval = 0;
+
+    vctx.be = inst->inst_be;
+    vctx.inst = inst;
+    vctx.sample = sample;
+    vctx.verbose = verbose;
+
+    if (dblayer_get_id2entry(vctx.be, &db) != 0 || db == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify", "%s: Failed to open id2entry.\n", inst->inst_name);
+        slapi_task_log_notice(task, "%s: Failed to open id2entry.", inst->inst_name);
+        return 1;
+    }
+    avl_apply(inst->inst_attrs, dbmdb_verify_count_attrs, (caddr_t)&nbattrs, -1, AVL_INORDER);
+    vctx.items = (dbmdb_verify_item_t *)slapi_ch_calloc(nbattrs + 1, sizeof(dbmdb_verify_item_t));
+    vctx.items[0].name = ID2ENTRY;
+    vctx.items[0].dbi = (dbmdb_dbi_t *)db;
+    vctx.nbitems = 1;
+    avl_apply(inst->inst_attrs, dbmdb_verify_add_item, (caddr_t)&vctx, -1, AVL_INORDER);
+
+    slapi_log_err(SLAPI_LOG_INFO, "dbmdb_verify", "%s: Verifying id2entry and %d indexes (sample rate 1/%d).\n",
+                  inst->inst_name, vctx.nbitems - 1, sample);
+    slapi_task_log_notice(task, "%s: Verifying id2entry and %d indexes (sample rate 1/%d).",
+                          inst->inst_name, vctx.nbitems - 1, sample);
+
+    nbthreads = util_get_capped_hardware_threads(1, DBMDB_VERIFY_MAX_THREADS);
+    if (nbthreads > vctx.nbitems) {
+        nbthreads = vctx.nbitems;
+    }
+    threads = (PRThread **)slapi_ch_calloc(nbthreads, sizeof(PRThread *));
+    for (int i = 0; i < nbthreads; i++) {
+        threads[i] = PR_CreateThread(PR_USER_THREAD, dbmdb_verify_worker, &vctx,
+                                     PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                     PR_JOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+        if (threads[i] == NULL) {
+            slapi_log_err(SLAPI_LOG_WARNING, "dbmdb_verify",
+                          "%s: Unable to create verify thread, using %d threads.\n", inst->inst_name, i);
+            if (i == 0) {
+                /* Do the job in this thread */
+                dbmdb_verify_worker(&vctx);
+            }
+            break;
+        }
+    }
+    for (int i = 0; i < nbthreads && threads[i]; i++) {
+        PR_JoinThread(threads[i]);
+    }
+    slapi_ch_free((void **)&threads);
+
+    for (int i = 0; i < vctx.nbitems; i++) {
+        dbmdb_verify_item_t *item = &vctx.items[i];
+        uint64_t nberrors = item->nbbad + item->nbdangling + item->nbmismatch + item->nbmissing;
+
+        if (item->rc) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify", "%s: %s: Failed to verify. err=%d %s\n",
+                          inst->inst_name, item->name, item->rc, mdb_strerror(item->rc));
+            slapi_task_log_notice(task, "%s: %s: Failed to verify. err=%d %s",
+                                  inst->inst_name, item->name, item->rc, mdb_strerror(item->rc));
+            rval = 1;
+        }
+        if (nberrors) {
+            rval = 1;
+        }
+        slapi_log_err(nberrors ? SLAPI_LOG_ERR : SLAPI_LOG_INFO, "dbmdb_verify",
+                      "%s: %s: %" PRIu64 " keys, %" PRIu64 " ids, %" PRIu64 " cross checked: "
+                      "%" PRIu64 " bad records, %" PRIu64 " dangling ids, %" PRIu64 " mismatched keys, "
+                      "%" PRIu64 " missing keys\n",
+                      inst->inst_name, item->name, item->nbkeys, item->nbids, item->nbchecked,
+                      item->nbbad, item->nbdangling, item->nbmismatch, item->nbmissing);
+        if (nberrors) {
+            slapi_task_log_notice(task, "%s: %s: %" PRIu64 " bad records, %" PRIu64 " dangling ids, "
+                                  "%" PRIu64 " mismatched keys, %" PRIu64 " missing keys",
+                                  inst->inst_name, item->name, item->nbbad, item->nbdangling,
+                                  item->nbmismatch, item->nbmissing);
+        }
+        if (i > 0) {
+            dblayer_release_index_file(vctx.be, item->ai, (dbi_db_t *)item->dbi);
+        }
+    }
+    dblayer_release_id2entry(vctx.be, db);
+    slapi_ch_free((void **)&vctx.items);
+
+    slapi_log_err(rval ? SLAPI_LOG_ERR : SLAPI_LOG_INFO, "dbmdb_verify", "%s: Verify %s.\n",
+                  inst->inst_name, rval ? "failed" : "succeeded");
+    slapi_task_log_notice(task, "%s: Verify %s.", inst->inst_name, rval ? "failed" : "succeeded");
+    return rval;
+}
+
+static int
+dbmdb_verify_one(struct ldbminfo *li, ldbm_instance *inst, int sample, int verbose, Slapi_Task *task)
+{
+    int rval;
+
+    /* check if an import/restore is already ongoing... */
+    if (instance_set_busy(inst) != 0) {
+        slapi_log_err(SLAPI_LOG_WARNING, "dbmdb_verify",
+                      "Backend '%s' is already in the middle of "
+                      "another task and cannot be disturbed.\n",
+                      inst->inst_name);
+        slapi_task_log_notice(task, "Backend '%s' is busy, it is not verified.", inst->inst_name);
+        return 1;
+    }
+    if ((li->li_flags & SLAPI_TASK_RUNNING_FROM_COMMANDLINE) &&
+        0 != dbmdb_instance_start(inst->inst_be, DBLAYER_EXPORT_MODE)) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify", "dbverify: Failed to start instance %s\n",
+                      inst->inst_name);
+        rval = 1;
+    } else {
+        rval = dbmdb_verify_instance(inst, sample, verbose, task);
+    }
+    instance_set_not_busy(inst);
+    return rval;
+}
+
 int
 dbmdb_verify(Slapi_PBlock *pb)
 {
-    return 0;  /* Fonction useless with lmdb - as we can verify the db when doing a backup */
+    struct ldbminfo *li = NULL;
+    Object *inst_obj = NULL;
+    ldbm_instance *inst = NULL;
+    Slapi_Task *task = NULL;
+    char **instance_names = NULL;
+    char *dbdir = NULL;
+    int run_from_cmdline = 0;
+    int task_flags = 0;
+    int verbose = 0;
+    int sample = 0;
+    int rval = 0;
+
+    slapi_log_err(SLAPI_LOG_TRACE, "dbmdb_verify", "Verifying db files...\n");
+    slapi_pblock_get(pb, SLAPI_BACKEND_INSTANCE_NAME, &instance_names);
+    slapi_pblock_get(pb, SLAPI_SEQ_TYPE, &verbose);
+    slapi_pblock_get(pb, SLAPI_PLUGIN_PRIVATE, &li);
+    slapi_pblock_get(pb, SLAPI_DBVERIFY_DBDIR, &dbdir);
+    slapi_pblock_get(pb, SLAPI_DBVERIFY_SAMPLE, &sample);
+    slapi_pblock_get(pb, SLAPI_TASK_FLAGS, &task_flags);
+    slapi_pblock_get(pb, SLAPI_BACKEND_TASK, &task);
+    run_from_cmdline = (task_flags & SLAPI_TASK_RUNNING_FROM_COMMANDLINE);
+    if (sample <= 0) {
+        sample = 1;
+    }
+
+    if (dbdir) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify",
+                      "Verifying a backup is not supported with lmdb: restore it then verify the database.\n");
+        return 1;
+    }
+
+    if (run_from_cmdline) {
+        li->li_flags |= SLAPI_TASK_RUNNING_FROM_COMMANDLINE;
+        /* no write needed; choose EXPORT MODE */
+        if (0 != dbmdb_start(li, DBLAYER_EXPORT_MODE)) {
+            slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify", "dbverify: Failed to init database\n");
+            return 1;
+        }
+    }
+
+    if (instance_names) {
+        for (char **inp = instance_names; *inp; inp++) {
+            inst = ldbm_instance_find_by_name(li, *inp);
+            if (inst) {
+                rval |= dbmdb_verify_one(li, inst, sample, verbose, task);
+            } else {
+                slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify", "Unknown backend instance: %s\n", *inp);
+                slapi_task_log_notice(task, "Unknown backend instance: %s", *inp);
+                rval |= 1; /* no such instance */
+            }
+        }
+    } else {
+        for (inst_obj = objset_first_obj(li->li_instance_set); inst_obj;
+             inst_obj = objset_next_obj(li->li_instance_set, inst_obj)) {
+            inst = (ldbm_instance *)object_get_data(inst_obj);
+            rval |= dbmdb_verify_one(li, inst, sample, verbose, task);
+        }
+    }
+
+    if (run_from_cmdline && 0 != dblayer_close(li, DBLAYER_EXPORT_MODE)) {
+        slapi_log_err(SLAPI_LOG_ERR, "dbmdb_verify", "Failed to close database\n");
+    }
+    return rval;
 }
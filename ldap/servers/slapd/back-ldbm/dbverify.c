@@ -19,8 +19,13 @@ int
 ldbm_back_dbverify(Slapi_PBlock *pb)
 {
     struct ldbminfo *li = NULL;
+    int task_flags = 0;
     slapi_pblock_get(pb, SLAPI_PLUGIN_PRIVATE, &li);
-    dblayer_setup(li);
+    slapi_pblock_get(pb, SLAPI_TASK_FLAGS, &task_flags);
+    /* a task verifies the running database */
+    if (task_flags & SLAPI_TASK_RUNNING_FROM_COMMANDLINE) {
+        dblayer_setup(li);
+    }
     dblayer_private *priv = (dblayer_private *)li->li_dblayer_private;
 
     return priv->dblayer_verify_fn(pb);;
@@ -131,6 +131,90 @@ idl_new_release_private(struct attrinfo *a)
     return 0;
 }
 
+/*
+ * Packed id blocks: the first id is kept as in a plain record, so the
+ * dup compare functions, which only look at the first id, keep the blocks
+ * of a key sorted. Each next id is coded as its delta to the previous one,
+ * 7 bits per byte, the high bit being set when more bytes follow.
+ */
+
+/* Decode a plain or packed record, returns the number of ids or -1 if it is malformed */
+int
+idl_packed_block_decode(const void *data, size_t size, ID *ids, size_t maxids)
+{
+    const unsigned char *pt = (const unsigned char *)data + sizeof(ID);
+    const unsigned char *end = (const unsigned char *)data + size;
+    size_t nids = 1;
+
+    if (size < sizeof(ID) || maxids == 0) {
+        return -1;
+    }
+    memcpy(&ids[0], data, sizeof(ID));
+    while (pt < end) {
+        uint64_t delta = 0;
+        int shift = 0;
+
+        do {
+            if (pt >= end || shift > 28) {
+                return -1;
+            }
+            delta |= (uint64_t)(*pt & 0x7f) << shift;
+            shift += 7;
+        } while (*pt++ & 0x80);
+        if (delta == 0 || nids >= maxids || delta > (uint64_t)(ALLID - ids[nids - 1])) {
+            return -1;
+        }
+        ids[nids] = ids[nids - 1] + (ID)delta;
+        nids++;
+    }
+    return (int)nids;
+}
+
+/*
+ * Code the first of nids increasing ids in buf, as many as fit in a block.
+ * Returns the number of coded ids and set *size to the block size.
+ */
+size_t
+idl_packed_block_encode(const ID *ids, size_t nids, char *buf, size_t *size)
+{
+    unsigned char *pt = (unsigned char *)buf + sizeof(ID);
+    unsigned char *end = (unsigned char *)buf + IDL_PACKED_BLOCK_MAXSIZE;
+    size_t n;
+
+    memcpy(buf, &ids[0], sizeof(ID));
+    for (n = 1; n < nids; n++) {
+        unsigned char varint[5];
+        ID delta = ids[n] - ids[n - 1];
+        size_t len = 0;
+
+        do {
+            varint[len++] = (delta & 0x7f) | 0x80;
+            delta >>= 7;
+        } while (delta);
+        varint[len - 1] &= 0x7f;
+        if (pt + len > end) {
+            break;
+        }
+        memcpy(pt, varint, len);
+        pt += len;
+    }
+    *size = pt - (unsigned char *)buf;
+    return n;
+}
+
+/* Tells whether the records of an index are packed id blocks */
+static int
+idl_new_is_packed(backend *be, dbi_db_t *db, struct attrinfo *a)
+{
+    struct ldbminfo *li = (struct ldbminfo *)be->be_database->plg_private;
+    dblayer_private *priv = li->li_dblayer_private;
+
+    if (priv->dblayer_idl_packed_fn) {
+        return priv->dblayer_idl_packed_fn(be, db, a);
+    }
+    return a && a->ai_idl_format == IDL_FORMAT_PACKED;
+}
+
 IDList *
 idl_new_fetch(
     backend *be,
@@ -212,33 +296,38 @@ idl_new_fetch(
     for (;;) {
         ID lastid = 0;
         for (dblayer_bulk_start(&bulkdata); DBI_RC_SUCCESS == dblayer_bulk_nextdata(&bulkdata, &dataret);) {
-            if (dataret.size != sizeof(ID)) {
+            ID ids[IDL_PACKED_BLOCK_MAXIDS];
+            int nids = idl_packed_block_decode(dataret.data, dataret.size, ids, IDL_PACKED_BLOCK_MAXIDS);
+
+            if (nids < 0) {
                 slapi_log_err(SLAPI_LOG_ERR, "idl_new_fetch",
                         "Database index is corrupt; "
-                        "(attribute: %s) key %s has a data item with the wrong size (%ld)\n",
+                        "(attribute: %s) key %s has a malformed data item (size %ld)\n",
                         index_id, (char *)key.data, dataret.size);
                 goto error;
             }
-            memcpy(&id, dataret.data, sizeof(ID));
-            if (id == lastid) { /* dup */
-                slapi_log_err(SLAPI_LOG_TRACE, "idl_new_fetch",
-                        "Detected duplicate id %d due to DB_MULTIPLE error - skipping (attribute: %s)\n",
-                              id, index_id);
-                continue; /* get next one */
-            }
-            /* note the last id read to check for dups */
-            lastid = id;
-            /* we got another ID, add it to our IDL */
-            idl_rc = idl_append_extend(&idl, id);
-            if (idl_rc) {
-                slapi_log_err(SLAPI_LOG_ERR, "idl_new_fetch",
-                        "Unable to extend id list for attribute (%s) (err=%d)\n",
-                        index_id, idl_rc);
-                idl_free(&idl);
-                goto error;
-            }
+            for (int i = 0; i < nids; i++) {
+                id = ids[i];
+                if (id == lastid) { /* dup */
+                    slapi_log_err(SLAPI_LOG_TRACE, "idl_new_fetch",
+                            "Detected duplicate id %d due to DB_MULTIPLE error - skipping (attribute: %s)\n",
+                                  id, index_id);
+                    continue; /* get next one */
+                }
+                /* note the last id read to check for dups */
+                lastid = id;
+                /* we got another ID, add it to our IDL */
+                idl_rc = idl_append_extend(&idl, id);
+                if (idl_rc) {
+                    slapi_log_err(SLAPI_LOG_ERR, "idl_new_fetch",
+                            "Unable to extend id list for attribute (%s) (err=%d)\n",
+                            index_id, idl_rc);
+                    idl_free(&idl);
+                    goto error;
+                }
 
-            count++;
+                count++;
+            }
         }
 
         slapi_log_err(SLAPI_LOG_TRACE, "idl_new_fetch",
@@ -517,57 +606,62 @@ idl_new_range_fetch(
             key = (ID)strtol((char *)cur_key.data + 1, (char **)NULL, 10);
         }
         while (DBI_RC_SUCCESS == dblayer_bulk_nextdata(&bulkdata, &dataret)) {
-            if (dataret.size != sizeof(ID)) {
+            ID ids[IDL_PACKED_BLOCK_MAXIDS];
+            int nids = idl_packed_block_decode(dataret.data, dataret.size, ids, IDL_PACKED_BLOCK_MAXIDS);
+
+            if (nids < 0) {
                 slapi_log_err(SLAPI_LOG_ERR, "idl_new_range_fetch", "Database index is corrupt; "
-                                                                    "key %s has a data item with the wrong size (%ld)\n",
+                                                                    "key %s has a malformed data item (size %ld)\n",
                               (char *)cur_key.data, dataret.size);
                 goto error;
             }
-            memcpy(&id, dataret.data, sizeof(ID));
-            if (id == lastid) { /* dup */
-                slapi_log_err(SLAPI_LOG_TRACE, "idl_new_range_fetch",
-                              "Detected duplicate id %d due to DB_MULTIPLE error - skipping\n", id);
-                continue; /* get next one */
-            }
-            /* note the last id read to check for dups */
-            lastid = id;
-            /* we got another ID, add it to our IDL */
-            if (operator & SLAPI_OP_RANGE_NO_IDL_SORT) {
-                if ((count == 0) && (suffix == 0)) {
-                    /* First time.  Keep the suffix ID.
-                     * note that 'suffix==0' mean we did not retrieve the suffix entry id
-                     * from the parentid index (key '=0'), so let assume the first
-                     * found entry is the one from the suffix
-                     */
-                    suffix = key;
-                    idl_rc = idl_append_extend(&idl, id);
-                } else if ((key == suffix) || idl_id_is_in_idlist(idl, key)) {
-                    /* the parent is the suffix or already in idl. */
-                    idl_rc = idl_append_extend(&idl, id);
-                } else {
-                    /* Otherwise, keep the {key,id} in leftover array */
-                    if (!leftover) {
-                        leftover = (idl_range_id_pair *)slapi_ch_calloc(leftoverlen, sizeof(idl_range_id_pair));
-                    } else if (leftovercnt == leftoverlen) {
-                        leftover = (idl_range_id_pair *)slapi_ch_realloc((char *)leftover, 2 * leftoverlen * sizeof(idl_range_id_pair));
-                        memset(leftover + leftovercnt, 0, leftoverlen);
-                        leftoverlen *= 2;
+            for (int i = 0; i < nids; i++) {
+                id = ids[i];
+                if (id == lastid) { /* dup */
+                    slapi_log_err(SLAPI_LOG_TRACE, "idl_new_range_fetch",
+                                  "Detected duplicate id %d due to DB_MULTIPLE error - skipping\n", id);
+                    continue; /* get next one */
+                }
+                /* note the last id read to check for dups */
+                lastid = id;
+                /* we got another ID, add it to our IDL */
+                if (operator & SLAPI_OP_RANGE_NO_IDL_SORT) {
+                    if ((count == 0) && (suffix == 0)) {
+                        /* First time.  Keep the suffix ID.
+                         * note that 'suffix==0' mean we did not retrieve the suffix entry id
+                         * from the parentid index (key '=0'), so let assume the first
+                         * found entry is the one from the suffix
+                         */
+                        suffix = key;
+                        idl_rc = idl_append_extend(&idl, id);
+                    } else if ((key == suffix) || idl_id_is_in_idlist(idl, key)) {
+                        /* the parent is the suffix or already in idl. */
+                        idl_rc = idl_append_extend(&idl, id);
+                    } else {
+                        /* Otherwise, keep the {key,id} in leftover array */
+                        if (!leftover) {
+                            leftover = (idl_range_id_pair *)slapi_ch_calloc(leftoverlen, sizeof(idl_range_id_pair));
+                        } else if (leftovercnt == leftoverlen) {
+                            leftover = (idl_range_id_pair *)slapi_ch_realloc((char *)leftover, 2 * leftoverlen * sizeof(idl_range_id_pair));
+                            memset(leftover + leftovercnt, 0, leftoverlen);
+                            leftoverlen *= 2;
+                        }
+                        leftover[leftovercnt].key = key;
+                        leftover[leftovercnt].id = id;
+                        leftovercnt++;
                     }
-                    leftover[leftovercnt].key = key;
-                    leftover[leftovercnt].id = id;
-                    leftovercnt++;
+                } else {
+                    idl_rc = idl_append_extend(&idl, id);
+                }
+                if (idl_rc) {
+                    slapi_log_err(SLAPI_LOG_ERR, "idl_new_range_fetch",
+                                  "Unable to extend id list (err=%d)\n", idl_rc);
+                    idl_free(&idl);
+                    goto error;
                 }
-            } else {
-                idl_rc = idl_append_extend(&idl, id);
-            }
-            if (idl_rc) {
-                slapi_log_err(SLAPI_LOG_ERR, "idl_new_range_fetch",
-                              "Unable to extend id list (err=%d)\n", idl_rc);
-                idl_free(&idl);
-                goto error;
-            }
 
-            count++;
+                count++;
+            }
         }
 
         slapi_log_err(SLAPI_LOG_TRACE, "idl_new_range_fetch",
@@ -673,6 +767,222 @@ error:
     return idl;
 }
 
+/*
+ * Position the cursor on the block of a packed key that may hold id, that is
+ * the last block whose first id is lower or equal to id, and read it in data
+ * (a IDL_PACKED_BLOCK_MAXSIZE buffer).
+ * Returns DBI_RC_NOTFOUND if there is no such block. Then if *next is set,
+ * the cursor and data are on the first block of the key.
+ */
+static int
+idl_new_packed_seek(backend *be, dbi_cursor_t *cursor, dbi_val_t *key, ID id, dbi_val_t *data, int *next)
+{
+    dbi_val_t curkey = {0};
+    ID first = 0;
+    int ret = 0;
+
+    *next = 0;
+    memcpy(data->data, &id, sizeof(ID));
+    data->size = sizeof(ID);
+    ret = dblayer_cursor_op(cursor, DBI_OP_MOVE_NEAR_DATA, key, data);
+    if (ret == 0) {
+        memcpy(&first, data->data, sizeof(ID));
+        if (first == id) {
+            return 0;
+        }
+        /* The previous block of the key, if any, is the one */
+        dblayer_value_init(be, &curkey);
+        ret = dblayer_cursor_op(cursor, DBI_OP_PREV, &curkey, data);
+        if (ret == 0 && KEY_EQ(&curkey, key)) {
+            dblayer_value_free(be, &curkey);
+            return 0;
+        }
+        dblayer_value_free(be, &curkey);
+        if (ret && ret != DBI_RC_NOTFOUND) {
+            return ret;
+        }
+        /* id is lower than the ids of the key: go back to its first block */
+        memcpy(data->data, &id, sizeof(ID));
+        data->size = sizeof(ID);
+        ret = dblayer_cursor_op(cursor, DBI_OP_MOVE_NEAR_DATA, key, data);
+        if (ret == 0) {
+            *next = 1;
+            ret = DBI_RC_NOTFOUND;
+        }
+        return ret;
+    }
+    if (ret != DBI_RC_NOTFOUND) {
+        return ret;
+    }
+    /* id is greater than the first id of each block: get the last one */
+    ret = dblayer_cursor_op(cursor, DBI_OP_MOVE_TO_KEY, key, data);
+    if (ret) {
+        return ret;
+    }
+    dblayer_value_init(be, &curkey);
+    ret = dblayer_cursor_op(cursor, DBI_OP_NEXT_KEY, &curkey, data);
+    if (ret == 0) {
+        ret = dblayer_cursor_op(cursor, DBI_OP_PREV, &curkey, data);
+    } else if (ret == DBI_RC_NOTFOUND) {
+        ret = dblayer_cursor_op(cursor, DBI_OP_MOVE_TO_LAST, &curkey, data);
+    }
+    dblayer_value_free(be, &curkey);
+    return ret;
+}
+
+/* Write ids as packed blocks of key */
+static int
+idl_new_packed_put(dbi_cursor_t *cursor, dbi_val_t *key, const ID *ids, size_t nids, dbi_val_t *data)
+{
+    size_t size = 0;
+    int ret = 0;
+
+    for (size_t i = 0; ret == 0 && i < nids;) {
+        i += idl_packed_block_encode(ids + i, nids - i, data->data, &size);
+        data->size = size;
+        ret = dblayer_cursor_op(cursor, DBI_OP_ADD, key, data);
+        if (ret == DBI_RC_KEYEXIST) {
+            ret = 0;
+        }
+    }
+    return ret;
+}
+
+/* Insert id in the blocks of a packed key */
+static int
+idl_new_packed_insert_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, dbi_txn_t *txn, struct attrinfo *a)
+{
+    char block[IDL_PACKED_BLOCK_MAXSIZE];
+    ID ids[IDL_PACKED_BLOCK_MAXIDS + 1];
+    dbi_cursor_t cursor = {0};
+    dbi_val_t data = {0};
+    char *index_id = get_index_name(be, db, a);
+    size_t size = 0;
+    int nids = 0;
+    int next = 0;
+    int ret = 0;
+    int ret2 = 0;
+    int i;
+
+    ret = dblayer_new_cursor(be, db, txn, &cursor);
+    if (0 != ret) {
+        ldbm_nasty("idl_new_packed_insert_key - idl_new.c", index_id, 70, ret);
+        return ret;
+    }
+    dblayer_value_set_buffer(be, &data, block, sizeof(block));
+    ret = idl_new_packed_seek(be, &cursor, key, id, &data, &next);
+    if (ret == DBI_RC_NOTFOUND && !next) {
+        /* new key */
+        ids[0] = id;
+        ret = idl_new_packed_put(&cursor, key, ids, 1, &data);
+        goto error;
+    }
+    if (ret && !next) {
+        ldbm_nasty("idl_new_packed_insert_key - idl_new.c", index_id, 71, ret);
+        goto error;
+    }
+    nids = idl_packed_block_decode(data.data, data.size, ids, IDL_PACKED_BLOCK_MAXIDS);
+    if (nids < 0) {
+        slapi_log_err(SLAPI_LOG_ERR, "idl_new_packed_insert_key",
+                      "Database index is corrupt; (attribute: %s) key %s has a malformed data item\n",
+                      index_id, (char *)key->data);
+        ret = DBI_RC_INVALID;
+        goto error;
+    }
+    for (i = 0; i < nids && ids[i] < id; i++);
+    if (i < nids && ids[i] == id) {
+        ret = 0; /* already there */
+        goto error;
+    }
+    memmove(&ids[i + 1], &ids[i], (nids - i) * sizeof(ID));
+    ids[i] = id;
+    nids++;
+    if (next && idl_packed_block_encode(ids, nids, block, &size) < nids) {
+        /* id is before the first block which is full: just add it */
+        ret = idl_new_packed_put(&cursor, key, &id, 1, &data);
+        goto error;
+    }
+    /* replace the block (its first id may change and it may be split) */
+    ret = dblayer_cursor_op(&cursor, DBI_OP_DEL, key, &data);
+    if (ret == 0) {
+        ret = idl_new_packed_put(&cursor, key, ids, nids, &data);
+    }
+    if (ret) {
+        ldbm_nasty("idl_new_packed_insert_key - idl_new.c", index_id, 72, ret);
+    }
+error:
+    ret2 = dblayer_cursor_op(&cursor, DBI_OP_CLOSE, NULL, NULL);
+    if (ret2) {
+        ldbm_nasty("idl_new_packed_insert_key - idl_new.c", index_id, 73, ret2);
+        if (!ret) {
+            ret = ret2;
+        }
+    }
+    return ret;
+}
+
+/* Remove id from the blocks of a packed key */
+static int
+idl_new_packed_delete_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, dbi_txn_t *txn, struct attrinfo *a)
+{
+    char block[IDL_PACKED_BLOCK_MAXSIZE];
+    ID ids[IDL_PACKED_BLOCK_MAXIDS];
+    dbi_cursor_t cursor = {0};
+    dbi_val_t data = {0};
+    char *index_id = get_index_name(be, db, a);
+    int nids = 0;
+    int next = 0;
+    int ret = 0;
+    int ret2 = 0;
+    int i;
+
+    ret = dblayer_new_cursor(be, db, txn, &cursor);
+    if (0 != ret) {
+        ldbm_nasty("idl_new_packed_delete_key - idl_new.c", index_id, 75, ret);
+        return ret;
+    }
+    dblayer_value_set_buffer(be, &data, block, sizeof(block));
+    ret = idl_new_packed_seek(be, &cursor, key, id, &data, &next);
+    if (ret) {
+        if (DBI_RC_NOTFOUND == ret) {
+            ret = 0; /* Not Found is OK */
+        } else {
+            ldbm_nasty("idl_new_packed_delete_key - idl_new.c", index_id, 76, ret);
+        }
+        goto error;
+    }
+    nids = idl_packed_block_decode(data.data, data.size, ids, IDL_PACKED_BLOCK_MAXIDS);
+    if (nids < 0) {
+        slapi_log_err(SLAPI_LOG_ERR, "idl_new_packed_delete_key",
+                      "Database index is corrupt; (attribute: %s) key %s has a malformed data item\n",
+                      index_id, (char *)key->data);
+        ret = DBI_RC_INVALID;
+        goto error;
+    }
+    for (i = 0; i < nids && ids[i] != id; i++);
+    if (i == nids || id == ALLID) {
+        goto error; /* not there, or allid: never delete it */
+    }
+    memmove(&ids[i], &ids[i + 1], (nids - i - 1) * sizeof(ID));
+    nids--;
+    ret = dblayer_cursor_op(&cursor, DBI_OP_DEL, key, &data);
+    if (ret == 0 && nids > 0) {
+        ret = idl_new_packed_put(&cursor, key, ids, nids, &data);
+    }
+    if (ret) {
+        ldbm_nasty("idl_new_packed_delete_key - idl_new.c", index_id, 77, ret);
+    }
+error:
+    ret2 = dblayer_cursor_op(&cursor, DBI_OP_CLOSE, NULL, NULL);
+    if (ret2) {
+        ldbm_nasty("idl_new_packed_delete_key - idl_new.c", index_id, 78, ret2);
+        if (!ret) {
+            ret = ret2;
+        }
+    }
+    return ret;
+}
+
 int
 idl_new_insert_key(
     backend *be __attribute__((unused)),
@@ -752,11 +1062,14 @@ idl_new_insert_key(
         dblayer_bulk_free(be, &bulkdata);
     }
 #else
-    dblayer_value_set_buffer(be, &data, &id, sizeof(id));
-
     if (NULL != disposition) {
         *disposition = IDL_INSERT_NORMAL;
     }
+    if (idl_new_is_packed(be, db, a)) {
+        return idl_new_packed_insert_key(be, db, key, id, txn, a);
+    }
+
+    dblayer_value_set_buffer(be, &data, &id, sizeof(id));
 
     ret = dblayer_db_op(be, db, txn, DBI_OP_ADD, key, &data);
     if (0 != ret) {
@@ -784,7 +1097,12 @@ int idl_new_delete_key(
     int ret2 = 0;
     dbi_cursor_t cursor = {0};
     dbi_val_t data = {0};
-    char *index_id = get_index_name(be, db, a);
+    char *index_id = NULL;
+
+    if (idl_new_is_packed(be, db, a)) {
+        return idl_new_packed_delete_key(be, db, key, id, txn, a);
+    }
+    index_id = get_index_name(be, db, a);
 
     /* Make a cursor */
     ret = dblayer_new_cursor(be, db, txn, &cursor);
@@ -897,6 +1215,53 @@ error:
 }
 #endif
 
+/* Store idl in a packed key: a new key gets filled blocks directly */
+static int
+idl_new_packed_store_block(backend *be, dbi_db_t *db, dbi_val_t *key, IDList *idl, dbi_txn_t *txn, struct attrinfo *a)
+{
+    char block[IDL_PACKED_BLOCK_MAXSIZE];
+    dbi_cursor_t cursor = {0};
+    dbi_val_t data = {0};
+    char *index_id = get_index_name(be, db, a);
+    int sorted = 1;
+    int ret = 0;
+    int ret2 = 0;
+    size_t x = 0;
+
+    for (x = 1; sorted && x < idl->b_nids; x++) {
+        sorted = (idl->b_ids[x - 1] < idl->b_ids[x]);
+    }
+    ret = dblayer_new_cursor(be, db, txn, &cursor);
+    if (0 != ret) {
+        ldbm_nasty("idl_new_packed_store_block - idl_new.c", index_id, 80, ret);
+        return ret;
+    }
+    dblayer_value_set_buffer(be, &data, block, sizeof(block));
+    ret = dblayer_cursor_op(&cursor, DBI_OP_MOVE_TO_KEY, key, &data);
+    if (ret == DBI_RC_NOTFOUND && sorted) {
+        ret = idl_new_packed_put(&cursor, key, idl->b_ids, idl->b_nids, &data);
+        sorted = -1;
+    }
+    ret2 = dblayer_cursor_op(&cursor, DBI_OP_CLOSE, NULL, NULL);
+    if (sorted >= 0 && (ret == 0 || ret == DBI_RC_NOTFOUND)) {
+        /* merge with the existing blocks */
+        ret = 0;
+        for (x = 0; ret == 0 && x < idl->b_nids; x++) {
+            ret = idl_new_packed_insert_key(be, db, key, idl->b_ids[x], txn, a);
+        }
+    }
+    if (ret) {
+        ldbm_nasty("idl_new_packed_store_block - idl_new.c", index_id, 81, ret);
+    }
+    if (ret2) {
+        ldbm_nasty("idl_new_packed_store_block - idl_new.c", index_id, 82, ret2);
+        if (!ret) {
+            ret = ret2;
+        }
+    }
+    return ret;
+}
+
 int idl_new_store_block(
     backend * be __attribute__((unused)),
     dbi_db_t * db,
@@ -931,6 +1296,9 @@ int idl_new_store_block(
         return idl_new_store_allids(be, db, key, txn);
     }
 #endif
+    if (idl_new_is_packed(be, db, a)) {
+        return idl_new_packed_store_block(be, db, key, idl, txn, a);
+    }
 
     /* Make a cursor */
     ret = dblayer_new_cursor(be, db, txn, &cursor);
@@ -121,6 +121,7 @@ int
 idl_insert_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, back_txn *txn, struct attrinfo *a, int *disposition)
 {
     dbi_txn_t *db_txn = (txn != NULL) ? txn->back_txn_txn : NULL;
+    int rc;
 
     if (txn && txn->back_special_handling_fn) {
         index_update_t update;
@@ -129,14 +130,17 @@ idl_insert_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, back_txn *txn,
         update.a = a;
         update.disposition = disposition;
         dblayer_value_set_buffer(be, &data, &update, sizeof update);
-        return txn->back_special_handling_fn(be, BTXNACT_INDEX_ADD, db, key, &data, txn);
-    }
-
-    if (idl_new) {
-        return idl_new_insert_key(be, db, key, id, db_txn, a, disposition);
+        rc = txn->back_special_handling_fn(be, BTXNACT_INDEX_ADD, db, key, &data, txn);
+    } else if (idl_new) {
+        rc = idl_new_insert_key(be, db, key, id, db_txn, a, disposition);
     } else {
-        return idl_old_insert_key(be, db, key, id, db_txn, a, disposition);
+        rc = idl_old_insert_key(be, db, key, id, db_txn, a, disposition);
     }
+    /* only a key that made it to the index goes in the bloom filter */
+    if (rc == 0) {
+        ldbm_bloom_add(a, key);
+    }
+    return rc;
 }
 
 int
@@ -164,9 +168,15 @@ idl_delete_key(backend *be, dbi_db_t *db, dbi_val_t *key, ID id, back_txn *txn,
 int
 idl_store_block(backend *be, dbi_db_t *db, dbi_val_t *key, IDList *idl, dbi_txn_t *txn, struct attrinfo *a)
 {
+    int rc;
+
     if (idl_new) {
-        return idl_new_store_block(be, db, key, idl, txn, a);
+        rc = idl_new_store_block(be, db, key, idl, txn, a);
     } else {
-        return idl_old_store_block(be, db, key, idl, txn, a);
+        rc = idl_old_store_block(be, db, key, idl, txn, a);
+    }
+    if (rc == 0) {
+        ldbm_bloom_add(a, key);
     }
+    return rc;
 }
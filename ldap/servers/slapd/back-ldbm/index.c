@@ -915,6 +915,7 @@ index_read_ext_allids(
     struct attrinfo *ai = NULL;
     char *basetmp, *basetype;
     int retry_count = 0;
+    int bloom_consulted = 0;
     struct berval *encrypted_val = NULL;
     struct berval *hashed_val = NULL;
     int is_and = 0;
@@ -1063,30 +1064,39 @@ index_read_ext_allids(
     if (NULL != txn) {
         db_txn = txn->back_txn_txn;
     }
-    for (retry_count = 0; retry_count < IDL_FETCH_RETRY_COUNT; retry_count++) {
-        *err = NEW_IDL_DEFAULT;
-        PRIntervalTime interval;
-        idl_free(&idl);
-        idl = idl_fetch_ext(be, db, &key, db_txn, ai, err, allidslimit);
-        if (*err == DBI_RC_RETRY) {
-            ldbm_nasty("index_read_ext_allids", "index read retrying transaction", 1045, *err);
+    if (!ldbm_bloom_maybe(ai, &key, &bloom_consulted)) {
+        /* The bloom filter of the index knows the key does not exist */
+        *err = DBI_RC_NOTFOUND;
+        idl = idl_alloc(0);
+    } else {
+        for (retry_count = 0; retry_count < IDL_FETCH_RETRY_COUNT; retry_count++) {
+            *err = NEW_IDL_DEFAULT;
+            PRIntervalTime interval;
+            idl_free(&idl);
+            idl = idl_fetch_ext(be, db, &key, db_txn, ai, err, allidslimit);
+            if (*err == DBI_RC_RETRY) {
+                ldbm_nasty("index_read_ext_allids", "index read retrying transaction", 1045, *err);
 #ifdef FIX_TXN_DEADLOCKS
 #error can only retry here if txn == NULL - otherwise, have to abort and retry txn
 #endif
-            interval = PR_MillisecondsToInterval(slapi_rand() % 100);
-            DS_Sleep(interval);
-            continue;
-        } else if (*err != 0 || idl == NULL) {
-            /* The database might not exist. We have to assume it means empty set */
-            slapi_log_err(SLAPI_LOG_TRACE, "index_read_ext_allids", "Failed to access idl index for %s\n", basetype);
-            slapi_log_err(SLAPI_LOG_TRACE, "index_read_ext_allids", "Assuming %s has no index values\n", basetype);
-            idl_free(&idl);
-            idl = idl_alloc(0);
-            break;
-        } else {
-            break;
+                interval = PR_MillisecondsToInterval(slapi_rand() % 100);
+                DS_Sleep(interval);
+                continue;
+            } else if (*err != 0 || idl == NULL) {
+                /* The database might not exist. We have to assume it means empty set */
+                slapi_log_err(SLAPI_LOG_TRACE, "index_read_ext_allids", "Failed to access idl index for %s\n", basetype);
+                slapi_log_err(SLAPI_LOG_TRACE, "index_read_ext_allids", "Assuming %s has no index values\n", basetype);
+                idl_free(&idl);
+                idl = idl_alloc(0);
+                break;
+            } else {
+                break;
+            }
         }
     }
+    if (bloom_consulted && idl && IDL_NIDS(idl) == 0 && (*err == 0 || *err == DBI_RC_NOTFOUND)) {
+        ldbm_bloom_false_positive(ai);
+    }
     if (retry_count == IDL_FETCH_RETRY_COUNT) {
         ldbm_nasty("index_read_ext_allids", "index_read retry count exceeded", 1046, *err);
     } else if (*err != 0 && *err != DBI_RC_NOTFOUND) {
@@ -263,6 +263,10 @@ ldbm_instance_start(backend *be)
 
     PR_Unlock(be->be_state_lock);
 
+    if (rc == 0) {
+        ldbm_bloom_build_instance((ldbm_instance *)be->be_instance_info);
+    }
+
     return rc;
 }
 
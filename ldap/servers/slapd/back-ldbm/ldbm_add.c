@@ -626,10 +626,13 @@ ldbm_back_add(Slapi_PBlock *pb)
                 /*
                  * next_id will add this id to the list of ids that are pending
                  * id2entry indexing.
+                 * Replicated adds come in bursts from a few supplier
+                 * connections: they take their id from a per thread block.
                  */
                 Slapi_DN nscpEntrySDN;
                 addingentry = backentry_init(e);
-                if ((addingentry->ep_id = next_id(be)) >= MAXID) {
+                addingentry->ep_id = is_replicated_operation ? next_id_block(be) : next_id(be);
+                if (addingentry->ep_id >= MAXID) {
                     slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_add ",
                                   "Maximum ID reached, cannot add entry to "
                                   "backend '%s'",
@@ -58,6 +58,7 @@ attrinfo_delete(struct attrinfo **pp)
         slapi_ch_free((void **)&((*pp)->ai_attrcrypt));
         attr_done(&((*pp)->ai_sattr));
         attrinfo_delete_idlistinfo(&(*pp)->ai_idlistinfo);
+        ldbm_bloom_free(*pp);
         if ((*pp)->ai_dblayer) {
             /* attriinfo is deleted.  Cleaning up the backpointer at the same time. */
             ((dblayer_handle *)((*pp)->ai_dblayer))->dblayer_handle_ai_backpointer = NULL;
@@ -138,6 +139,8 @@ ainfo_dup(
     /* copy cmp functions and substr lengths */
     a->ai_key_cmp_fn = b->ai_key_cmp_fn;
     a->ai_dup_cmp_fn = b->ai_dup_cmp_fn;
+    a->ai_idl_format = b->ai_idl_format;
+    a->ai_bloom_filter = b->ai_bloom_filter;
     if (b->ai_substr_lens) {
         size_t substrlen = sizeof(int) * INDEX_SUBSTRLEN;
         a->ai_substr_lens = (int *)slapi_ch_calloc(1, substrlen);
@@ -676,6 +679,7 @@ attr_index_config(
     int mr_count = 0;
     char myreturntext[SLAPI_DSE_RETURNTEXT_SIZE];
     int substrval = 0;
+    const char *idlformat = NULL;
 
     /* Get the cn */
     if (0 == slapi_entry_attr_find(e, "cn", &attr)) {
@@ -793,6 +797,33 @@ attr_index_config(
     }
     a->ai_substr_lens = substrlens;
 
+    /*
+     * nsIndexIDListFormat: packed
+     */
+    idlformat = slapi_entry_attr_get_ref(e, INDEX_ATTR_IDLISTFORMAT);
+    if (idlformat == NULL || strcasecmp(idlformat, "plain") == 0) {
+        a->ai_idl_format = IDL_FORMAT_PLAIN;
+    } else if (strcasecmp(idlformat, "packed") == 0) {
+        a->ai_idl_format = IDL_FORMAT_PACKED;
+    } else {
+        slapi_create_errormsg(err_buf, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "Error: %s: line %d: unknown %s \"%s\" in entry (%s), "
+                              "valid values are \"plain\" or \"packed\"\n",
+                              fname, lineno, INDEX_ATTR_IDLISTFORMAT, idlformat, slapi_entry_get_dn(e));
+        slapi_log_err(SLAPI_LOG_ERR, "attr_index_config",
+                      "%s: line %d: unknown %s \"%s\" in entry (%s), "
+                      "valid values are \"plain\" or \"packed\"\n",
+                      fname, lineno, INDEX_ATTR_IDLISTFORMAT, idlformat, slapi_entry_get_dn(e));
+        slapi_ch_free((void **)&a->ai_substr_lens);
+        attrinfo_delete(&a);
+        return -1;
+    }
+
+    /*
+     * nsIndexBloomFilter: on
+     */
+    a->ai_bloom_filter = slapi_entry_attr_get_bool(e, INDEX_ATTR_BLOOMFILTER);
+
     if (0 == slapi_entry_attr_find(e, "nsMatchingRule", &attr)) {
         char **official_rules;
         size_t k = 0;
@@ -0,0 +1,403 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2019 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* ldbm_bloom.c - bloom filters of the equality keys of an index */
+
+#include "back-ldbm.h"
+
+/*
+ * An index configured with nsIndexBloomFilter: on keeps a bloom filter of
+ * its equality keys, so equality lookups of keys that do not exist (unique
+ * attribute checks, referential integrity, dna, memberOf "member=dn" ...)
+ * are answered without a B-tree descent.
+ *
+ * The filter is built by walking the keys of the index when the instance
+ * starts and once an import or a reindex is over. The walk runs in a
+ * write txn, so the updates in progress are either seen by the walk or
+ * wait for the filter to be published and then add their keys in it.
+ * Keys are never removed: a deleted key only costs a false positive.
+ * When too many keys were added since the build, the filter is no more
+ * used until the next build.
+ */
+
+#define BLOOM_NHASHES       7       /* about 1% false positives ... */
+#define BLOOM_BITS_PER_KEY  10      /* ... with this many bits per key */
+#define BLOOM_MIN_BITS      4096
+#define BLOOM_MAX_FILL      0.6     /* fill ratio above which the filter is not used */
+
+#define BLOOM_INVALID       0       /* not built */
+#define BLOOM_READY         1
+#define BLOOM_OVERFULL      2       /* built but too many keys were added */
+
+struct ldbm_bloom
+{
+    Slapi_RWLock *lock;             /* protects bits against a rebuild */
+    uint64_t *bits;
+    uint64_t nbits;                 /* power of 2 */
+    uint64_t nbset;                 /* number of bits set */
+    uint64_t maxset;                /* overfull limit of nbset */
+    uint64_t nkeys;                 /* keys found by the build */
+    int state;
+    uint64_t lookups;               /* lookups the filter was consulted for */
+    uint64_t negatives;             /* lookups answered by the filter */
+    uint64_t falsepositives;        /* lookups of missing keys the filter let through */
+};
+
+static const char eq_prefix[] = {EQ_PREFIX, 0};
+static const char hash_eq_prefix[] = {HASH_PREFIX, EQ_PREFIX, 0};
+
+/* Only the equality keys (possibly hashed because they are too large) are filtered */
+static int
+bloom_is_eq_key(const dbi_val_t *key)
+{
+    const char *pt = key->data;
+
+    if (key->size < 1) {
+        return 0;
+    }
+    return pt[0] == EQ_PREFIX || (key->size > 1 && pt[0] == HASH_PREFIX && pt[1] == EQ_PREFIX);
+}
+
+/* 64 bits FNV-1a hash of the key */
+static uint64_t
+bloom_hash(const dbi_val_t *key)
+{
+    const unsigned char *pt = key->data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < key->size; i++) {
+        h ^= pt[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* Derive the filter bits from the key hash (double hashing) */
+static inline uint64_t
+bloom_bit(uint64_t hash, int i, uint64_t nbits)
+{
+    uint64_t h2 = (hash >> 32) | (hash << 32);
+
+    h2 = (h2 ^ (h2 >> 29)) * 0xbf58476d1ce4e5b9ULL;
+    return (hash + i * (h2 | 1)) & (nbits - 1);
+}
+
+static void
+bloom_set(struct ldbm_bloom *bf, uint64_t hash)
+{
+    for (int i = 0; i < BLOOM_NHASHES; i++) {
+        uint64_t bit = bloom_bit(hash, i, bf->nbits);
+        uint64_t mask = 1ULL << (bit & 63);
+
+        if (!(__atomic_fetch_or(&bf->bits[bit >> 6], mask, __ATOMIC_RELAXED) & mask)) {
+            if (__atomic_add_fetch(&bf->nbset, 1, __ATOMIC_RELAXED) > bf->maxset) {
+                __atomic_store_n(&bf->state, BLOOM_OVERFULL, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+static int
+bloom_test(struct ldbm_bloom *bf, uint64_t hash)
+{
+    for (int i = 0; i < BLOOM_NHASHES; i++) {
+        uint64_t bit = bloom_bit(hash, i, bf->nbits);
+
+        if (!(__atomic_load_n(&bf->bits[bit >> 6], __ATOMIC_RELAXED) & (1ULL << (bit & 63)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static struct ldbm_bloom *
+bloom_get(struct attrinfo *ai, int create)
+{
+    struct ldbm_bloom *bf = ai ? __atomic_load_n(&ai->ai_bloom, __ATOMIC_ACQUIRE) : NULL;
+    struct ldbm_bloom *expected = NULL;
+
+    if (bf || !create || !ai) {
+        return bf;
+    }
+    bf = (struct ldbm_bloom *)slapi_ch_calloc(1, sizeof(struct ldbm_bloom));
+    bf->lock = slapi_new_rwlock();
+    if (!__atomic_compare_exchange_n(&ai->ai_bloom, &expected, bf, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        slapi_destroy_rwlock(bf->lock);
+        slapi_ch_free((void **)&bf);
+        bf = expected;
+    }
+    return bf;
+}
+
+/* Append the hashes of the keys starting with prefix */
+static int
+bloom_walk_keys(backend *be, dbi_cursor_t *cursor, const char *prefix, uint64_t **hashes, size_t *nhashes, size_t *maxhashes)
+{
+    size_t plen = strlen(prefix);
+    dbi_val_t key = {0};
+    dbi_val_t data = {0};
+    int rc;
+
+    dblayer_value_strdup(be, &key, (char *)prefix);
+    rc = dblayer_cursor_op(cursor, DBI_OP_MOVE_NEAR_KEY, &key, &data);
+    while (rc == 0 && key.size >= plen && strncmp(key.data, prefix, plen) == 0) {
+        if (*nhashes == *maxhashes) {
+            *maxhashes = *maxhashes ? 2 * *maxhashes : 1024;
+            *hashes = (uint64_t *)slapi_ch_realloc((char *)*hashes, *maxhashes * sizeof(uint64_t));
+        }
+        (*hashes)[(*nhashes)++] = bloom_hash(&key);
+        rc = dblayer_cursor_op(cursor, DBI_OP_NEXT_KEY, &key, &data);
+    }
+    dblayer_value_free(be, &key);
+    dblayer_value_free(be, &data);
+    return (rc == DBI_RC_NOTFOUND) ? 0 : rc;
+}
+
+/* Build the filter of an index from its keys */
+int
+ldbm_bloom_build(backend *be, struct attrinfo *ai)
+{
+    struct ldbm_bloom *bf = bloom_get(ai, 1);
+    struct ldbm_bloom tmp = {0};
+    dbi_cursor_t cursor = {0};
+    uint64_t *hashes = NULL;
+    size_t nhashes = 0;
+    size_t maxhashes = 0;
+    dbi_db_t *db = NULL;
+    back_txn txn = {0};
+    uint64_t *oldbits = NULL;
+    int rc;
+
+    rc = dblayer_get_index_file(be, ai, &db, DBOPEN_CREATE);
+    if (rc) {
+        return rc;
+    }
+    rc = dblayer_txn_begin(be, NULL, &txn);
+    if (rc == 0) {
+        rc = dblayer_new_cursor(be, db, txn.back_txn_txn, &cursor);
+        if (rc == 0) {
+            rc = bloom_walk_keys(be, &cursor, eq_prefix, &hashes, &nhashes, &maxhashes);
+            if (rc == 0) {
+                rc = bloom_walk_keys(be, &cursor, hash_eq_prefix, &hashes, &nhashes, &maxhashes);
+            }
+            dblayer_cursor_op(&cursor, DBI_OP_CLOSE, NULL, NULL);
+        }
+        if (rc == 0) {
+            /* Leave room for as many new keys as there are keys */
+            tmp.nbits = BLOOM_MIN_BITS;
+            while (tmp.nbits < 2 * nhashes * BLOOM_BITS_PER_KEY) {
+                tmp.nbits <<= 1;
+            }
+            tmp.bits = (uint64_t *)slapi_ch_calloc(tmp.nbits / 64, sizeof(uint64_t));
+            tmp.maxset = (uint64_t)(BLOOM_MAX_FILL * tmp.nbits);
+            for (size_t i = 0; i < nhashes; i++) {
+                bloom_set(&tmp, hashes[i]);
+            }
+            /* Publish the filter before the txn ends and updates resume */
+            slapi_rwlock_wrlock(bf->lock);
+            oldbits = bf->bits;
+            bf->bits = tmp.bits;
+            bf->nbits = tmp.nbits;
+            bf->nbset = tmp.nbset;
+            bf->maxset = tmp.maxset;
+            bf->nkeys = nhashes;
+            __atomic_store_n(&bf->state, BLOOM_READY, __ATOMIC_RELAXED);
+            slapi_rwlock_unlock(bf->lock);
+            slapi_ch_free((void **)&oldbits);
+        }
+        /* Nothing was written */
+        dblayer_txn_abort(be, &txn);
+    }
+    dblayer_release_index_file(be, ai, db);
+    slapi_ch_free((void **)&hashes);
+    if (rc) {
+        slapi_log_err(SLAPI_LOG_ERR, "ldbm_bloom_build", "Failed to build the bloom filter of index %s. Error %d\n",
+                      ai->ai_type, rc);
+    } else {
+        slapi_log_err(SLAPI_LOG_INFO, "ldbm_bloom_build", "Bloom filter of index %s built with %lu keys (%lu bytes).\n",
+                      ai->ai_type, (u_long)nhashes, (u_long)(tmp.nbits / 8));
+    }
+    return rc;
+}
+
+/* Stop using the filter of an index, until its next build */
+void
+ldbm_bloom_invalidate(struct attrinfo *ai)
+{
+    struct ldbm_bloom *bf = bloom_get(ai, 0);
+
+    if (bf) {
+        slapi_rwlock_wrlock(bf->lock);
+        slapi_ch_free((void **)&bf->bits);
+        bf->nbits = bf->nbset = bf->nkeys = 0;
+        __atomic_store_n(&bf->state, BLOOM_INVALID, __ATOMIC_RELAXED);
+        slapi_rwlock_unlock(bf->lock);
+    }
+}
+
+static int
+bloom_build_cb(caddr_t data, caddr_t arg)
+{
+    struct attrinfo *ai = (struct attrinfo *)data;
+
+    if (ai->ai_bloom_filter && (ai->ai_indexmask & INDEX_EQUALITY)) {
+        ldbm_bloom_build((backend *)arg, ai);
+    } else {
+        ldbm_bloom_invalidate(ai);
+    }
+    return 0;
+}
+
+static int
+bloom_invalidate_cb(caddr_t data, caddr_t arg __attribute__((unused)))
+{
+    ldbm_bloom_invalidate((struct attrinfo *)data);
+    return 0;
+}
+
+/* (Re)build the filters of the indexes configured with nsIndexBloomFilter */
+void
+ldbm_bloom_build_instance(ldbm_instance *inst)
+{
+    avl_apply(inst->inst_attrs, bloom_build_cb, (caddr_t)inst->inst_be, -1, AVL_INORDER);
+}
+
+/* Called before the indexes are rewritten without ldbm_bloom_add (import, reindex) */
+void
+ldbm_bloom_invalidate_instance(ldbm_instance *inst)
+{
+    avl_apply(inst->inst_attrs, bloom_invalidate_cb, NULL, -1, AVL_INORDER);
+}
+
+/* A key is added in an index */
+void
+ldbm_bloom_add(struct attrinfo *ai, const dbi_val_t *key)
+{
+    struct ldbm_bloom *bf = bloom_get(ai, 0);
+
+    if (bf && bloom_is_eq_key(key)) {
+        slapi_rwlock_rdlock(bf->lock);
+        if (bf->bits) {
+            bloom_set(bf, bloom_hash(key));
+        }
+        slapi_rwlock_unlock(bf->lock);
+    }
+}
+
+/*
+ * Tells whether an index may hold a key.
+ * Returns 0 only if the filter is sure the key does not exist.
+ * *consulted is set when the filter was used.
+ */
+int
+ldbm_bloom_maybe(struct attrinfo *ai, const dbi_val_t *key, int *consulted)
+{
+    struct ldbm_bloom *bf = bloom_get(ai, 0);
+    int rc = 1;
+
+    *consulted = 0;
+    if (bf && ai->ai_bloom_filter && bloom_is_eq_key(key)) {
+        slapi_rwlock_rdlock(bf->lock);
+        if (__atomic_load_n(&bf->state, __ATOMIC_RELAXED) == BLOOM_READY) {
+            *consulted = 1;
+            __atomic_add_fetch(&bf->lookups, 1, __ATOMIC_RELAXED);
+            rc = bloom_test(bf, bloom_hash(key));
+            if (!rc) {
+                __atomic_add_fetch(&bf->negatives, 1, __ATOMIC_RELAXED);
+            }
+        }
+        slapi_rwlock_unlock(bf->lock);
+    }
+    return rc;
+}
+
+/* The filter let through a key that does not exist */
+void
+ldbm_bloom_false_positive(struct attrinfo *ai)
+{
+    struct ldbm_bloom *bf = bloom_get(ai, 0);
+
+    if (bf) {
+        __atomic_add_fetch(&bf->falsepositives, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void
+ldbm_bloom_free(struct attrinfo *ai)
+{
+    struct ldbm_bloom *bf = ai->ai_bloom;
+
+    if (bf) {
+        slapi_destroy_rwlock(bf->lock);
+        slapi_ch_free((void **)&bf->bits);
+        slapi_ch_free((void **)&ai->ai_bloom);
+    }
+}
+
+static int
+bloom_monitor_cb(caddr_t data, caddr_t arg)
+{
+    struct attrinfo *ai = (struct attrinfo *)data;
+    char ***values = (char ***)arg;
+    struct ldbm_bloom *bf = bloom_get(ai, 0);
+    static const char *states[] = {"invalid", "ready", "overfull"};
+    uint64_t negatives, falsepositives;
+    char buf[BUFSIZ];
+
+    if (!bf || !ai->ai_bloom_filter) {
+        return 0;
+    }
+    slapi_rwlock_rdlock(bf->lock);
+    negatives = __atomic_load_n(&bf->negatives, __ATOMIC_RELAXED);
+    falsepositives = __atomic_load_n(&bf->falsepositives, __ATOMIC_RELAXED);
+    /* The false positive rate is measured on the lookups of missing keys */
+    PR_snprintf(buf, sizeof(buf),
+                "%s state=%s keys=%" PRIu64 " bytes=%" PRIu64 " fill=%.3f lookups=%" PRIu64
+                " negatives=%" PRIu64 " falsepositives=%" PRIu64 " falsepositiverate=%.4f",
+                ai->ai_type, states[__atomic_load_n(&bf->state, __ATOMIC_RELAXED)], bf->nkeys, bf->nbits / 8,
+                bf->nbits ? (double)__atomic_load_n(&bf->nbset, __ATOMIC_RELAXED) / bf->nbits : 0.0,
+                __atomic_load_n(&bf->lookups, __ATOMIC_RELAXED), negatives, falsepositives,
+                (negatives + falsepositives) ? (double)falsepositives / (negatives + falsepositives) : 0.0);
+    slapi_rwlock_unlock(bf->lock);
+    charray_add(values, slapi_ch_strdup(buf));
+    return 0;
+}
+
+/* Set the indexBloomFilter values of the instance monitor entry */
+void
+ldbm_bloom_monitor(ldbm_instance *inst, Slapi_Entry *e)
+{
+    char **values = NULL;
+    struct berval *bvals = NULL;
+    struct berval **vals = NULL;
+    size_t nb = 0;
+
+    avl_apply(inst->inst_attrs, bloom_monitor_cb, (caddr_t)&values, -1, AVL_INORDER);
+    if (values == NULL) {
+        attrlist_delete(&e->e_attrs, "indexBloomFilter");
+        return;
+    }
+    while (values[nb]) {
+        nb++;
+    }
+    bvals = (struct berval *)slapi_ch_calloc(nb, sizeof(struct berval));
+    vals = (struct berval **)slapi_ch_calloc(nb + 1, sizeof(struct berval *));
+    for (size_t i = 0; i < nb; i++) {
+        bvals[i].bv_val = values[i];
+        bvals[i].bv_len = strlen(values[i]);
+        vals[i] = &bvals[i];
+    }
+    attrlist_replace(&e->e_attrs, "indexBloomFilter", vals);
+    slapi_ch_free((void **)&vals);
+    slapi_ch_free((void **)&bvals);
+    charray_free(values);
+}
@@ -223,6 +223,56 @@ bail:
     return rc;
 }
 
+/*
+ * Tells whether changing the id list format of an index to the one of
+ * entryAfter would make its existing keys unreadable.  Unless the database
+ * layer tells the format from the database itself, the keys are read with
+ * the configured format: a plain record is a packed block of one id, but
+ * packed blocks cannot be read as plain records until the index is rebuilt.
+ */
+static int
+ldbm_index_idl_format_locked(ldbm_instance *inst, struct attrinfo *ainfo, Slapi_Entry *entryAfter)
+{
+    struct ldbminfo *li = inst->inst_li;
+    dblayer_private *priv = (dblayer_private *)li->li_dblayer_private;
+    const char *idlformat = slapi_entry_attr_get_ref(entryAfter, INDEX_ATTR_IDLISTFORMAT);
+    int format = IDL_FORMAT_PLAIN;
+    dbi_db_t *db = NULL;
+    dbi_cursor_t dbc = {0};
+    dbi_val_t key = {0};
+    dbi_val_t value = {0};
+    int has_data = 0;
+
+    if (priv->dblayer_idl_packed_fn) {
+        return 0;
+    }
+    if (idlformat && strcasecmp(idlformat, "packed") == 0) {
+        format = IDL_FORMAT_PACKED;
+    } else if (idlformat && strcasecmp(idlformat, "plain") != 0) {
+        return 0; /* rejected by attr_index_config */
+    }
+    if (format == IDL_FORMAT_PACKED || ainfo->ai_idl_format != IDL_FORMAT_PACKED) {
+        return 0;
+    }
+
+    /* no index file: nothing to misread */
+    if (dblayer_get_index_file(inst->inst_be, ainfo, &db, 0) != 0) {
+        return 0;
+    }
+    dblayer_value_init(inst->inst_be, &key);
+    dblayer_value_init(inst->inst_be, &value);
+    if (dblayer_new_cursor(inst->inst_be, db, NULL, &dbc) == 0) {
+        has_data = (dblayer_cursor_op(&dbc, DBI_OP_MOVE_TO_FIRST, &key, &value) != DBI_RC_NOTFOUND);
+        dblayer_cursor_op(&dbc, DBI_OP_CLOSE, NULL, NULL);
+    } else {
+        has_data = 1;
+    }
+    dblayer_value_free(inst->inst_be, &value);
+    dblayer_value_free(inst->inst_be, &key);
+    dblayer_release_index_file(inst->inst_be, ainfo, db);
+    return has_data;
+}
+
 /*
  * Config DSE callback for index entry changes.
  *
@@ -294,6 +344,19 @@ ldbm_instance_index_config_modify_callback(Slapi_PBlock *pb __attribute__((unuse
         return SLAPI_DSE_CALLBACK_ERROR;
     }
 
+    if (ldbm_index_idl_format_locked(inst, ainfo, entryAfter)) {
+        slapi_create_errormsg(returntext, SLAPI_DSE_RETURNTEXT_SIZE,
+                              "Error: index %s is not empty, %s can only be set back to plain "
+                              "when the server is stopped, followed by a reindex\n",
+                              edn, INDEX_ATTR_IDLISTFORMAT);
+        slapi_log_err(SLAPI_LOG_ERR,
+                      "ldbm_instance_index_config_modify_callback", "Index %s is not empty, %s can only be set back to plain "
+                                                                    "when the server is stopped, followed by a reindex\n",
+                      edn, INDEX_ATTR_IDLISTFORMAT);
+        *returncode = LDAP_UNWILLING_TO_PERFORM;
+        return SLAPI_DSE_CALLBACK_ERROR;
+    }
+
     if (attr_index_config(inst->inst_be, "from DSE modify", 0, entryAfter, 0, 0, returntext)) {
         *returncode = LDAP_UNWILLING_TO_PERFORM;
         return SLAPI_DSE_CALLBACK_ERROR;
@@ -384,6 +447,18 @@ ldbm_instance_config_add_index_entry(
         }
     }
 
+    /* get nsIndexIDListFormat, if any */
+    if (slapi_entry_attr_get_ref(e, INDEX_ATTR_IDLISTFORMAT)) {
+        eBuf = PR_sprintf_append(eBuf, "%s: %s\n", INDEX_ATTR_IDLISTFORMAT,
+                                 slapi_entry_attr_get_ref(e, INDEX_ATTR_IDLISTFORMAT));
+    }
+
+    /* get nsIndexBloomFilter, if any */
+    if (slapi_entry_attr_get_ref(e, INDEX_ATTR_BLOOMFILTER)) {
+        eBuf = PR_sprintf_append(eBuf, "%s: %s\n", INDEX_ATTR_BLOOMFILTER,
+                                 slapi_entry_attr_get_ref(e, INDEX_ATTR_BLOOMFILTER));
+    }
+
     ldbm_config_add_dse_entry(li, eBuf, flags);
     if (eBuf) {
         PR_smprintf_free(eBuf);
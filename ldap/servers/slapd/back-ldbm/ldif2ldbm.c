@@ -199,6 +199,252 @@ ldbm_back_ldbm2ldif(Slapi_PBlock *pb)
 }
 
 
+#define DB2INDEX_ONLINE_BATCH 100 /* entries indexed per transaction */
+
+/*
+ * Add the keys of a tombstone to an index being built online.
+ * Like index_addordel_entry() for a tombstone, only objectclass
+ * (nstombstone), nsuniqueid, nscpentrydn, nstombstonecsn, entryusn
+ * and parentid get keys.
+ */
+static int
+ldbm2index_online_tombstone(backend *be, struct backentry *ep, struct attrinfo *ai, back_txn *txn)
+{
+    Slapi_Entry *e = ep->ep_entry;
+    const char *value = NULL;
+    char deletion_csn_str[CSN_STRSIZE];
+    Slapi_DN parent;
+    int rc = 0;
+
+    slapi_sdn_init(&parent);
+    if (strcasecmp(ai->ai_type, SLAPI_ATTR_OBJECTCLASS) == 0) {
+        value = SLAPI_ATTR_VALUE_TOMBSTONE;
+    } else if (strcasecmp(ai->ai_type, SLAPI_ATTR_UNIQUEID) == 0) {
+        value = slapi_entry_get_uniqueid(e);
+    } else if (strcasecmp(ai->ai_type, SLAPI_ATTR_NSCP_ENTRYDN) == 0) {
+        slapi_sdn_get_parent(slapi_entry_get_sdn(e), &parent);
+        value = slapi_sdn_get_ndn(&parent);
+    } else if (strcasecmp(ai->ai_type, SLAPI_ATTR_TOMBSTONE_CSN) == 0) {
+        const CSN *tombstone_csn = entry_get_deletion_csn(e);
+        if (tombstone_csn) {
+            csn_as_string(tombstone_csn, PR_FALSE, deletion_csn_str);
+            value = deletion_csn_str;
+        }
+    } else if (strcasecmp(ai->ai_type, SLAPI_ATTR_ENTRYUSN) == 0) {
+        value = slapi_entry_attr_get_ref(e, SLAPI_ATTR_ENTRYUSN);
+    } else if (strcasecmp(ai->ai_type, LDBM_PARENTID_STR) == 0 && entryrdn_get_switch()) {
+        Slapi_Attr *attr = NULL;
+        if (slapi_entry_attr_find(e, LDBM_PARENTID_STR, &attr) == 0) {
+            rc = index_addordel_values_sv(be, LDBM_PARENTID_STR, attr_get_present_values(attr),
+                                          NULL, ep->ep_id, BE_INDEX_ADD, txn);
+        }
+    }
+    if (value) {
+        rc = index_addordel_string(be, ai->ai_type, value, ep->ep_id, BE_INDEX_ADD, txn);
+    }
+    slapi_sdn_done(&parent);
+    return rc;
+}
+
+/*
+ * Add the keys of one entry to the indexes being built online.
+ * IDs without entry are holes left by deletes.
+ */
+static int
+ldbm2index_online_entry(backend *be, ID id, struct attrinfo **ais, back_txn *txn)
+{
+    ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
+    struct backentry *ep = NULL;
+    Slapi_Attr *attr = NULL;
+    char *type = NULL;
+    int err = 0;
+    int rc = 0;
+
+    ep = id2entry(be, id, txn, &err);
+    if (ep == NULL) {
+        return (err == DBI_RC_NOTFOUND) ? 0 : err;
+    }
+    if (slapi_entry_flag_is_set(ep->ep_entry, SLAPI_ENTRY_FLAG_TOMBSTONE)) {
+        for (size_t i = 0; rc == 0 && ais[i]; i++) {
+            rc = ldbm2index_online_tombstone(be, ep, ais[i], txn);
+        }
+        CACHE_RETURN(&inst->inst_cache, &ep);
+        return rc;
+    }
+    for (size_t i = 0; rc == 0 && ais[i]; i++) {
+        for (int r = slapi_entry_first_attr(ep->ep_entry, &attr); rc == 0 && r == 0;
+             r = slapi_entry_next_attr(ep->ep_entry, attr, &attr)) {
+            slapi_attr_get_type(attr, &type);
+            if (slapi_attr_type_cmp(ais[i]->ai_type, type, SLAPI_TYPE_CMP_BASE) == 0) {
+                rc = index_addordel_values_sv(be, type, attr_get_present_values(attr),
+                                              NULL, id, BE_INDEX_ADD, txn);
+            }
+        }
+    }
+    CACHE_RETURN(&inst->inst_cache, &ep);
+    return rc;
+}
+
+/*
+ * ldbm_back_ldbm2index_online - build already configured indexes without
+ * making the backend read-only.
+ *
+ * The indexes stay INDEX_OFFLINE, so filter_candidates does not use them,
+ * while id2entry is scanned in ID order.  Updates keep maintaining an
+ * offline index, and each batch of the scan runs in a backend transaction
+ * that is serialized with them: an entry below the high-water mark was
+ * either indexed by the scan after its last update, or by that update.
+ * The indexes go online once the mark reaches the last ID.  Keys left by
+ * an earlier build are not removed, reindex offline to drop them.
+ */
+static int
+ldbm_back_ldbm2index_online(Slapi_PBlock *pb)
+{
+    struct ldbminfo *li = NULL;
+    ldbm_instance *inst = NULL;
+    Slapi_Task *task = NULL;
+    char *instance_name = NULL;
+    char **indexlist = NULL;
+    char *attrs_str = NULL;
+    char *prev = NULL;
+    struct attrinfo **ais = NULL;
+    back_txn txn = {0};
+    backend *be;
+    size_t nais = 0;
+    ID id, lastid;
+    int rc = -1;
+
+    slapi_pblock_get(pb, SLAPI_PLUGIN_PRIVATE, &li);
+    slapi_pblock_get(pb, SLAPI_BACKEND_INSTANCE_NAME, &instance_name);
+    slapi_pblock_get(pb, SLAPI_BACKEND_TASK, &task);
+    slapi_pblock_get(pb, SLAPI_DB2INDEX_ATTRS, &indexlist);
+
+    inst = ldbm_instance_find_by_name(li, instance_name);
+    if (NULL == inst) {
+        slapi_task_log_notice(task, "Unknown ldbm instance %s", instance_name);
+        slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_ldbm2index_online", "Unknown ldbm instance %s\n",
+                      instance_name);
+        return rc;
+    }
+    be = inst->inst_be;
+    slapi_pblock_set(pb, SLAPI_BACKEND, be);
+
+    for (size_t i = 0; indexlist && indexlist[i]; i++) {
+        nais++;
+    }
+    ais = (struct attrinfo **)slapi_ch_calloc(nais + 1, sizeof(struct attrinfo *));
+    nais = 0;
+    for (size_t i = 0; indexlist && indexlist[i]; i++) {
+        struct attrinfo *ai = NULL;
+        char *type = indexlist[i] + 1;
+
+        if (indexlist[i][0] != 't' ||
+            strcasecmp(type, LDBM_ENTRYRDN_STR) == 0 ||
+            strcasecmp(type, LDBM_ANCESTORID_STR) == 0) {
+            slapi_task_log_notice(task, "%s: index %s can not be built online.",
+                                  inst->inst_name, type);
+            slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_ldbm2index_online",
+                          "%s: index %s can not be built online.\n", inst->inst_name, type);
+            goto out;
+        }
+        ainfo_get(be, type, &ai);
+        if (ai == NULL || !(ai->ai_indexmask & INDEX_ANY) ||
+            slapi_attr_type_cmp(ai->ai_type, type, SLAPI_TYPE_CMP_BASE) != 0) {
+            slapi_task_log_notice(task, "%s: attribute %s has no index configuration.",
+                                  inst->inst_name, type);
+            slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_ldbm2index_online",
+                          "%s: attribute %s has no index configuration.\n", inst->inst_name, type);
+            goto out;
+        }
+        ais[nais++] = ai;
+        prev = attrs_str;
+        attrs_str = slapi_ch_smprintf("%s%s%s", prev ? prev : "", prev ? " " : "", ai->ai_type);
+        slapi_ch_free_string(&prev);
+    }
+
+    /* make sure no other tasks are going, the backend stays writable */
+    if (instance_set_busy(inst) != 0) {
+        slapi_task_log_notice(task,
+                "%s: is already in the middle of another task and cannot be disturbed.",
+                inst->inst_name);
+        slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_ldbm2index_online", "ldbm: '%s' is already in the middle of "
+                                                                      "another task and cannot be disturbed.\n",
+                      inst->inst_name);
+        goto out;
+    }
+
+    for (size_t i = 0; i < nais; i++) {
+        ais[i]->ai_indexmask |= INDEX_OFFLINE;
+    }
+    /* entries added from now on get IDs above lastid and are indexed by the add */
+    lastid = next_id_get(be) - 1;
+    PR_Lock(inst->inst_config_mutex);
+    inst->inst_online_index_attrs = attrs_str;
+    PR_Unlock(inst->inst_config_mutex);
+    slapi_atomic_store_64(&inst->inst_online_index_mark, 0, __ATOMIC_RELAXED);
+    slapi_atomic_store_64(&inst->inst_online_index_last, lastid, __ATOMIC_RELEASE);
+    slapi_log_err(SLAPI_LOG_INFO, "ldbm_back_ldbm2index_online", "%s: Indexing %s online up to ID %lu.\n",
+                  inst->inst_name, attrs_str, (u_long)lastid);
+
+    rc = 0;
+    for (id = 1; rc == 0 && id <= lastid;) {
+        ID batch_end = (lastid - id < DB2INDEX_ONLINE_BATCH) ? lastid : id + DB2INDEX_ONLINE_BATCH - 1;
+
+        if (g_get_shutdown() || c_get_shutdown()) {
+            rc = -1;
+            break;
+        }
+        rc = dblayer_txn_begin(be, NULL, &txn);
+        if (rc) {
+            break;
+        }
+        for (; rc == 0 && id <= batch_end; id++) {
+            rc = ldbm2index_online_entry(be, id, ais, &txn);
+        }
+        if (rc) {
+            dblayer_txn_abort(be, &txn);
+            break;
+        }
+        rc = dblayer_txn_commit(be, &txn);
+        if (rc == 0) {
+            slapi_atomic_store_64(&inst->inst_online_index_mark, batch_end, __ATOMIC_RELEASE);
+            if ((batch_end / DB2INDEX_ONLINE_BATCH) % 100 == 0 || batch_end == lastid) {
+                slapi_task_log_status(task, "%s: Indexed %lu of %lu entries.",
+                                      inst->inst_name, (u_long)batch_end, (u_long)lastid);
+            }
+        }
+    }
+
+    if (rc == 0) {
+        for (size_t i = 0; i < nais; i++) {
+            ais[i]->ai_indexmask &= ~INDEX_OFFLINE;
+            if (ais[i]->ai_bloom_filter && (ais[i]->ai_indexmask & INDEX_EQUALITY)) {
+                ldbm_bloom_build(be, ais[i]);
+            }
+        }
+        slapi_task_log_notice(task, "%s: Finished online indexing of %s.", inst->inst_name, attrs_str);
+        slapi_log_err(SLAPI_LOG_INFO, "ldbm_back_ldbm2index_online", "%s: Finished online indexing of %s.\n",
+                      inst->inst_name, attrs_str);
+    } else {
+        /* the indexes stay offline until they are rebuilt */
+        ID mark = (ID)slapi_atomic_load_64(&inst->inst_online_index_mark, __ATOMIC_ACQUIRE);
+        slapi_task_log_notice(task, "%s: Online indexing of %s stopped after ID %lu (error %d).",
+                              inst->inst_name, attrs_str, (u_long)mark, rc);
+        slapi_log_err(SLAPI_LOG_ERR, "ldbm_back_ldbm2index_online", "%s: Online indexing of %s stopped after ID %lu (error %d).\n",
+                      inst->inst_name, attrs_str, (u_long)mark, rc);
+    }
+    slapi_atomic_store_64(&inst->inst_online_index_last, 0, __ATOMIC_RELEASE);
+    PR_Lock(inst->inst_config_mutex);
+    inst->inst_online_index_attrs = NULL;
+    PR_Unlock(inst->inst_config_mutex);
+    instance_set_not_busy(inst);
+
+out:
+    slapi_ch_free_string(&attrs_str);
+    slapi_ch_free((void **)&ais);
+    return rc;
+}
+
 /*
  * ldbm_back_ldbm2index - backend routine to create a new index from an
  * existing database
@@ -214,6 +460,10 @@ ldbm_back_ldbm2index(Slapi_PBlock *pb)
     slapi_pblock_get(pb, SLAPI_TASK_FLAGS, &task_flags);
     run_from_cmdline = (task_flags & SLAPI_TASK_RUNNING_FROM_COMMANDLINE);
 
+    if (!run_from_cmdline && (task_flags & SLAPI_TASK_ONLINE_INDEX)) {
+        return ldbm_back_ldbm2index_online(pb);
+    }
+
     if (run_from_cmdline) {
         li->li_flags |= SLAPI_TASK_RUNNING_FROM_COMMANDLINE;
 
@@ -15,30 +15,85 @@
 
 #include "back-ldbm.h"
 
+/*
+ * Block of IDs reserved by a thread (see next_id_block).  It is only valid
+ * for the instance and the generation of inst_nextid it was taken from: the
+ * generation changes each time inst_nextid is reloaded from id2entry (after
+ * an import, a restore ...) and is unique among all the instances.
+ */
+typedef struct
+{
+    ldbm_instance *inst;
+    uint64_t gen;
+    ID first; /* first ID of the block */
+    ID next;  /* next ID to hand out */
+    ID last;  /* last ID of the block */
+} nextid_block_t;
+
+static pthread_key_t nextid_block_key;
+static pthread_once_t nextid_block_once = PTHREAD_ONCE_INIT;
+static uint64_t nextid_generation;
+
+static void
+nextid_block_destroy(void *block)
+{
+    slapi_ch_free(&block);
+}
+
+static void
+nextid_block_key_init(void)
+{
+    if (pthread_key_create(&nextid_block_key, nextid_block_destroy) != 0) {
+        slapi_log_err(SLAPI_LOG_ERR, "nextid_block_key_init", "Failed to create pthread key.\n");
+    }
+}
+
+static nextid_block_t *
+nextid_get_block(void)
+{
+    nextid_block_t *block;
+
+    (void)pthread_once(&nextid_block_once, nextid_block_key_init);
+    block = (nextid_block_t *)pthread_getspecific(nextid_block_key);
+    if (block == NULL) {
+        block = (nextid_block_t *)slapi_ch_calloc(1, sizeof(nextid_block_t));
+        pthread_setspecific(nextid_block_key, block);
+    }
+    return block;
+}
+
+/*
+ * Reserve count consecutive entry IDs and return the first one.
+ * The range is taken with an atomic fetch-add so that parallel adds,
+ * replication apply or bulk loaders never wait on each other.  A caller
+ * may keep a range for itself and hand out its IDs without any further
+ * synchronization.  IDs of a range that end up unused are only a gap:
+ * the next id is recomputed from id2entry at startup, so the high
+ * watermark does not need to be stored.
+ */
 ID
-next_id(backend *be)
+next_id_reserve(backend *be, ID count)
 {
     ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
     ID id;
+    ID last;
 
-    PR_Lock(inst->inst_nextid_mutex);
+    id = __atomic_fetch_add(&inst->inst_nextid, count, __ATOMIC_RELAXED);
 
     /* Test if nextid hasn't been initialized. */
-    if (inst->inst_nextid < 1) {
+    if (id < 1) {
         slapi_log_err(SLAPI_LOG_CRIT,
                       "next_id", "nextid not initialized... exiting.\n");
         exit(1);
     }
 
-    /* Increment the in-memory nextid */
-    inst->inst_nextid++;
-    id = inst->inst_nextid - 1;
-
-    PR_Unlock(inst->inst_nextid_mutex);
-
     /* if ID is above the threshold, the database may need rebuilding soon */
-    if (id >= ID_WARNING_THRESHOLD) {
-        if (id >= MAXID) {
+    last = id + count - 1;
+    if (last < id) {
+        last = MAXID; /* wrapped around */
+    }
+    if (last >= ID_WARNING_THRESHOLD) {
+        if (last >= MAXID) {
             slapi_log_err(SLAPI_LOG_ALERT,
                           "next_id", "FATAL ERROR: backend '%s' has no"
                                      "IDs left. DATABASE MUST BE REBUILT.\n",
@@ -54,31 +109,69 @@ next_id(backend *be)
     return (id);
 }
 
+ID
+next_id(backend *be)
+{
+    return next_id_reserve(be, 1);
+}
+
+/*
+ * Same as next_id but the ID is taken from a block of NEXTID_BLOCK_SIZE IDs
+ * reserved by the calling thread, so that threads applying replicated
+ * updates do not all hit inst_nextid for each entry.  The IDs of the
+ * different threads interleave: as after a move, a child may get a lower
+ * ID than its parent.
+ */
+ID
+next_id_block(backend *be)
+{
+    ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
+    nextid_block_t *block = nextid_get_block();
+    uint64_t gen = __atomic_load_n(&inst->inst_nextid_gen, __ATOMIC_ACQUIRE);
+    ID id;
+
+    if (block->inst != inst || block->gen != gen || block->next > block->last) {
+        id = next_id_reserve(be, NEXTID_BLOCK_SIZE);
+        if (id >= MAXID) {
+            return MAXID;
+        }
+        block->inst = inst;
+        block->gen = gen;
+        block->first = id;
+        block->next = id;
+        block->last = id + NEXTID_BLOCK_SIZE - 1;
+    }
+    return block->next++;
+}
+
 void
 next_id_return(backend *be, ID id)
 {
     ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
-
-    /*Lock*/
-    PR_Lock(inst->inst_nextid_mutex);
+    nextid_block_t *block;
+    ID expected = id + 1;
 
     /*Test if nextid hasn't been initialized. */
-    if (inst->inst_nextid < 1) {
+    if (__atomic_load_n(&inst->inst_nextid, __ATOMIC_RELAXED) < 1) {
         slapi_log_err(SLAPI_LOG_CRIT,
                       "next_id_return", "nextid not initialized... exiting\n");
         exit(1);
     }
 
-    if (id != inst->inst_nextid - 1) {
-        PR_Unlock(inst->inst_nextid_mutex);
+    /* An ID of the thread block goes back to the block if it is the last
+     * one taken from it */
+    block = nextid_get_block();
+    if (block->inst == inst &&
+        block->gen == __atomic_load_n(&inst->inst_nextid_gen, __ATOMIC_ACQUIRE) &&
+        id >= block->first && id + 1 == block->next) {
+        block->next = id;
         return;
     }
 
-    /*decrement the in-memory version*/
-    inst->inst_nextid--;
-
-    /*unlock this bad boy*/
-    PR_Unlock(inst->inst_nextid_mutex);
+    /* Only the last given ID can be reclaimed: if another ID has been
+     * handed out meanwhile, this one is just left as a gap */
+    __atomic_compare_exchange_n(&inst->inst_nextid, &expected, id, 0,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
 }
 
 ID
@@ -87,22 +180,31 @@ next_id_get(backend *be)
     ldbm_instance *inst = (ldbm_instance *)be->be_instance_info;
     ID id;
 
-    /*lock*/
-    PR_Lock(inst->inst_nextid_mutex);
+    id = __atomic_load_n(&inst->inst_nextid, __ATOMIC_RELAXED);
 
     /*Test if nextid hasn't been initialized.*/
-    if (inst->inst_nextid < 1) {
+    if (id < 1) {
         slapi_log_err(SLAPI_LOG_CRIT,
                       "next_id_get", "nextid not initialized... exiting\n");
         exit(1);
     }
 
-    id = inst->inst_nextid;
-    PR_Unlock(inst->inst_nextid_mutex);
-
     return (id);
 }
 
+/*
+ * Reset the next id of the instance.  A new generation is taken so that
+ * the blocks the threads still hold from the previous value are dropped.
+ */
+static void
+next_id_set(ldbm_instance *inst, ID id)
+{
+    __atomic_store_n(&inst->inst_nextid, id, __ATOMIC_RELEASE);
+    __atomic_store_n(&inst->inst_nextid_gen,
+                     __atomic_add_fetch(&nextid_generation, 1, __ATOMIC_RELAXED),
+                     __ATOMIC_RELEASE);
+}
+
 /*
  *  Function: get_ids_from_disk
  *
@@ -136,7 +238,7 @@ get_ids_from_disk(backend *be)
    * are no entries, and that nextid should be 1
    */
     if (id2entrydb == NULL) {
-        inst->inst_nextid = 1;
+        next_id_set(inst, 1);
 
         /* unlock */
         PR_Unlock(inst->inst_nextid_mutex);
@@ -155,15 +257,15 @@ get_ids_from_disk(backend *be)
         if (0 == return_value) {
             return_value = dblayer_cursor_op(&dbc, DBI_OP_MOVE_TO_LAST, &key, &value);
             if ((0 == return_value) && (NULL != key.dptr)) {
-                inst->inst_nextid = id_stored_to_internal(key.dptr) + 1;
+                next_id_set(inst, id_stored_to_internal(key.dptr) + 1);
             } else {
-                inst->inst_nextid = 1; /* error case: set 1 */
+                next_id_set(inst, 1); /* error case: set 1 */
             }
             dblayer_cursor_op(&dbc, DBI_OP_CLOSE, NULL, NULL);
             dblayer_value_free(be, &value);
             dblayer_value_free(be, &key);
         } else {
-            inst->inst_nextid = 1; /* when there is no id2entry, start from id 1 */
+            next_id_set(inst, 1); /* when there is no id2entry, start from id 1 */
         }
     }
 
@@ -33,6 +33,19 @@ int ldbm_compute_init(void);
 void attrinfo_deletetree(ldbm_instance *inst);
 void attr_create_empty(backend *be, char *type, struct attrinfo **ai);
 
+/*
+ * ldbm_bloom.c
+ */
+int ldbm_bloom_build(backend *be, struct attrinfo *ai);
+void ldbm_bloom_invalidate(struct attrinfo *ai);
+void ldbm_bloom_build_instance(ldbm_instance *inst);
+void ldbm_bloom_invalidate_instance(ldbm_instance *inst);
+void ldbm_bloom_add(struct attrinfo *ai, const dbi_val_t *key);
+int ldbm_bloom_maybe(struct attrinfo *ai, const dbi_val_t *key, int *consulted);
+void ldbm_bloom_false_positive(struct attrinfo *ai);
+void ldbm_bloom_free(struct attrinfo *ai);
+void ldbm_bloom_monitor(ldbm_instance *inst, Slapi_Entry *e);
+
 /*
  * cache.c
  */
@@ -230,6 +243,8 @@ int idl_get_tune(void);
 size_t idl_get_allidslimit(struct attrinfo *a, int allidslimit);
 int idl_get_idl_new(void);
 IDList *idl_new_range_fetch(backend *be, dbi_db_t *db, dbi_val_t *lowerkey, dbi_val_t *upperkey, dbi_txn_t *txn, struct attrinfo *a, int *flag_err, int allidslimit, int sizelimit, struct timespec *expire_time, int lookthrough_limit, int operator);
+int idl_packed_block_decode(const void *data, size_t size, ID *ids, size_t maxids);
+size_t idl_packed_block_encode(const ID *ids, size_t nids, char *buf, size_t *size);
 char *get_index_name(backend *be, dbi_db_t *db, struct attrinfo *a);
 
 int64_t idl_compare(IDList *a, IDList *b);
@@ -347,6 +362,8 @@ void ldbm_set_error(Slapi_PBlock *pb, int retval, int *ldap_result_code, char **
  * nextid.c
  */
 ID next_id(backend *be);
+ID next_id_reserve(backend *be, ID count);
+ID next_id_block(backend *be);
 void next_id_return(backend *be, ID id);
 ID next_id_get(backend *be);
 void id_internal_to_stored(ID, char *);
@@ -109,6 +109,14 @@ slapi_filter_test_ext_internal(
         return (0);
     }
 
+    /*
+     * Components added by a search rewriter to reach the indexes are
+     * implied by the rest of the filter: they never exclude an entry.
+     */
+    if (f->f_flags & SLAPI_FILTER_CANDIDATES_ONLY) {
+        return (0);
+    }
+
     switch (f->f_choice) {
     case LDAP_FILTER_EQUALITY:
         slapi_log_err(SLAPI_LOG_FILTER, "slapi_filter_test_ext_internal", "EQUALITY\n");
@@ -799,6 +807,11 @@ slapi_vattr_filter_test_ext_internal(
         return (0);
     }
 
+    /* see slapi_filter_test_ext_internal */
+    if (f->f_flags & SLAPI_FILTER_CANDIDATES_ONLY) {
+        return (0);
+    }
+
     switch (f->f_choice) {
     case LDAP_FILTER_EQUALITY:
         if (verify_access) {
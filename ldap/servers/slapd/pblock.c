@@ -2114,6 +2114,13 @@ slapi_pblock_get(Slapi_PBlock *pblock, int arg, void *value)
             (*(int *)value) = 0;
         }
         break;
+    case SLAPI_BACKUP_INCREMENTAL_BASE:
+        if (pblock->pb_task != NULL) {
+            (*(char **)value) = pblock->pb_task->backup_base;
+        } else {
+            (*(char **)value) = NULL;
+        }
+        break;
 
     /* dbverify */
     case SLAPI_DBVERIFY_DBDIR:
@@ -2123,6 +2130,13 @@ slapi_pblock_get(Slapi_PBlock *pblock, int arg, void *value)
             (*(char **)value) = NULL;
         }
         break;
+    case SLAPI_DBVERIFY_SAMPLE:
+        if (pblock->pb_task != NULL) {
+            (*(int *)value) = pblock->pb_task->dbverify_sample;
+        } else {
+            (*(int *)value) = 0;
+        }
+        break;
 
 
     /* transaction arguments */
@@ -3920,6 +3934,10 @@ slapi_pblock_set(Slapi_PBlock *pblock, int arg, void *value)
         _pblock_assert_pb_task(pblock);
         pblock->pb_task->ldif_include_changelog = *((int *)value);
         break;
+    case SLAPI_BACKUP_INCREMENTAL_BASE:
+        _pblock_assert_pb_task(pblock);
+        pblock->pb_task->backup_base = (char *)value;
+        break;
 
     case SLAPI_LDIF2DB_ENCRYPT:
     case SLAPI_DB2LDIF_DECRYPT:
@@ -3931,6 +3949,10 @@ slapi_pblock_set(Slapi_PBlock *pblock, int arg, void *value)
         _pblock_assert_pb_task(pblock);
         pblock->pb_task->dbverify_dbdir = (char *)value;
         break;
+    case SLAPI_DBVERIFY_SAMPLE:
+        _pblock_assert_pb_task(pblock);
+        pblock->pb_task->dbverify_sample = *((int *)value);
+        break;
 
 
     /* transaction arguments */
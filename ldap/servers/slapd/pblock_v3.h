@@ -45,6 +45,7 @@ typedef struct _slapi_pblock_task
     Slapi_Task *task;
     char *seq_attrname;
     char *seq_val;
+    char *backup_base; /* db2bak: base of an incremental backup */
     char *dbverify_dbdir;
     char *ldif_file;
     char **db2index_attrs;
@@ -66,6 +67,7 @@ typedef struct _slapi_pblock_task
     int seq_type;
     int removedupvals;
     int ldif2db_noattrindexes;
+    int dbverify_sample;
     int ldif_printkey;
     int task_flags;
     int32_t task_warning;
@@ -601,6 +601,7 @@ struct slapi_value_set
     size_t max;     /* The number of slots in the array */
     size_t *sorted; /* sorted array of indices, if NULL va is not sorted */
     struct slapi_value **va;
+    struct valueset_hash *hash; /* hash index of large valuesets, used instead of sorted */
 };
 
 struct valuearrayfast
@@ -6658,6 +6658,7 @@ int slapi_config_remove_callback(int operation, int flags, const char *base, int
 /* task flag (pb_task_flags)*/
 #define SLAPI_TASK_RUNNING_AS_TASK          0x0
 #define SLAPI_TASK_RUNNING_FROM_COMMANDLINE 0x1
+#define SLAPI_TASK_ONLINE_INDEX             0x2 /* db2index keeps the backend writable */
 
 /* task flags (set by the task-control code) */
 #define SLAPI_TASK_DESTROYING 0x01 /* queued event for destruction */
@@ -7470,6 +7471,8 @@ typedef enum _slapi_op_note_t {
 /* dump uniqueid */
 #define SLAPI_DB2LDIF_DUMP_UNIQUEID  176
 #define SLAPI_LDIF_CHANGELOG  1761
+/* db2bak: directory of the backup an incremental backup is based on */
+#define SLAPI_BACKUP_INCREMENTAL_BASE 1762
 #define SLAPI_DB2LDIF_SERVER_RUNNING 197
 
 /* db2ldif/ldif2db/bak2db/db2bak arguments */
@@ -7547,6 +7550,7 @@ typedef enum _slapi_op_note_t {
 
 /* dbverify */
 #define SLAPI_DBVERIFY_DBDIR 1947
+#define SLAPI_DBVERIFY_SAMPLE 1951 /* cross check one index record out of n */
 
 /* convenience macros for checking modify operation types */
 #define SLAPI_IS_MOD_ADD(x)     (((x) & ~LDAP_MOD_BVALUES) == LDAP_MOD_ADD)
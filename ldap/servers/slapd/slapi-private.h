@@ -59,6 +59,8 @@ typedef enum _slapi_filter_flags_t {
     SLAPI_FILTER_NORMALIZED_VALUE = 16,
     SLAPI_FILTER_INVALID_ATTR_UNDEFINE = 32,
     SLAPI_FILTER_INVALID_ATTR_WARN = 64,
+    /* component only narrows the candidate list, entries always match it */
+    SLAPI_FILTER_CANDIDATES_ONLY = 128,
 } slapi_filter_flags;
 
 #define SLAPI_ENTRY_LDAPSUBENTRY 2
@@ -520,6 +522,7 @@ int slapi_entry_vattrcache_findAndTest(const Slapi_Entry *e, const char *type, S
 int slapi_vattrcache_iscacheable(const char *type);
 void slapi_vattrcache_cache_all(void);
 void slapi_vattrcache_cache_none(void);
+int slapi_vattr_is_virtual_type(Slapi_DN *namespace_dn, const char *type);
 
 int vattr_test_filter(Slapi_PBlock *pb,
                       /* Entry we're interested in */ Slapi_Entry *e,
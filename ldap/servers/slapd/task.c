@@ -1502,8 +1502,11 @@ task_backup_thread(void *arg)
 
     slapi_task_finish(task, rv);
     char *seq_val = NULL;
+    char *backup_base = NULL;
     slapi_pblock_get(pb, SLAPI_SEQ_VAL, &seq_val);
     slapi_ch_free((void **)&seq_val);
+    slapi_pblock_get(pb, SLAPI_BACKUP_INCREMENTAL_BASE, &backup_base);
+    slapi_ch_free_string(&backup_base);
     slapi_pblock_destroy(pb);
     g_decr_active_threadcnt();
 }
@@ -1591,6 +1594,9 @@ task_backup_add(Slapi_PBlock *pb __attribute__((unused)),
     }
     char *seq_val = slapi_ch_strdup(archive_dir);
     slapi_pblock_set(mypb, SLAPI_SEQ_VAL, seq_val);
+    /* incremental backup: only store what changed since that backup */
+    char *backup_base = slapi_entry_attr_get_charptr(e, "nsIncrementalBase");
+    slapi_pblock_set(mypb, SLAPI_BACKUP_INCREMENTAL_BASE, backup_base);
     slapi_pblock_set(mypb, SLAPI_PLUGIN, (be->be_database));
     slapi_pblock_set(mypb, SLAPI_BACKEND_TASK, task);
     int32_t task_flags = SLAPI_TASK_RUNNING_AS_TASK;
@@ -1606,6 +1612,7 @@ task_backup_add(Slapi_PBlock *pb __attribute__((unused)),
         *returncode = LDAP_OPERATIONS_ERROR;
         rv = SLAPI_DSE_CALLBACK_ERROR;
         slapi_ch_free((void **)&seq_val);
+        slapi_ch_free_string(&backup_base);
         slapi_pblock_destroy(mypb);
         goto out;
     }
@@ -1906,6 +1913,10 @@ task_index_add(Slapi_PBlock *pb __attribute__((unused)),
     slapi_pblock_set(mypb, SLAPI_PLUGIN, be->be_database);
     slapi_pblock_set(mypb, SLAPI_BACKEND_TASK, task);
     int32_t task_flags = SLAPI_TASK_RUNNING_AS_TASK;
+    /* build the indexes while the backend keeps serving updates */
+    if (strcasecmp(slapi_fetch_attr(e, "nsIndexOnline", "false"), "true") == 0) {
+        task_flags |= SLAPI_TASK_ONLINE_INDEX;
+    }
     slapi_pblock_set(mypb, SLAPI_TASK_FLAGS, &task_flags);
     char *copy_instance_name = slapi_ch_strdup(instance_name);
     slapi_pblock_set(mypb, SLAPI_BACKEND_INSTANCE_NAME, copy_instance_name);
@@ -2048,6 +2059,127 @@ out:
     return SLAPI_DSE_CALLBACK_OK;
 }
 
+static void
+task_dbverify_thread(void *arg)
+{
+    Slapi_PBlock *pb = (Slapi_PBlock *)arg;
+    char **instance_names = NULL;
+    Slapi_Task *task = NULL;
+    struct slapdplugin *pb_plugin;
+    int rv;
+
+    slapi_pblock_get(pb, SLAPI_BACKEND_TASK, &task);
+    slapi_pblock_get(pb, SLAPI_PLUGIN, &pb_plugin);
+    slapi_pblock_get(pb, SLAPI_BACKEND_INSTANCE_NAME, &instance_names);
+
+    g_incr_active_threadcnt();
+    slapi_task_begin(task, 1);
+
+    rv = (*pb_plugin->plg_dbverify)(pb);
+    if (rv != 0) {
+        slapi_task_log_notice(task, "Verify failed (error %d)", rv);
+        slapi_task_log_status(task, "Verify failed (error %d)", rv);
+        slapi_log_err(SLAPI_LOG_ERR, "task_dbverify_thread", "Verify failed (error %d)\n", rv);
+    }
+
+    slapi_task_finish(task, rv);
+    charray_free(instance_names);
+    slapi_pblock_destroy(pb);
+    g_decr_active_threadcnt();
+}
+
+/*
+ * verify the running database
+ *
+ *   dn: cn=verify_it,cn=dbverify,cn=tasks,cn=config
+ *   objectclass: top
+ *   objectclass: extensibleObject
+ *   cn: verify_it
+ *   nsInstance: userRoot          (optional, all backends by default)
+ *   nsVerifySampleRate: 100       (optional, cross check 1 index record out of 100)
+ */
+static int
+task_dbverify_add(Slapi_PBlock *pb __attribute__((unused)),
+                  Slapi_Entry *e,
+                  Slapi_Entry *eAfter __attribute__((unused)),
+                  int *returncode,
+                  char *returntext __attribute__((unused)),
+                  void *arg __attribute__((unused)))
+{
+    int rv = SLAPI_DSE_CALLBACK_OK;
+    Slapi_Backend *be = NULL;
+    Slapi_Task *task = NULL;
+    Slapi_PBlock *mypb = NULL;
+    PRThread *thread = NULL;
+    char **instance_names = NULL;
+    char *cookie = NULL;
+
+    *returncode = LDAP_SUCCESS;
+    if (slapi_entry_attr_get_ref(e, "cn") == NULL) {
+        *returncode = LDAP_OBJECT_CLASS_VIOLATION;
+        rv = SLAPI_DSE_CALLBACK_ERROR;
+        goto out;
+    }
+
+    /* get backend that has dbverify */
+    be = slapi_get_first_backend(&cookie);
+    while (be) {
+        if (NULL != be->be_database->plg_dbverify)
+            break;
+
+        be = (backend *)slapi_get_next_backend(cookie);
+    }
+    slapi_ch_free_string(&cookie);
+    if (NULL == be) {
+        slapi_log_err(SLAPI_LOG_ERR, "task_dbverify_add", "No dbverify is defined.\n");
+        *returncode = LDAP_UNWILLING_TO_PERFORM;
+        rv = SLAPI_DSE_CALLBACK_ERROR;
+        goto out;
+    }
+
+    /* allocate new task now */
+    task = slapi_new_task(slapi_entry_get_ndn(e));
+    if (task == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR, "task_dbverify_add", "Unable to allocate new task!\n");
+        *returncode = LDAP_OPERATIONS_ERROR;
+        rv = SLAPI_DSE_CALLBACK_ERROR;
+        goto out;
+    }
+
+    instance_names = slapi_entry_attr_get_charray(e, "nsInstance");
+    int32_t sample = slapi_entry_attr_get_int(e, "nsVerifySampleRate");
+    mypb = slapi_pblock_new();
+    slapi_pblock_set(mypb, SLAPI_PLUGIN, be->be_database);
+    slapi_pblock_set(mypb, SLAPI_BACKEND_TASK, task);
+    slapi_pblock_set(mypb, SLAPI_BACKEND_INSTANCE_NAME, instance_names);
+    slapi_pblock_set(mypb, SLAPI_DBVERIFY_SAMPLE, &sample);
+    int32_t task_flags = SLAPI_TASK_RUNNING_AS_TASK;
+    slapi_pblock_set(mypb, SLAPI_TASK_FLAGS, &task_flags);
+
+    /* start the verify as a separate thread */
+    thread = PR_CreateThread(PR_USER_THREAD, task_dbverify_thread,
+                             (void *)mypb, PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                             PR_UNJOINABLE_THREAD, SLAPD_DEFAULT_THREAD_STACKSIZE);
+    if (thread == NULL) {
+        slapi_log_err(SLAPI_LOG_ERR,
+                      "task_dbverify_add", "Unable to create dbverify thread!\n");
+        *returncode = LDAP_OPERATIONS_ERROR;
+        rv = SLAPI_DSE_CALLBACK_ERROR;
+        charray_free(instance_names);
+        slapi_pblock_destroy(mypb);
+        goto out;
+    }
+
+    /* thread successful -- don't free the pb, let the thread do that. */
+    return SLAPI_DSE_CALLBACK_OK;
+
+out:
+    if (task) {
+        destroy_task(1, task);
+    }
+    return rv;
+}
+
 /*
  * sysconfig reload task
  *
@@ -2829,6 +2961,7 @@ task_init(void)
     slapi_task_register_handler("restore", task_restore_add);
     slapi_task_register_handler("index", task_index_add);
     slapi_task_register_handler("upgradedb", task_upgradedb_add);
+    slapi_task_register_handler("dbverify", task_dbverify_add);
     slapi_task_register_handler("sysconfig reload", task_sysconfig_reload_add);
     slapi_task_register_handler("fixup tombstones", task_fixup_tombstones_add);
     slapi_task_register_handler("compact db", task_compact_db_add);
@@ -31,6 +31,8 @@
 #include "nspr.h"
 #include <netinet/in.h>
 #include <inttypes.h>
+#include <zlib.h>
+#include "../../plugins/replication/cl5_compress.h"
 
 
 #if (defined(hpux))
@@ -159,30 +161,6 @@ db_printfln(const char *fmt, ...)
 uint32_t MAX_BUFFER = 4096;
 uint32_t MIN_BUFFER = 20;
 
-static IDL *
-idl_make(dbi_val_t *data)
-{
-    IDL *idl = NULL, *xidl;
-
-    if (data->size < 2 * sizeof(uint32_t)) {
-        idl = (IDL *)malloc(sizeof(IDL) + 64 * sizeof(ID));
-        if (!idl)
-            return NULL;
-        idl->max = 64;
-        idl->used = 1;
-        idl->id[0] = *(ID *)(data->data);
-        return idl;
-    }
-
-    xidl = (IDL *)(data->data);
-    idl = (IDL *)malloc(data->size);
-    if (!idl)
-        return NULL;
-
-    memcpy(idl, xidl, data->size);
-    return idl;
-}
-
 static void
 idl_free(IDL *idl)
 {
@@ -205,6 +183,67 @@ idl_append(IDL *idl, ID id)
     return idl;
 }
 
+/*
+ * Append the ids of an index record: a single id, or a packed block
+ * (first id followed by varint coded deltas, see nsIndexIDListFormat)
+ */
+static IDL *
+idl_append_block(IDL *idl, dbi_val_t *data)
+{
+    unsigned char *pt = (unsigned char *)data->data + sizeof(ID);
+    unsigned char *end = (unsigned char *)data->data + data->size;
+    ID id = 0;
+
+    if (data->size < sizeof(ID)) {
+        free(idl);
+        return NULL;
+    }
+    memcpy(&id, data->data, sizeof(ID));
+    idl = idl_append(idl, id);
+    while (idl && pt < end) {
+        ID delta = 0;
+        int shift = 0;
+
+        do {
+            if (pt >= end || shift > 28) {
+                free(idl);
+                return NULL;
+            }
+            delta |= (ID)(*pt & 0x7f) << shift;
+            shift += 7;
+        } while (*pt++ & 0x80);
+        id += delta;
+        idl = idl_append(idl, id);
+    }
+    return idl;
+}
+
+static IDL *
+idl_make(dbi_val_t *data)
+{
+    IDL *idl = NULL, *xidl;
+
+    xidl = (IDL *)(data->data);
+    if (data->size >= 2 * sizeof(uint32_t) &&
+        data->size == 2 * sizeof(uint32_t) + xidl->max * sizeof(ID) &&
+        (xidl->used <= xidl->max || xidl->max == 0)) {
+        /* old idl format */
+        idl = (IDL *)malloc(data->size);
+        if (!idl)
+            return NULL;
+
+        memcpy(idl, xidl, data->size);
+        return idl;
+    }
+
+    idl = (IDL *)malloc(sizeof(IDL) + 64 * sizeof(ID));
+    if (!idl)
+        return NULL;
+    idl->max = 64;
+    idl->used = 0;
+    return idl_append_block(idl, data);
+}
+
 
 /* format a string for easy printing */
 #define FMT_LF_OK 1
@@ -502,26 +541,74 @@ print_ruv(unsigned char *buff)
 Note: the length of time is set uint32_t instead of time_t. Regardless of the
 width of long (32-bit or 64-bit), it's stored using 4bytes by the server [153306].
 
+   Version 7 has a flags byte instead of "encrypted", and when it is
+   compressed everything following the csn is deflated:
+   <4 byte uncompressed size><deflated uniqueid, targetdn, ... mods>
+
    mod format:
    -----------
    <0 byte modop><null terminated attr name><4 byte value count>
    <4 byte value size><value1><4 byte value size><value2>
 */
+
+/* inflate the body of a compressed changelog record, the caller frees it */
+static char *
+_cl5UncompressBody(char *pos, int clen)
+{
+    z_stream zs = {0};
+    uint32_t body_len;
+    char *body;
+    int rc;
+
+    if (clen < (int)sizeof(body_len)) {
+        return NULL;
+    }
+    memcpy((char *)&body_len, pos, sizeof(body_len));
+    body_len = ntohl(body_len);
+    if (!cl5_compress_body_len_ok(body_len, clen - sizeof(body_len))) {
+        return NULL;
+    }
+    if (inflateInit(&zs) != Z_OK) {
+        return NULL;
+    }
+    body = malloc(body_len);
+    if (body == NULL) {
+        inflateEnd(&zs);
+        return NULL;
+    }
+    zs.next_in = (Bytef *)(pos + sizeof(body_len));
+    zs.avail_in = clen - sizeof(body_len);
+    zs.next_out = (Bytef *)body;
+    zs.avail_out = body_len;
+    rc = inflate(&zs, Z_FINISH);
+    if (rc == Z_NEED_DICT) {
+        inflateSetDictionary(&zs, (const Bytef *)cl5_compress_dict, sizeof(cl5_compress_dict) - 1);
+        rc = inflate(&zs, Z_FINISH);
+    }
+    inflateEnd(&zs);
+    if ((rc != Z_STREAM_END) || (zs.total_out != body_len)) {
+        free(body);
+        return NULL;
+    }
+    return body;
+}
+
 void
-print_changelog(unsigned char *data, int len __attribute__((unused)))
+print_changelog(unsigned char *data, int len)
 {
     uint8_t version;
-    uint8_t encrypted;
+    uint8_t encrypted = 0;
     unsigned long operation_type;
     char *pos = (char *)data;
+    char *body = NULL;
     uint32_t thetime32;
     time_t thetime;
     uint32_t replgen;
 
     /* read byte of version */
     version = *((uint8_t *)pos);
-    if (version != 5 && version != 6) {
-        db_printf("Invalid changelog db version %i\nWorks for version 5 and 6 only.\n", version);
+    if (version != 5 && version != 6 && version != 7) {
+        db_printf("Invalid changelog db version %i\nWorks for version 5, 6 and 7 only.\n", version);
         exit(1);
     }
     pos += sizeof(version);
@@ -530,6 +617,12 @@ print_changelog(unsigned char *data, int len __attribute__((unused)))
         /* process the encrypted flag */
         db_printf("\tencrypted: %s\n", *pos ? "yes" : "no");
         pos += sizeof(encrypted);
+    } else if (version == 7) {
+        /* process the flags */
+        encrypted = *((uint8_t *)pos);
+        db_printf("\tencrypted: %s\n", (encrypted & CL5_FLAG_ENCRYPTED) ? "yes" : "no");
+        db_printf("\tcompressed: %s\n", (encrypted & CL5_FLAG_COMPRESSED) ? "yes" : "no");
+        pos += sizeof(encrypted);
     }
 
     /* read change type */
@@ -547,6 +640,16 @@ print_changelog(unsigned char *data, int len __attribute__((unused)))
 
     /* read csn */
     print_attr("csn", &pos);
+
+    if (version == 7 && (encrypted & CL5_FLAG_COMPRESSED)) {
+        body = _cl5UncompressBody(pos, len - (pos - (char *)data));
+        if (body == NULL) {
+            db_printf("Failed to decompress changelog entry\n");
+            return;
+        }
+        pos = body;
+    }
+
     /* read UniqueID */
     print_attr("uniqueid", &pos);
 
@@ -584,6 +687,7 @@ print_changelog(unsigned char *data, int len __attribute__((unused)))
         db_printf("Failed to format entry\n");
         break;
     }
+    free(body);
 }
 
 static void
@@ -621,8 +725,11 @@ display_index_item(dbi_cursor_t *cursor, dbi_val_t *key, dbi_val_t *data, unsign
     /* fetch all other id's too */
     while (ret == 0) {
         ret = dblayer_cursor_op(cursor, DBI_OP_NEXT_DATA, key, data);
-        if (ret == 0)
-            idl = idl_append(idl, *(uint32_t *)(data->data));
+        if (ret == 0) {
+            idl = idl_append_block(idl, data);
+            if (idl == NULL)
+                break;
+        }
     }
     if (ret == DBI_RC_NOTFOUND)
         ret = 0;
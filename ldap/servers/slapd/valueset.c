@@ -439,9 +439,38 @@ valuearrayfast_add_value_passin(struct valuearrayfast *vaf, Slapi_Value *v)
 /* <=========================== Value Set =======================> */
 
 #define VALUESET_ARRAY_SORT_THRESHOLD 10
+#define VALUESET_ARRAY_HASH_THRESHOLD 512
 #define VALUESET_ARRAY_MINSIZE 2
 #define VALUESET_ARRAY_MAXINCREMENT 4096
 
+/*
+ * Valuesets with more than VALUESET_ARRAY_HASH_THRESHOLD values (e.g. the
+ * member attribute of large groups) are indexed by an open addressing hash
+ * table instead of the sorted array: a lookup normalizes the searched value
+ * once and compares it to a single candidate, and adding or removing a value
+ * no longer shifts an index of every value.
+ * The hash code of every value is kept in codes, in the order of va, so the
+ * table can be rebuilt or copied without normalizing the values again.
+ * Removing a value moves the last value to its place, so the values of a
+ * large valueset do not keep their order.
+ */
+#define VALUESET_HASH_EMPTY 0
+#define VALUESET_HASH_DELETED ((size_t)-1)
+#define VALUESET_HASH_MINSIZE 1024
+
+struct valueset_hash
+{
+    size_t size;     /* number of slots, a power of 2 */
+    size_t filled;   /* number of used or deleted slots */
+    size_t *slots;   /* index in va + 1, or VALUESET_HASH_EMPTY/DELETED */
+    PRUint32 *codes; /* hash code of each value of va, same size as va */
+};
+
+static void valueset_hash_free(Slapi_ValueSet *vs);
+static Slapi_Value *valueset_find_hash(const Slapi_Attr *a, const Slapi_ValueSet *vs, const Slapi_Value *v, size_t *slot);
+static Slapi_Value *valueset_remove_value_hash(const Slapi_Attr *a, Slapi_ValueSet *vs, const Slapi_Value *v);
+static void valueset_hash_rehash(Slapi_ValueSet *vs);
+
 Slapi_ValueSet *
 slapi_valueset_new()
 {
@@ -459,6 +488,7 @@ slapi_valueset_init(Slapi_ValueSet *vs)
     if (vs != NULL) {
         vs->va = NULL;
         vs->sorted = NULL;
+        vs->hash = NULL;
         vs->num = 0;
         vs->max = 0;
     }
@@ -477,6 +507,7 @@ slapi_valueset_done(Slapi_ValueSet *vs)
             slapi_ch_free((void **)&vs->sorted);
             vs->sorted = NULL;
         }
+        valueset_hash_free(vs);
         vs->num = 0;
         vs->max = 0;
     }
@@ -609,7 +640,9 @@ slapi_valueset_find(const Slapi_Attr *a, const Slapi_ValueSet *vs, const Slapi_V
 {
     Slapi_Value *r = NULL;
     if (vs && (vs->num > 0)) {
-        if (vs->sorted) {
+        if (vs->hash) {
+            r = valueset_find_hash(a, vs, v, NULL);
+        } else if (vs->sorted) {
             r = valueset_find_sorted(a, vs, v, NULL);
         } else {
             int i = valuearray_find(a, vs->va, v);
@@ -656,7 +689,9 @@ Slapi_Value *
 valueset_remove_value(const Slapi_Attr *a, Slapi_ValueSet *vs, const Slapi_Value *v)
 {
     Slapi_Value *r = NULL;
-    if (vs->sorted) {
+    if (vs->hash) {
+        r = valueset_remove_value_hash(a, vs, v);
+    } else if (vs->sorted) {
         r = valueset_remove_value_sorted(a, vs, v);
     } else {
         if (!valuearray_isempty(vs->va)) {
@@ -678,6 +713,7 @@ valueset_array_purge(const Slapi_Attr *a, Slapi_ValueSet *vs, const CSN *csn)
 {
     size_t i = 0;
     size_t j = 0;
+    size_t oldnum = vs->num;
     int nextValue = 0;
     int nv = 0;
     int numValues = 0;
@@ -775,6 +811,9 @@ valueset_array_purge(const Slapi_Attr *a, Slapi_ValueSet *vs, const CSN *csn)
 
                 if(nextValue < vs->num) {
                     vs->va[i] = vs->va[nextValue];
+                    if (vs->hash) {
+                        vs->hash->codes[i] = vs->hash->codes[nextValue];
+                    }
                     nextValue++;
                 } else {
                     break;
@@ -792,6 +831,10 @@ valueset_array_purge(const Slapi_Attr *a, Slapi_ValueSet *vs, const CSN *csn)
             vs->max = vs->num + 1;
         } else {
             vs->num = numValues;
+            if (vs->hash && vs->num < oldnum) {
+                /* the remaining values moved, reindex them */
+                valueset_hash_rehash(vs);
+            }
         }
 
         for (j = vs->num; j < vs->max; j++) {
@@ -809,7 +852,7 @@ valueset_array_purge(const Slapi_Attr *a, Slapi_ValueSet *vs, const CSN *csn)
     }
 
     /* We still have values but not sorted array! rebuild it */
-    if(vs->num > VALUESET_ARRAY_SORT_THRESHOLD && vs->sorted == NULL) {
+    if(vs->num > VALUESET_ARRAY_SORT_THRESHOLD && vs->sorted == NULL && vs->hash == NULL) {
         vs->sorted = (size_t *) slapi_ch_malloc( vs->max* sizeof(size_t));
         valueset_array_to_sorted(a, vs);
     }
@@ -1086,6 +1129,206 @@ valueset_insert_value_to_sorted(const Slapi_Attr *a, Slapi_ValueSet *vs, Slapi_V
     }
 }
 
+/* FNV-1a, the DN values are case folded as done by valueset_value_cmp */
+static PRUint32
+valueset_hash_bytes(PRUint32 code, const unsigned char *s, size_t len, int fold)
+{
+    for (size_t i = 0; i < len; i++) {
+        code ^= fold ? (PRUint32)tolower(s[i]) : (PRUint32)s[i];
+        code *= 16777619U;
+    }
+    return code;
+}
+
+/* compute a hash code such as equal values, as seen by valueset_value_cmp, get the same code */
+static PRUint32
+valueset_hash_code(const Slapi_Attr *a, const Slapi_Value *v)
+{
+    PRUint32 code = 2166136261U;
+
+    if (a == NULL || slapi_attr_is_dn_syntax_attr((Slapi_Attr *)a)) {
+        unsigned char *s = (unsigned char *)v->bv.bv_val;
+        unsigned char *lower = NULL;
+
+        if (s == NULL) {
+            return code;
+        }
+        if (slapi_has8thBit(s) && (lower = slapi_utf8StrToLower(s)) != NULL) {
+            code = valueset_hash_bytes(code, lower, strlen((char *)lower), 0);
+            slapi_ch_free((void **)&lower);
+        } else {
+            code = valueset_hash_bytes(code, s, strlen((char *)s), 1);
+        }
+    } else {
+        const Slapi_Value *oneval[2];
+        Slapi_Value **keyvals = NULL;
+
+        oneval[0] = v;
+        oneval[1] = NULL;
+        if (slapi_attr_values2keys_sv(a, (Slapi_Value **)oneval, &keyvals, LDAP_FILTER_EQUALITY) != 0 ||
+            keyvals == NULL || keyvals[0] == NULL) {
+            slapi_log_err(SLAPI_LOG_ERR, "valueset_hash_code",
+                          "slapi_attr_values2keys_sv failed for type %s\n",
+                          a->a_type);
+            code = valueset_hash_bytes(code, (unsigned char *)v->bv.bv_val, v->bv.bv_len, 0);
+        } else {
+            code = valueset_hash_bytes(code, (unsigned char *)keyvals[0]->bv.bv_val, keyvals[0]->bv.bv_len, 0);
+        }
+        if (keyvals != NULL)
+            valuearray_free(&keyvals);
+    }
+    return code;
+}
+
+static void
+valueset_hash_free(Slapi_ValueSet *vs)
+{
+    if (vs->hash != NULL) {
+        slapi_ch_free((void **)&vs->hash->slots);
+        slapi_ch_free((void **)&vs->hash->codes);
+        slapi_ch_free((void **)&vs->hash);
+    }
+}
+
+static void
+valueset_hash_insert_slot(struct valueset_hash *h, size_t index)
+{
+    size_t mask = h->size - 1;
+    size_t i = h->codes[index] & mask;
+
+    while (h->slots[i] != VALUESET_HASH_EMPTY && h->slots[i] != VALUESET_HASH_DELETED) {
+        i = (i + 1) & mask;
+    }
+    if (h->slots[i] == VALUESET_HASH_EMPTY) {
+        h->filled++;
+    }
+    h->slots[i] = index + 1;
+}
+
+/* size the table for the current values and index them from their codes */
+static void
+valueset_hash_rehash(Slapi_ValueSet *vs)
+{
+    struct valueset_hash *h = vs->hash;
+    size_t size = VALUESET_HASH_MINSIZE;
+
+    while (size < 2 * (vs->num + 1)) {
+        size *= 2;
+    }
+    if (size != h->size) {
+        slapi_ch_free((void **)&h->slots);
+        h->slots = (size_t *)slapi_ch_malloc(size * sizeof(size_t));
+        h->size = size;
+    }
+    memset(h->slots, 0, h->size * sizeof(size_t));
+    h->filled = 0;
+    for (size_t i = 0; i < vs->num; i++) {
+        valueset_hash_insert_slot(h, i);
+    }
+}
+
+static void
+valueset_hash_build(const Slapi_Attr *a, Slapi_ValueSet *vs)
+{
+    vs->hash = (struct valueset_hash *)slapi_ch_calloc(1, sizeof(struct valueset_hash));
+    vs->hash->codes = (PRUint32 *)slapi_ch_malloc(vs->max * sizeof(PRUint32));
+    for (size_t i = 0; i < vs->num; i++) {
+        vs->hash->codes[i] = valueset_hash_code(a, vs->va[i]);
+    }
+    valueset_hash_rehash(vs);
+    /* the hash replaces the sorted array */
+    slapi_ch_free((void **)&vs->sorted);
+}
+
+/* find a value with the hash code, if slot is provided it gets the slot of the value */
+static Slapi_Value *
+valueset_hash_lookup(const Slapi_Attr *a, const Slapi_ValueSet *vs, const Slapi_Value *v, PRUint32 code, size_t *slot)
+{
+    struct valueset_hash *h = vs->hash;
+    size_t mask = h->size - 1;
+    size_t i = code & mask;
+
+    while (h->slots[i] != VALUESET_HASH_EMPTY) {
+        if (h->slots[i] != VALUESET_HASH_DELETED) {
+            size_t index = h->slots[i] - 1;
+            if (h->codes[index] == code && valueset_value_cmp(a, v, vs->va[index]) == 0) {
+                if (slot)
+                    *slot = i;
+                return vs->va[index];
+            }
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+static Slapi_Value *
+valueset_find_hash(const Slapi_Attr *a, const Slapi_ValueSet *vs, const Slapi_Value *v, size_t *slot)
+{
+    return valueset_hash_lookup(a, vs, v, valueset_hash_code(a, v), slot);
+}
+
+/* insert the value vi, stored at va[num], in the hash
+ * if dupcheck is set no duplicate values will be accepted and -1 is returned
+ */
+static int
+valueset_insert_value_to_hash(const Slapi_Attr *a, Slapi_ValueSet *vs, Slapi_Value *vi, int dupcheck)
+{
+    struct valueset_hash *h = vs->hash;
+    PRUint32 code = valueset_hash_code(a, vi);
+
+    if (dupcheck && valueset_hash_lookup(a, vs, vi, code, NULL)) {
+        /* value already exists, do not insert duplicates */
+        return (-1);
+    }
+    h->codes[vs->num] = code;
+    vs->num++;
+    if (4 * (h->filled + 1) > 3 * h->size) {
+        /* too many used or deleted slots, grow and clean up the table */
+        valueset_hash_rehash(vs);
+    } else {
+        valueset_hash_insert_slot(h, vs->num - 1);
+    }
+    return (0);
+}
+
+/*
+ * The value is found in the set, removed and returned.
+ * The last value of the array takes its place.
+ */
+static Slapi_Value *
+valueset_remove_value_hash(const Slapi_Attr *a, Slapi_ValueSet *vs, const Slapi_Value *v)
+{
+    struct valueset_hash *h = vs->hash;
+    Slapi_Value *r = NULL;
+    size_t slot = 0;
+    size_t index;
+    size_t last;
+
+    r = valueset_find_hash(a, vs, v, &slot);
+    if (r == NULL) {
+        return NULL;
+    }
+    index = h->slots[slot] - 1;
+    h->slots[slot] = VALUESET_HASH_DELETED;
+    last = vs->num - 1;
+    if (index != last) {
+        size_t mask = h->size - 1;
+        size_t i = h->codes[last] & mask;
+
+        /* move the last value and repoint its slot */
+        while (h->slots[i] != last + 1) {
+            i = (i + 1) & mask;
+        }
+        h->slots[i] = index + 1;
+        vs->va[index] = vs->va[last];
+        h->codes[index] = h->codes[last];
+    }
+    vs->va[last] = NULL;
+    vs->num--;
+    return r;
+}
+
 /*
  * If this function returns an error, it is safe to do both
  * slapi_valueset_done(vs);
@@ -1128,16 +1371,25 @@ slapi_valueset_add_attr_valuearray_ext(const Slapi_Attr *a, Slapi_ValueSet *vs,
     if (allocate > 0) {
         if (vs->va == NULL) {
             vs->va = (Slapi_Value **)slapi_ch_malloc(allocate * sizeof(Slapi_Value *));
+            /* the values were consumed, the index is stale */
+            valueset_hash_free(vs);
         } else {
             vs->va = (Slapi_Value **)slapi_ch_realloc((char *)vs->va, allocate * sizeof(Slapi_Value *));
             if (vs->sorted) {
                 vs->sorted = (size_t *)slapi_ch_realloc((char *)vs->sorted, allocate * sizeof(size_t));
             }
         }
+        if (vs->hash) {
+            vs->hash->codes = (PRUint32 *)slapi_ch_realloc((char *)vs->hash->codes, allocate * sizeof(PRUint32));
+        }
         vs->max = allocate;
     }
 
-    if ((vs->num + naddvals > VALUESET_ARRAY_SORT_THRESHOLD || dupcheck) && !vs->sorted && vs->max > 0) {
+    if (vs->num + naddvals > VALUESET_ARRAY_HASH_THRESHOLD && !vs->hash && vs->max > 0) {
+        /* index the values by hash, this replaces the sorted array */
+        valueset_hash_build(a, vs);
+    }
+    if ((vs->num + naddvals > VALUESET_ARRAY_SORT_THRESHOLD || dupcheck) && !vs->sorted && !vs->hash && vs->max > 0) {
         /* initialize sort array and do initial sort */
         vs->sorted = (size_t *)slapi_ch_malloc(vs->max * sizeof(size_t));
         valueset_array_to_sorted(a, vs);
@@ -1152,23 +1404,26 @@ slapi_valueset_add_attr_valuearray_ext(const Slapi_Attr *a, Slapi_ValueSet *vs,
                 /* We copy the values */
                 (vs->va)[vs->num] = slapi_value_dup(addvals[i]);
             }
-            if (vs->sorted) {
+            if (vs->hash) {
+                dup = valueset_insert_value_to_hash(a, vs, (vs->va)[vs->num], dupcheck);
+            } else if (vs->sorted) {
                 dup = valueset_insert_value_to_sorted(a, vs, (vs->va)[vs->num], dupcheck);
-                if (dup < 0) {
-                    rc = LDAP_TYPE_OR_VALUE_EXISTS;
-                    if (dup_index)
-                        *dup_index = i;
-                    if (passin) {
-                        PR_ASSERT((i == 0) || dup_index);
-                        /* caller must provide dup_index to know how far we got in addvals */
-                        (vs->va)[vs->num] = NULL;
-                    } else {
-                        slapi_value_free(&(vs->va)[vs->num]);
-                    }
-                    break;
-                }
             } else {
                 vs->num++;
+                dup = 0;
+            }
+            if (dup < 0) {
+                rc = LDAP_TYPE_OR_VALUE_EXISTS;
+                if (dup_index)
+                    *dup_index = i;
+                if (passin) {
+                    PR_ASSERT((i == 0) || dup_index);
+                    /* caller must provide dup_index to know how far we got in addvals */
+                    (vs->va)[vs->num] = NULL;
+                } else {
+                    slapi_value_free(&(vs->va)[vs->num]);
+                }
+                break;
             }
         }
     }
@@ -1247,6 +1502,17 @@ valueset_set_valueset(Slapi_ValueSet *vs1, const Slapi_ValueSet *vs2)
         } else {
             slapi_ch_free((void **)&vs1->sorted);
         }
+        valueset_hash_free(vs1);
+        if (vs2->hash && vs2->va) {
+            /* the copied values are in the same order, the index can be copied */
+            vs1->hash = (struct valueset_hash *)slapi_ch_calloc(1, sizeof(struct valueset_hash));
+            vs1->hash->size = vs2->hash->size;
+            vs1->hash->filled = vs2->hash->filled;
+            vs1->hash->slots = (size_t *)slapi_ch_malloc(vs1->hash->size * sizeof(size_t));
+            memcpy(vs1->hash->slots, vs2->hash->slots, vs1->hash->size * sizeof(size_t));
+            vs1->hash->codes = (PRUint32 *)slapi_ch_malloc(vs1->max * sizeof(PRUint32));
+            memcpy(vs1->hash->codes, vs2->hash->codes, vs1->num * sizeof(PRUint32));
+        }
         /* post-condition */
         PR_ASSERT((vs1->sorted == NULL) || (vs1->num < VALUESET_ARRAY_SORT_THRESHOLD) || ((vs1->num >= VALUESET_ARRAY_SORT_THRESHOLD) && (vs1->sorted[0] < vs1->num)));
     }
@@ -1409,6 +1675,8 @@ valueset_replace_valuearray_ext(Slapi_Attr *a, Slapi_ValueSet *vs, Slapi_Value *
             vs_new->va = NULL;
             vs->sorted = vs_new->sorted;
             vs_new->sorted = NULL;
+            vs->hash = vs_new->hash;
+            vs_new->hash = NULL;
             vs->num = vs_new->num;
             vs->max = vs_new->max;
             slapi_valueset_free(vs_new);
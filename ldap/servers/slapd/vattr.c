@@ -85,6 +85,7 @@ typedef vattr_sp_handle vattr_sp_handle_list;
 /* Local prototypes */
 static int vattr_map_create(void);
 static void vattr_map_destroy(void);
+static int vattr_map_type_has_sp(const char *type);
 int vattr_map_sp_insert(char *type_to_add, vattr_sp_handle *sp, void *hint);
 vattr_sp_handle_list *vattr_map_sp_getlist(char *type_to_find);
 vattr_sp_handle_list *vattr_map_namespace_sp_getlist(Slapi_DN *dn, const char *type_to_find);
@@ -115,6 +116,16 @@ typedef struct _vattr_map vattr_map;
 
 static vattr_map *the_map = NULL;
 
+/*
+ * Most types have no service provider at all. Each registered type sets
+ * a bit picked by the hash of its base name (without the backend namespace),
+ * so that a clear bit answers "no provider" without the lock and the hash
+ * table. Types are never removed from the map, so bits are never cleared.
+ */
+#define VATTR_MAP_TYPE_BITS 1024
+static uint64_t vattr_map_type_bits[VATTR_MAP_TYPE_BITS / 64];
+static uint64_t vattr_map_type_count = 0;
+
 /* Housekeeping Functions, called by server startup/shutdown code */
 
 /* Called on server startup, init all structures etc */
@@ -552,17 +563,20 @@ vattr_test_filter(Slapi_PBlock *pb,
     Slapi_Backend *be;
     Slapi_DN *namespace_dn;
 
-    /* get the namespace this entry belongs to */
-    sdn = slapi_entry_get_sdn(e);
-    be = slapi_be_select(sdn);
-    namespace_dn = (Slapi_DN *)slapi_be_getsuffix(be, 0);
-
     /* Look for attribute in the map */
 
-    if (namespace_dn) {
-        list = vattr_map_namespace_sp_getlist(namespace_dn, type);
-    } else {
-        list = vattr_map_namespace_sp_getlist(NULL, type);
+    /* no need to look for the namespace of the entry if nobody provides the type */
+    if (vattr_map_type_has_sp(type)) {
+        /* get the namespace this entry belongs to */
+        sdn = slapi_entry_get_sdn(e);
+        be = slapi_be_select(sdn);
+        namespace_dn = (Slapi_DN *)slapi_be_getsuffix(be, 0);
+
+        if (namespace_dn) {
+            list = vattr_map_namespace_sp_getlist(namespace_dn, type);
+        } else {
+            list = vattr_map_namespace_sp_getlist(NULL, type);
+        }
     }
 
     if (list) {
@@ -773,12 +787,6 @@ slapi_vattr_values_get_sp(vattr_context *c,
             return rc;
         }
         ctx = c;
-    } else {
-        use_local_ctx = PR_TRUE;
-        local_pb = slapi_pblock_new();
-        ctx = vattr_context_new(local_pb);
-        ctx->vattr_context_loop_count = 1;
-        ctx->error_displayed = 0;
     }
 
     /* For attributes which are in the entry, we just need to get to the Slapi_Attr structure and yank out the slapi_value_set
@@ -823,6 +831,14 @@ slapi_vattr_values_get_sp(vattr_context *c,
             case SLAPI_ENTRY_VATTR_NOT_RESOLVED: /* not resolved */
             default:                             /* any other result, resolve */
             {
+                /* the loop context is only needed when calling the providers */
+                if (ctx == NULL) {
+                    use_local_ctx = PR_TRUE;
+                    local_pb = slapi_pblock_new();
+                    ctx = vattr_context_new(local_pb);
+                    ctx->vattr_context_loop_count = 1;
+                    ctx->error_displayed = 0;
+                }
                 for (current_handle = vattr_map_sp_first(list, &hint); current_handle; current_handle = vattr_map_sp_next(current_handle, &hint)) {
                     rc = vattr_call_sp_get_value(current_handle, ctx, e, &my_get, type, results, type_name_disposition, actual_type_name, flags, buffer_flags, hint);
                     if (0 == rc) {
@@ -886,7 +902,7 @@ slapi_vattr_values_get_sp(vattr_context *c,
     if (use_local_ctx) {
         /* slapi_pblock_destroy cleans up pb_vattr_context, as well */
         slapi_pblock_destroy(local_pb);
-    } else {
+    } else if (c != NULL) {
         vattr_context_ungrok(&c);
     }
     return rc;
@@ -1397,7 +1413,8 @@ slapi_vattr_list_attrs(/* Entry we're interested in */ Slapi_Entry *e,
      * found in the entry.
     */
 
-    if (!(flags & SLAPI_REALATTRS_ONLY)) {
+    /* providers can only return types of the map */
+    if (!(flags & SLAPI_REALATTRS_ONLY) && slapi_atomic_load_64(&vattr_map_type_count, __ATOMIC_ACQUIRE)) {
         list = vattr_map_sp_get_complete_list();
         if (list) {
             vattr_sp_handle *current_handle = NULL;
@@ -1959,21 +1976,55 @@ vattr_hash_compare_values(const void *v1, const void *v2)
     return (((char *)v1 == (char *)v2) ? 1 : 0);
 }
 
+/* FNV-1a of the lower cased name, up to the end or to the stop character */
 static PLHashNumber
-vattr_hash_fn(const void *type_name)
+vattr_hash_name(const char *name, char stop)
 {
-    /* need a hash function here */
-    /* Sum the bytes for now */
-    PLHashNumber result = 0;
-    char *current_position = NULL;
-    char current_char = 0;
-    for (current_position = (char *)type_name; *current_position; current_position++) {
-        current_char = tolower(*current_position);
-        result += current_char;
+    PLHashNumber result = 2166136261U;
+    const char *current_position = NULL;
+
+    for (current_position = name; *current_position && *current_position != stop; current_position++) {
+        result ^= (unsigned char)tolower(*current_position);
+        result *= 16777619U;
     }
     return result;
 }
 
+static PLHashNumber
+vattr_hash_fn(const void *type_name)
+{
+    return vattr_hash_name((const char *)type_name, '\0');
+}
+
+/* Bit of the base type name, skipping the namespace of "dn::type" keys */
+static void
+vattr_map_type_bit(const char *type_name, size_t *word, uint64_t *bit)
+{
+    const char *sep = NULL;
+    PLHashNumber hash;
+
+    while ((sep = strstr(type_name, "::")) != NULL) {
+        type_name = sep + 2;
+    }
+    hash = vattr_hash_name(type_name, ';') % VATTR_MAP_TYPE_BITS;
+    *word = hash / 64;
+    *bit = (uint64_t)1 << (hash % 64);
+}
+
+/* Returns 0 if no service provider registered the type, 1 if one may have */
+static int
+vattr_map_type_has_sp(const char *type)
+{
+    size_t word;
+    uint64_t bit;
+
+    if (type == NULL) {
+        return 0;
+    }
+    vattr_map_type_bit(type, &word, &bit);
+    return (slapi_atomic_load_64(&vattr_map_type_bits[word], __ATOMIC_ACQUIRE) & bit) ? 1 : 0;
+}
+
 static int
 vattr_map_create(void)
 {
@@ -2114,6 +2165,17 @@ vattr_map_insert(vattr_map_entry *vae)
     /* It's illegal to call this function if the entry is already there */
     PR_ASSERT(NULL == PL_HashTableLookupConst(the_map->hashtable, (void *)vae->type_name));
     PL_HashTableAdd(the_map->hashtable, (void *)vae->type_name, (void *)vae);
+    /* Publish the type, writers are serialized by the lock */
+    {
+        size_t word;
+        uint64_t bit;
+
+        vattr_map_type_bit(vae->type_name, &word, &bit);
+        slapi_atomic_store_64(&vattr_map_type_bits[word],
+                              slapi_atomic_load_64(&vattr_map_type_bits[word], __ATOMIC_RELAXED) | bit,
+                              __ATOMIC_RELEASE);
+        slapi_atomic_incr_64(&vattr_map_type_count, __ATOMIC_RELEASE);
+    }
     /* Unlock and we're done */
     slapi_rwlock_unlock(the_map->lock);
     return 0;
@@ -2312,6 +2374,10 @@ vattr_map_sp_getlist(char *type_to_find)
 {
     int ret = 0;
     vattr_map_entry *result = NULL;
+
+    if (!vattr_map_type_has_sp(type_to_find)) {
+        return NULL;
+    }
     ret = vattr_map_lookup(type_to_find, &result);
     if (0 == ret) {
         return (vattr_sp_handle_list *)result->sp_list;
@@ -2337,6 +2403,11 @@ vattr_map_namespace_sp_getlist(Slapi_DN *dn, const char *type_to_find)
         return NULL;
     }
 
+    /* neither the global nor a split namespace provider */
+    if (!vattr_map_type_has_sp(type_to_find)) {
+        return NULL;
+    }
+
     ret = vattr_map_lookup(type_to_find, &result);
     if (0 == ret) {
         return_list = (vattr_sp_handle_list *)result->sp_list;
@@ -2363,6 +2434,16 @@ vattr_map_namespace_sp_getlist(Slapi_DN *dn, const char *type_to_find)
     return return_list;
 }
 
+/*
+ * Returns 1 if a service provider computes the attribute type, so that
+ * the indexes do not reflect all of its values, 0 otherwise.
+ */
+int
+slapi_vattr_is_virtual_type(Slapi_DN *namespace_dn, const char *type)
+{
+    return (vattr_map_namespace_sp_getlist(namespace_dn, type) != NULL);
+}
+
 
 /* Iterator function for the list */
 vattr_sp_handle *
@@ -744,17 +744,18 @@ class Backend(DSLdapObject):
         if reindex:
             self.reindex(attr_name)
 
-    def reindex(self, attrs=None, wait=False):
+    def reindex(self, attrs=None, wait=False, online=False):
         """Reindex the attributes for this backend
         :param attrs - an optional list of attributes to index
         :param wait - Set to true to wait for task to complete
+        :param online - Set to true to keep the backend writable while indexing
         """
         args = None
         if wait:
             args = {TASK_WAIT: True}
         bename = ensure_str(self.get_attr_val_bytes('cn'))
         reindex_task = Tasks(self._instance)
-        reindex_task.reindex(benamebase=bename, attrname=attrs, args=args)
+        reindex_task.reindex(benamebase=bename, attrname=attrs, args=args, online=online)
 
     def get_encrypted_attrs(self, just_names=False):
         """Get a list of the excrypted attributes
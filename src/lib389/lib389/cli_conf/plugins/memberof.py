@@ -77,7 +77,7 @@ def do_fixup(inst, basedn, log, args):
     if not plugin.status():
         log.error("'%s' is disabled. Fix up task can't be executed" % plugin.rdn)
         return
-    fixup_task = plugin.fixup(args.DN, args.filter)
+    fixup_task = plugin.fixup(args.DN, args.filter, args.threads)
     if args.wait:
         log.info(f'Waiting for fixup task "{fixup_task.dn}" to complete.  You can safely exit by pressing Control C ...')
         fixup_task.wait(timeout=None)
@@ -152,6 +152,8 @@ def create_parser(subparsers):
                        help='Filter for entries to fix up.\n If omitted, all entries with objectclass '
                             'inetuser/inetadmin/nsmemberof under the specified base will have '
                             'their memberOf attribute regenerated.')
+    fixup.add_argument('--threads', type=int,
+                       help='Number of threads computing and applying the memberOf values (1 to 64, default 4)')
     fixup.add_argument('--wait', action='store_true',
                        help="Wait for the task to finish, this could take a long time")
 
@@ -39,6 +39,7 @@ arg_to_attr = {
         'trim_interval': 'nsslapd-changelogtrim-interval',
         'encrypt_algo': 'nsslapd-encryptionalgorithm',
         'encrypt_key': 'nssymmetrickey',
+        'compression': 'nsslapd-changelogcompression',
         # Agreement
         'host': 'nsds5replicahost',
         'port': 'nsds5replicaport',
@@ -1299,6 +1300,7 @@ def create_parser(subparsers):
     repl_set_per_backend_cl.add_argument('--trim-interval', help="Sets the interval to check if the replication changelog can be trimmed")
     repl_set_per_backend_cl.add_argument('--encrypt', action='store_true', help="Sets the replication changelog to use encryption. You must export and import the changelog after setting this.")
     repl_set_per_backend_cl.add_argument('--disable-encrypt', action='store_true', help="Sets the replication changelog to not use encryption. You must export and import the changelog after setting this.")
+    repl_set_per_backend_cl.add_argument('--compression', choices=['on', 'off'], help="Sets if new replication changelog records are compressed")
 
     repl_get_per_backend_cl = repl_subcommands.add_parser('get-changelog', help='Display replication changelog attributes')
     repl_get_per_backend_cl.set_defaults(func=get_per_backend_cl)
@@ -940,13 +940,15 @@ class MemberOfPlugin(Plugin):
 
         return self.remove_all('nsslapd-pluginConfigArea')
 
-    def fixup(self, basedn, _filter=None):
+    def fixup(self, basedn, _filter=None, threads=None):
         """Create a memberOf task
 
         :param basedn: Basedn to fix up
         :type basedn: str
         :param _filter: a filter for entries to fix up
         :type _filter: str
+        :param threads: number of worker threads used by the task
+        :type threads: int
 
         :returns: an instance of Task(DSLdapObject)
         """
@@ -955,6 +957,8 @@ class MemberOfPlugin(Plugin):
         task_properties = {'basedn': basedn}
         if _filter is not None:
             task_properties['filter'] = _filter
+        if threads is not None:
+            task_properties['threads'] = str(threads)
         try:
             task.create(properties=task_properties)
         except ldap.NO_SUCH_OBJECT:
@@ -1115,6 +1115,15 @@ class Changelog(DSLdapObject):
         """
         self.remove_all('nsslapd-encryptionalgorithm')
 
+    def set_compression(self, value):
+        """Compress the new changelog records. Records already written
+        are read back whatever their format.
+
+        :param value: "on" or "off"
+        :type value: str
+        """
+        self.replace('nsslapd-changelogcompression', value)
+
 
 class Changelog5(DSLdapObject):
     """Represents the Directory Server changelog. This is used for
@@ -434,6 +434,21 @@ class RestoreTask(Task):
         super(RestoreTask, self).__init__(instance, dn)
 
 
+class DBVerifyTask(Task):
+    """Create the online db verify task
+
+    :param instance: The instance
+    :type instance: lib389.DirSrv
+    """
+
+    def __init__(self, instance, dn=None):
+        self.cn = 'dbverify_' + Task._get_task_date()
+        dn = "cn=" + self.cn + ",cn=dbverify," + DN_TASKS
+        self._properties = None
+
+        super(DBVerifyTask, self).__init__(instance, dn)
+
+
 class Tasks(object):
     proxied_methods = 'search_s getEntry'.split()
 
@@ -730,7 +745,7 @@ class Tasks(object):
 
         return exitCode
 
-    def reindex(self, suffix=None, benamebase=None, attrname=None, args=None, vlv=False):
+    def reindex(self, suffix=None, benamebase=None, attrname=None, args=None, vlv=False, online=False):
         '''
         Reindex a 'suffix' (or 'benamebase' that stores that suffix) for a
         given 'attrname'.  It uses an internal task to acheive this request.
@@ -747,6 +762,7 @@ class Tasks(object):
                 wait: True/[False] - If True, 'index' waits for the completion
                                      of the task before to return
         :param vlv - this task is to reindex a VLV index
+        :param online - build the indexes while the backend accepts updates
 
         :return None
 
@@ -832,6 +848,8 @@ class Tasks(object):
                 'nsIndexAttribute': attrs,
                 'nsInstance': backend
             })
+            if online:
+                entry.update({'nsIndexOnline': 'true'})
 
         # start the task and possibly wait for task completion
         try:
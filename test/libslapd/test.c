@@ -33,6 +33,7 @@ run_libslapd_tests(void)
         cmocka_unit_test(test_libslapd_filter_optimise),
         cmocka_unit_test(test_libslapd_pal_meminfo),
         cmocka_unit_test(test_libslapd_util_cachesane),
+        cmocka_unit_test(test_libslapd_valueset_large),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
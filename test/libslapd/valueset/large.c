@@ -0,0 +1,82 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../../test_slapd.h"
+
+#include <slap.h>
+#include <proto-slap.h>
+
+/* Enough values for the valueset to be indexed by hash */
+#define VALUESET_LARGE_VALUES 20000
+
+static Slapi_Value *
+valueset_test_value(const char *fmt, size_t i)
+{
+    char buf[128];
+
+    snprintf(buf, sizeof(buf), fmt, i);
+    return slapi_value_new_string(buf);
+}
+
+void
+test_libslapd_valueset_large(void **state __attribute__((unused)))
+{
+    Slapi_ValueSet *vs = slapi_valueset_new();
+    Slapi_ValueSet *copy = slapi_valueset_new();
+    Slapi_Value *v = NULL;
+    Slapi_Value *removed = NULL;
+    size_t i;
+
+    /* Add the values one by one, rejecting duplicates */
+    for (i = 0; i < VALUESET_LARGE_VALUES; i++) {
+        v = valueset_test_value("uid=user%zu,ou=people,dc=example,dc=com", i);
+        assert_int_equal(slapi_valueset_add_attr_value_ext(NULL, vs, v, SLAPI_VALUE_FLAG_PASSIN | SLAPI_VALUE_FLAG_DUPCHECK), LDAP_SUCCESS);
+    }
+    assert_int_equal(slapi_valueset_count(vs), VALUESET_LARGE_VALUES);
+
+    /* DN values are compared without case */
+    v = valueset_test_value("UID=USER%zu,ou=people,dc=example,dc=com", 42);
+    assert_non_null(slapi_valueset_find(NULL, vs, v));
+    assert_int_equal(slapi_valueset_add_attr_value_ext(NULL, vs, v, SLAPI_VALUE_FLAG_DUPCHECK), LDAP_TYPE_OR_VALUE_EXISTS);
+    slapi_value_free(&v);
+
+    /* Remove a third of the values */
+    for (i = 0; i < VALUESET_LARGE_VALUES; i += 3) {
+        v = valueset_test_value("uid=user%zu,ou=people,dc=example,dc=com", i);
+        removed = valueset_remove_value(NULL, vs, v);
+        assert_non_null(removed);
+        slapi_value_free(&removed);
+        slapi_value_free(&v);
+    }
+    assert_int_equal(slapi_valueset_count(vs), VALUESET_LARGE_VALUES - (VALUESET_LARGE_VALUES + 2) / 3);
+
+    /* The copy finds the same values */
+    slapi_valueset_set_valueset(copy, vs);
+    for (i = 0; i < VALUESET_LARGE_VALUES; i++) {
+        v = valueset_test_value("uid=user%zu,ou=people,dc=example,dc=com", i);
+        if (i % 3 == 0) {
+            assert_null(slapi_valueset_find(NULL, vs, v));
+            assert_null(slapi_valueset_find(NULL, copy, v));
+        } else {
+            assert_non_null(slapi_valueset_find(NULL, vs, v));
+            assert_non_null(slapi_valueset_find(NULL, copy, v));
+        }
+        slapi_value_free(&v);
+    }
+
+    /* Add the removed values back to the copy */
+    for (i = 0; i < VALUESET_LARGE_VALUES; i += 3) {
+        v = valueset_test_value("uid=user%zu,ou=people,dc=example,dc=com", i);
+        assert_int_equal(slapi_valueset_add_attr_value_ext(NULL, copy, v, SLAPI_VALUE_FLAG_PASSIN | SLAPI_VALUE_FLAG_DUPCHECK), LDAP_SUCCESS);
+    }
+    assert_int_equal(slapi_valueset_count(copy), VALUESET_LARGE_VALUES);
+    assert_int_equal(slapi_valueset_count(vs), VALUESET_LARGE_VALUES - (VALUESET_LARGE_VALUES + 2) / 3);
+
+    slapi_valueset_free(vs);
+    slapi_valueset_free(copy);
+}
@@ -0,0 +1,268 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../../test_slapd.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <cl5_clring.h>
+
+#define CLRING_STRESS_READERS 4
+#define CLRING_STRESS_CHANGES 50000
+#define CLRING_STRESS_SIZE 64
+#define CLRING_STRESS_BATCH 16
+
+/* Keys sort like csn strings: fixed width */
+static size_t
+clring_test_key(size_t i, char *key)
+{
+    return (size_t)snprintf(key, CSN_STRSIZE, "%020zu", i);
+}
+
+static void
+clring_test_append(struct clc_ring *ring, struct clc_ring_stamp *stamp, size_t i)
+{
+    char key[CSN_STRSIZE];
+    size_t keylen = clring_test_key(i, key);
+
+    /* the data is the key, to check the change is the expected one */
+    clcache_ring_append(ring, stamp, key, keylen, key, keylen + 1);
+}
+
+static size_t
+clring_test_num(struct clc_ring_entry *entry)
+{
+    return (size_t)strtoull(entry->re_key, NULL, 10);
+}
+
+void
+test_plugin_replication_clring_wraparound(void **state __attribute__((unused)))
+{
+    struct clc_ring ring = {0};
+    struct clc_ring_stamp *stamp = clcache_ring_new_stamp();
+    char key[CSN_STRSIZE];
+    size_t i;
+    int j;
+
+    clcache_ring_init(&ring, 8);
+    for (i = 0; i < 20; i++) {
+        clring_test_append(&ring, stamp, i);
+        assert_int_equal(ring.ring_count, i < 8 ? (int)i + 1 : 8);
+        /* the changes stay in key order across the end of the array */
+        for (j = 0; j < ring.ring_count; j++) {
+            struct clc_ring_entry *entry = clcache_ring_entry(&ring, j);
+            assert_int_equal(clring_test_num(entry), i + 1 - ring.ring_count + j);
+            assert_string_equal(entry->re_key, (char *)entry->re_data);
+        }
+    }
+    assert_int_equal(ring.ring_first, 20 % 8);
+
+    /* evicted changes are not found anymore */
+    clring_test_key(11, key);
+    assert_int_equal(clcache_ring_find(&ring, key), -1);
+    for (i = 12; i < 20; i++) {
+        clring_test_key(i, key);
+        assert_int_equal(clcache_ring_find(&ring, key), i - 12);
+    }
+    clring_test_key(20, key);
+    assert_int_equal(clcache_ring_find(&ring, key), -1);
+
+    /* a fresh read replaces what follows its anchor, over the wrap */
+    clcache_ring_truncate(&ring, 3);
+    assert_int_equal(ring.ring_count, 3);
+    for (i = 100; i < 110; i++) {
+        clring_test_append(&ring, stamp, i);
+    }
+    assert_int_equal(ring.ring_count, 8);
+    assert_int_equal(clring_test_num(clcache_ring_entry(&ring, 0)), 102);
+    assert_int_equal(clring_test_num(clcache_ring_entry(&ring, 7)), 109);
+
+    /* all the changes hold the stamp */
+    assert_int_equal(stamp->rs_refcnt, 9);
+    clcache_ring_clear(&ring);
+    assert_int_equal(ring.ring_count, 0);
+    assert_int_equal(ring.ring_first, 0);
+    assert_int_equal(stamp->rs_refcnt, 1);
+
+    clcache_ring_release_stamp(stamp);
+    clcache_ring_destroy(&ring);
+    assert_null(ring.ring_entries);
+}
+
+void
+test_plugin_replication_clring_full(void **state __attribute__((unused)))
+{
+    struct clc_ring ring = {0};
+    struct clc_ring_stamp *old = clcache_ring_new_stamp();
+    struct clc_ring_stamp *recent = clcache_ring_new_stamp();
+    struct clc_ring_entry *held[4];
+    size_t i;
+
+    clcache_ring_init(&ring, 4);
+    for (i = 0; i < 4; i++) {
+        clring_test_append(&ring, old, i);
+    }
+    assert_int_equal(ring.ring_count, ring.ring_size);
+    clcache_ring_release_stamp(old);
+    assert_int_equal(old->rs_refcnt, 4);
+
+    /* a buffer takes the whole ring */
+    for (i = 0; i < 4; i++) {
+        held[i] = clcache_ring_entry(&ring, i);
+        held[i]->re_refcnt++;
+    }
+
+    /* a full ring evicts its oldest changes, one per append */
+    for (i = 4; i < 10; i++) {
+        clring_test_append(&ring, recent, i);
+        assert_int_equal(ring.ring_count, 4);
+        assert_int_equal(clring_test_num(clcache_ring_entry(&ring, 0)), i - 3);
+    }
+
+    /* the evicted changes stay valid for the buffer */
+    for (i = 0; i < 4; i++) {
+        assert_int_equal(held[i]->re_refcnt, 1);
+        assert_int_equal(clring_test_num(held[i]), i);
+        assert_string_equal(held[i]->re_key, (char *)held[i]->re_data);
+    }
+    assert_int_equal(old->rs_refcnt, 4);
+    for (i = 0; i < 3; i++) {
+        clcache_ring_release_entry(held[i]);
+    }
+    assert_int_equal(old->rs_refcnt, 1);
+    clcache_ring_release_entry(held[3]); /* frees the stamp too */
+
+    assert_int_equal(recent->rs_refcnt, 5);
+    clcache_ring_destroy(&ring);
+    assert_int_equal(recent->rs_refcnt, 1);
+    clcache_ring_release_stamp(recent);
+}
+
+typedef struct clring_stress
+{
+    struct clc_ring ring;
+    pthread_mutex_t lock; /* stands for the busy list lock */
+    int done;
+    int failed; /* cmocka asserts only work in the test thread */
+} clring_stress;
+
+/* Appends the changes in order, like the loads reading the db head */
+static void *
+clring_stress_writer(void *arg)
+{
+    clring_stress *st = (clring_stress *)arg;
+    struct clc_ring_stamp *stamp = NULL;
+    size_t i;
+
+    for (i = 0; i < CLRING_STRESS_CHANGES; i++) {
+        pthread_mutex_lock(&st->lock);
+        if (i % 10 == 0) {
+            if (stamp) {
+                clcache_ring_release_stamp(stamp);
+            }
+            stamp = clcache_ring_new_stamp();
+        }
+        clring_test_append(&st->ring, stamp, i);
+        pthread_mutex_unlock(&st->lock);
+    }
+    pthread_mutex_lock(&st->lock);
+    clcache_ring_release_stamp(stamp);
+    pthread_mutex_unlock(&st->lock);
+    __atomic_store_n(&st->done, 1, __ATOMIC_SEQ_CST);
+    return NULL;
+}
+
+/*
+ * Follows the changes like a buffer: takes a batch following its anchor,
+ * replays it without the lock and releases it. When its anchor has been
+ * evicted it lags behind and restarts from the oldest change.
+ */
+static void *
+clring_stress_reader(void *arg)
+{
+    clring_stress *st = (clring_stress *)arg;
+    struct clc_ring_entry *batch[CLRING_STRESS_BATCH];
+    char anchor[CSN_STRSIZE];
+    size_t last = 0;
+    int started = 0;
+
+    while (!started || last < CLRING_STRESS_CHANGES - 1) {
+        int done = __atomic_load_n(&st->done, __ATOMIC_SEQ_CST);
+        int cnt = 0;
+        int consecutive = 1;
+        int i;
+
+        pthread_mutex_lock(&st->lock);
+        i = started ? clcache_ring_find(&st->ring, anchor) + 1 : 0;
+        if (i == 0) {
+            /* lagging (or starting): from the oldest change */
+            consecutive = 0;
+        }
+        for (; i < st->ring.ring_count && cnt < CLRING_STRESS_BATCH; i++) {
+            batch[cnt] = clcache_ring_entry(&st->ring, i);
+            batch[cnt]->re_refcnt++;
+            cnt++;
+        }
+        pthread_mutex_unlock(&st->lock);
+
+        for (i = 0; i < cnt; i++) {
+            size_t num = clring_test_num(batch[i]);
+
+            if (strcmp(batch[i]->re_key, (char *)batch[i]->re_data) != 0 ||
+                (started && num <= last) || ((consecutive || i > 0) && num != last + 1)) {
+                st->failed = 1;
+            }
+            last = num;
+            started = 1;
+        }
+        if (cnt) {
+            clring_test_key(last, anchor);
+        } else if (!done) {
+            sched_yield();
+        } else if (done && started && last != CLRING_STRESS_CHANGES - 1) {
+            st->failed = 1;
+            break;
+        }
+
+        pthread_mutex_lock(&st->lock);
+        for (i = 0; i < cnt; i++) {
+            clcache_ring_release_entry(batch[i]);
+        }
+        pthread_mutex_unlock(&st->lock);
+    }
+    return NULL;
+}
+
+void
+test_plugin_replication_clring_stress(void **state __attribute__((unused)))
+{
+    pthread_t readers[CLRING_STRESS_READERS];
+    pthread_t writer;
+    clring_stress st = {0};
+    size_t i;
+
+    clcache_ring_init(&st.ring, CLRING_STRESS_SIZE);
+    pthread_mutex_init(&st.lock, NULL);
+
+    for (i = 0; i < CLRING_STRESS_READERS; i++) {
+        assert_int_equal(pthread_create(&readers[i], NULL, clring_stress_reader, &st), 0);
+    }
+    assert_int_equal(pthread_create(&writer, NULL, clring_stress_writer, &st), 0);
+    pthread_join(writer, NULL);
+    for (i = 0; i < CLRING_STRESS_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    assert_int_equal(st.failed, 0);
+    assert_int_equal(st.ring.ring_count, CLRING_STRESS_SIZE);
+    assert_int_equal(clring_test_num(clcache_ring_entry(&st.ring, 0)),
+                     CLRING_STRESS_CHANGES - CLRING_STRESS_SIZE);
+
+    pthread_mutex_destroy(&st.lock);
+    clcache_ring_destroy(&st.ring);
+}
@@ -0,0 +1,206 @@
+/** BEGIN COPYRIGHT BLOCK
+ * Copyright (C) 2026 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * License: GPL (version 3 or any later version).
+ * See LICENSE for details.
+ * END COPYRIGHT BLOCK **/
+
+#include "../../test_slapd.h"
+
+#include <pthread.h>
+#include <csnpl.h>
+
+/* Normally provided by the replication plugin */
+char *repl_plugin_name = "csnpl-test";
+
+#define CSNPL_STRESS_THREADS 8
+#define CSNPL_STRESS_CSNS 20000
+
+static CSN *
+csnpl_test_csn(size_t i)
+{
+    CSN *csn = csn_new();
+    csn_set_replicaid(csn, 1);
+    csn_set_time(csn, 1000000 + (i / 65536));
+    csn_set_seqnum(csn, i % 65536);
+    return csn;
+}
+
+void
+test_plugin_replication_csnpl_rollup(void **state __attribute__((unused)))
+{
+    CSNPL *csnpl = csnplNew();
+    CSN *csns[6];
+    CSN *first = NULL;
+    CSN *max = NULL;
+    PRBool committed = PR_TRUE;
+    size_t i;
+
+    for (i = 0; i < 6; i++) {
+        csns[i] = csnpl_test_csn(i);
+    }
+    for (i = 0; i < 5; i++) {
+        assert_int_equal(csnplInsert(csnpl, csns[i], NULL), 0);
+    }
+    /* csns are inserted in ascending order only */
+    assert_int_equal(csnplInsert(csnpl, csns[2], NULL), 1);
+    assert_int_equal(csnplCommit(csnpl, csns[5]), -1);
+
+    /* nothing to roll up while the head is pending */
+    assert_int_equal(csnplCommit(csnpl, csns[2]), 0);
+    assert_null(csnplRollUp(csnpl, &first));
+    assert_null(first);
+
+    max = csnplGetMinCSN(csnpl, &committed);
+    assert_true(csn_is_equal(max, csns[0]));
+    assert_false(committed);
+    csn_free(&max);
+
+    assert_int_equal(csnplCommit(csnpl, csns[0]), 0);
+    max = csnplRollUp(csnpl, &first);
+    assert_true(csn_is_equal(max, csns[0]));
+    assert_ptr_equal(max, first);
+    csn_free(&max);
+
+    /* a removed csn does not hold the roll up */
+    assert_int_equal(csnplRemove(csnpl, csns[1]), 0);
+    assert_int_equal(csnplRemove(csnpl, csns[1]), -1);
+    max = csnplRollUp(csnpl, &first);
+    assert_true(csn_is_equal(max, csns[2]));
+    assert_true(csn_is_equal(first, csns[2]));
+    csn_free(&max);
+
+    /* removing the tail allows a smaller csn to be inserted */
+    assert_int_equal(csnplRemove(csnpl, csns[4]), 0);
+    assert_int_equal(csnplInsert(csnpl, csns[4], NULL), 0);
+    assert_int_equal(csnplCommit(csnpl, csns[4]), 0);
+    assert_int_equal(csnplCommit(csnpl, csns[3]), 0);
+    max = csnplRollUp(csnpl, &first);
+    assert_true(csn_is_equal(max, csns[4]));
+    assert_true(csn_is_equal(first, csns[3]));
+    csn_free(&first);
+    csn_free(&max);
+
+    assert_null(csnplGetMinCSN(csnpl, NULL));
+
+    for (i = 0; i < 6; i++) {
+        csn_free(&csns[i]);
+    }
+    csnplFree(&csnpl);
+}
+
+typedef struct csnpl_stress
+{
+    CSNPL *csnpl;
+    pthread_mutex_t gen_lock; /* stands for the csn generator */
+    size_t next;
+    size_t committed;
+    int done;
+    int failed; /* cmocka asserts only work in the test thread */
+} csnpl_stress;
+
+static void *
+csnpl_stress_writer(void *arg)
+{
+    csnpl_stress *st = (csnpl_stress *)arg;
+
+    while (1) {
+        CSN *csn;
+        size_t i;
+
+        pthread_mutex_lock(&st->gen_lock);
+        i = st->next++;
+        if (i >= CSNPL_STRESS_CSNS) {
+            pthread_mutex_unlock(&st->gen_lock);
+            break;
+        }
+        csn = csnpl_test_csn(i);
+        if (csnplInsert(st->csnpl, csn, NULL) != 0) {
+            st->failed = 1;
+        }
+        pthread_mutex_unlock(&st->gen_lock);
+
+        /* some operations fail and are cancelled */
+        if (i % 7 == 3) {
+            if (csnplRemove(st->csnpl, csn) != 0) {
+                st->failed = 1;
+            }
+        } else {
+            if (csnplCommit(st->csnpl, csn) != 0) {
+                st->failed = 1;
+            }
+            __atomic_add_fetch(&st->committed, 1, __ATOMIC_SEQ_CST);
+        }
+        csn_free(&csn);
+    }
+    return NULL;
+}
+
+static void *
+csnpl_stress_roller(void *arg)
+{
+    csnpl_stress *st = (csnpl_stress *)arg;
+    CSN *last = NULL;
+    int done = 0;
+
+    while (!done) {
+        CSN *first = NULL;
+        CSN *max;
+
+        done = __atomic_load_n(&st->done, __ATOMIC_SEQ_CST);
+        max = csnplRollUp(st->csnpl, &first);
+        if (max) {
+            /* roll ups only move forward */
+            if (first == NULL || csn_compare(first, max) > 0 ||
+                (last && csn_compare(last, first) >= 0)) {
+                st->failed = 1;
+            }
+            if (first != max) {
+                csn_free(&first);
+            }
+            csn_free(&last);
+            last = max;
+        }
+    }
+
+    /* everything was committed or removed: the last csn is the max */
+    {
+        CSN *expected = csnpl_test_csn(CSNPL_STRESS_CSNS - 1);
+        if (last == NULL || !csn_is_equal(last, expected)) {
+            st->failed = 1;
+        }
+        csn_free(&expected);
+    }
+    csn_free(&last);
+    return NULL;
+}
+
+void
+test_plugin_replication_csnpl_stress(void **state __attribute__((unused)))
+{
+    pthread_t writers[CSNPL_STRESS_THREADS];
+    pthread_t roller;
+    csnpl_stress st = {0};
+    size_t i;
+
+    st.csnpl = csnplNew();
+    pthread_mutex_init(&st.gen_lock, NULL);
+
+    assert_int_equal(pthread_create(&roller, NULL, csnpl_stress_roller, &st), 0);
+    for (i = 0; i < CSNPL_STRESS_THREADS; i++) {
+        assert_int_equal(pthread_create(&writers[i], NULL, csnpl_stress_writer, &st), 0);
+    }
+    for (i = 0; i < CSNPL_STRESS_THREADS; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    __atomic_store_n(&st.done, 1, __ATOMIC_SEQ_CST);
+    pthread_join(roller, NULL);
+
+    assert_int_equal(st.failed, 0);
+    assert_null(csnplGetMinCSN(st.csnpl, NULL));
+    assert_int_equal(st.committed, CSNPL_STRESS_CSNS - (CSNPL_STRESS_CSNS + 3) / 7);
+
+    pthread_mutex_destroy(&st.gen_lock);
+    csnplFree(&st.csnpl);
+}
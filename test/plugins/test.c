@@ -26,6 +26,11 @@ run_plugin_tests(void)
         cmocka_unit_test_setup_teardown(test_plugin_pwdstorage_pbkdf2_rounds,
                                         test_plugin_pwdstorage_nss_setup,
                                         test_plugin_pwdstorage_nss_stop),
+        cmocka_unit_test(test_plugin_replication_csnpl_rollup),
+        cmocka_unit_test(test_plugin_replication_csnpl_stress),
+        cmocka_unit_test(test_plugin_replication_clring_wraparound),
+        cmocka_unit_test(test_plugin_replication_clring_full),
+        cmocka_unit_test(test_plugin_replication_clring_stress),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -50,6 +50,10 @@ void test_libslapd_operation_v3c_target_spec(void **state);
 void test_libslapd_counters_atomic_usage(void **state);
 void test_libslapd_counters_atomic_overflow(void **state);
 
+/* libslapd-valueset-large */
+
+void test_libslapd_valueset_large(void **state);
+
 /* libslapd-pal-meminfo */
 
 void test_libslapd_pal_meminfo(void **state);
@@ -66,3 +70,14 @@ int test_plugin_pwdstorage_nss_stop(void **state);
 
 void test_plugin_pwdstorage_pbkdf2_auth(void **state);
 void test_plugin_pwdstorage_pbkdf2_rounds(void **state);
+
+/* plugin-replication-csnpl */
+
+void test_plugin_replication_csnpl_rollup(void **state);
+void test_plugin_replication_csnpl_stress(void **state);
+
+/* plugin-replication-clring */
+
+void test_plugin_replication_clring_wraparound(void **state);
+void test_plugin_replication_clring_full(void **state);
+void test_plugin_replication_clring_stress(void **state);